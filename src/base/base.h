@@ -24,15 +24,19 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef BASE_BASE_H
 #define BASE_BASE_H
 
+#include "cdict.h"
 #include "cmdline.h"
 #include "convert.h"
 #include "debug.h"
 #include "dict.h"
 #include "error.h"
+#include "expr.h"
 #include "helpers.h"
 #include "mem.h"
 #include "objpool.h"
 #include "operators.h"
+#include "resolver.h"
+#include "scope.h"
 #include "strlist.h"
 #include "strpool.h"
 
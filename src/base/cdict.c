@@ -0,0 +1,377 @@
+/** \file   cdict.c
+ * \brief   Concurrent dictionary
+ * \ingroup base
+ *
+ * Dictionary that can be shared between threads, for example a global symbol
+ * table filled by workers assembling modules in parallel.
+ *
+ * Keys are distributed over a number of shards by the upper bits of their
+ * hash. Each shard is an open addressing dict protected by its own
+ * readers-writer lock, so lookups only block on writers to the same shard and
+ * writers to different shards don't contend at all. Shards are cache line
+ * aligned so locking one shard doesn't bounce the lines of its neighbours.
+ *
+ * Lookups don't set \c base_errno when a key isn't found, so threads doing
+ * only lookups never write to shared state.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* for pthread_rwlock_t and posix_memalign() */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "dict.h"
+#include "dict_open.h"
+#include "error.h"
+#include "mem.h"
+
+#include "cdict.h"
+
+
+/** \brief  Size of a cache line, used to align shards
+ */
+#define CDICT_CACHE_LINE    64u
+
+
+/** \brief  Shard contents
+ */
+typedef struct cdict_shard_data_s {
+    pthread_rwlock_t    lock;   /**< lock protecting \c dict */
+    dict_t *            dict;   /**< dict holding the keys of the shard */
+} cdict_shard_data_t;
+
+
+/** \brief  Shard, padded to a multiple of the cache line size
+ */
+typedef union cdict_shard_u {
+    cdict_shard_data_t  s;      /**< shard data */
+    char                pad[((sizeof(cdict_shard_data_t) + CDICT_CACHE_LINE - 1u)
+                             / CDICT_CACHE_LINE) * CDICT_CACHE_LINE];
+                                /**< padding */
+} cdict_shard_t;
+
+
+/** \brief  Concurrent dictionary
+ */
+struct cdict_s {
+    cdict_shard_t * shards;     /**< shards, cache line aligned */
+    size_t          count;      /**< number of shards (power of two) */
+    unsigned int    shift;      /**< right shift of a hash to get its shard */
+};
+
+
+/** \brief  Get shard for \a hash
+ *
+ * Uses the upper bits of the hash, the open addressing table of the shard
+ * uses the lower bits.
+ *
+ * \param[in]   cdict   concurrent dict
+ * \param[in]   hash    hash of key
+ *
+ * \return  shard data
+ */
+static cdict_shard_data_t *get_shard(cdict_t *cdict, uint32_t hash)
+{
+    size_t index = cdict->count > 1u ? (size_t)(hash >> cdict->shift) : 0;
+
+    return &cdict->shards[index].s;
+}
+
+
+/** \brief  Create new concurrent dict
+ *
+ * \param[in]   shards  number of shards, rounded up to a power of two and
+ *                      clamped to #CDICT_MAX_SHARDS, 0 for the default of
+ *                      #CDICT_DEFAULT_SHARDS
+ *
+ * \return  new concurrent dict, free with cdict_free()
+ */
+cdict_t *cdict_new(size_t shards)
+{
+    cdict_t *cdict;
+    void *mem = NULL;
+    size_t count = 1;
+    unsigned int bits = 0;
+
+    if (shards == 0) {
+        shards = CDICT_DEFAULT_SHARDS;
+    } else if (shards > CDICT_MAX_SHARDS) {
+        shards = CDICT_MAX_SHARDS;
+    }
+    while (count < shards) {
+        count <<= 1u;
+        bits++;
+    }
+
+    if (posix_memalign(&mem, CDICT_CACHE_LINE, count * sizeof(cdict_shard_t)) != 0) {
+        fprintf(stderr, "%s: failed to allocate %zu bytes, exiting.\n",
+                __func__, count * sizeof(cdict_shard_t));
+        exit(EXIT_FAILURE);
+    }
+
+    cdict = base_malloc(sizeof *cdict);
+    cdict->shards = mem;
+    cdict->count = count;
+    cdict->shift = 32u - bits;
+    for (size_t i = 0; i < count; i++) {
+        pthread_rwlock_init(&cdict->shards[i].s.lock, NULL);
+        cdict->shards[i].s.dict = dict_new_backend(DICT_BACKEND_OPEN, 0);
+    }
+    return cdict;
+}
+
+
+/** \brief  Free concurrent dict
+ *
+ * Must not be called while other threads are still using \a cdict.
+ *
+ * \param[in,out]   cdict   concurrent dict
+ */
+void cdict_free(cdict_t *cdict)
+{
+    for (size_t i = 0; i < cdict->count; i++) {
+        pthread_rwlock_destroy(&cdict->shards[i].s.lock);
+        dict_free(cdict->shards[i].s.dict);
+    }
+    free(cdict->shards);
+    base_free(cdict);
+}
+
+
+/** \brief  Get number of items in concurrent dict
+ *
+ * The shards are counted one after the other, so with concurrent writers the
+ * result is only an approximation.
+ *
+ * \param[in]   cdict   concurrent dict
+ *
+ * \return  number of items
+ */
+size_t cdict_size(cdict_t *cdict)
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < cdict->count; i++) {
+        cdict_shard_data_t *shard = &cdict->shards[i].s;
+
+        pthread_rwlock_rdlock(&shard->lock);
+        size += dict_size(shard->dict);
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return size;
+}
+
+
+/** \brief  Get value of \a entry for handing out to the caller
+ *
+ * String values are copied, since the dict's copy can be freed by another
+ * thread as soon as the shard lock is released.
+ *
+ * \param[in]   entry   dict entry, shard lock must be held
+ *
+ * \return  value, heap-allocated for a #DICT_ITEM_STR item
+ */
+static dict_value_t entry_value(const dict_open_entry_t *entry)
+{
+    if (entry->type == DICT_ITEM_STR) {
+        return base_strdup(entry->value);
+    }
+    return entry->value;
+}
+
+
+/** \brief  Set item in concurrent dict
+ *
+ * Adds the item or replaces the value and type of an existing item.
+ *
+ * \param[in,out]   cdict   concurrent dict
+ * \param[in]       key     item key
+ * \param[in]       value   item value
+ * \param[in]       type    item type
+ *
+ * \return  `true` on success
+ * \throw   BASE_ERR_KEY    \a key is `NULL` or empty
+ * \throw   BASE_ERR_ENUM   \a type is invalid
+ */
+bool cdict_set(cdict_t *cdict,
+               const char *key,
+               dict_value_t value,
+               dict_type_t type)
+{
+    cdict_shard_data_t *shard;
+    uint32_t hash;
+    bool result;
+
+    if (key == NULL || *key == '\0') {
+        base_errno = BASE_ERR_KEY;
+        return false;
+    }
+    hash = dict_hash_key(key);
+    shard = get_shard(cdict, hash);
+
+    pthread_rwlock_wrlock(&shard->lock);
+    result = dict_set_hashed(shard->dict, key, hash, value, type);
+    pthread_rwlock_unlock(&shard->lock);
+    return result;
+}
+
+
+/** \brief  Add item to concurrent dict unless its key is already present
+ *
+ * The check and the insertion are atomic, so when multiple threads add the
+ * same key exactly one of them succeeds.
+ *
+ * \param[in,out]   cdict       concurrent dict
+ * \param[in]       key         item key
+ * \param[in]       value       item value
+ * \param[in]       type        item type
+ * \param[out]      existing    value of the existing item (optional), a
+ *                              #DICT_ITEM_STR value is a copy that must be
+ *                              freed with base_free()
+ *
+ * \return  `true` if the item was added, `false` if \a key was already
+ *          present or on error
+ * \throw   BASE_ERR_KEY    \a key is `NULL` or empty
+ * \throw   BASE_ERR_ENUM   \a type is invalid
+ */
+bool cdict_add(cdict_t *cdict,
+               const char *key,
+               dict_value_t value,
+               dict_type_t type,
+               dict_value_t *existing)
+{
+    cdict_shard_data_t *shard;
+    const dict_open_entry_t *entry;
+    uint32_t hash;
+    bool result;
+
+    if (key == NULL || *key == '\0') {
+        base_errno = BASE_ERR_KEY;
+        return false;
+    }
+    hash = dict_hash_key(key);
+    shard = get_shard(cdict, hash);
+
+    pthread_rwlock_wrlock(&shard->lock);
+    entry = dict_open_find(shard->dict->open, key, hash);
+    if (entry != NULL) {
+        if (existing != NULL) {
+            *existing = entry_value(entry);
+        }
+        result = false;
+    } else {
+        result = dict_set_hashed(shard->dict, key, hash, value, type);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    return result;
+}
+
+
+/** \brief  Get item from concurrent dict
+ *
+ * The value of a #DICT_ITEM_STR item is a copy, made while the item is
+ * locked, which must be freed with base_free().
+ *
+ * Doesn't set \c base_errno when \a key isn't found.
+ *
+ * \param[in]   cdict   concurrent dict
+ * \param[in]   key     item key
+ * \param[out]  value   item value (optional)
+ * \param[out]  type    item type (optional)
+ *
+ * \return  `true` if \a key was found
+ */
+bool cdict_get(cdict_t *cdict,
+               const char *key,
+               dict_value_t *value,
+               dict_type_t *type)
+{
+    cdict_shard_data_t *shard;
+    const dict_open_entry_t *entry;
+    uint32_t hash;
+
+    if (key == NULL || *key == '\0') {
+        return false;
+    }
+    hash = dict_hash_key(key);
+    shard = get_shard(cdict, hash);
+
+    pthread_rwlock_rdlock(&shard->lock);
+    entry = dict_open_find(shard->dict->open, key, hash);
+    if (entry != NULL) {
+        if (value != NULL) {
+            *value = entry_value(entry);
+        }
+        if (type != NULL) {
+            *type = entry->type;
+        }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    return entry != NULL;
+}
+
+
+/** \brief  Check if key is present in concurrent dict
+ *
+ * \param[in]   cdict   concurrent dict
+ * \param[in]   key     key
+ *
+ * \return  `true` if \a key was found
+ */
+bool cdict_has_key(cdict_t *cdict, const char *key)
+{
+    return cdict_get(cdict, key, NULL, NULL);
+}
+
+
+/** \brief  Remove item from concurrent dict
+ *
+ * \param[in,out]   cdict   concurrent dict
+ * \param[in]       key     item key
+ *
+ * \return  `true` if the item was removed
+ * \throw   BASE_ERR_KEY    \a key is `NULL`, empty or not found
+ */
+bool cdict_remove(cdict_t *cdict, const char *key)
+{
+    cdict_shard_data_t *shard;
+    bool result;
+
+    if (key == NULL || *key == '\0') {
+        base_errno = BASE_ERR_KEY;
+        return false;
+    }
+    shard = get_shard(cdict, dict_hash_key(key));
+
+    pthread_rwlock_wrlock(&shard->lock);
+    result = dict_remove(shard->dict, key);
+    pthread_rwlock_unlock(&shard->lock);
+    if (!result) {
+        base_errno = BASE_ERR_KEY;
+    }
+    return result;
+}
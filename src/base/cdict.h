@@ -0,0 +1,67 @@
+/** \file   cdict.h
+ * \brief   Concurrent dictionary - header
+ * \ingroup base
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BASE_CDICT_H
+#define BASE_CDICT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "dict.h"
+
+/** \brief  Default number of shards
+ */
+#define CDICT_DEFAULT_SHARDS    64u
+
+/** \brief  Maximum number of shards
+ */
+#define CDICT_MAX_SHARDS        4096u
+
+
+/** \brief  Concurrent dictionary, opaque
+ */
+typedef struct cdict_s cdict_t;
+
+
+cdict_t *   cdict_new   (size_t shards);
+void        cdict_free  (cdict_t *cdict);
+size_t      cdict_size  (cdict_t *cdict);
+
+bool        cdict_set   (cdict_t *cdict,
+                         const char *key,
+                         dict_value_t value,
+                         dict_type_t type);
+bool        cdict_add   (cdict_t *cdict,
+                         const char *key,
+                         dict_value_t value,
+                         dict_type_t type,
+                         dict_value_t *existing);
+bool        cdict_get   (cdict_t *cdict,
+                         const char *key,
+                         dict_value_t *value,
+                         dict_type_t *type);
+bool        cdict_has_key(cdict_t *cdict, const char *key);
+bool        cdict_remove(cdict_t *cdict, const char *key);
+
+#endif
@@ -1,5 +1,9 @@
 /** \file   cmdline.c
  * \brief   Commandline handling
+ *
+ * The registered options and program information are kept per thread, so a
+ * thread can set up and parse its own command line without interfering with
+ * other threads.
  */
 
 /*
@@ -29,6 +33,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "convert.h"
 #include "debug.h"
+#include "helpers.h"
 #include "mem.h"
 #include "strlist.h"
 
@@ -58,48 +63,48 @@ static bool cmdline_add_option(const cmdline_option_t *option);
  *
  * Used for display during --help, --version and error message
  */
-static char *prg_name = NULL;
+static BASE_THREAD_LOCAL char *prg_name = NULL;
 
 
 /** \brief  Program version
  *
  * Used for displaying --version
  */
-static char *prg_version = NULL;
+static BASE_THREAD_LOCAL char *prg_version = NULL;
 
 
 /** \brief  Prologue function to call for --help (optional)
  */
-static void (*prologue)(void) = NULL;
+static BASE_THREAD_LOCAL void (*prologue)(void) = NULL;
 
 
 /** \brief  Epilogue function to call for --help (optional)
  *
  * Called after listing the register command line options
  */
-static void (*epilogue)(void) = NULL;
+static BASE_THREAD_LOCAL void (*epilogue)(void) = NULL;
 
 
 /** \brief  List of registered options
  */
-static cmdline_option_t **option_list = NULL;
+static BASE_THREAD_LOCAL cmdline_option_t **option_list = NULL;
 
 
 /** \brief  Size of the \c options_list
  */
-static size_t option_list_size = 0;
+static BASE_THREAD_LOCAL size_t option_list_size = 0;
 
 
 /** \brief  Number of used entries in the \c options_list
  */
-static size_t option_list_used = 0;
+static BASE_THREAD_LOCAL size_t option_list_used = 0;
 
 /** \brief  Pointer to the strlist_t passed to cmdline_parse()
  *
  * Used to free the arguments collected by the parser when calling
  * cmdline_exit(). To keep the argument list, use strlist_dup() (TODO).
  */
-static strlist_t **args_list = NULL;
+static BASE_THREAD_LOCAL strlist_t **args_list = NULL;
 
 
 /** \brief  Initialize the command line options list
@@ -1719,12 +1719,13 @@ static const opcode_table_t opcode_tables[]= {
 
 /** \brief  CPU type
  *
- * CPU type used to access an opcode table.
+ * CPU type used to access an opcode table. Each thread has its own CPU type,
+ * so worker threads can disassemble code for different CPUs at the same time.
  *
  * \see opcode_set_cpu_type
  * \see opcode_get_cpu_type
  */
-static cpu_type_t opcode_cpu_type = CPU_65XX;
+static BASE_THREAD_LOCAL cpu_type_t opcode_cpu_type = CPU_65XX;
 
 
 /** \brief  Set CPU type
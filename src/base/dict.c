@@ -25,20 +25,54 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stddef.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "debug.h"
 #include "error.h"
 #include "hash.h"
+#include "helpers.h"
 #include "mem.h"
 
 #include "dict.h"
+#include "dict_open.h"
 
-/** \brief  Hashmap size in bits
+/** \brief  Increment lookup counter \a FIELD of \a DICT
  *
- * For now we'll use < 16 and the fnv-1a-tiny hash function.
+ * Compiles to nothing unless `HAVE_DICT_STATS` is defined.
+ *
+ * \param[in]   DICT    dict
+ * \param[in]   FIELD   member of dict_counters_t
+ */
+#ifdef HAVE_DICT_STATS
+# define DICT_COUNT(DICT, FIELD)    ((DICT)->counters->FIELD++)
+#else
+# define DICT_COUNT(DICT, FIELD)
+#endif
+
+/** \brief  Number of keys hashed and prefetched at a time by the batch functions
+ *
+ * Large enough to hide memory latency, small enough for the prefetched cache
+ * lines to still be around when the keys get resolved.
  */
-#define HASHMAP_SIZE_BITS  10u
+#define DICT_BATCH_SIZE     16u
+
+/** \brief  Minimum hashmap size in bits
+ */
+#define DICT_MIN_BITS       4u
+
+/** \brief  Maximum hashmap size in bits
+ */
+#define DICT_MAX_BITS       30u
+
+/** \brief  Number of buckets moved to the new hashmap per modifying operation
+ *
+ * When growing, items are moved from the old hashmap a few buckets at a time
+ * instead of all at once to avoid latency spikes on insertion. Moving more
+ * than one bucket per insertion guarantees rehashing finishes well before the
+ * new hashmap needs to grow.
+ */
+#define DICT_REHASH_STEPS   4u
 
 
 /** \brief  Type names table
@@ -50,18 +84,35 @@ static const char *type_names[] = {
 };
 
 
-/** \brief  Calculate hash of a key
+/** \brief  Check key for validity
  *
- * \param[in]   dict    dict
- * \param[in]   key     key name
+ * \param[in]   key     key
  *
- * \return  fnv-1a hash of \a key
+ * \return  `true` if \a key is valid
+ * \throw   BASE_ERR_KEY    \a key is `NULL` or empty
  */
-static uint32_t calc_hash(const dict_t *dict, const char *key)
+static bool valid_key(const char *key)
 {
-    /* To easily test the collision handling of the code, make this always
-     * return 0 and rebuild. */
-    return hash_fnv1_tiny((const uint8_t *)key, strlen(key), dict->bits);
+    if (key == NULL || *key == '\0') {
+        base_errno = BASE_ERR_KEY;
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Fold hash into index in a hashmap of \a bits
+ *
+ * Same folding as used by hash_fnv1_tiny().
+ *
+ * \param[in]   hash    32-bit hash
+ * \param[in]   bits    size of the hashmap in bits
+ *
+ * \return  bucket index
+ */
+static uint32_t hash_index(uint32_t hash, uint32_t bits)
+{
+    return ((hash >> bits) ^ hash) & ((1u << bits) - 1u);
 }
 
 
@@ -70,13 +121,17 @@ static uint32_t calc_hash(const dict_t *dict, const char *key)
  * Allocate memory for item, copy key name and set item type to 'undefined'.
  *
  * \param[in]   key     item key
+ * \param[in]   hash    hash of \a key
  * \param[in]   value   item value
  * \param[in]   type    item type
  *
  * \return  new item or `NULL` on failure
  * \throw   BASE_ERR_KEY    \a key is `NULL` or empty
  */
-static dict_item_t *dict_item_new(const char *key, dict_value_t value, int type)
+static dict_item_t *dict_item_new(const char *key,
+                                  uint32_t hash,
+                                  dict_value_t value,
+                                  int type)
 {
     dict_item_t *item;
 
@@ -88,6 +143,7 @@ static dict_item_t *dict_item_new(const char *key, dict_value_t value, int type)
     item = base_malloc(sizeof *item);
 
     item->key = base_strdup(key);
+    item->hash = hash;
     item->type = type;
     if (type == DICT_ITEM_STR) {
         item->value = base_strdup((const char *)value);
@@ -125,6 +181,109 @@ static void dict_item_free(dict_item_t *item)
 }
 
 
+/** \brief  Allocate hashmap of \a size empty buckets
+ *
+ * \param[in]   size    number of buckets
+ *
+ * \return  hashmap
+ */
+static dict_item_t **hashmap_new(size_t size)
+{
+    return base_calloc(size, sizeof(dict_item_t *));
+}
+
+
+/** \brief  Free all items in hashmap \a items of \a size buckets
+ *
+ * \param[in]   items   hashmap
+ * \param[in]   size    number of buckets
+ */
+static void hashmap_clear(dict_item_t **items, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (items[i] != NULL) {
+            dict_item_free(items[i]);
+            items[i] = NULL;
+        }
+    }
+}
+
+
+/** \brief  Prepend \a item to the list at \a bucket
+ *
+ * \param[in,out]   bucket  list head
+ * \param[in,out]   item    item to add
+ */
+static void bucket_push(dict_item_t **bucket, dict_item_t *item)
+{
+    item->prev = NULL;
+    item->next = *bucket;
+    if (*bucket != NULL) {
+        (*bucket)->prev = item;
+    }
+    *bucket = item;
+}
+
+
+/** \brief  Move up to \a steps buckets from the old hashmap to the new one
+ *
+ * Frees the old hashmap when all its buckets have been moved.
+ *
+ * \param[in,out]   dict    dict
+ * \param[in]       steps   number of buckets to move
+ */
+static void rehash_step(dict_t *dict, size_t steps)
+{
+    while (dict->old_items != NULL && steps-- > 0) {
+        dict_item_t *item = dict->old_items[dict->rehash_index];
+
+        while (item != NULL) {
+            dict_item_t *next = item->next;
+            uint32_t index = hash_index(item->hash, dict->bits);
+
+            bucket_push(&dict->items[index], item);
+            item = next;
+        }
+        dict->old_items[dict->rehash_index++] = NULL;
+
+        if (dict->rehash_index == dict->old_size) {
+            base_free(dict->old_items);
+            dict->old_items = NULL;
+            dict->old_size = 0;
+            dict->old_bits = 0;
+            dict->rehash_index = 0;
+        }
+    }
+}
+
+
+/** \brief  Start growing the hashmap of \a dict if the load factor requires it
+ *
+ * The hashmap is doubled in size when the number of items reaches the number
+ * of buckets. The items are moved to the new hashmap by rehash_step().
+ *
+ * \param[in,out]   dict    dict
+ */
+static void maybe_grow(dict_t *dict)
+{
+    if (dict->count < dict->size || dict->bits >= DICT_MAX_BITS) {
+        return;
+    }
+    /* still moving items from a previous resize: finish that first */
+    rehash_step(dict, dict->old_size);
+
+    dict->old_items = dict->items;
+    dict->old_size = dict->size;
+    dict->old_bits = dict->bits;
+    dict->rehash_index = 0;
+
+    dict->bits++;
+    dict->size = 1u << dict->bits;
+    dict->items = hashmap_new(dict->size);
+    dict->rehashes++;
+}
+
+
 /** \brief  Get dict value type name
  *
  * \param[in]   type    dict value type
@@ -144,68 +303,195 @@ const char *dict_type_name(dict_type_t type)
 
 /** \brief  Find item by key
  *
- * Find item in \a dict at \a key, optionally storing the hash of the key at
- * \a hash_result.
- * The \a hash_result argument can be used to avoid having to calculate the hash
- * of a key twice (as in dict_remove()), use `NULL` to ignore the hash result.
+ * Find item in \a dict at \a key, optionally storing a pointer to the head of
+ * the list containing the item at \a bucket_result.
+ * While the dict is growing the item can be in either the new or the old
+ * hashmap; \a bucket_result is needed to unlink the item (as in
+ * dict_remove()), use `NULL` to ignore it.
+ *
+ * The stored hashes are compared first, so keys are only compared when the
+ * hashes match.
  *
- * \param[in]   dict        dict
- * \param[in]   key         item key
- * \param[out]  hash_result hash result (optional)
+ * \param[in]   dict            dict
+ * \param[in]   key             item key
+ * \param[in]   hash            hash of \a key
+ * \param[out]  bucket_result   list head of the item (optional)
  *
  * \return  item or `NULL` when not found
- * \throw   BASE_ERR_KEY    \a key is `NULL` or empty
  */
 static dict_item_t *find_item(const dict_t *dict,
                               const char *key,
-                              uint32_t *hash_result)
+                              uint32_t hash,
+                              dict_item_t ***bucket_result)
 {
+    dict_item_t **bucket;
     dict_item_t *item;
-    uint32_t hash;
-
-    if (key == NULL || *key == '\0') {
-        base_errno = BASE_ERR_KEY;
-        return NULL;
-    }
 
-    hash = calc_hash(dict, key);
-    if (hash_result != NULL) {
-        *hash_result = hash;
-    }
-
-    item = dict->items[hash];
-    while (item != NULL) {
-        if (strcmp(key, item->key) == 0) {
+    bucket = &dict->items[hash_index(hash, dict->bits)];
+    for (item = *bucket; item != NULL; item = item->next) {
+        if (item->hash == hash && strcmp(key, item->key) == 0) {
             break;
         }
-        item = item->next;
+    }
+    if (item == NULL && dict->old_items != NULL) {
+        bucket = &dict->old_items[hash_index(hash, dict->old_bits)];
+        for (item = *bucket; item != NULL; item = item->next) {
+            if (item->hash == hash && strcmp(key, item->key) == 0) {
+                break;
+            }
+        }
+    }
+    if (item != NULL && bucket_result != NULL) {
+        *bucket_result = bucket;
     }
     return item;
 }
 
 
-/** \brief  Create new empty dict
+/** \brief  Calculate hash of \a len bytes of \a data
+ *
+ * Gives the same result as dict_hash_key() for a key of \a len characters,
+ * for callers that hash names that aren't NUL-terminated or whose length is
+ * already known, such as the string pool.
  *
- * Create an empty dict object and initialize to empty.
+ * XXH64 xor-folded into 32 bits.
  *
- * \todo    Perhaps allow setting a hashmap size?
+ * \param[in]   data    data
+ * \param[in]   len     number of bytes in \a data
+ *
+ * \return  hash
+ */
+uint32_t dict_hash_bytes(const void *data, size_t len)
+{
+    uint64_t hash;
+
+    /* To easily test the collision handling of the code, make this always
+     * return 0 and rebuild. */
+    hash = hash_xx64(data, len, 0);
+    return (uint32_t)(hash ^ (hash >> 32u));
+}
+
+
+/** \brief  Calculate hash of a key
+ *
+ * The hash used internally by dicts. Callers that need to look up the same
+ * key repeatedly, or that already hashed the key with this function, can pass
+ * the result to the dict_*_hashed() functions to avoid hashing it again.
+ *
+ * \param[in]   key     key
+ *
+ * \return  hash of \a key
+ */
+uint32_t dict_hash_key(const char *key)
+{
+    return dict_hash_bytes(key, strlen(key));
+}
+
+
+/** \brief  Allocate lookup counters when compiled with `HAVE_DICT_STATS`
+ *
+ * \return  zeroed counters or `NULL`
+ */
+static dict_counters_t *counters_new(void)
+{
+#ifdef HAVE_DICT_STATS
+    return base_calloc(1, sizeof(dict_counters_t));
+#else
+    return NULL;
+#endif
+}
+
+
+/** \brief  Create new empty dict
+ *
+ * Create an empty dict object and initialize to empty. The hashmap grows
+ * when items are added.
  *
  * \return  new dict
  */
 dict_t *dict_new(void)
+{
+    return dict_new_size(0);
+}
+
+
+/** \brief  Create new empty dict sized for \a hint items
+ *
+ * Create an empty dict with a hashmap large enough to hold \a hint items
+ * without having to grow.
+ *
+ * \param[in]   hint    expected number of items
+ *
+ * \return  new dict
+ */
+dict_t *dict_new_size(size_t hint)
 {
     dict_t *dict = base_malloc(sizeof *dict);
 
-    dict->bits = HASHMAP_SIZE_BITS;
+    dict->bits = DICT_MIN_BITS;
+    while ((1u << dict->bits) <= hint && dict->bits < DICT_MAX_BITS) {
+        dict->bits++;
+    }
     dict->size = 1u << dict->bits;
     dict->count = 0;
     dict->collisions = 0;
+    dict->items = hashmap_new(dict->size);
+
+    dict->old_items = NULL;
+    dict->old_size = 0;
+    dict->old_bits = 0;
+    dict->rehash_index = 0;
+    dict->rehashes = 0;
+
+    dict->backend = DICT_BACKEND_CHAINED;
+    dict->open = NULL;
+    dict->counters = counters_new();
 
-    dict->items = base_malloc(sizeof *(dict->items) * dict->size);
-    for (size_t i = 0; i < dict->size; i++) {
-        dict->items[i] = NULL;
+    return dict;
+}
+
+
+/** \brief  Create new empty dict using \a backend
+ *
+ * The #DICT_BACKEND_OPEN backend stores entries in a dense array indexed by
+ * an open addressing hash table, which avoids an allocation per item and
+ * pointer chasing on lookups. It's the better choice for large dicts that
+ * see a lot of lookups, such as symbol tables.
+ *
+ * \param[in]   backend storage backend
+ * \param[in]   hint    expected number of items
+ *
+ * \return  new dict or `NULL` on error
+ * \throw   BASE_ERR_ENUM   \a backend is invalid
+ */
+dict_t *dict_new_backend(dict_backend_t backend, size_t hint)
+{
+    dict_t *dict;
+
+    switch (backend) {
+        case DICT_BACKEND_CHAINED:
+            return dict_new_size(hint);
+        case DICT_BACKEND_OPEN:
+            break;
+        default:
+            base_errno = BASE_ERR_ENUM;
+            return NULL;
     }
 
+    dict = base_malloc(sizeof *dict);
+    dict->items = NULL;
+    dict->size = 0;
+    dict->bits = 0;
+    dict->count = 0;
+    dict->collisions = 0;
+    dict->old_items = NULL;
+    dict->old_size = 0;
+    dict->old_bits = 0;
+    dict->rehash_index = 0;
+    dict->rehashes = 0;
+    dict->backend = DICT_BACKEND_OPEN;
+    dict->open = dict_open_new(hint);
+    dict->counters = counters_new();
     return dict;
 }
 
@@ -218,12 +504,18 @@ dict_t *dict_new(void)
  */
 void dict_free(dict_t *dict)
 {
-    for (size_t i = 0; i < dict->size; i++) {
-        if (dict->items[i] != NULL) {
-            dict_item_free(dict->items[i]);
-        }
+    base_free(dict->counters);
+    if (dict->open != NULL) {
+        dict_open_free(dict->open);
+        base_free(dict);
+        return;
     }
+    hashmap_clear(dict->items, dict->size);
     base_free(dict->items);
+    if (dict->old_items != NULL) {
+        hashmap_clear(dict->old_items, dict->old_size);
+        base_free(dict->old_items);
+    }
     base_free(dict);
 }
 
@@ -235,12 +527,10 @@ void dict_free(dict_t *dict)
  * \param[in]   dict
  *
  * \return  number of items in \a dict
- *
- * \todo    Add unit test for this function
  */
 size_t dict_size(const dict_t *dict)
 {
-    return dict->size;
+    return dict->count;
 }
 
 
@@ -265,11 +555,38 @@ bool dict_set(dict_t *dict,
               dict_value_t value,
               dict_type_t type)
 {
-    uint32_t hash;
+    if (!valid_key(key)) {
+        return false;
+    }
+    return dict_set_hashed(dict, key, dict_hash_key(key), value, type);
+}
+
+
+/** \brief  Set dict item using a precomputed hash
+ *
+ * Like dict_set(), but takes the hash of \a key as obtained with
+ * dict_hash_key().
+ *
+ * \param[in]   dict    dict
+ * \param[in]   key     item key
+ * \param[in]   hash    hash of \a key
+ * \param[in]   value   item value
+ * \param[in]   type    item type
+ *
+ * \return  `true` on success
+ * \throw   BASE_ERR_KEY    \a key is `NULL` or empty
+ * \throw   BASE_ERR_ENUM   \a type is invalid
+ */
+bool dict_set_hashed(dict_t *dict,
+                     const char *key,
+                     uint32_t hash,
+                     dict_value_t value,
+                     dict_type_t type)
+{
+    dict_item_t **bucket;
     dict_item_t *node;
 
-    if (key == NULL || *key == '\0') {
-        base_errno = BASE_ERR_KEY;
+    if (!valid_key(key)) {
         return false;
     }
     if (type < 0 || type > DICT_ITEM_PTR) {
@@ -277,52 +594,48 @@ bool dict_set(dict_t *dict,
         return false;
     }
 
-    hash = calc_hash(dict, key);
-    //base_debug("hash of '%s' is 0x%"PRIx32, key, hash);
-    node = dict->items[hash];
-    if (node == NULL) {
-        //base_debug("creating first node of list");
-        dict->items[hash] = dict_item_new(key, value, type);
-        dict->count++;
-    } else {
-        /* we've got a hash collision, find tail of linked list to add item or
-         * update value of existing item */
-        dict_item_t *prev = node->prev;
-        //base_debug("hash collision, iterating list to add item");
-        while (node != NULL) {
-
-            if (strcmp(key, node->key) == 0) {
-                /* found key: replace value and update type */
-                //base_debug("found key, replacing value");
-
-                if (node->type == DICT_ITEM_STR && node->value != NULL) {
-                    /* free old string string */
-                    base_free(node->value);
-                }
+    if (dict->open != NULL) {
+        dict_open_entry_t *entry = dict_open_find(dict->open, key, hash);
 
-                /* set value and type */
-                if (type == DICT_ITEM_STR) {
-                    node->value = base_strdup(value);
-                }
-                node->type = type;
-                return true;
-            }
-            prev = node;
-            node = node->next;
+        if (entry == NULL) {
+            entry = dict_open_insert(dict->open, key, hash);
+            dict->count++;
+        } else if (entry->type == DICT_ITEM_STR) {
+            base_free(entry->value);
         }
+        entry->type = type;
+        entry->value = type == DICT_ITEM_STR ? base_strdup(value) : value;
+        return true;
+    }
 
-        /* different key but with same hash */
-        //base_debug("key not found, adding item to list");
-        dict->collisions++;
-        dict->count++;  /* don't forget this! */
-
-        /* create new node, add to tail of list */
-        node = dict_item_new(key, value, type);
-        node->prev = prev;
-        prev->next = node;
+    rehash_step(dict, DICT_REHASH_STEPS);
 
+    node = find_item(dict, key, hash, NULL);
+    if (node != NULL) {
+        /* found key: replace value and update type */
+        if (node->type == DICT_ITEM_STR && node->value != NULL) {
+            /* free old string string */
+            base_free(node->value);
+        }
+        if (type == DICT_ITEM_STR) {
+            node->value = base_strdup(value);
+        } else {
+            node->value = value;
+        }
+        node->type = type;
+        return true;
     }
 
+    maybe_grow(dict);
+
+    /* new items always go into the current hashmap */
+    bucket = &dict->items[hash_index(hash, dict->bits)];
+    if (*bucket != NULL) {
+        /* different key but with same hash */
+        dict->collisions++;
+    }
+    bucket_push(bucket, dict_item_new(key, hash, value, type));
+    dict->count++;
     return true;
 }
 
@@ -346,12 +659,65 @@ bool dict_get(const dict_t *dict,
               dict_value_t *value,
               dict_type_t *type)
 {
-    const dict_item_t *item = find_item(dict, key, NULL);
+    if (!valid_key(key)) {
+        return false;
+    }
+    return dict_get_hashed(dict, key, dict_hash_key(key), value, type);
+}
+
 
+/** \brief  Retrieve item value from dict using a precomputed hash
+ *
+ * Like dict_get(), but takes the hash of \a key as obtained with
+ * dict_hash_key().
+ *
+ * \param[in]   dict    dict
+ * \param[in]   key     item key
+ * \param[in]   hash    hash of \a key
+ * \param[out]  value   item value (optional)
+ * \param[out]  type    item type (optional)
+ *
+ * \return  `true` if \a key was found
+ * \throw   BASE_ERR_KEY    \a key is `NULL` or empty, or not found
+ */
+bool dict_get_hashed(const dict_t *dict,
+                     const char *key,
+                     uint32_t hash,
+                     dict_value_t *value,
+                     dict_type_t *type)
+{
+    const dict_item_t *item;
+
+    if (!valid_key(key)) {
+        return false;
+    }
+    DICT_COUNT(dict, lookups);
+
+    if (dict->open != NULL) {
+        const dict_open_entry_t *entry = dict_open_find(dict->open, key, hash);
+
+        if (entry == NULL) {
+            DICT_COUNT(dict, misses);
+            base_errno = BASE_ERR_KEY;
+            return false;
+        }
+        DICT_COUNT(dict, hits);
+        if (value != NULL) {
+            *value = entry->value;
+        }
+        if (type != NULL) {
+            *type = entry->type;
+        }
+        return true;
+    }
+
+    item = find_item(dict, key, hash, NULL);
     if (item == NULL) {
+        DICT_COUNT(dict, misses);
         base_errno = BASE_ERR_KEY;
         return false;
     }
+    DICT_COUNT(dict, hits);
     if (value != NULL) {
         *value = item->value;
     }
@@ -362,6 +728,128 @@ bool dict_get(const dict_t *dict,
 }
 
 
+/** \brief  Hash a batch of keys and prefetch the memory their lookups touch
+ *
+ * \param[in]   dict    dict
+ * \param[in]   keys    keys
+ * \param[in]   count   number of keys (at most #DICT_BATCH_SIZE)
+ * \param[out]  hashes  hashes of \a keys, 0 for invalid keys
+ */
+static void batch_prefetch(const dict_t *dict,
+                           const char * const *keys,
+                           size_t count,
+                           uint32_t *hashes)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (keys[i] == NULL || *keys[i] == '\0') {
+            hashes[i] = 0;
+            continue;
+        }
+        hashes[i] = dict_hash_key(keys[i]);
+        if (dict->open != NULL) {
+            dict_open_prefetch(dict->open, hashes[i]);
+        } else {
+            BASE_PREFETCH(&dict->items[hash_index(hashes[i], dict->bits)]);
+        }
+    }
+    if (dict->open == NULL) {
+        /* second stage: the heads of the lists are (being) loaded by now */
+        for (size_t i = 0; i < count; i++) {
+            BASE_PREFETCH(dict->items[hash_index(hashes[i], dict->bits)]);
+        }
+    }
+}
+
+
+/** \brief  Retrieve values of multiple keys from dict
+ *
+ * Batched version of dict_get(): keys are hashed and the memory needed to
+ * look them up is prefetched a batch at a time before resolving them, so the
+ * cache misses of different keys overlap instead of being taken one after
+ * the other.
+ *
+ * For keys that aren't found the value is set to `NULL` and the type to
+ * #DICT_ITEM_ERR.
+ *
+ * \param[in]   dict    dict
+ * \param[in]   keys    keys to look up
+ * \param[in]   count   number of keys
+ * \param[out]  values  values of \a keys (optional)
+ * \param[out]  types   types of \a keys (optional)
+ *
+ * \return  number of keys found
+ */
+size_t dict_get_many(const dict_t *dict,
+                     const char * const *keys,
+                     size_t count,
+                     dict_value_t *values,
+                     dict_type_t *types)
+{
+    uint32_t hashes[DICT_BATCH_SIZE];
+    size_t found = 0;
+
+    for (size_t base = 0; base < count; base += DICT_BATCH_SIZE) {
+        size_t n = count - base < DICT_BATCH_SIZE ? count - base : DICT_BATCH_SIZE;
+
+        batch_prefetch(dict, keys + base, n, hashes);
+        for (size_t i = 0; i < n; i++) {
+            size_t k = base + i;
+            dict_value_t value = NULL;
+            dict_type_t type = DICT_ITEM_ERR;
+
+            if (keys[k] != NULL && *keys[k] != '\0' &&
+                    dict_get_hashed(dict, keys[k], hashes[i], &value, &type)) {
+                found++;
+            }
+            if (values != NULL) {
+                values[k] = value;
+            }
+            if (types != NULL) {
+                types[k] = type;
+            }
+        }
+    }
+    return found;
+}
+
+
+/** \brief  Set multiple dict items of the same type
+ *
+ * Batched version of dict_set(), see dict_get_many().
+ *
+ * \param[in]   dict    dict
+ * \param[in]   keys    item keys
+ * \param[in]   values  item values
+ * \param[in]   count   number of items
+ * \param[in]   type    type of all items
+ *
+ * \return  `true` on success, `false` on the first error
+ * \throw   BASE_ERR_KEY    a key is `NULL` or empty
+ * \throw   BASE_ERR_ENUM   \a type is invalid
+ */
+bool dict_set_many(dict_t *dict,
+                   const char * const *keys,
+                   const dict_value_t *values,
+                   size_t count,
+                   dict_type_t type)
+{
+    uint32_t hashes[DICT_BATCH_SIZE];
+
+    for (size_t base = 0; base < count; base += DICT_BATCH_SIZE) {
+        size_t n = count - base < DICT_BATCH_SIZE ? count - base : DICT_BATCH_SIZE;
+
+        batch_prefetch(dict, keys + base, n, hashes);
+        for (size_t i = 0; i < n; i++) {
+            if (!dict_set_hashed(dict, keys[base + i], hashes[i],
+                                 values[base + i], type)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
 /** \brief  Remove item from dict
  *
  * Remove item at \a key from \a dict, freeing its value if the item's value
@@ -375,10 +863,26 @@ bool dict_get(const dict_t *dict,
  */
 bool dict_remove(dict_t *dict, const char *key)
 {
+    dict_item_t **bucket = NULL;
     dict_item_t *item;
     uint32_t hash;
 
-    item = find_item(dict, key, &hash);
+    if (!valid_key(key)) {
+        return false;
+    }
+    hash = dict_hash_key(key);
+
+    if (dict->open != NULL) {
+        if (!dict_open_remove(dict->open, key, hash)) {
+            return false;
+        }
+        dict->count--;
+        return true;
+    }
+
+    rehash_step(dict, DICT_REHASH_STEPS);
+
+    item = find_item(dict, key, hash, &bucket);
 
     if (item == NULL) {
         return false;
@@ -386,7 +890,6 @@ bool dict_remove(dict_t *dict, const char *key)
         /* unlink item */
         dict_item_t *next = item->next;
         dict_item_t *prev = item->prev;
-        dict_item_t *head = dict->items[hash];
 
         if (prev != NULL) {
             prev->next = next;
@@ -394,9 +897,9 @@ bool dict_remove(dict_t *dict, const char *key)
         if (next != NULL) {
             next->prev = prev;
         }
-        if (item == head) {
+        if (item == *bucket) {
             /* item is the head, update head */
-            dict->items[hash] = next;
+            *bucket = next;
         }
 
         /* free memory used */
@@ -418,15 +921,24 @@ bool dict_remove(dict_t *dict, const char *key)
  *
  * \param[in]   dict    dict
  *
- * \note    Does not free \a dict itself or reset the collisions count.
+ * \note    Does not free \a dict itself, shrink the hash table or reset the
+ *          collisions count.
  */
 void dict_remove_all(dict_t *dict)
 {
-    for (size_t i = 0; i < dict->size; i++) {
-        if (dict->items[i] != NULL) {
-            dict_item_free(dict->items[i]);
-            dict->items[i] = NULL;
-        }
+    if (dict->open != NULL) {
+        dict_open_clear(dict->open);
+        dict->count = 0;
+        return;
+    }
+    hashmap_clear(dict->items, dict->size);
+    if (dict->old_items != NULL) {
+        hashmap_clear(dict->old_items, dict->old_size);
+        base_free(dict->old_items);
+        dict->old_items = NULL;
+        dict->old_size = 0;
+        dict->old_bits = 0;
+        dict->rehash_index = 0;
     }
     dict->count = 0;
 }
@@ -444,41 +956,342 @@ void dict_remove_all(dict_t *dict)
  */
 bool dict_has_key(const dict_t *dict, const char *key)
 {
-    return find_item(dict, key, NULL) != NULL ? true : false;
+    if (!valid_key(key)) {
+        return false;
+    }
+    return dict_has_key_hashed(dict, key, dict_hash_key(key));
+}
+
+
+/** \brief  Determine if a key exists using a precomputed hash
+ *
+ * Like dict_has_key(), but takes the hash of \a key as obtained with
+ * dict_hash_key().
+ *
+ * \param[in]   dict    dict
+ * \param[in]   key     key
+ * \param[in]   hash    hash of \a key
+ *
+ * \return  `true` if \a key exists
+ * \throw   BASE_ERR_KEY    \a key is `NULL` or empty
+ */
+bool dict_has_key_hashed(const dict_t *dict, const char *key, uint32_t hash)
+{
+    bool found;
+
+    if (!valid_key(key)) {
+        return false;
+    }
+    if (dict->open != NULL) {
+        found = dict_open_find(dict->open, key, hash) != NULL ? true : false;
+    } else {
+        found = find_item(dict, key, hash, NULL) != NULL ? true : false;
+    }
+    DICT_COUNT(dict, lookups);
+    if (found) {
+        DICT_COUNT(dict, hits);
+    } else {
+        DICT_COUNT(dict, misses);
+    }
+    return found;
+}
+
+
+/** \brief  Add keys in hashmap \a items to \a keys
+ *
+ * \param[in]   items   hashmap
+ * \param[in]   size    number of buckets in \a items
+ * \param[out]  keys    list of keys
+ * \param[in]   index   index in \a keys to start at
+ *
+ * \return  index in \a keys after the last key added
+ */
+static size_t hashmap_keys(dict_item_t *const *items,
+                           size_t size,
+                           const char **keys,
+                           size_t index)
+{
+    for (size_t hash = 0; hash < size; hash++) {
+        const dict_item_t *item = items[hash];
+
+        while (item != NULL) {
+            keys[index++] = item->key;
+            item = item->next;
+        }
+    }
+    return index;
 }
 
 
 /** \brief  Get keys in the dict
  *
- * Get an unsorted list of keys in the dict.
+ * Get a list of keys in the dict. The keys are unsorted, except for dicts
+ * using the #DICT_BACKEND_OPEN backend, which return them in insertion order.
  *
  * \param[in]   dict    dict
  *
  * \note    The list must be freed with base_free() but the keys are owned
- *          by the \a dict and must not be freed.
+ *          by the \a dict and must not be freed. The keys are valid until
+ *          the \a dict is modified.
  *
  * \return  `NULL`-terminated list of keys in \a dict
  */
 const char **dict_keys(const dict_t *dict)
 {
     const char **keys;
-    size_t index = 0;
+    size_t index;
 
     keys = base_malloc(sizeof *keys * (dict->count + 1u));
 
-    for (size_t hash = 0; hash < dict->size; hash++) {
-        const dict_item_t *item = dict->items[hash];
+    if (dict->open != NULL) {
+        const dict_open_entry_t *entries = dict->open->entries;
 
-        while (item != NULL) {
-            keys[index++] = item->key;
-            item = item->next;
+        index = 0;
+        for (size_t i = 0; i < dict->open->entries_used; i++) {
+            if (entries[i].key != NULL) {
+                keys[index++] = entries[i].key;
+            }
         }
+        keys[index] = NULL;
+        return keys;
+    }
+
+    index = hashmap_keys(dict->items, dict->size, keys, 0);
+    if (dict->old_items != NULL) {
+        index = hashmap_keys(dict->old_items, dict->old_size, keys, index);
     }
     keys[index] = NULL;
     return keys;
 }
 
 
+/** \brief  Compact storage of \a dict
+ *
+ * Squeezes out the holes left by removed items in a dict using the
+ * #DICT_BACKEND_OPEN backend, so iteration is a linear scan over contiguous
+ * entries again, and frees the memory of their keys. Invalidates the keys
+ * returned by dict_keys(). Does nothing for other backends.
+ *
+ * \param[in,out]   dict    dict
+ */
+void dict_compact(dict_t *dict)
+{
+    if (dict->open != NULL) {
+        dict_open_compact(dict->open);
+    }
+}
+
+
+/** \brief  Add chain lengths of hashmap \a items to \a stats
+ *
+ * \param[in]       items   hashmap
+ * \param[in]       size    number of buckets in \a items
+ * \param[in,out]   stats   statistics
+ * \param[in,out]   total   sum of probe lengths of all items
+ */
+static void hashmap_stats(dict_item_t *const *items,
+                          size_t size,
+                          dict_stats_t *stats,
+                          size_t *total)
+{
+    for (size_t i = 0; i < size; i++) {
+        size_t probes = 0;
+
+        for (const dict_item_t *item = items[i]; item != NULL; item = item->next) {
+            probes++;
+            stats->probes[probes <= DICT_STATS_PROBES ?
+                          probes - 1u : DICT_STATS_PROBES - 1u]++;
+            *total += probes;
+        }
+        if (probes > stats->max_probe) {
+            stats->max_probe = probes;
+        }
+    }
+}
+
+
+/** \brief  Get statistics of \a dict
+ *
+ * The structure of the hashmap is examined on each call, which takes time
+ * proportional to the size of the dict. The lookup counters are only
+ * maintained when compiled with `HAVE_DICT_STATS`, otherwise they're 0 and
+ * \c stats->counters is `false`.
+ *
+ * For the chained backend the probe length of an item is its position in its
+ * bucket's list, for the open addressing backend it's the number of groups
+ * of slots visited to find it.
+ *
+ * \param[in]   dict    dict
+ * \param[out]  stats   statistics
+ */
+void dict_get_stats(const dict_t *dict, dict_stats_t *stats)
+{
+    size_t total = 0;
+
+    memset(stats, 0, sizeof *stats);
+    stats->backend = dict->backend;
+
+    if (dict->open != NULL) {
+        stats->count = dict->open->count;
+        stats->buckets = dict->open->capacity;
+        stats->rehashes = dict->open->rebuilds;
+        dict_open_probe_stats(dict->open, stats->probes, DICT_STATS_PROBES,
+                              &stats->max_probe, &total);
+    } else {
+        stats->count = dict->count;
+        stats->buckets = dict->size + dict->old_size;
+        stats->rehashes = dict->rehashes;
+        hashmap_stats(dict->items, dict->size, stats, &total);
+        if (dict->old_items != NULL) {
+            hashmap_stats(dict->old_items, dict->old_size, stats, &total);
+        }
+    }
+
+    if (stats->buckets > 0) {
+        stats->load_factor = (double)stats->count / (double)stats->buckets;
+    }
+    if (stats->count > 0) {
+        stats->avg_probe = (double)total / (double)stats->count;
+        stats->collisions = stats->count - stats->probes[0];
+    }
+
+    if (dict->counters != NULL) {
+        stats->counters = true;
+        stats->lookups = dict->counters->lookups;
+        stats->hits = dict->counters->hits;
+        stats->misses = dict->counters->misses;
+    }
+}
+
+
+/** \brief  Debug hook: dump statistics of \a dict on stdout
+ *
+ * \param[in]   dict    dict
+ */
+void dict_dump_stats(const dict_t *dict)
+{
+    dict_stats_t stats;
+    size_t last;
+
+    dict_get_stats(dict, &stats);
+
+    printf("backend     : %s\n",
+           stats.backend == DICT_BACKEND_OPEN ? "open addressing" : "chained");
+    printf("items       : %zu\n", stats.count);
+    printf("buckets     : %zu\n", stats.buckets);
+    printf("load factor : %.3f\n", stats.load_factor);
+    printf("collisions  : %zu\n", stats.collisions);
+    printf("max probe   : %zu\n", stats.max_probe);
+    printf("avg probe   : %.3f\n", stats.avg_probe);
+    printf("rehashes    : %zu\n", stats.rehashes);
+    if (stats.counters) {
+        printf("lookups     : %zu (%zu hits, %zu misses)\n",
+               stats.lookups, stats.hits, stats.misses);
+    } else {
+        printf("lookups     : not counted (compile with HAVE_DICT_STATS)\n");
+    }
+
+    /* skip the empty tail of the histogram */
+    last = DICT_STATS_PROBES;
+    while (last > 1 && stats.probes[last - 1u] == 0) {
+        last--;
+    }
+    printf("probe length histogram:\n");
+    for (size_t i = 0; i < last; i++) {
+        printf("  %2zu%s : %zu\n",
+               i + 1u, i == DICT_STATS_PROBES - 1u ? "+" : " ", stats.probes[i]);
+    }
+}
+
+
+/** \brief  Initialize iterator over the items in \a dict
+ *
+ * The iterator doesn't allocate memory. Items are visited in the same order
+ * as returned by dict_keys(). The dict must not be modified while iterating.
+ *
+ * \param[out]  iter    iterator
+ * \param[in]   dict    dict
+ */
+void dict_iter_init(dict_iter_t *iter, const dict_t *dict)
+{
+    iter->dict = dict;
+    iter->index = 0;
+    iter->item = NULL;
+    iter->old = false;
+}
+
+
+/** \brief  Get next item of iterator \a iter
+ *
+ * \param[in,out]   iter    iterator
+ * \param[out]      key     item key (optional)
+ * \param[out]      value   item value (optional)
+ * \param[out]      type    item type (optional)
+ *
+ * \return  `false` when all items have been visited
+ */
+bool dict_iter_next(dict_iter_t *iter,
+                    const char **key,
+                    dict_value_t *value,
+                    dict_type_t *type)
+{
+    const dict_t *dict = iter->dict;
+    const char *k;
+    dict_value_t v;
+    dict_type_t t;
+
+    if (dict->open != NULL) {
+        const dict_open_t *table = dict->open;
+        const dict_open_entry_t *entry;
+
+        while (iter->index < table->entries_used &&
+                table->entries[iter->index].key == NULL) {
+            iter->index++;
+        }
+        if (iter->index >= table->entries_used) {
+            return false;
+        }
+        entry = &table->entries[iter->index++];
+        k = entry->key;
+        v = entry->value;
+        t = entry->type;
+    } else {
+        const dict_item_t *item = iter->item;
+
+        while (item == NULL) {
+            dict_item_t **items = iter->old ? dict->old_items : dict->items;
+            size_t size = iter->old ? dict->old_size : dict->size;
+
+            if (iter->index >= size) {
+                if (iter->old || dict->old_items == NULL) {
+                    return false;
+                }
+                /* continue with the hashmap being moved */
+                iter->old = true;
+                iter->index = 0;
+                continue;
+            }
+            item = items[iter->index++];
+        }
+        iter->item = item->next;
+        k = item->key;
+        v = item->value;
+        t = item->type;
+    }
+
+    if (key != NULL) {
+        *key = k;
+    }
+    if (value != NULL) {
+        *value = v;
+    }
+    if (type != NULL) {
+        *type = t;
+    }
+    return true;
+}
+
+
 /*
  * Type-specific wrappers
  *
@@ -39,6 +39,15 @@ typedef enum dict_type_e {
 } dict_type_t;
 
 
+/** \brief  Dict storage backends
+ */
+typedef enum dict_backend_e {
+    DICT_BACKEND_CHAINED,   /**< hash map with linked lists of items */
+    DICT_BACKEND_OPEN       /**< open addressing, entries in a dense array
+                                 in insertion order */
+} dict_backend_t;
+
+
 /** \brief  Dict value opaque type
  */
 typedef void* dict_value_t;
@@ -100,6 +109,7 @@ typedef void* dict_value_t;
  */
 typedef struct dict_item_s {
     char *key;                  /**< key */
+    uint32_t hash;              /**< hash of \c key */
     dict_type_t type;           /**< value type */
     dict_value_t value;         /**< value */
     struct dict_item_s *next;   /**< next item in the list */
@@ -107,21 +117,103 @@ typedef struct dict_item_s {
 } dict_item_t;
 
 
+/** \brief  Number of elements in the probe length histogram of dict_stats_t
+ */
+#define DICT_STATS_PROBES   16
+
+
+/** \brief  Lookup counters
+ *
+ * Only maintained when compiled with `HAVE_DICT_STATS`. Not thread-safe: with
+ * `HAVE_DICT_STATS` concurrent lookups in the same dict race on these.
+ */
+typedef struct dict_counters_s {
+    size_t  lookups;    /**< number of lookups */
+    size_t  hits;       /**< number of lookups that found their key */
+    size_t  misses;     /**< number of lookups that didn't */
+} dict_counters_t;
+
+
+/** \brief  Dictionary statistics
+ *
+ * \see dict_get_stats(), dict_dump_stats()
+ */
+typedef struct dict_stats_s {
+    dict_backend_t  backend;        /**< storage backend */
+    size_t          count;          /**< number of items */
+    size_t          buckets;        /**< number of hashmap buckets or slots */
+    double          load_factor;    /**< \c count divided by \c buckets */
+    size_t          probes[DICT_STATS_PROBES];
+                                    /**< number of items per probe length:
+                                         element N counts items found by
+                                         visiting N+1 list items or slot
+                                         groups, the last element also counts
+                                         longer probes */
+    size_t          max_probe;      /**< longest probe length */
+    double          avg_probe;      /**< average probe length of successful
+                                         lookups */
+    size_t          collisions;     /**< number of items not found with the
+                                         first probe */
+    size_t          rehashes;       /**< number of times the hashmap was
+                                         resized or rebuilt */
+    bool            counters;       /**< the counters below are maintained */
+    size_t          lookups;        /**< number of lookups */
+    size_t          hits;           /**< number of successful lookups */
+    size_t          misses;         /**< number of failed lookups */
+} dict_stats_t;
+
+
 /** \brief  Dictionary object
+ *
+ * The hash map doubles in size when the number of items reaches the number of
+ * entries. Items are moved from the old hash map to the new one a few entries
+ * at a time on each following dict_set() or dict_remove() call.
  */
 typedef struct dict_s {
-    dict_item_t **  items;      /**< hash map with linked lists */
-    size_t          size;       /**< size of hash map in entries */
-    uint32_t        bits;       /**< size of hash in bits */
-    size_t          count;      /**< number of items in dict */
-    size_t          collisions; /**< number of hash collisions */
+    dict_item_t **  items;          /**< hash map with linked lists */
+    size_t          size;           /**< size of hash map in entries */
+    uint32_t        bits;           /**< size of hash in bits */
+    size_t          count;          /**< number of items in dict */
+    size_t          collisions;     /**< number of hash collisions */
+
+    dict_item_t **  old_items;      /**< hash map being moved into \c items,
+                                         or `NULL` when not growing */
+    size_t          old_size;       /**< size of old hash map in entries */
+    uint32_t        old_bits;       /**< size of old hash in bits */
+    size_t          rehash_index;   /**< next entry in the old hash map to
+                                         move */
+
+    size_t          rehashes;       /**< number of times the hashmap grew */
+
+    dict_backend_t  backend;        /**< storage backend */
+    struct dict_open_s *open;       /**< open addressing table, only used
+                                         for #DICT_BACKEND_OPEN */
+
+    dict_counters_t *counters;      /**< lookup counters, `NULL` unless
+                                         compiled with `HAVE_DICT_STATS` */
 } dict_t;
 
 
+/** \brief  Dictionary iterator
+ *
+ * \see dict_iter_init(), dict_iter_next()
+ */
+typedef struct dict_iter_s {
+    const dict_t *      dict;   /**< dict being iterated */
+    size_t              index;  /**< next hashmap entry or entries index */
+    const dict_item_t * item;   /**< next item in the current list */
+    bool                old;    /**< iterating the old hashmap */
+} dict_iter_t;
+
+
 const char *    dict_type_name(dict_type_t type);
 
 dict_t *        dict_new    (void);
 
+dict_t *        dict_new_size(size_t hint);
+
+dict_t *        dict_new_backend(dict_backend_t backend, size_t hint);
+
 void            dict_free   (dict_t *dict);
 
 size_t          dict_size   (const dict_t *dict);
@@ -136,6 +228,37 @@ bool            dict_get    (const dict_t *dict,
                              dict_value_t *value,
                              dict_type_t *type);
 
+uint32_t        dict_hash_key(const char *key);
+uint32_t        dict_hash_bytes(const void *data, size_t len);
+
+bool            dict_set_hashed(dict_t *dict,
+                                const char *key,
+                                uint32_t hash,
+                                dict_value_t value,
+                                dict_type_t type);
+
+bool            dict_get_hashed(const dict_t *dict,
+                                const char *key,
+                                uint32_t hash,
+                                dict_value_t *value,
+                                dict_type_t *type);
+
+bool            dict_has_key_hashed(const dict_t *dict,
+                                    const char *key,
+                                    uint32_t hash);
+
+size_t          dict_get_many(const dict_t *dict,
+                              const char * const *keys,
+                              size_t count,
+                              dict_value_t *values,
+                              dict_type_t *types);
+
+bool            dict_set_many(dict_t *dict,
+                              const char * const *keys,
+                              const dict_value_t *values,
+                              size_t count,
+                              dict_type_t type);
+
 bool            dict_remove (dict_t *dict, const char *key);
 
 void            dict_remove_all(dict_t *dict);
@@ -144,6 +267,17 @@ bool            dict_has_key(const dict_t *dict, const char *key);
 
 const char **   dict_keys   (const dict_t *dict);
 
+void            dict_compact(dict_t *dict);
+
+void            dict_get_stats(const dict_t *dict, dict_stats_t *stats);
+void            dict_dump_stats(const dict_t *dict);
+
+void            dict_iter_init(dict_iter_t *iter, const dict_t *dict);
+bool            dict_iter_next(dict_iter_t *iter,
+                               const char **key,
+                               dict_value_t *value,
+                               dict_type_t *type);
+
 bool            dict_set_int(dict_t *dict, const char *key, int value);
 bool            dict_get_int(const dict_t *dict, const char *key, int *value);
 
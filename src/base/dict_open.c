@@ -0,0 +1,581 @@
+/** \file   dict_open.c
+ * \brief   Open addressing dict backend
+ * \ingroup base
+ *
+ * Hash table with open addressing in the style of Abseil's SwissTable: each
+ * slot has a control byte that is either empty, deleted or contains seven
+ * bits of the hash of the entry in the slot. Slots are probed in groups of
+ * sixteen control bytes, using SSE2 when available, so a lookup usually
+ * touches a single cache line of control bytes and compares a single key.
+ *
+ * The entries themselves live in an array in insertion order, the slots only
+ * hold indices into that array. Keys are copied into an arena, so adding an
+ * entry doesn't allocate unless one of the arrays needs to grow.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#include "dict.h"
+#include "helpers.h"
+#include "mem.h"
+
+#include "dict_open.h"
+
+
+/** \brief  Control byte of an empty slot
+ */
+#define CTRL_EMPTY      0x80u
+
+/** \brief  Control byte of a deleted slot
+ */
+#define CTRL_DELETED    0xfeu
+
+/** \brief  Slot index returned when a key isn't found
+ */
+#define SLOT_NONE       SIZE_MAX
+
+/** \brief  Arena chunk size for keys
+ */
+#define KEYS_CHUNK_SIZE 4096
+
+
+/** \brief  Get bits of the hash stored in the control byte
+ *
+ * \param[in]   hash    hash
+ *
+ * \return  lower seven bits of \a hash
+ */
+static uint8_t hash_h2(uint32_t hash)
+{
+    return (uint8_t)(hash & 0x7fu);
+}
+
+
+/** \brief  Get bits of the hash used to select the first group to probe
+ *
+ * \param[in]   hash    hash
+ *
+ * \return  \a hash without the bits used for the control byte
+ */
+static size_t hash_h1(uint32_t hash)
+{
+    return (size_t)(hash >> 7u);
+}
+
+
+/** \brief  Get index of the lowest set bit in \a mask
+ *
+ * \param[in]   mask    non-zero bit mask
+ *
+ * \return  bit index
+ */
+static unsigned int lowest_bit(uint32_t mask)
+{
+#ifdef __GNUC__
+    return (unsigned int)__builtin_ctz(mask);
+#else
+    unsigned int bit = 0;
+
+    while ((mask & 1u) == 0) {
+        mask >>= 1u;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+
+/** \brief  Find control bytes equal to \a byte in a group
+ *
+ * \param[in]   ctrl    first control byte of the group
+ * \param[in]   byte    value to look for
+ *
+ * \return  bit mask with a bit set for each matching control byte
+ */
+static uint32_t group_match(const uint8_t *ctrl, uint8_t byte)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)(const void *)ctrl);
+    __m128i match = _mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte));
+
+    return (uint32_t)_mm_movemask_epi8(match);
+#else
+    uint32_t mask = 0;
+
+    for (unsigned int i = 0; i < DICT_OPEN_GROUP_SIZE; i++) {
+        if (ctrl[i] == byte) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+
+/** \brief  Find empty or deleted slots in a group
+ *
+ * Both have the high bit set, unlike control bytes of used slots.
+ *
+ * \param[in]   ctrl    first control byte of the group
+ *
+ * \return  bit mask with a bit set for each free slot
+ */
+static uint32_t group_match_free(const uint8_t *ctrl)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)(const void *)ctrl);
+
+    return (uint32_t)_mm_movemask_epi8(group);
+#else
+    uint32_t mask = 0;
+
+    for (unsigned int i = 0; i < DICT_OPEN_GROUP_SIZE; i++) {
+        if ((ctrl[i] & 0x80u) != 0) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+
+/** \brief  Find slot containing \a key
+ *
+ * Groups are probed using triangular numbers, which visits every group of a
+ * power-of-two sized table exactly once.
+ *
+ * \param[in]   table   hash table
+ * \param[in]   key     key
+ * \param[in]   hash    hash of \a key
+ *
+ * \return  slot index or #SLOT_NONE when not found
+ */
+static size_t find_slot(const dict_open_t *table, const char *key, uint32_t hash)
+{
+    size_t groups = table->capacity / DICT_OPEN_GROUP_SIZE;
+    size_t group = hash_h1(hash) & (groups - 1u);
+    uint8_t h2 = hash_h2(hash);
+
+    for (size_t step = 1; step <= groups; step++) {
+        const uint8_t *ctrl = table->ctrl + group * DICT_OPEN_GROUP_SIZE;
+        uint32_t match = group_match(ctrl, h2);
+
+        while (match != 0) {
+            size_t slot = group * DICT_OPEN_GROUP_SIZE + lowest_bit(match);
+            const dict_open_entry_t *entry = &table->entries[table->slots[slot]];
+
+            if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+                return slot;
+            }
+            match &= match - 1u;
+        }
+        if (group_match(ctrl, CTRL_EMPTY) != 0) {
+            /* an empty slot ends the probe sequence */
+            return SLOT_NONE;
+        }
+        group = (group + step) & (groups - 1u);
+    }
+    return SLOT_NONE;
+}
+
+
+/** \brief  Find first free slot for \a hash
+ *
+ * \param[in]   table   hash table
+ * \param[in]   hash    hash
+ *
+ * \return  slot index
+ *
+ * \note    The table must have at least one free slot.
+ */
+static size_t find_free_slot(const dict_open_t *table, uint32_t hash)
+{
+    size_t groups = table->capacity / DICT_OPEN_GROUP_SIZE;
+    size_t group = hash_h1(hash) & (groups - 1u);
+    size_t step = 1;
+
+    while (true) {
+        uint32_t match = group_match_free(table->ctrl + group * DICT_OPEN_GROUP_SIZE);
+
+        if (match != 0) {
+            return group * DICT_OPEN_GROUP_SIZE + lowest_bit(match);
+        }
+        group = (group + step++) & (groups - 1u);
+    }
+}
+
+
+/** \brief  Squeeze removed entries out of the entries array
+ *
+ * Keeps the order of the remaining entries. Invalidates the slots, so the
+ * caller must rebuild them.
+ *
+ * \param[in,out]   table   hash table
+ */
+static void compact_entries(dict_open_t *table)
+{
+    size_t used = 0;
+
+    if (table->entries_used == table->count) {
+        return;
+    }
+    for (size_t i = 0; i < table->entries_used; i++) {
+        if (table->entries[i].key != NULL) {
+            table->entries[used++] = table->entries[i];
+        }
+    }
+    table->entries_used = used;
+}
+
+
+/** \brief  Copy the keys of the live entries of \a table to a new arena
+ *
+ * Reclaims the memory of removed keys. Entries must be compacted first.
+ *
+ * \param[in,out]   table   hash table
+ */
+static void repack_keys(dict_open_t *table)
+{
+    base_arena_t keys;
+
+    base_arena_init(&keys, KEYS_CHUNK_SIZE);
+    for (size_t i = 0; i < table->entries_used; i++) {
+        table->entries[i].key = base_arena_strdup(&keys,
+                                                  table->entries[i].key);
+    }
+    base_arena_free(&table->keys);
+    table->keys = keys;
+    table->keys_size -= table->keys_dead;
+    table->keys_dead = 0;
+}
+
+
+/** \brief  Rebuild the slots of \a table with \a capacity slots
+ *
+ * Also gets rid of deleted slots and removed entries, and of the keys of
+ * removed entries once they take up half of the key storage.
+ *
+ * \param[in,out]   table       hash table
+ * \param[in]       capacity    new number of slots
+ */
+static void rebuild(dict_open_t *table, size_t capacity)
+{
+    table->rebuilds++;
+    compact_entries(table);
+    if (table->keys_dead > 0 && table->keys_dead >= table->keys_size / 2u) {
+        repack_keys(table);
+    }
+
+    if (capacity != table->capacity) {
+        base_free(table->ctrl);
+        base_free(table->slots);
+        table->ctrl = base_malloc(capacity);
+        table->slots = base_malloc(capacity * sizeof *(table->slots));
+        table->capacity = capacity;
+    }
+    memset(table->ctrl, CTRL_EMPTY, capacity);
+    table->tombstones = 0;
+
+    for (size_t i = 0; i < table->entries_used; i++) {
+        uint32_t hash = table->entries[i].hash;
+        size_t slot = find_free_slot(table, hash);
+
+        table->ctrl[slot] = hash_h2(hash);
+        table->slots[slot] = (uint32_t)i;
+    }
+}
+
+
+/** \brief  Free string values of all entries in \a table
+ *
+ * \param[in,out]   table   hash table
+ */
+static void free_values(dict_open_t *table)
+{
+    for (size_t i = 0; i < table->entries_used; i++) {
+        if (table->entries[i].key != NULL &&
+                table->entries[i].type == DICT_ITEM_STR) {
+            base_free(table->entries[i].value);
+        }
+    }
+}
+
+
+/** \brief  Create new hash table sized for \a hint entries
+ *
+ * \param[in]   hint    expected number of entries
+ *
+ * \return  new hash table
+ */
+dict_open_t *dict_open_new(size_t hint)
+{
+    dict_open_t *table = base_malloc(sizeof *table);
+    size_t capacity = DICT_OPEN_GROUP_SIZE;
+
+    /* keep the load factor at or below 7/8 */
+    while (capacity / 8u * 7u < hint) {
+        capacity *= 2u;
+    }
+    table->ctrl = base_malloc(capacity);
+    table->slots = base_malloc(capacity * sizeof *(table->slots));
+    table->capacity = capacity;
+    memset(table->ctrl, CTRL_EMPTY, capacity);
+    table->tombstones = 0;
+    table->rebuilds = 0;
+
+    table->entries_size = hint > 16u ? hint : 16u;
+    table->entries = base_malloc(table->entries_size * sizeof *(table->entries));
+    table->entries_used = 0;
+    table->count = 0;
+
+    base_arena_init(&table->keys, KEYS_CHUNK_SIZE);
+    table->keys_size = 0;
+    table->keys_dead = 0;
+    return table;
+}
+
+
+/** \brief  Free hash table and all its entries
+ *
+ * \param[in,out]   table   hash table
+ */
+void dict_open_free(dict_open_t *table)
+{
+    free_values(table);
+    base_free(table->ctrl);
+    base_free(table->slots);
+    base_free(table->entries);
+    base_arena_free(&table->keys);
+    base_free(table);
+}
+
+
+/** \brief  Remove all entries from \a table
+ *
+ * \param[in,out]   table   hash table
+ */
+void dict_open_clear(dict_open_t *table)
+{
+    free_values(table);
+    table->entries_used = 0;
+    table->count = 0;
+    memset(table->ctrl, CTRL_EMPTY, table->capacity);
+    table->tombstones = 0;
+    base_arena_reset(&table->keys);
+    table->keys_size = 0;
+    table->keys_dead = 0;
+}
+
+
+/** \brief  Look up \a key in \a table
+ *
+ * \param[in]   table   hash table
+ * \param[in]   key     key
+ * \param[in]   hash    hash of \a key
+ *
+ * \return  entry or `NULL` when not found
+ */
+dict_open_entry_t *dict_open_find(const dict_open_t *table,
+                                  const char *key,
+                                  uint32_t hash)
+{
+    size_t slot = find_slot(table, key, hash);
+
+    if (slot == SLOT_NONE) {
+        return NULL;
+    }
+    return &table->entries[table->slots[slot]];
+}
+
+
+/** \brief  Prefetch the control bytes and slots probed first for \a hash
+ *
+ * \param[in]   table   hash table
+ * \param[in]   hash    hash of the key that will be looked up
+ */
+void dict_open_prefetch(const dict_open_t *table, uint32_t hash)
+{
+    size_t groups = table->capacity / DICT_OPEN_GROUP_SIZE;
+    size_t slot = (hash_h1(hash) & (groups - 1u)) * DICT_OPEN_GROUP_SIZE;
+
+    BASE_PREFETCH(table->ctrl + slot);
+    BASE_PREFETCH(table->slots + slot);
+}
+
+
+/** \brief  Add new entry for \a key to \a table
+ *
+ * The caller must make sure \a key isn't in \a table yet, and must set the
+ * type and value of the returned entry.
+ *
+ * \param[in,out]   table   hash table
+ * \param[in]       key     key
+ * \param[in]       hash    hash of \a key
+ *
+ * \return  new entry, valid until the next insertion or removal
+ */
+dict_open_entry_t *dict_open_insert(dict_open_t *table,
+                                    const char *key,
+                                    uint32_t hash)
+{
+    dict_open_entry_t *entry;
+    size_t slot;
+
+    if ((table->count + table->tombstones + 1u) * 8u > table->capacity * 7u) {
+        /* grow if more than about half full, else just purge tombstones */
+        if ((table->count + 1u) * 16u > table->capacity * 7u) {
+            rebuild(table, table->capacity * 2u);
+        } else {
+            rebuild(table, table->capacity);
+        }
+    }
+    if (table->entries_used == table->entries_size) {
+        /* make room by squeezing out removed entries if there are enough of
+         * them, otherwise grow */
+        if (table->count < table->entries_used / 2u) {
+            rebuild(table, table->capacity);
+        } else {
+            table->entries_size *= 2u;
+            table->entries = base_realloc(table->entries,
+                                          table->entries_size * sizeof *(table->entries));
+        }
+    }
+
+    slot = find_free_slot(table, hash);
+    if (table->ctrl[slot] == CTRL_DELETED) {
+        table->tombstones--;
+    }
+    table->ctrl[slot] = hash_h2(hash);
+    table->slots[slot] = (uint32_t)table->entries_used;
+
+    entry = &table->entries[table->entries_used++];
+    table->count++;
+    entry->key = base_arena_strdup(&table->keys, key);
+    table->keys_size += strlen(key) + 1u;
+    entry->hash = hash;
+    entry->type = DICT_ITEM_INT;
+    entry->value = NULL;
+    return entry;
+}
+
+
+/** \brief  Remove \a key from \a table
+ *
+ * The entry is marked as removed, keeping the order of the other entries.
+ * The memory used by the key is reclaimed when the table is rebuilt or
+ * compacted.
+ *
+ * \param[in,out]   table   hash table
+ * \param[in]       key     key
+ * \param[in]       hash    hash of \a key
+ *
+ * \return  `true` if \a key was found
+ */
+bool dict_open_remove(dict_open_t *table, const char *key, uint32_t hash)
+{
+    size_t slot = find_slot(table, key, hash);
+    dict_open_entry_t *entry;
+
+    if (slot == SLOT_NONE) {
+        return false;
+    }
+    entry = &table->entries[table->slots[slot]];
+    if (entry->type == DICT_ITEM_STR) {
+        base_free(entry->value);
+    }
+    table->keys_dead += strlen(entry->key) + 1u;
+    entry->key = NULL;
+    entry->value = NULL;
+    table->ctrl[slot] = CTRL_DELETED;
+    table->tombstones++;
+    table->count--;
+    return true;
+}
+
+
+/** \brief  Gather probe length statistics of \a table
+ *
+ * The probe length of an entry is the number of groups visited by a lookup
+ * of its key, following the same probe sequence as find_slot().
+ *
+ * \param[in]   table       hash table
+ * \param[out]  histogram   number of entries per probe length, index 0 is
+ *                          a probe length of 1, the last element also counts
+ *                          all longer probe lengths
+ * \param[in]   size        number of elements in \a histogram
+ * \param[out]  max_probe   longest probe length
+ * \param[out]  total       sum of the probe lengths of all entries
+ */
+void dict_open_probe_stats(const dict_open_t *table,
+                           size_t *histogram,
+                           size_t size,
+                           size_t *max_probe,
+                           size_t *total)
+{
+    size_t groups = table->capacity / DICT_OPEN_GROUP_SIZE;
+
+    *max_probe = 0;
+    *total = 0;
+    for (size_t slot = 0; slot < table->capacity; slot++) {
+        size_t target = slot / DICT_OPEN_GROUP_SIZE;
+        size_t group;
+        size_t probes = 1;
+
+        if (table->ctrl[slot] & CTRL_EMPTY) {
+            /* empty or deleted */
+            continue;
+        }
+        group = hash_h1(table->entries[table->slots[slot]].hash) & (groups - 1u);
+        while (group != target) {
+            group = (group + probes++) & (groups - 1u);
+        }
+
+        histogram[probes <= size ? probes - 1u : size - 1u]++;
+        *total += probes;
+        if (probes > *max_probe) {
+            *max_probe = probes;
+        }
+    }
+}
+
+
+/** \brief  Squeeze removed entries, deleted slots and removed keys out of
+ *          \a table
+ *
+ * \param[in,out]   table   hash table
+ */
+void dict_open_compact(dict_open_t *table)
+{
+    if (table->entries_used != table->count || table->tombstones > 0) {
+        rebuild(table, table->capacity);
+    }
+    if (table->keys_dead > 0) {
+        repack_keys(table);
+    }
+}
@@ -0,0 +1,110 @@
+/** \file   dict_open.h
+ * \brief   Open addressing dict backend - header
+ * \ingroup base
+ *
+ * Internal to the dict module, use the dict_*() functions in dict.h.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BASE_DICT_OPEN_H
+#define BASE_DICT_OPEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dict.h"
+#include "mem.h"
+
+
+/** \brief  Number of control bytes probed at once
+ */
+#define DICT_OPEN_GROUP_SIZE    16
+
+
+/** \brief  Dict entry in the entries array
+ */
+typedef struct dict_open_entry_s {
+    const char *    key;    /**< key, allocated in the key arena, `NULL` for
+                                 a removed entry */
+    uint32_t        hash;   /**< full hash of \c key */
+    dict_type_t     type;   /**< value type */
+    dict_value_t    value;  /**< value */
+} dict_open_entry_t;
+
+
+/** \brief  Open addressing hash table
+ *
+ * The table itself consists of one control byte and one entry index per
+ * slot. A control byte is either empty, deleted, or holds the lower seven
+ * bits of the hash of the entry in the slot, so most mismatches are rejected
+ * by comparing control bytes, sixteen at a time.
+ *
+ * Entries are appended to the entries array, so iterating it yields the
+ * entries in insertion order. Removed entries leave a hole that is squeezed
+ * out when the table is rebuilt or compacted.
+ */
+typedef struct dict_open_s {
+    uint8_t *           ctrl;           /**< control bytes */
+    uint32_t *          slots;          /**< index in \c entries per slot */
+    size_t              capacity;       /**< number of slots (power of two,
+                                             multiple of the group size) */
+    size_t              tombstones;     /**< number of deleted slots */
+    size_t              rebuilds;       /**< number of times the slots were
+                                             rebuilt */
+
+    dict_open_entry_t * entries;        /**< entries in insertion order */
+    size_t              entries_size;   /**< number of entries allocated */
+    size_t              entries_used;   /**< number of entries used, including
+                                             removed entries */
+    size_t              count;          /**< number of live entries */
+
+    base_arena_t        keys;           /**< storage for keys */
+    size_t              keys_size;      /**< bytes of keys in \c keys,
+                                             including removed keys */
+    size_t              keys_dead;      /**< bytes of removed keys in
+                                             \c keys */
+} dict_open_t;
+
+
+dict_open_t *       dict_open_new(size_t hint);
+void                dict_open_free(dict_open_t *table);
+void                dict_open_clear(dict_open_t *table);
+void                dict_open_compact(dict_open_t *table);
+void                dict_open_probe_stats(const dict_open_t *table,
+                                          size_t *histogram,
+                                          size_t size,
+                                          size_t *max_probe,
+                                          size_t *total);
+
+dict_open_entry_t * dict_open_find(const dict_open_t *table,
+                                   const char *key,
+                                   uint32_t hash);
+void                dict_open_prefetch(const dict_open_t *table,
+                                       uint32_t hash);
+dict_open_entry_t * dict_open_insert(dict_open_t *table,
+                                     const char *key,
+                                     uint32_t hash);
+bool                dict_open_remove(dict_open_t *table,
+                                     const char *key,
+                                     uint32_t hash);
+
+#endif
@@ -45,13 +45,18 @@ static const char *err_msgs[] = {
     "key error",
     "index error",
     "invalid enum value",
-    "out of range"
+    "out of range",
+    "syntax error",
+    "undefined symbol",
+    "overlapping data"
 };
 
 
 /** \brief  Error code for the various binaries
+ *
+ * Each thread has its own copy, like libc's \c errno.
  */
-int base_errno = 0;
+BASE_THREAD_LOCAL int base_errno = 0;
 
 
 /** \brief  Get error message for error code \a err
@@ -29,6 +29,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <string.h>
 #include <errno.h>
 
+#include "helpers.h"
+
 /** \brief  Error codes
  */
 enum {
@@ -42,7 +44,10 @@ enum {
     BASE_ERR_KEY,           /**< key error */
     BASE_ERR_INDEX,         /**< index error */
     BASE_ERR_ENUM,          /**< value is not valid for enum */
-    BASE_ERR_RANGE          /**< out of range */
+    BASE_ERR_RANGE,         /**< out of range */
+    BASE_ERR_SYNTAX,        /**< syntax error */
+    BASE_ERR_UNDEF,         /**< undefined symbol */
+    BASE_ERR_OVERLAP        /**< overlapping data */
 };
 
 /** \brief  Print error code and message on stderr
@@ -65,7 +70,7 @@ enum {
         fputc('\n', stderr);                            \
     } while (0);
 
-extern int base_errno;
+extern BASE_THREAD_LOCAL int base_errno;
 
 const char *base_strerror(int err);
 
@@ -0,0 +1,760 @@
+/** \file   expr.c
+ * \brief   Expression compiler and evaluator
+ * \ingroup base
+ *
+ * Expressions are compiled once with a shunting-yard parser into a compact
+ * postfix bytecode, folding constant subexpressions on the fly. Symbol
+ * references are stored as slot indices, so re-evaluating an expression on
+ * each assembler pass doesn't require parsing the expression text again.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "debug.h"
+#include "error.h"
+#include "mem.h"
+#include "operators.h"
+#include "strings.h"
+
+#include "expr.h"
+
+
+/** \brief  Initial size of the bytecode arena
+ */
+#define EXPR_CODE_INITIAL_SIZE  256
+
+
+/** \brief  Operand stack element used during compilation
+ *
+ * Keeps track of where the code of each operand starts so constant operands
+ * can be folded into a single constant.
+ */
+typedef struct operand_s {
+    size_t  offset;     /**< offset in the arena of the operand's code */
+    bool    constant;   /**< operand is a constant */
+    int32_t value;      /**< value of the operand if constant */
+} operand_t;
+
+
+/** \brief  Compiler state
+ */
+typedef struct compiler_s {
+    expr_code_t *   code;                       /**< bytecode arena */
+    operator_id_t   ops[EXPR_STACK_MAX];        /**< operator stack */
+    size_t          ops_used;                   /**< operator stack size */
+    operand_t       vals[EXPR_STACK_MAX];       /**< operand stack */
+    size_t          vals_used;                  /**< operand stack size */
+} compiler_t;
+
+
+/** \brief  Store 32-bit value little endian
+ *
+ * \param[out]  p       destination
+ * \param[in]   value   value
+ */
+static void put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value & 0xffu);
+    p[1] = (uint8_t)((value >> 8u) & 0xffu);
+    p[2] = (uint8_t)((value >> 16u) & 0xffu);
+    p[3] = (uint8_t)((value >> 24u) & 0xffu);
+}
+
+
+/** \brief  Retrieve 32-bit little endian value
+ *
+ * \param[in]   p   source
+ *
+ * \return  value
+ */
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8u) |
+        ((uint32_t)p[2] << 16u) | ((uint32_t)p[3] << 24u);
+}
+
+
+/** \brief  Determine if \a id is a supported unary (prefix) operator
+ *
+ * \param[in]   id  operator ID
+ *
+ * \return  bool
+ */
+static bool is_unary(operator_id_t id)
+{
+    switch ((int)id) {
+        case OPR_ID_LSB:        /* fall through */
+        case OPR_ID_MSB:        /* fall through */
+        case OPR_ID_PLUS:       /* fall through */
+        case OPR_ID_MINUS:      /* fall through */
+        case OPR_ID_NOT_LOG:    /* fall through */
+        case OPR_ID_NOT_BIT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+/** \brief  Determine if \a id is a supported binary operator
+ *
+ * \param[in]   id  operator ID
+ *
+ * \return  bool
+ */
+static bool is_binary(operator_id_t id)
+{
+    return id >= OPR_ID_MUL && id <= OPR_ID_OR_LOG;
+}
+
+
+/** \brief  Apply operator \a id to its operand(s)
+ *
+ * Arithmetic is done in 32 bits with wrap-around. Shift counts are masked to
+ * five bits, the logical and comparison operators result in 0 or 1.
+ *
+ * \param[in]   id      operator ID
+ * \param[in]   a       first (or only) operand
+ * \param[in]   b       second operand (ignored for unary operators)
+ * \param[out]  result  result
+ *
+ * \return  `false` on error
+ * \throw   BASE_ERR_RANGE  division or modulo by zero
+ * \throw   BASE_ERR_ENUM   \a id is not supported
+ */
+static bool apply_operator(operator_id_t id,
+                           int32_t a,
+                           int32_t b,
+                           int32_t *result)
+{
+    uint32_t ua = (uint32_t)a;
+    uint32_t ub = (uint32_t)b;
+    uint32_t r;
+
+    switch ((int)id) {
+        case OPR_ID_LSB:        r = ua & 0xffu; break;
+        case OPR_ID_MSB:        r = (ua >> 8u) & 0xffu; break;
+        case OPR_ID_PLUS:       r = ua; break;
+        case OPR_ID_MINUS:      r = 0u - ua; break;
+        case OPR_ID_NOT_LOG:    r = a == 0; break;
+        case OPR_ID_NOT_BIT:    r = ~ua; break;
+        case OPR_ID_MUL:        r = ua * ub; break;
+        case OPR_ID_DIV:        /* fall through */
+        case OPR_ID_MOD:
+            if (b == 0) {
+                base_errno = BASE_ERR_RANGE;
+                return false;
+            }
+            if (a == INT32_MIN && b == -1) {
+                /* avoid trapping on overflow */
+                r = id == OPR_ID_DIV ? ua : 0u;
+            } else {
+                r = (uint32_t)(id == OPR_ID_DIV ? a / b : a % b);
+            }
+            break;
+        case OPR_ID_ADD:        r = ua + ub; break;
+        case OPR_ID_SUB:        r = ua - ub; break;
+        case OPR_ID_LSHIFT:     r = ua << (ub & 31u); break;
+        case OPR_ID_RSHIFT:     r = (uint32_t)(a >> (ub & 31u)); break;
+        case OPR_ID_LT:         r = a < b; break;
+        case OPR_ID_LTE:        r = a <= b; break;
+        case OPR_ID_GT:         r = a > b; break;
+        case OPR_ID_GTE:        r = a >= b; break;
+        case OPR_ID_EQUAL:      r = a == b; break;
+        case OPR_ID_NOTEQUAL:   r = a != b; break;
+        case OPR_ID_AND_BIT:    r = ua & ub; break;
+        case OPR_ID_XOR:        r = ua ^ ub; break;
+        case OPR_ID_OR_BIT:     r = ua | ub; break;
+        case OPR_ID_AND_LOG:    r = a != 0 && b != 0; break;
+        case OPR_ID_OR_LOG:     r = a != 0 || b != 0; break;
+        default:
+            base_errno = BASE_ERR_ENUM;
+            return false;
+    }
+    *result = (int32_t)r;
+    return true;
+}
+
+
+/** \brief  Reserve \a size bytes at the end of the arena
+ *
+ * \param[in,out]   code    bytecode arena
+ * \param[in]       size    number of bytes to reserve
+ *
+ * \return  pointer to reserved bytes
+ */
+static uint8_t *code_reserve(expr_code_t *code, size_t size)
+{
+    uint8_t *p;
+
+    if (code->used + size > code->size) {
+        while (code->used + size > code->size) {
+            code->size *= 2;
+        }
+        code->data = base_realloc(code->data, code->size);
+    }
+    p = code->data + code->used;
+    code->used += size;
+    return p;
+}
+
+
+/** \brief  Emit constant
+ *
+ * Uses the short #EXPR_OP_BYTE form for values in the range 0-255.
+ *
+ * \param[in,out]   code    bytecode arena
+ * \param[in]       value   constant
+ */
+static void emit_const(expr_code_t *code, int32_t value)
+{
+    uint8_t *p;
+
+    if (value >= 0 && value <= 0xff) {
+        p = code_reserve(code, 2u);
+        p[0] = EXPR_OP_BYTE;
+        p[1] = (uint8_t)value;
+    } else {
+        p = code_reserve(code, 5u);
+        p[0] = EXPR_OP_CONST;
+        put_u32(p + 1, (uint32_t)value);
+    }
+}
+
+
+/** \brief  Push operand onto the compiler's operand stack
+ *
+ * \param[in,out]   comp        compiler state
+ * \param[in]       offset      offset of operand code in the arena
+ * \param[in]       constant    operand is constant
+ * \param[in]       value       value of the operand if constant
+ *
+ * \return  `false` on stack overflow
+ * \throw   BASE_ERR_RANGE  expression too complex
+ */
+static bool push_operand(compiler_t *comp,
+                         size_t offset,
+                         bool constant,
+                         int32_t value)
+{
+    operand_t *op;
+
+    if (comp->vals_used == EXPR_STACK_MAX) {
+        base_errno = BASE_ERR_RANGE;
+        return false;
+    }
+    op = &comp->vals[comp->vals_used++];
+    op->offset = offset;
+    op->constant = constant;
+    op->value = value;
+    return true;
+}
+
+
+/** \brief  Emit constant operand
+ *
+ * \param[in,out]   comp    compiler state
+ * \param[in]       value   constant
+ *
+ * \return  `false` on error
+ */
+static bool emit_const_operand(compiler_t *comp, int32_t value)
+{
+    size_t offset = comp->code->used;
+
+    emit_const(comp->code, value);
+    return push_operand(comp, offset, true, value);
+}
+
+
+/** \brief  Emit symbol operand
+ *
+ * \param[in,out]   comp    compiler state
+ * \param[in]       slot    symbol slot index
+ *
+ * \return  `false` on error
+ */
+static bool emit_symbol_operand(compiler_t *comp, uint32_t slot)
+{
+    size_t offset = comp->code->used;
+    uint8_t *p = code_reserve(comp->code, 5u);
+
+    p[0] = EXPR_OP_SYMBOL;
+    put_u32(p + 1, slot);
+    return push_operand(comp, offset, false, 0);
+}
+
+
+/** \brief  Emit operator, folding constant operands
+ *
+ * If all operands of the operator are constants, their code is removed and
+ * replaced with the result of applying the operator.
+ *
+ * \param[in,out]   comp    compiler state
+ * \param[in]       id      operator ID
+ *
+ * \return  `false` on error
+ * \throw   BASE_ERR_SYNTAX missing operand
+ * \throw   BASE_ERR_RANGE  division by zero in constant subexpression
+ */
+static bool emit_operator(compiler_t *comp, operator_id_t id)
+{
+    size_t nargs = is_unary(id) ? 1u : 2u;
+    operand_t *args;
+    uint8_t *p;
+
+    if (comp->vals_used < nargs) {
+        base_errno = BASE_ERR_SYNTAX;
+        return false;
+    }
+    args = &comp->vals[comp->vals_used - nargs];
+
+    if (args[0].constant && (nargs == 1u || args[1].constant)) {
+        int32_t result;
+
+        if (!apply_operator(id, args[0].value,
+                            nargs == 2u ? args[1].value : 0, &result)) {
+            return false;
+        }
+        /* drop the operands' code and replace with the folded constant */
+        comp->code->used = args[0].offset;
+        comp->vals_used -= nargs;
+        return emit_const_operand(comp, result);
+    }
+
+    p = code_reserve(comp->code, 2u);
+    p[0] = nargs == 1u ? EXPR_OP_UNARY : EXPR_OP_BINARY;
+    p[1] = (uint8_t)id;
+    /* the result replaces the operands on the stack, its code starts where
+     * the code of the first operand starts */
+    comp->vals_used -= nargs - 1u;
+    args[0].constant = false;
+    return true;
+}
+
+
+/** \brief  Pop operators off the operator stack while \a id binds weaker
+ *
+ * \param[in,out]   comp    compiler state
+ * \param[in]       id      binary operator about to be pushed
+ *
+ * \return  `false` on error
+ */
+static bool reduce(compiler_t *comp, operator_id_t id)
+{
+    int prec = operator_prec(id);
+    bool ltr = operator_assoc(id) == OPR_LTR;
+
+    while (comp->ops_used > 0) {
+        operator_id_t top = comp->ops[comp->ops_used - 1u];
+        int top_prec;
+
+        if (top == OPR_ID_LPAREN) {
+            break;
+        }
+        top_prec = operator_prec(top);
+        if (top_prec < prec || (top_prec == prec && !ltr)) {
+            break;
+        }
+        comp->ops_used--;
+        if (!emit_operator(comp, top)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Push operator onto the compiler's operator stack
+ *
+ * \param[in,out]   comp    compiler state
+ * \param[in]       id      operator ID
+ *
+ * \return  `false` on stack overflow
+ * \throw   BASE_ERR_RANGE  expression too complex
+ */
+static bool push_operator(compiler_t *comp, operator_id_t id)
+{
+    if (comp->ops_used == EXPR_STACK_MAX) {
+        base_errno = BASE_ERR_RANGE;
+        return false;
+    }
+    comp->ops[comp->ops_used++] = id;
+    return true;
+}
+
+
+/** \brief  Determine if \a ch can start an identifier
+ *
+ * \param[in]   ch  character
+ *
+ * \return  bool
+ */
+static bool is_ident_start(int ch)
+{
+    return isalpha(ch) || ch == '_';
+}
+
+
+/** \brief  Determine if \a ch can be part of an identifier
+ *
+ * \param[in]   ch  character
+ *
+ * \return  bool
+ */
+static bool is_ident_char(int ch)
+{
+    return isalnum(ch) || ch == '_';
+}
+
+
+/** \brief  Initialize bytecode arena
+ *
+ * \param[out]  code    bytecode arena
+ */
+void expr_code_init(expr_code_t *code)
+{
+    code->data = base_malloc(EXPR_CODE_INITIAL_SIZE);
+    code->size = EXPR_CODE_INITIAL_SIZE;
+    code->used = 0;
+}
+
+
+/** \brief  Free memory used by the bytecode arena
+ *
+ * Invalidates all expressions compiled into \a code.
+ *
+ * \param[in,out]   code    bytecode arena
+ */
+void expr_code_free(expr_code_t *code)
+{
+    base_free(code->data);
+    code->data = NULL;
+    code->size = 0;
+    code->used = 0;
+}
+
+
+/** \brief  Remove all expressions from the bytecode arena
+ *
+ * Invalidates all expressions compiled into \a code but keeps the memory
+ * allocated for reuse.
+ *
+ * \param[in,out]   code    bytecode arena
+ */
+void expr_code_reset(expr_code_t *code)
+{
+    code->used = 0;
+}
+
+
+/** \brief  Compile expression
+ *
+ * Compile the expression at the start of \a text into bytecode appended to
+ * \a code. Compilation stops at the first character that cannot continue the
+ * expression, such as a comma or an unmatched closing parenthesis (as in
+ * `$fb),y` when the opening parenthesis of an indirect operand has already
+ * been consumed), \a endptr is set to point to that character.
+ *
+ * Operands are decimal, hexadecimal (`$`) and binary (`%`) integer literals,
+ * character literals (`'a'`) and symbol names, which are mapped to slot
+ * indices with \a symbol_cb.
+ *
+ * \param[in,out]   code        bytecode arena
+ * \param[in]       text        expression text
+ * \param[out]      endptr      first character after the expression (optional)
+ * \param[in]       symbol_cb   symbol resolver (optional)
+ * \param[in]       data        user data for \a symbol_cb
+ * \param[out]      expr        compiled expression
+ *
+ * \return  `true` on success
+ * \throw   BASE_ERR_EMPTY  no expression found
+ * \throw   BASE_ERR_SYNTAX syntax error
+ * \throw   BASE_ERR_UNDEF  \a symbol_cb rejected a symbol or is `NULL`
+ * \throw   BASE_ERR_RANGE  literal out of range, expression too complex or
+ *                          division by zero in a constant subexpression
+ */
+bool expr_compile(expr_code_t *code,
+                  const char *text,
+                  const char **endptr,
+                  expr_symbol_cb_t symbol_cb,
+                  void *data,
+                  expr_t *expr)
+{
+    compiler_t comp;
+    operator_ctx_t ctx = OPR_CTX_OPERAND;
+    const char *p = text;
+    size_t start = code->used;
+    bool ok = true;
+
+    comp.code = code;
+    comp.ops_used = 0;
+    comp.vals_used = 0;
+
+    while (ok) {
+        operator_id_t id;
+        size_t len;
+
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+
+        if (ctx == OPR_CTX_OPERAND) {
+            unsigned char ch = (unsigned char)*p;
+
+            if (isdigit(ch) || ch == STR_PREFIX_HEX || ch == '\'' ||
+                    (ch == STR_PREFIX_BIN && (p[1] == '0' || p[1] == '1'))) {
+                int32_t value;
+
+                if (!str_scan_int(p, &len, &value)) {
+                    ok = false;
+                    break;
+                }
+                p += len;
+                ok = emit_const_operand(&comp, value);
+                ctx = OPR_CTX_OPERATOR;
+            } else if (is_ident_start(ch)) {
+                const char *name = p;
+                uint32_t slot;
+
+                while (is_ident_char((unsigned char)*p)) {
+                    p++;
+                }
+                if (symbol_cb == NULL ||
+                        !symbol_cb(name, (size_t)(p - name), &slot, data)) {
+                    base_errno = BASE_ERR_UNDEF;
+                    ok = false;
+                    break;
+                }
+                ok = emit_symbol_operand(&comp, slot);
+                ctx = OPR_CTX_OPERATOR;
+            } else {
+                id = operator_parse(p, OPR_CTX_OPERAND, &len);
+                if (id != OPR_ID_LPAREN && !is_unary(id)) {
+                    base_errno = (p == text && comp.ops_used == 0)
+                        ? BASE_ERR_EMPTY : BASE_ERR_SYNTAX;
+                    ok = false;
+                    break;
+                }
+                p += len;
+                ok = push_operator(&comp, id);
+            }
+        } else {
+            id = operator_parse(p, OPR_CTX_OPERATOR, &len);
+            if (id == OPR_ID_RPAREN) {
+                /* pop operators until the matching '(' */
+                while (comp.ops_used > 0 &&
+                        comp.ops[comp.ops_used - 1u] != OPR_ID_LPAREN) {
+                    if (!emit_operator(&comp, comp.ops[--comp.ops_used])) {
+                        ok = false;
+                        break;
+                    }
+                }
+                if (!ok || comp.ops_used == 0) {
+                    /* unmatched ')' ends the expression */
+                    break;
+                }
+                comp.ops_used--;
+                p += len;
+            } else if (is_binary(id)) {
+                ok = reduce(&comp, id) && push_operator(&comp, id);
+                p += len;
+                ctx = OPR_CTX_OPERAND;
+            } else {
+                /* end of expression */
+                break;
+            }
+        }
+    }
+
+    if (ok && ctx == OPR_CTX_OPERAND) {
+        /* missing operand */
+        base_errno = BASE_ERR_SYNTAX;
+        ok = false;
+    }
+    while (ok && comp.ops_used > 0) {
+        operator_id_t id = comp.ops[--comp.ops_used];
+
+        if (id == OPR_ID_LPAREN) {
+            /* unmatched '(' */
+            base_errno = BASE_ERR_SYNTAX;
+            ok = false;
+        } else {
+            ok = emit_operator(&comp, id);
+        }
+    }
+
+    if (endptr != NULL) {
+        *endptr = p;
+    }
+    if (!ok) {
+        /* discard partial code */
+        code->used = start;
+        return false;
+    }
+    expr->offset = start;
+    expr->len = code->used - start;
+    return true;
+}
+
+
+/** \brief  Evaluate compiled expression
+ *
+ * \param[in]   code    bytecode arena
+ * \param[in]   expr    compiled expression
+ * \param[in]   env     symbol values (optional if \a expr has no symbols)
+ * \param[out]  result  value of the expression
+ *
+ * \return  `true` on success
+ * \throw   BASE_ERR_UNDEF  a symbol is undefined
+ * \throw   BASE_ERR_RANGE  division by zero
+ */
+bool expr_eval(const expr_code_t *code,
+               const expr_t *expr,
+               const expr_env_t *env,
+               int32_t *result)
+{
+    int32_t stack[EXPR_STACK_MAX];
+    size_t sp = 0;
+    const uint8_t *pc = code->data + expr->offset;
+    const uint8_t *end = pc + expr->len;
+
+    while (pc < end) {
+        uint32_t slot;
+
+        switch ((expr_opcode_t)*pc) {
+            case EXPR_OP_BYTE:
+                stack[sp++] = pc[1];
+                pc += 2;
+                break;
+            case EXPR_OP_CONST:
+                stack[sp++] = (int32_t)get_u32(pc + 1);
+                pc += 5;
+                break;
+            case EXPR_OP_SYMBOL:
+                slot = get_u32(pc + 1);
+                if (env == NULL || slot >= env->count ||
+                        (env->defined != NULL && !env->defined[slot])) {
+                    base_errno = BASE_ERR_UNDEF;
+                    return false;
+                }
+                stack[sp++] = env->values[slot];
+                pc += 5;
+                break;
+            case EXPR_OP_UNARY:
+                if (!apply_operator((operator_id_t)pc[1],
+                                    stack[sp - 1u], 0, &stack[sp - 1u])) {
+                    return false;
+                }
+                pc += 2;
+                break;
+            case EXPR_OP_BINARY:
+                if (!apply_operator((operator_id_t)pc[1],
+                                    stack[sp - 2u], stack[sp - 1u],
+                                    &stack[sp - 2u])) {
+                    return false;
+                }
+                sp--;
+                pc += 2;
+                break;
+            default:
+                base_errno = BASE_ERR_ENUM;
+                return false;
+        }
+    }
+    *result = stack[0];
+    return true;
+}
+
+
+/** \brief  Determine if a compiled expression is constant
+ *
+ * Constant expressions are folded into a single constant during compilation.
+ *
+ * \param[in]   code    bytecode arena
+ * \param[in]   expr    compiled expression
+ * \param[out]  value   value of \a expr if constant (optional)
+ *
+ * \return  `true` if \a expr is constant
+ */
+bool expr_is_const(const expr_code_t *code, const expr_t *expr, int32_t *value)
+{
+    const uint8_t *pc = code->data + expr->offset;
+    int32_t v;
+
+    if (expr->len == 2u && pc[0] == EXPR_OP_BYTE) {
+        v = pc[1];
+    } else if (expr->len == 5u && pc[0] == EXPR_OP_CONST) {
+        v = (int32_t)get_u32(pc + 1);
+    } else {
+        return false;
+    }
+    if (value != NULL) {
+        *value = v;
+    }
+    return true;
+}
+
+
+/** \brief  Debug hook: dump bytecode of \a expr on stdout
+ *
+ * \param[in]   code    bytecode arena
+ * \param[in]   expr    compiled expression
+ */
+void expr_dump(const expr_code_t *code, const expr_t *expr)
+{
+    const uint8_t *pc = code->data + expr->offset;
+    const uint8_t *end = pc + expr->len;
+
+    while (pc < end) {
+        switch ((expr_opcode_t)*pc) {
+            case EXPR_OP_BYTE:
+                printf("byte    $%02x\n", (unsigned int)pc[1]);
+                pc += 2;
+                break;
+            case EXPR_OP_CONST:
+                printf("const   $%08"PRIx32"\n", get_u32(pc + 1));
+                pc += 5;
+                break;
+            case EXPR_OP_SYMBOL:
+                printf("symbol  #%"PRIu32"\n", get_u32(pc + 1));
+                pc += 5;
+                break;
+            case EXPR_OP_UNARY:
+                printf("unary   %s\n", operator_text((operator_id_t)pc[1]));
+                pc += 2;
+                break;
+            case EXPR_OP_BINARY:
+                printf("binary  %s\n", operator_text((operator_id_t)pc[1]));
+                pc += 2;
+                break;
+            default:
+                printf("??      $%02x\n", (unsigned int)*pc);
+                return;
+        }
+    }
+}
@@ -0,0 +1,125 @@
+/** \file   expr.h
+ * \brief   Expression compiler and evaluator - header
+ * \ingroup base
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BASE_EXPR_H
+#define BASE_EXPR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/** \brief  Maximum depth of the operator and operand stacks
+ *
+ * Limits the nesting of parentheses and the number of pending operands of an
+ * expression, both during compilation and evaluation.
+ */
+#define EXPR_STACK_MAX  64
+
+
+/** \brief  Bytecode instructions
+ *
+ * Each instruction is a single byte, optionally followed by an immediate
+ * operand. Multi-byte immediates are stored little endian.
+ */
+typedef enum expr_opcode_e {
+    EXPR_OP_BYTE,   /**< push constant 0-255 (1 byte immediate) */
+    EXPR_OP_CONST,  /**< push 32-bit constant (4 byte immediate) */
+    EXPR_OP_SYMBOL, /**< push value of a symbol slot (4 byte slot index) */
+    EXPR_OP_UNARY,  /**< apply unary operator (1 byte operator ID) */
+    EXPR_OP_BINARY  /**< apply binary operator (1 byte operator ID) */
+} expr_opcode_t;
+
+
+/** \brief  Bytecode arena
+ *
+ * Contains the bytecode of all expressions compiled into it. Expressions
+ * refer to their code by offset, so the arena can grow while compiling.
+ */
+typedef struct expr_code_s {
+    uint8_t *   data;   /**< bytecode */
+    size_t      size;   /**< number of bytes allocated for \c data */
+    size_t      used;   /**< number of bytes used in \c data */
+} expr_code_t;
+
+
+/** \brief  Compiled expression handle
+ */
+typedef struct expr_s {
+    size_t  offset; /**< offset of the bytecode in the arena */
+    size_t  len;    /**< length of the bytecode in bytes */
+} expr_t;
+
+
+/** \brief  Symbol resolver callback for the compiler
+ *
+ * Called for each symbol reference in an expression to map the symbol name
+ * to a slot index. The name is not 0-terminated.
+ *
+ * \param[in]   name    symbol name
+ * \param[in]   len     length of \a name
+ * \param[out]  slot    slot index of the symbol
+ * \param[in]   data    user data passed to expr_compile()
+ *
+ * \return  `false` to reject the symbol
+ */
+typedef bool (*expr_symbol_cb_t)(const char *name,
+                                 size_t len,
+                                 uint32_t *slot,
+                                 void *data);
+
+
+/** \brief  Symbol values for the evaluator
+ */
+typedef struct expr_env_s {
+    const int32_t * values;     /**< symbol values, indexed by slot */
+    const bool *    defined;    /**< symbol defined flags, indexed by slot
+                                     (optional, `NULL` means all defined) */
+    size_t          count;      /**< number of slots */
+} expr_env_t;
+
+
+void    expr_code_init(expr_code_t *code);
+void    expr_code_free(expr_code_t *code);
+void    expr_code_reset(expr_code_t *code);
+
+bool    expr_compile(expr_code_t *code,
+                     const char *text,
+                     const char **endptr,
+                     expr_symbol_cb_t symbol_cb,
+                     void *data,
+                     expr_t *expr);
+
+bool    expr_eval(const expr_code_t *code,
+                  const expr_t *expr,
+                  const expr_env_t *env,
+                  int32_t *result);
+
+bool    expr_is_const(const expr_code_t *code,
+                      const expr_t *expr,
+                      int32_t *value);
+
+void    expr_dump(const expr_code_t *code, const expr_t *expr);
+
+#endif
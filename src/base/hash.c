@@ -25,15 +25,31 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "hash.h"
 
 /** \brief  Prime for the 32-bit FNV-1(a) hash */
-#define FNV1_PRIME_32   ((2u << 24u) + (2u << 8u) + 0x93u)
+#define FNV1_PRIME_32   ((1u << 24u) + (1u << 8u) + 0x93u)
 
 /** \brief  Offset for the 32-bit FNV-1(a) hash */
 #define FNV1_OFFSET_32  2166136261u
 
+/** \brief  XXH64 prime 1 */
+#define XX64_PRIME_1    0x9e3779b185ebca87u
+
+/** \brief  XXH64 prime 2 */
+#define XX64_PRIME_2    0xc2b2ae3d27d4eb4fu
+
+/** \brief  XXH64 prime 3 */
+#define XX64_PRIME_3    0x165667b19e3779f9u
+
+/** \brief  XXH64 prime 4 */
+#define XX64_PRIME_4    0x85ebca77c2b2ae63u
+
+/** \brief  XXH64 prime 5 */
+#define XX64_PRIME_5    0x27d4eb2f165667c5u
+
 /** \brief  Mask for the 16-bit FNV-1(a) hash
  *
  * Mask used to xor-fold a 32-bit hash result into 16 bits
@@ -85,7 +101,7 @@ uint32_t hash_fnv1_16(const uint8_t *data, size_t size)
  *
  * Calculate \a bits bit FNV-1a hash of \a size bytes of \a data.
  *
- * Uses the 32-bit hash and xor-folds and 
+ * Uses the 32-bit hash and xor-folds the result into \a bits bits.
  *
  * \param[in]   data    data to hash
  * \param[in]   size    number of bytes of \a data to process
@@ -93,10 +109,297 @@ uint32_t hash_fnv1_16(const uint8_t *data, size_t size)
  *
  * \return  FNV-1a hash of \a bits size
  */
-
 uint32_t hash_fnv1_tiny(const uint8_t *data, size_t size, uint32_t bits)
 {
     uint32_t hash = hash_fnv1_32(data, size);
 
     return ((hash >> bits) ^ hash) & ((1u << bits) - 1u);
 }
+
+
+/*
+ * XXH64
+ *
+ * Implementation of the XXH64 algorithm by Yann Collet, producing the same
+ * hashes as the reference implementation. Input is consumed in stripes of
+ * 32 bytes by four independent 64-bit accumulators, so the multiplies of a
+ * stripe can execute in parallel.
+ */
+
+/** \brief  Rotate 64-bit value left
+ *
+ * \param[in]   x   value
+ * \param[in]   r   number of bits to rotate (1-63)
+ *
+ * \return  rotated value
+ */
+static inline uint64_t rotl64(uint64_t x, unsigned int r)
+{
+    return (x << r) | (x >> (64u - r));
+}
+
+
+/** \brief  Read little endian 64-bit value from unaligned memory
+ *
+ * \param[in]   p   pointer to data
+ *
+ * \return  value
+ */
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof v);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+
+/** \brief  Read little endian 32-bit value from unaligned memory
+ *
+ * \param[in]   p   pointer to data
+ *
+ * \return  value
+ */
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof v);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+
+/** \brief  Mix eight bytes of input into an accumulator
+ *
+ * \param[in]   acc     accumulator
+ * \param[in]   input   input
+ *
+ * \return  new accumulator value
+ */
+static inline uint64_t xx64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XX64_PRIME_2;
+    acc = rotl64(acc, 31u);
+    return acc * XX64_PRIME_1;
+}
+
+
+/** \brief  Merge accumulator into the hash
+ *
+ * \param[in]   hash    hash
+ * \param[in]   acc     accumulator
+ *
+ * \return  new hash
+ */
+static inline uint64_t xx64_merge(uint64_t hash, uint64_t acc)
+{
+    hash ^= xx64_round(0, acc);
+    return hash * XX64_PRIME_1 + XX64_PRIME_4;
+}
+
+
+/** \brief  Process stripes of 32 bytes
+ *
+ * \param[in,out]   acc     accumulators
+ * \param[in]       p       input
+ * \param[in]       size    number of bytes, multiple of 32
+ */
+static void xx64_stripes(uint64_t *acc, const uint8_t *p, size_t size)
+{
+    uint64_t a0 = acc[0];
+    uint64_t a1 = acc[1];
+    uint64_t a2 = acc[2];
+    uint64_t a3 = acc[3];
+
+    for (const uint8_t *end = p + size; p < end; p += 32) {
+        a0 = xx64_round(a0, read64(p));
+        a1 = xx64_round(a1, read64(p + 8));
+        a2 = xx64_round(a2, read64(p + 16));
+        a3 = xx64_round(a3, read64(p + 24));
+    }
+    acc[0] = a0;
+    acc[1] = a1;
+    acc[2] = a2;
+    acc[3] = a3;
+}
+
+
+/** \brief  Hash the last (less than 32) bytes and avalanche the result
+ *
+ * \param[in]   hash    hash so far, including the total length
+ * \param[in]   p       remaining input
+ * \param[in]   size    number of bytes in \a p (\< 32)
+ *
+ * \return  final hash
+ */
+static uint64_t xx64_finalize(uint64_t hash, const uint8_t *p, size_t size)
+{
+    while (size >= 8) {
+        hash ^= xx64_round(0, read64(p));
+        hash = rotl64(hash, 27u) * XX64_PRIME_1 + XX64_PRIME_4;
+        p += 8;
+        size -= 8;
+    }
+    if (size >= 4) {
+        hash ^= (uint64_t)read32(p) * XX64_PRIME_1;
+        hash = rotl64(hash, 23u) * XX64_PRIME_2 + XX64_PRIME_3;
+        p += 4;
+        size -= 4;
+    }
+    while (size-- > 0) {
+        hash ^= (uint64_t)(*p++) * XX64_PRIME_5;
+        hash = rotl64(hash, 11u) * XX64_PRIME_1;
+    }
+
+    hash ^= hash >> 33u;
+    hash *= XX64_PRIME_2;
+    hash ^= hash >> 29u;
+    hash *= XX64_PRIME_3;
+    hash ^= hash >> 32u;
+    return hash;
+}
+
+
+/** \brief  Initialize accumulators for \a seed
+ *
+ * \param[out]  acc     accumulators
+ * \param[in]   seed    seed
+ */
+static void xx64_init_acc(uint64_t *acc, uint64_t seed)
+{
+    acc[0] = seed + XX64_PRIME_1 + XX64_PRIME_2;
+    acc[1] = seed + XX64_PRIME_2;
+    acc[2] = seed;
+    acc[3] = seed - XX64_PRIME_1;
+}
+
+
+/** \brief  Fold accumulators into a single hash
+ *
+ * \param[in]   acc     accumulators
+ *
+ * \return  hash
+ */
+static uint64_t xx64_fold_acc(const uint64_t *acc)
+{
+    uint64_t hash = rotl64(acc[0], 1u) + rotl64(acc[1], 7u) +
+                    rotl64(acc[2], 12u) + rotl64(acc[3], 18u);
+
+    hash = xx64_merge(hash, acc[0]);
+    hash = xx64_merge(hash, acc[1]);
+    hash = xx64_merge(hash, acc[2]);
+    return xx64_merge(hash, acc[3]);
+}
+
+
+/** \brief  Calculate 64-bit XXH64 hash
+ *
+ * Calculate XXH64 hash of \a size bytes of \a data. Considerably faster than
+ * FNV-1a on anything but very short inputs, with much better distribution.
+ *
+ * \param[in]   data    data to hash
+ * \param[in]   size    number of bytes of \a data to process
+ * \param[in]   seed    seed
+ *
+ * \return  64-bit hash
+ */
+uint64_t hash_xx64(const void *data, size_t size, uint64_t seed)
+{
+    const uint8_t *p = data;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t acc[4];
+        size_t stripes = size & ~(size_t)31u;
+
+        xx64_init_acc(acc, seed);
+        xx64_stripes(acc, p, stripes);
+        hash = xx64_fold_acc(acc);
+        p += stripes;
+    } else {
+        hash = seed + XX64_PRIME_5;
+    }
+    hash += (uint64_t)size;
+    return xx64_finalize(hash, p, size & 31u);
+}
+
+
+/** \brief  Initialize streaming XXH64 hash
+ *
+ * \param[out]  state   hash state
+ * \param[in]   seed    seed
+ */
+void hash_xx64_init(hash_xx64_t *state, uint64_t seed)
+{
+    xx64_init_acc(state->acc, seed);
+    state->seed = seed;
+    state->total = 0;
+    state->buffered = 0;
+}
+
+
+/** \brief  Add data to streaming XXH64 hash
+ *
+ * Hashing data in pieces gives the same result as hashing it in one go with
+ * hash_xx64().
+ *
+ * \param[in,out]   state   hash state
+ * \param[in]       data    data to hash
+ * \param[in]       size    number of bytes of \a data to process
+ */
+void hash_xx64_update(hash_xx64_t *state, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    size_t stripes;
+
+    state->total += (uint64_t)size;
+
+    /* top up a partially filled buffer first */
+    if (state->buffered > 0) {
+        size_t fill = sizeof state->buffer - state->buffered;
+
+        if (size < fill) {
+            memcpy(state->buffer + state->buffered, p, size);
+            state->buffered += size;
+            return;
+        }
+        memcpy(state->buffer + state->buffered, p, fill);
+        xx64_stripes(state->acc, state->buffer, sizeof state->buffer);
+        state->buffered = 0;
+        p += fill;
+        size -= fill;
+    }
+
+    stripes = size & ~(size_t)31u;
+    xx64_stripes(state->acc, p, stripes);
+    memcpy(state->buffer, p + stripes, size - stripes);
+    state->buffered = size - stripes;
+}
+
+
+/** \brief  Get hash of the data added to streaming XXH64 hash
+ *
+ * Doesn't modify \a state, so more data can be added afterwards.
+ *
+ * \param[in]   state   hash state
+ *
+ * \return  64-bit hash
+ */
+uint64_t hash_xx64_final(const hash_xx64_t *state)
+{
+    uint64_t hash;
+
+    if (state->total >= 32) {
+        hash = xx64_fold_acc(state->acc);
+    } else {
+        hash = state->seed + XX64_PRIME_5;
+    }
+    hash += state->total;
+    return xx64_finalize(hash, state->buffer, state->buffered);
+}
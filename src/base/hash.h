@@ -28,8 +28,26 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stddef.h>
 #include <stdint.h>
 
+/** \brief  Streaming XXH64 hash state
+ *
+ * \see hash_xx64_init(), hash_xx64_update(), hash_xx64_final()
+ */
+typedef struct hash_xx64_s {
+    uint64_t    acc[4];         /**< accumulators */
+    uint64_t    seed;           /**< seed */
+    uint64_t    total;          /**< total number of bytes processed */
+    uint8_t     buffer[32];     /**< input not yet consumed */
+    size_t      buffered;       /**< number of bytes in \c buffer */
+} hash_xx64_t;
+
+
 uint32_t hash_fnv1_32(const uint8_t *data, size_t size);
 uint32_t hash_fnv1_16(const uint8_t *data, size_t size);
 uint32_t hash_fnv1_tiny(const uint8_t *data, size_t size, uint32_t bits);
 
+uint64_t hash_xx64(const void *data, size_t size, uint64_t seed);
+void     hash_xx64_init(hash_xx64_t *state, uint64_t seed);
+void     hash_xx64_update(hash_xx64_t *state, const void *data, size_t size);
+uint64_t hash_xx64_final(const hash_xx64_t *state);
+
 #endif
@@ -36,4 +36,29 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #define BASE_ARRAY_SIZE(ARR) (sizeof ARR / sizeof ARR[0])
 
+/** \brief  Hint the CPU to fetch the cache line containing \a ADDR for reading
+ *
+ * Expands to nothing useful on compilers without `__builtin_prefetch()`.
+ *
+ * \param[in]   ADDR    address
+ */
+#ifdef __GNUC__
+# define BASE_PREFETCH(ADDR) __builtin_prefetch((ADDR), 0, 3)
+#else
+# define BASE_PREFETCH(ADDR) ((void)(ADDR))
+#endif
+
+/** \brief  Storage class for per-thread variables
+ *
+ * Uses C11 `_Thread_local` or the GCC/Clang `__thread` extension. Expands to
+ * nothing on other compilers, making such variables process-global.
+ */
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+# define BASE_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+# define BASE_THREAD_LOCAL __thread
+#else
+# define BASE_THREAD_LOCAL
+#endif
+
 #endif
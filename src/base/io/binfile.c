@@ -22,13 +22,24 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+/* for writev(), fsync(), fchmod() and IOV_MAX */
+#define _XOPEN_SOURCE 700
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "../debug.h"
+#include "../helpers.h"
 #include "../mem.h"
 #include "../error.h"
 
@@ -44,6 +55,16 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #define CHUNK_SIZE          INITIAL_BUFSIZE
 
+#ifndef IOV_MAX
+/** \brief  Maximum number of buffers passed to writev(2)
+ */
+# define IOV_MAX            1024
+#endif
+
+/** \brief  Maximum number of attempts at creating a unique temporary file
+ */
+#define TEMP_ATTEMPTS       100
+
 
 /** \brief  Read binary file while allocating memory
  *
@@ -119,11 +140,18 @@ long base_binfile_read(const char *path, uint8_t **dest)
      *
      * We can't use base_realloc() here since it'll barf on a failed attempt at
      * resizing to a smaller size. */
-    if (data != NULL) {
+    if (data != NULL && size > 0) {
+        /* never shrink to 0 bytes: realloc(3) may free the buffer and return
+         * `NULL`, leaving a dangling pointer for the caller */
+#ifdef HAVE_MEM_TRACKING
+        /* tracked memory has a header realloc(3) doesn't know about */
+        data = base_realloc(data, (size_t)size);
+#else
         uint8_t *tmp = realloc(data, (size_t)size);
         if (tmp != NULL) {
             data = tmp;
         }
+#endif
     }
     *dest = data;
     fclose(fp);
@@ -131,37 +159,218 @@ long base_binfile_read(const char *path, uint8_t **dest)
 }
 
 
-/** \brief  Write binary data to file
+/** \brief  Write all vectors in \a iov to \a fd
  *
- * \param[in]   path    file to write \a data to
- * \param[in]   data    data to write to file
- * \param[in]   size    number of bytes of \a data to write
+ * Handles partial writes and writes of more than \c IOV_MAX vectors.
+ *
+ * \param[in]       fd      file descriptor
+ * \param[in,out]   iov     vectors, modified on partial writes
+ * \param[in]       count   number of vectors in \a iov
+ *
+ * \return  bool
+ */
+static bool write_vectors(int fd, struct iovec *iov, size_t count)
+{
+    while (count > 0) {
+        int n = count > IOV_MAX ? IOV_MAX : (int)count;
+        ssize_t written = writev(fd, iov, n);
+        size_t left;
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        /* skip the vectors written */
+        left = (size_t)written;
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (left > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Create temporary file next to \a path
+ *
+ * The name of the temporary file is \a path followed by a dot, the process ID
+ * and a counter, so it ends up in the same directory (and file system) as
+ * \a path and can be renamed to \a path atomically.
+ *
+ * \param[in]   path    path of the final file
+ * \param[out]  temp    path of the temporary file (heap-allocated)
+ *
+ * \return  file descriptor, or -1 on error
+ */
+static int temp_create(const char *path, char **temp)
+{
+    static BASE_THREAD_LOCAL unsigned int counter = 0;
+    size_t size = strlen(path) + 32u;
+    char *name = base_malloc(size);
+
+    for (int attempt = 0; attempt < TEMP_ATTEMPTS; attempt++) {
+        int fd;
+
+        snprintf(name, size, "%s.%ld.%u~", path, (long)getpid(), counter++);
+        fd = open(name, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (fd >= 0) {
+            *temp = name;
+            return fd;
+        }
+        if (errno != EEXIST) {
+            break;
+        }
+    }
+    base_free(name);
+    return -1;
+}
+
+
+/** \brief  Flush the directory entry of \a path to disk
+ *
+ * \param[in]   path    path of file
+ *
+ * \return  bool
+ */
+static bool sync_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    char *dir;
+    bool result;
+    int fd;
+
+    if (slash == NULL) {
+        dir = base_strdup(".");
+    } else {
+        size_t len = slash == path ? 1u : (size_t)(slash - path);
+
+        dir = base_malloc(len + 1u);
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+
+    result = false;
+    fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        result = fsync(fd) == 0;
+        close(fd);
+    }
+    base_free(dir);
+    return result;
+}
+
+
+/** \brief  Write binary data in multiple parts to file
+ *
+ * The data is written to a temporary file in the same directory as \a path
+ * with a single writev(2) call (unless the number of parts exceeds the limit
+ * of the system), which is then renamed to \a path. So \a path either has
+ * its old content or the complete new content, never a partially written
+ * file.
+ *
+ * If \a path exists, the new file gets its permission bits, otherwise the
+ * permissions follow from the umask like with fopen(3).
+ *
+ * With \a sync the data and the directory entry are flushed to disk before
+ * returning, which makes the result survive a crash or power loss, at the
+ * cost of waiting for the disk.
+ *
+ * \note    If flushing the directory fails, \a path has already been replaced
+ *          with the new content, but the replacement might not survive a
+ *          crash. This is still reported as BASE_ERR_IO, since the durability
+ *          asked for with \a sync isn't guaranteed.
+ *
+ * \param[in]   path    file to write \a parts to
+ * \param[in]   parts   parts of the data to write, in order
+ * \param[in]   count   number of elements in \a parts
+ * \param[in]   sync    flush the file to disk with fsync(2)
  *
  * \return  boolean
  *
  * \throw   BASE_ERR_IO I/O error
  */
-bool base_binfile_write(const char *path, const uint8_t *data, size_t size)
+bool base_binfile_write_parts(const char *path,
+                              const base_binfile_part_t *parts,
+                              size_t count,
+                              bool sync)
 {
-    FILE *fp;
-    size_t result;
+    struct iovec *iov;
+    struct stat st;
+    char *temp = NULL;
+    bool result = true;
+    int fd;
 
-    /* attempt to open file for writing */
-    fp = fopen(path, "wb");
-    if (fp == NULL) {
+    fd = temp_create(path, &temp);
+    if (fd < 0) {
         base_errno = BASE_ERR_IO;
         return false;
     }
 
-    /* try to write to file */
-    result = fwrite(data, 1U, size, fp);
-    if (result != size) {
-        /* oops */
+    /* keep the permissions of the file we're replacing */
+    if (stat(path, &st) == 0) {
+        result = fchmod(fd, st.st_mode & 07777) == 0;
+    }
+
+    iov = base_malloc(sizeof *iov * (count > 0 ? count : 1u));
+    for (size_t i = 0; i < count; i++) {
+        iov[i].iov_base = (void *)(uintptr_t)parts[i].data;
+        iov[i].iov_len = parts[i].size;
+    }
+
+    if (result) {
+        result = write_vectors(fd, iov, count);
+    }
+    if (result && sync) {
+        result = fsync(fd) == 0;
+    }
+    if (close(fd) != 0) {
+        result = false;
+    }
+    if (result) {
+        result = rename(temp, path) == 0;
+    }
+    if (result && sync) {
+        /* too late to back out: the new content is in place */
+        result = sync_dir(path);
+    } else if (!result) {
+        unlink(temp);
+    }
+    if (!result) {
         base_errno = BASE_ERR_IO;
-        fclose(fp);
-        return false;
     }
 
-    fclose(fp);
-    return true;
+    base_free(iov);
+    base_free(temp);
+    return result;
+}
+
+
+/** \brief  Write binary data to file
+ *
+ * \param[in]   path    file to write \a data to
+ * \param[in]   data    data to write to file
+ * \param[in]   size    number of bytes of \a data to write
+ * \param[in]   sync    flush the file to disk with fsync(2)
+ *
+ * \return  boolean
+ *
+ * \throw   BASE_ERR_IO I/O error
+ *
+ * \see base_binfile_write_parts
+ */
+bool base_binfile_write(const char *path,
+                        const uint8_t *data,
+                        size_t size,
+                        bool sync)
+{
+    base_binfile_part_t part = { data, size };
+
+    return base_binfile_write_parts(path, &part, 1, sync);
 }
@@ -29,7 +29,23 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdbool.h>
 #include <stdint.h>
 
+
+/** \brief  Part of the data written by base_binfile_write_parts()
+ */
+typedef struct base_binfile_part_s {
+    const uint8_t * data;   /**< data */
+    size_t          size;   /**< number of bytes of \c data */
+} base_binfile_part_t;
+
+
 long base_binfile_read(const char *path, uint8_t **dest);
-bool base_binfile_write(const char *path, const uint8_t *data, size_t size);
+bool base_binfile_write(const char *path,
+                        const uint8_t *data,
+                        size_t size,
+                        bool sync);
+bool base_binfile_write_parts(const char *path,
+                              const base_binfile_part_t *parts,
+                              size_t count,
+                              bool sync);
 
 #endif
@@ -0,0 +1,554 @@
+/** \file   image.c
+ * \brief   Sparse output image
+ * \ingroup base
+ *
+ * Collects the segments produced by the assembler in a sparse 16MB address
+ * space and writes (parts of) it to file, filling the gaps between segments.
+ * Each file is written with base_binfile_write_parts(), directly from the
+ * pages of the image.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../debug.h"
+#include "../mem.h"
+#include "../error.h"
+#include "binfile.h"
+
+#include "image.h"
+
+
+/** \brief  Size of the buffer used to write gaps
+ *
+ * Sixteen pages, so each vector written for a gap covers up to sixteen
+ * unallocated pages.
+ */
+#define FILL_SIZE   (IMAGE_PAGE_SIZE * 16)
+
+
+/** \brief  Get index of lowest set bit in \a word
+ *
+ * \param[in]   word    value, must not be 0
+ *
+ * \return  bit index
+ */
+static unsigned int lowest_bit(uint64_t word)
+{
+#ifdef __GNUC__
+    return (unsigned int)__builtin_ctzll((unsigned long long)word);
+#else
+    unsigned int bit = 0;
+
+    while ((word & 1u) == 0) {
+        word >>= 1u;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+
+/** \brief  Find first bit in a 256-bit bitmap that is set or clear
+ *
+ * \param[in]   bits    bitmap
+ * \param[in]   index   bit to start searching at
+ * \param[in]   set     look for a set bit
+ *
+ * \return  index of the bit, or 256 when not found
+ */
+static unsigned int bits_find(const uint64_t *bits, unsigned int index, bool set)
+{
+    while (index < IMAGE_BITMAP_WORDS * 64u) {
+        uint64_t word = set ? bits[index / 64u] : ~bits[index / 64u];
+
+        word &= ~UINT64_C(0) << (index % 64u);
+        if (word != 0) {
+            return (index & ~63u) + lowest_bit(word);
+        }
+        index = (index & ~63u) + 64u;
+    }
+    return IMAGE_BITMAP_WORDS * 64u;
+}
+
+
+/** \brief  Set bit \a index in a bitmap
+ *
+ * \param[in,out]   bits    bitmap
+ * \param[in]       index   bit index
+ */
+static void bits_set(uint64_t *bits, unsigned int index)
+{
+    bits[index / 64u] |= UINT64_C(1) << (index % 64u);
+}
+
+
+/** \brief  Get page containing \a address
+ *
+ * \param[in]   image   image
+ * \param[in]   address address
+ *
+ * \return  page or `NULL` when not allocated
+ */
+static const image_page_t *page_find(const image_t *image, uint32_t address)
+{
+    const image_bank_t *bank = image->banks[address >> 16u];
+
+    if (bank == NULL) {
+        return NULL;
+    }
+    return bank->pages[(address >> 8u) & 0xffu];
+}
+
+
+/** \brief  Get page containing \a address, allocating it if required
+ *
+ * \param[in,out]   image   image
+ * \param[in]       address address
+ *
+ * \return  page
+ */
+static image_page_t *page_get(image_t *image, uint32_t address)
+{
+    unsigned int b = address >> 16u;
+    unsigned int p = (address >> 8u) & 0xffu;
+    image_bank_t *bank = image->banks[b];
+    image_page_t *page;
+
+    if (bank == NULL) {
+        bank = base_calloc(1, sizeof *bank);
+        image->banks[b] = bank;
+        bits_set(image->banks_used, b);
+    }
+    page = bank->pages[p];
+    if (page == NULL) {
+        page = base_malloc(sizeof *page);
+        memset(page->data, image->fill, sizeof page->data);
+        memset(page->used, 0, sizeof page->used);
+        bank->pages[p] = page;
+        bits_set(bank->dirty, p);
+        image->pages_used++;
+    }
+    return page;
+}
+
+
+/** \brief  Find first written or unwritten byte at or after \a address
+ *
+ * Skips unallocated banks and pages using the bitmaps.
+ *
+ * \param[in]   image   image
+ * \param[in]   address address to start searching at
+ * \param[in]   used    look for a written byte
+ *
+ * \return  address of the byte, or #IMAGE_SIZE when not found
+ */
+static uint32_t find_byte(const image_t *image, uint32_t address, bool used)
+{
+    while (address < IMAGE_SIZE) {
+        unsigned int b = address >> 16u;
+        unsigned int p = (address >> 8u) & 0xffu;
+        const image_bank_t *bank;
+        const image_page_t *page;
+        unsigned int index;
+
+        if (used) {
+            index = bits_find(image->banks_used, b, true);
+            if (index >= IMAGE_BANKS) {
+                break;
+            }
+            if (index != b) {
+                b = index;
+                p = 0;
+                address = (uint32_t)b << 16u;
+            }
+            bank = image->banks[b];
+            index = bits_find(bank->dirty, p, true);
+            if (index >= IMAGE_BANK_PAGES) {
+                address = (uint32_t)(b + 1u) << 16u;
+                continue;
+            }
+            if (index != p) {
+                address = ((uint32_t)b << 16u) | ((uint32_t)index << 8u);
+            }
+        }
+
+        page = page_find(image, address);
+        if (page == NULL) {
+            /* only reached when looking for an unwritten byte */
+            return address;
+        }
+        index = bits_find(page->used, address & 0xffu, used);
+        if (index < IMAGE_PAGE_SIZE) {
+            return (address & ~UINT32_C(0xff)) | index;
+        }
+        address = (address | 0xffu) + 1u;
+    }
+    return IMAGE_SIZE;
+}
+
+
+/** \brief  Check if the range \a address to \a size is inside the image
+ *
+ * \param[in]   address start address
+ * \param[in]   size    number of bytes
+ *
+ * \return  bool
+ *
+ * \throw   BASE_ERR_RANGE  range outside the image
+ */
+static bool range_valid(uint32_t address, size_t size)
+{
+    if (address > IMAGE_SIZE || size > IMAGE_SIZE - address) {
+        base_errno = BASE_ERR_RANGE;
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Initialize \a image
+ *
+ * \param[out]  image   image
+ * \param[in]   fill    value of bytes not written to
+ */
+void image_init(image_t *image, uint8_t fill)
+{
+    memset(image->banks, 0, sizeof image->banks);
+    memset(image->banks_used, 0, sizeof image->banks_used);
+    image->start = IMAGE_SIZE;
+    image->end = 0;
+    image->overlap = 0;
+    image->pages_used = 0;
+    image->bytes_used = 0;
+    image->fill = fill;
+}
+
+
+/** \brief  Free memory used by the members of \a image
+ *
+ * Leaves \a image empty, ready for reuse.
+ *
+ * \param[in,out]   image   image
+ */
+void image_free(image_t *image)
+{
+    for (size_t b = 0; b < IMAGE_BANKS; b++) {
+        image_bank_t *bank = image->banks[b];
+
+        if (bank != NULL) {
+            for (size_t p = 0; p < IMAGE_BANK_PAGES; p++) {
+                if (bank->pages[p] != NULL) {
+                    base_free(bank->pages[p]);
+                }
+            }
+            base_free(bank);
+        }
+    }
+    image_init(image, image->fill);
+}
+
+
+/** \brief  Write \a size bytes of \a data to \a image at \a address
+ *
+ * Nothing is written if any of the bytes was written before, in that case
+ * the address of the first overlapping byte is stored in the \c overlap
+ * member of \a image.
+ *
+ * \param[in,out]   image   image
+ * \param[in]       address address of the first byte
+ * \param[in]       data    data
+ * \param[in]       size    number of bytes of \a data
+ *
+ * \return  bool
+ *
+ * \throw   BASE_ERR_RANGE      data doesn't fit in the image
+ * \throw   BASE_ERR_OVERLAP    data overlaps previously written data
+ */
+bool image_write(image_t *image, uint32_t address,
+                 const uint8_t *data, size_t size)
+{
+    uint32_t start = address;
+    uint32_t end;
+    uint32_t overlap;
+
+    if (size == 0) {
+        return true;
+    }
+    if (!range_valid(address, size)) {
+        return false;
+    }
+    end = address + (uint32_t)size;
+
+    overlap = find_byte(image, address, true);
+    if (overlap < end) {
+        image->overlap = overlap;
+        base_errno = BASE_ERR_OVERLAP;
+        return false;
+    }
+
+    while (address < end) {
+        image_page_t *page = page_get(image, address);
+        unsigned int offset = address & 0xffu;
+        size_t count = IMAGE_PAGE_SIZE - offset;
+
+        if (count > end - address) {
+            count = end - address;
+        }
+        memcpy(page->data + offset, data, count);
+        for (size_t i = 0; i < count; i++) {
+            bits_set(page->used, (unsigned int)(offset + i));
+        }
+        image->bytes_used += count;
+        address += (uint32_t)count;
+        data += count;
+    }
+
+    if (start < image->start) {
+        image->start = start;
+    }
+    if (end > image->end) {
+        image->end = end;
+    }
+    return true;
+}
+
+
+/** \brief  Read \a size bytes from \a image at \a address
+ *
+ * Bytes not written to are read as the fill byte of \a image.
+ *
+ * \param[in]   image   image
+ * \param[in]   address address of the first byte
+ * \param[out]  dest    destination of the data
+ * \param[in]   size    number of bytes to read
+ *
+ * \return  bool
+ *
+ * \throw   BASE_ERR_RANGE  range outside the image
+ */
+bool image_read(const image_t *image, uint32_t address,
+                uint8_t *dest, size_t size)
+{
+    if (!range_valid(address, size)) {
+        return false;
+    }
+
+    while (size > 0) {
+        const image_page_t *page = page_find(image, address);
+        unsigned int offset = address & 0xffu;
+        size_t count = IMAGE_PAGE_SIZE - offset;
+
+        if (count > size) {
+            count = size;
+        }
+        if (page != NULL) {
+            memcpy(dest, page->data + offset, count);
+        } else {
+            memset(dest, image->fill, count);
+        }
+        address += (uint32_t)count;
+        dest += count;
+        size -= count;
+    }
+    return true;
+}
+
+
+/** \brief  Find next segment of \a image
+ *
+ * A segment is a run of written bytes. To iterate all segments, start at 0
+ * and pass the end of the previous segment as \a from.
+ *
+ * \param[in]   image   image
+ * \param[in]   from    address to start searching at
+ * \param[out]  start   address of the first byte of the segment
+ * \param[out]  end     address of the last byte of the segment plus one
+ *
+ * \return  `false` when no segment was found
+ */
+bool image_next_segment(const image_t *image, uint32_t from,
+                        uint32_t *start, uint32_t *end)
+{
+    uint32_t address = find_byte(image, from, true);
+
+    if (address >= IMAGE_SIZE) {
+        return false;
+    }
+    *start = address;
+    *end = find_byte(image, address, false);
+    return true;
+}
+
+
+/** \brief  Write range \a start to \a end of \a image to \a path
+ *
+ * Gaps are written as the fill byte of \a image.
+ *
+ * \param[in]   image   image
+ * \param[in]   path    path of file to write
+ * \param[in]   format  file format
+ * \param[in]   start   first address to write
+ * \param[in]   end     last address to write plus one
+ * \param[in]   sync    flush the file to disk with fsync(2)
+ *
+ * \return  bool
+ *
+ * \throw   BASE_ERR_RANGE  invalid range, or range outside the first 64KB
+ *                          while writing a PRG file
+ * \throw   BASE_ERR_IO     I/O error
+ */
+bool image_save_range(const image_t *image, const char *path,
+                      image_format_t format, uint32_t start, uint32_t end,
+                      bool sync)
+{
+    base_binfile_part_t *parts;
+    size_t count = 0;
+    uint8_t header[2];
+    uint8_t *fill;
+    uint32_t address;
+    bool fill_last = false;
+    bool result;
+
+    if (start > end || !range_valid(start, end - start)) {
+        base_errno = BASE_ERR_RANGE;
+        return false;
+    }
+    if (format == IMAGE_FORMAT_PRG && end > 0x10000) {
+        base_errno = BASE_ERR_RANGE;
+        return false;
+    }
+
+    /* one part per page at most, plus the header */
+    parts = base_malloc(sizeof *parts * ((end - start) / IMAGE_PAGE_SIZE + 3u));
+    fill = base_malloc(FILL_SIZE);
+    memset(fill, image->fill, FILL_SIZE);
+
+    if (format == IMAGE_FORMAT_PRG) {
+        header[0] = (uint8_t)(start & 0xffu);
+        header[1] = (uint8_t)(start >> 8u);
+        parts[count].data = header;
+        parts[count].size = sizeof header;
+        count++;
+    }
+
+    address = start;
+    while (address < end) {
+        const image_page_t *page = page_find(image, address);
+        unsigned int offset = address & 0xffu;
+        size_t size = IMAGE_PAGE_SIZE - offset;
+
+        if (size > end - address) {
+            size = end - address;
+        }
+        if (page != NULL) {
+            parts[count].data = page->data + offset;
+            parts[count].size = size;
+            count++;
+            fill_last = false;
+        } else if (fill_last && parts[count - 1u].size + size <= FILL_SIZE) {
+            parts[count - 1u].size += size;
+        } else {
+            parts[count].data = fill;
+            parts[count].size = size;
+            count++;
+            fill_last = true;
+        }
+        address += (uint32_t)size;
+    }
+
+    result = base_binfile_write_parts(path, parts, count, sync);
+
+    base_free(fill);
+    base_free(parts);
+    return result;
+}
+
+
+/** \brief  Write \a image to \a path
+ *
+ * Writes the range from the lowest to the highest written address.
+ *
+ * \param[in]   image   image
+ * \param[in]   path    path of file to write
+ * \param[in]   format  file format
+ * \param[in]   sync    flush the file to disk with fsync(2)
+ *
+ * \return  bool
+ *
+ * \throw   BASE_ERR_EMPTY  nothing written to \a image
+ * \throw   BASE_ERR_RANGE  image doesn't fit in the first 64KB while
+ *                          writing a PRG file
+ * \throw   BASE_ERR_IO     I/O error
+ */
+bool image_save(const image_t *image, const char *path,
+                image_format_t format, bool sync)
+{
+    if (image->bytes_used == 0) {
+        base_errno = BASE_ERR_EMPTY;
+        return false;
+    }
+    return image_save_range(image, path, format,
+                            image->start, image->end, sync);
+}
+
+
+/** \brief  Write each segment of \a image to a separate file
+ *
+ * The path of each file is \a prefix, followed by the start address of the
+ * segment in hexadecimal (four digits or six for addresses above 64KB),
+ * followed by \a suffix.
+ *
+ * \param[in]   image   image
+ * \param[in]   prefix  start of each path
+ * \param[in]   suffix  end of each path
+ * \param[in]   format  file format
+ * \param[in]   sync    flush the files to disk with fsync(2)
+ *
+ * \return  bool
+ *
+ * \throw   BASE_ERR_RANGE  segment doesn't fit in the first 64KB while
+ *                          writing PRG files
+ * \throw   BASE_ERR_IO     I/O error
+ */
+bool image_save_segments(const image_t *image,
+                         const char *prefix, const char *suffix,
+                         image_format_t format,
+                         bool sync)
+{
+    size_t size = strlen(prefix) + strlen(suffix) + 7u;
+    char *path = base_malloc(size);
+    uint32_t start;
+    uint32_t end = 0;
+    bool result = true;
+
+    while (result && image_next_segment(image, end, &start, &end)) {
+        snprintf(path, size, "%s%0*lx%s",
+                 prefix, start > 0xffff ? 6 : 4, (unsigned long)start, suffix);
+        result = image_save_range(image, path, format, start, end, sync);
+    }
+    base_free(path);
+    return result;
+}
@@ -0,0 +1,124 @@
+/** \file   image.h
+ * \brief   Sparse output image - header
+ * \ingroup base
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BASE_IO_IMAGE_H
+#define BASE_IO_IMAGE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/** \brief  Number of bytes in a page
+ */
+#define IMAGE_PAGE_SIZE     0x100
+
+/** \brief  Number of pages in a bank
+ */
+#define IMAGE_BANK_PAGES    0x100
+
+/** \brief  Number of banks in an image
+ */
+#define IMAGE_BANKS         0x100
+
+/** \brief  Size of the address space of an image (16MB, as on the 65816)
+ */
+#define IMAGE_SIZE          (IMAGE_BANKS * IMAGE_BANK_PAGES * IMAGE_PAGE_SIZE)
+
+/** \brief  Number of 64-bit words in a bitmap of 256 bits
+ */
+#define IMAGE_BITMAP_WORDS  4
+
+
+/** \brief  Output file formats
+ */
+typedef enum image_format_e {
+    IMAGE_FORMAT_RAW,   /**< raw data */
+    IMAGE_FORMAT_PRG    /**< raw data preceded by a 16-bit little endian
+                             load address */
+} image_format_t;
+
+
+/** \brief  Page of an image
+ *
+ * Bytes not written are set to the fill byte of the image.
+ */
+typedef struct image_page_s {
+    uint8_t     data[IMAGE_PAGE_SIZE];          /**< data */
+    uint64_t    used[IMAGE_BITMAP_WORDS];       /**< bitmap of written bytes */
+} image_page_t;
+
+
+/** \brief  Bank of 64KB of an image
+ */
+typedef struct image_bank_s {
+    image_page_t *  pages[IMAGE_BANK_PAGES];    /**< pages, `NULL` when not
+                                                     written to */
+    uint64_t        dirty[IMAGE_BITMAP_WORDS];  /**< bitmap of allocated
+                                                     pages */
+} image_bank_t;
+
+
+/** \brief  Sparse output image
+ *
+ * The address space is split into banks of 256 pages of 256 bytes, which are
+ * only allocated when written to, so a few segments spread over 16MB only
+ * cost memory for the pages they occupy. Each level keeps a bitmap of the
+ * allocated or written entries below it to quickly skip unused parts.
+ */
+typedef struct image_s {
+    image_bank_t *  banks[IMAGE_BANKS];         /**< banks, `NULL` when not
+                                                     written to */
+    uint64_t        banks_used[IMAGE_BITMAP_WORDS]; /**< bitmap of allocated
+                                                         banks */
+    uint32_t        start;      /**< lowest written address */
+    uint32_t        end;        /**< highest written address plus one */
+    uint32_t        overlap;    /**< address of the first overlapping byte
+                                     of the last failed image_write() */
+    size_t          pages_used; /**< number of allocated pages */
+    size_t          bytes_used; /**< number of written bytes */
+    uint8_t         fill;       /**< value of bytes not written to */
+} image_t;
+
+
+void    image_init(image_t *image, uint8_t fill);
+void    image_free(image_t *image);
+
+bool    image_write(image_t *image, uint32_t address,
+                    const uint8_t *data, size_t size);
+bool    image_read(const image_t *image, uint32_t address,
+                   uint8_t *dest, size_t size);
+bool    image_next_segment(const image_t *image, uint32_t from,
+                           uint32_t *start, uint32_t *end);
+
+bool    image_save(const image_t *image, const char *path,
+                   image_format_t format, bool sync);
+bool    image_save_range(const image_t *image, const char *path,
+                         image_format_t format, uint32_t start, uint32_t end,
+                         bool sync);
+bool    image_save_segments(const image_t *image,
+                            const char *prefix, const char *suffix,
+                            image_format_t format, bool sync);
+
+#endif
@@ -26,6 +26,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define BASE_IO_H
 
 #include "binfile.h"
+#include "image.h"
+#include "txtcache.h"
 #include "txtfile.h"
 
 #endif
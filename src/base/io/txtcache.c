@@ -0,0 +1,305 @@
+/** \file   txtcache.c
+ * \brief   Text file cache
+ * \ingroup base
+ *
+ * Caches text files such as include files, so each file is read and split
+ * into lines once per assembly instead of once per include.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* for realpath() and struct stat's st_mtim */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../debug.h"
+#include "../dict.h"
+#include "../error.h"
+#include "../mem.h"
+#include "binfile.h"
+
+#include "txtcache.h"
+
+
+/** \brief  Initial number of elements in the files array
+ */
+#define FILES_INITIAL_SIZE  16
+
+/** \brief  Initial number of elements in the line index of a file
+ */
+#define LINES_INITIAL_SIZE  256
+
+
+/** \brief  Get canonical path of \a path
+ *
+ * \param[in]   path    path
+ *
+ * \return  canonical path (heap-allocated), or `NULL` on error
+ */
+static char *canonical_path(const char *path)
+{
+    char *real = realpath(path, NULL);
+    char *result;
+
+    if (real == NULL) {
+        return NULL;
+    }
+    /* realpath(3) uses malloc(3), copy so base_free() can be used */
+    result = base_strdup(real);
+    free(real);
+    return result;
+}
+
+
+/** \brief  Split \a file's text into lines
+ *
+ * Replaces the line terminators (LF or CR+LF) with 0 and builds the line
+ * index. A last line without terminator is included.
+ *
+ * \param[in,out]   file    cached file, with text and size set
+ */
+static void file_split(txtcache_file_t *file)
+{
+    size_t lines_size = LINES_INITIAL_SIZE;
+    size_t size = (size_t)file->size;
+    size_t pos = 0;
+
+    file->lines = base_malloc(sizeof *file->lines * lines_size);
+    file->line_count = 0;
+
+    while (pos < size) {
+        char *start = file->text + pos;
+        char *end = memchr(start, '\n', size - pos);
+        size_t len = end != NULL ? (size_t)(end - start) : size - pos;
+
+        if (file->line_count == lines_size) {
+            lines_size *= 2;
+            file->lines = base_realloc(file->lines,
+                                       sizeof *file->lines * lines_size);
+        }
+        file->lines[file->line_count].offset = pos;
+        pos += len + 1u;
+
+        /* strip Windows CR */
+        if (len > 0 && start[len - 1u] == '\r') {
+            len--;
+        }
+        start[len] = '\0';
+        file->lines[file->line_count].len = len;
+        file->line_count++;
+    }
+}
+
+
+/** \brief  Read file \a path into a new cache entry
+ *
+ * \param[in]   path    canonical path
+ * \param[in]   st      status of \a path
+ *
+ * \return  cached file, or `NULL` on error
+ *
+ * \throw   BASE_ERR_IO I/O error
+ */
+static txtcache_file_t *file_read(const char *path, const struct stat *st)
+{
+    txtcache_file_t *file;
+    uint8_t *data = NULL;
+    long size;
+
+    size = base_binfile_read(path, &data);
+    if (size < 0) {
+        return NULL;
+    }
+
+    file = base_malloc(sizeof *file);
+    file->path = base_strdup(path);
+    /* the file can have changed since the stat(2) call; a changed size
+     * causes a reload on the next lookup */
+    file->size = (int64_t)size;
+    file->mtime = (int64_t)st->st_mtim.tv_sec;
+    file->mtime_nsec = st->st_mtim.tv_nsec;
+    /* add room for the terminator of a last line without newline */
+    file->text = base_realloc(data, (size_t)size + 1u);
+    file->text[size] = '\0';
+    file_split(file);
+    return file;
+}
+
+
+/** \brief  Free cached \a file
+ *
+ * \param[in,out]   file    cached file
+ */
+static void file_free(txtcache_file_t *file)
+{
+    base_free(file->path);
+    base_free(file->text);
+    base_free(file->lines);
+    base_free(file);
+}
+
+
+/** \brief  Check if cached \a file matches the file status in \a st
+ *
+ * \param[in]   file    cached file
+ * \param[in]   st      file status
+ *
+ * \return  `true` if size and modification time match
+ */
+static bool file_current(const txtcache_file_t *file, const struct stat *st)
+{
+    return file->size == (int64_t)st->st_size &&
+           file->mtime == (int64_t)st->st_mtim.tv_sec &&
+           file->mtime_nsec == st->st_mtim.tv_nsec;
+}
+
+
+/** \brief  Initialize \a cache
+ *
+ * \param[out]  cache   text file cache
+ */
+void txtcache_init(txtcache_t *cache)
+{
+    cache->index = dict_new();
+    cache->files = base_malloc(sizeof *cache->files * FILES_INITIAL_SIZE);
+    cache->files_size = FILES_INITIAL_SIZE;
+    cache->files_used = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->reloads = 0;
+    pthread_mutex_init(&cache->lock, NULL);
+}
+
+
+/** \brief  Free memory used by the members of \a cache
+ *
+ * Invalidates all files returned by txtcache_get().
+ *
+ * \param[in,out]   cache   text file cache
+ */
+void txtcache_free(txtcache_t *cache)
+{
+    for (size_t i = 0; i < cache->files_used; i++) {
+        file_free(cache->files[i]);
+    }
+    base_free(cache->files);
+    dict_free(cache->index);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+
+/** \brief  Get file \a path from \a cache, reading it if required
+ *
+ * The file is read when it isn't in the cache yet, or when its size or
+ * modification time differs from the cached version. Reading is done without
+ * holding the lock, so other threads can use the cache meanwhile. When two
+ * threads read the same version of a file at the same time, the first one
+ * to finish adds it and the other one uses that and drops its own copy.
+ *
+ * \param[in,out]   cache   text file cache
+ * \param[in]       path    path to file
+ *
+ * \return  cached file, or `NULL` on error
+ *
+ * \throw   BASE_ERR_IO I/O error
+ */
+const txtcache_file_t *txtcache_get(txtcache_t *cache, const char *path)
+{
+    txtcache_file_t *file = NULL;
+    void *ptr = NULL;
+    struct stat st;
+    char *real;
+
+    real = canonical_path(path);
+    if (real == NULL || stat(real, &st) != 0) {
+        base_errno = BASE_ERR_IO;
+        base_free(real);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    if (dict_get_ptr(cache->index, real, &ptr) && file_current(ptr, &st)) {
+        file = ptr;
+        cache->hits++;
+    } else {
+        if (ptr != NULL) {
+            base_debug("'%s' changed, reloading.", real);
+            cache->reloads++;
+        }
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (file == NULL) {
+        file = file_read(real, &st);
+        if (file == NULL) {
+            base_free(real);
+            return NULL;
+        }
+
+        pthread_mutex_lock(&cache->lock);
+        ptr = NULL;
+        if (dict_get_ptr(cache->index, real, &ptr) && file_current(ptr, &st)) {
+            /* another thread got there first */
+            file_free(file);
+            file = ptr;
+        } else {
+            if (cache->files_used == cache->files_size) {
+                cache->files_size *= 2;
+                cache->files = base_realloc(cache->files,
+                                            sizeof *cache->files *
+                                            cache->files_size);
+            }
+            /* replaced versions stay in the files array, they may be in use */
+            cache->files[cache->files_used++] = file;
+            dict_set_ptr(cache->index, real, file);
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+    base_free(real);
+    return file;
+}
+
+
+/** \brief  Get line \a index of cached \a file
+ *
+ * \param[in]   file    cached file
+ * \param[in]   index   line index (0-based)
+ *
+ * \return  0-terminated line, or `NULL` when \a index is out of range
+ *
+ * \throw   BASE_ERR_INDEX  \a index is out of range
+ */
+const char *txtcache_line(const txtcache_file_t *file, size_t index)
+{
+    if (index >= file->line_count) {
+        base_errno = BASE_ERR_INDEX;
+        return NULL;
+    }
+    return file->text + file->lines[index].offset;
+}
@@ -0,0 +1,90 @@
+/** \file   txtcache.h
+ * \brief   Text file cache - header
+ * \ingroup base
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BASE_IO_TXTCACHE_H
+#define BASE_IO_TXTCACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../dict.h"
+
+
+/** \brief  Line of a cached text file
+ */
+typedef struct txtcache_line_s {
+    size_t  offset; /**< offset of the line in the text */
+    size_t  len;    /**< length of the line, excluding line terminators */
+} txtcache_line_t;
+
+
+/** \brief  Cached text file
+ *
+ * The text is read once and split into 0-terminated lines in place.
+ */
+typedef struct txtcache_file_s {
+    char *              path;       /**< canonical path */
+    int64_t             size;       /**< size of the file when read */
+    int64_t             mtime;      /**< modification time when read (s) */
+    long                mtime_nsec; /**< nanoseconds part of \c mtime */
+    char *              text;       /**< text, lines 0-terminated */
+    txtcache_line_t *   lines;      /**< line index */
+    size_t              line_count; /**< number of lines */
+} txtcache_file_t;
+
+
+/** \brief  Text file cache
+ *
+ * Keeps the files read through it, keyed by canonical path, so a file
+ * included from many sources is only read and split into lines once.
+ * A file is read again when its size or modification time changes.
+ *
+ * Files returned by txtcache_get() stay valid until txtcache_free(), even
+ * after being replaced by a newer version of the file. The cache can be
+ * shared between threads.
+ */
+typedef struct txtcache_s {
+    dict_t *            index;      /**< canonical path to current file */
+    txtcache_file_t **  files;      /**< all files read, including replaced
+                                         versions */
+    size_t              files_size; /**< number of elements in \c files */
+    size_t              files_used; /**< number of used elements in \c files */
+    size_t              hits;       /**< number of lookups served from the
+                                         cache */
+    size_t              misses;     /**< number of lookups reading a file */
+    size_t              reloads;    /**< number of misses caused by a changed
+                                         file */
+    pthread_mutex_t     lock;       /**< lock for concurrent access */
+} txtcache_t;
+
+
+void                    txtcache_init(txtcache_t *cache);
+void                    txtcache_free(txtcache_t *cache);
+const txtcache_file_t * txtcache_get(txtcache_t *cache, const char *path);
+const char *            txtcache_line(const txtcache_file_t *file,
+                                      size_t index);
+
+#endif
@@ -25,7 +25,6 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <errno.h>
 
 #include "../base.h"
 
@@ -52,6 +51,8 @@ static void txtfile_handle_init(txtfile_t *handle)
     handle->bufused = 0;
     handle->filepos = -1;
     handle->linenum = 0;
+    handle->cached = NULL;
+    handle->eof = false;
 }
 
 
@@ -61,7 +62,9 @@ static void txtfile_handle_init(txtfile_t *handle)
  */
 static void txtfile_handle_cleanup(txtfile_t *handle)
 {
-    fclose(handle->fp);
+    if (handle->fp != NULL) {
+        fclose(handle->fp);
+    }
     base_free(handle->path);
     base_free(handle->buffer);
 }
@@ -95,6 +98,34 @@ bool txtfile_open(txtfile_t *handle, const char *path)
 }
 
 
+/** \brief  Open text file \a path through \a cache
+ *
+ * Reads lines from the cached copy of \a path, reading the file into the
+ * cache first if required. The cache must outlive \a handle.
+ *
+ * \param[in,out]   handle  text file handle
+ * \param[in,out]   cache   text file cache
+ * \param[in]       path    path to file to open
+ *
+ * \return  boolean
+ *
+ * \throw   BASE_ERR_IO failed to read file
+ */
+bool txtfile_open_cached(txtfile_t *handle, txtcache_t *cache, const char *path)
+{
+    const txtcache_file_t *file;
+
+    file = txtcache_get(cache, path);
+    if (file == NULL) {
+        return false;
+    }
+    txtfile_handle_init(handle);
+    handle->cached = file;
+    handle->path = base_strdup(path);
+    return true;
+}
+
+
 /** \brief  Close text file
  *
  * Frees memory used by the member of \a handle and closes the file.
@@ -109,69 +140,69 @@ void txtfile_close(txtfile_t *handle)
 
 /** \brief  Read a line of text from \a handle
  *
- * \return  line of text or `NULL` on error
+ * Lines end with LF or CR+LF, the terminator isn't included in the line.
+ * A last line without terminator is returned as well. Other CRs are kept,
+ * so lines are the same as those of a file opened with txtfile_open_cached().
  *
  * \param[in,out]   handle  text file handle
  *
- * \return  pointer to buffer or `NULL` on failure
+ * \return  pointer to buffer or `NULL` on end-of-file or failure
  *
  * \throw   BASE_ERR_IO file I/O error
  */
 const char *txtfile_readline(txtfile_t *handle)
 {
-    /* TODO: actually read a line of text from the file */
     size_t index = 0;
     int ch;
 
-    errno = 0;
+    if (handle->cached != NULL) {
+        const txtcache_file_t *file = handle->cached;
 
-    while ((ch = fgetc(handle->fp)) != EOF)  {
+        if ((size_t)handle->linenum >= file->line_count) {
+            handle->eof = true;
+            return NULL;
+        }
+        handle->bufused = file->lines[handle->linenum].len + 1u;
+        return txtcache_line(file, (size_t)handle->linenum++);
+    }
 
-        /* resize buffer? */
-        if (index == handle->bufsize) {
+    while ((ch = fgetc(handle->fp)) != EOF && ch != '\n') {
+        /* resize buffer? keep room for the terminator */
+        if (index + 1u == handle->bufsize) {
             handle->buffer = base_realloc(handle->buffer, handle->bufsize * 2);
             handle->bufsize *= 2;
         }
-
-        /* store char */
-
-        /* check for Windows CR */
-        if (ch == '\r') {
-            /* skip */
-            ch = fgetc(handle->fp);
-            if (ch == EOF) {
-                break;
-            }
-        }
-
-        /* check for end-of-line */
-        if (ch == '\n') {
-            /* end-of-line */
-            handle->buffer[index] = '\0';
-            handle->bufused = index + 1;
-            handle->linenum++;
-            /* store current pos */
-            handle->filepos = ftell(handle->fp);
-            break;
-        }
-
         handle->buffer[index++] = (char)ch;
     }
 
-    if (feof(handle->fp)) {
-        if (errno != 0) {
+    if (ch == EOF) {
+        if (ferror(handle->fp)) {
             base_errno = BASE_ERR_IO;
+            return NULL;
+        }
+        if (index == 0) {
+            handle->eof = true;
+            return NULL;
         }
-        return NULL;
     }
 
+    /* strip Windows CR */
+    if (index > 0 && handle->buffer[index - 1u] == '\r') {
+        index--;
+    }
+    handle->buffer[index] = '\0';
+    handle->bufused = index + 1;
+    handle->linenum++;
+    /* store current pos */
+    handle->filepos = ftell(handle->fp);
     return handle->buffer;
 }
 
 
 /** \brief  Get EOF status
  *
- * Tests \a handle for end-of-file
+ * Tests \a handle for end-of-file, which is set once txtfile_readline()
+ * returned `NULL` because no lines are left.
  *
  * \param[in]   handle  text file handle
  *
@@ -179,7 +210,7 @@ const char *txtfile_readline(txtfile_t *handle)
  */
 bool txtfile_get_eof(const txtfile_t *handle)
 {
-    return feof(handle->fp);
+    return handle->eof;
 }
 
 
@@ -225,5 +256,11 @@ const char *txtfile_get_path(const txtfile_t *handle)
  */
 const char *txtfile_get_text(const txtfile_t *handle)
 {
+    if (handle->cached != NULL) {
+        if (handle->linenum == 0) {
+            return "";
+        }
+        return txtcache_line(handle->cached, (size_t)handle->linenum - 1u);
+    }
     return handle->buffer;
 }
@@ -29,6 +29,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include "txtcache.h"
+
 
 /** \brief  Text file handle
  *
@@ -43,10 +45,16 @@ typedef struct txtfile_s {
     size_t bufused;     /**< number of used bytes in the buffer (string len) */
     long filepos;       /**< position in the file (in "binary" mode) */
     long linenum;       /**< line number */
+    const txtcache_file_t *cached;  /**< cached file to read lines from
+                                         instead of \c fp */
+    bool eof;           /**< end of file reached */
 } txtfile_t;
 
 
 bool        txtfile_open(txtfile_t *handle, const char *path);
+bool        txtfile_open_cached(txtfile_t *handle,
+                                txtcache_t *cache,
+                                const char *path);
 void        txtfile_close(txtfile_t *handle);
 const char *txtfile_readline(txtfile_t *handle);
 
@@ -25,13 +25,354 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <limits.h>
 #include <ctype.h>
 
+#ifdef HAVE_MEM_TRACKING
+# include <pthread.h>
+#endif
+
 #include "mem.h"
 
 
+#ifdef HAVE_MEM_TRACKING
+
+/** \brief  Size of the call site table (power of two)
+ */
+#define MEM_SITES_SIZE      4096u
+
+/** \brief  Number of call sites listed by base_mem_report()
+ */
+#define MEM_REPORT_SITES    20
+
+/** \brief  Value marking a tracked allocation
+ */
+#define MEM_MAGIC           0x6d656d21u
+
+
+/** \brief  Statistics of an allocation call site
+ */
+typedef struct mem_site_s {
+    const char *    file;           /**< source file, `NULL` for unknown */
+    int             line;           /**< line number */
+    size_t          allocs;         /**< number of (re)allocations */
+    size_t          bytes_total;    /**< number of bytes allocated */
+    size_t          bytes_live;     /**< number of bytes currently allocated */
+    size_t          bytes_peak;     /**< maximum of \c bytes_live */
+} mem_site_t;
+
+
+/** \brief  Header preceding each tracked allocation
+ *
+ * The union keeps the memory following the header suitably aligned.
+ */
+typedef union mem_header_u {
+    struct {
+        size_t      size;   /**< size requested */
+        uint32_t    site;   /**< index in the call site table */
+        uint32_t    magic;  /**< #MEM_MAGIC */
+    } info;                 /**< allocation info */
+    long double     ld;     /**< for alignment */
+    void *          ptr;    /**< for alignment */
+    uint64_t        u64;    /**< for alignment */
+} mem_header_t;
+
+
+/** \brief  Lock protecting the statistics
+ */
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief  Call site table, element 0 is the unknown site
+ */
+static mem_site_t mem_sites[MEM_SITES_SIZE];
+
+/** \brief  Totals
+ */
+static base_mem_stats_t mem_stats;
+
+/** \brief  base_mem_report() has been registered with atexit()
+ */
+static bool mem_report_registered = false;
+
+
+/** \brief  Get index in the call site table of \a file and \a line
+ *
+ * Must be called with the lock held. Falls back to the unknown site when the
+ * table is getting full.
+ *
+ * \param[in]   file    source file
+ * \param[in]   line    line number
+ *
+ * \return  index
+ */
+static uint32_t site_index(const char *file, int line)
+{
+    uint32_t mask = MEM_SITES_SIZE - 1u;
+    uint32_t index;
+
+    if (file == NULL || mem_stats.sites >= MEM_SITES_SIZE / 4u * 3u) {
+        return 0;
+    }
+    /* __FILE__ gives the same pointer for all calls in a translation unit */
+    index = (uint32_t)((((uintptr_t)file >> 3u) * 31u + (uintptr_t)line) *
+                       UINT32_C(2654435761)) & mask;
+    while (true) {
+        mem_site_t *site = &mem_sites[index];
+
+        if (index != 0) {
+            if (site->file == NULL) {
+                site->file = file;
+                site->line = line;
+                mem_stats.sites++;
+                return index;
+            }
+            if (site->file == file && site->line == line) {
+                return index;
+            }
+        }
+        index = (index + 1u) & mask;
+    }
+}
+
+
+/** \brief  Account for \a size bytes allocated or grown at a site
+ *
+ * Must be called with the lock held.
+ *
+ * \param[in]   index   index of the call site
+ * \param[in]   added   number of bytes added
+ */
+static void site_add(uint32_t index, size_t added)
+{
+    mem_site_t *site = &mem_sites[index];
+
+    site->allocs++;
+    site->bytes_total += added;
+    site->bytes_live += added;
+    if (site->bytes_live > site->bytes_peak) {
+        site->bytes_peak = site->bytes_live;
+    }
+    mem_stats.bytes_total += added;
+    mem_stats.bytes_live += added;
+    if (mem_stats.bytes_live > mem_stats.bytes_peak) {
+        mem_stats.bytes_peak = mem_stats.bytes_live;
+    }
+}
+
+
+/** \brief  Get header of tracked allocation \a ptr
+ *
+ * Aborts when \a ptr wasn't allocated by the tracking functions.
+ *
+ * \param[in]   ptr     memory returned by a tracking function
+ *
+ * \return  header
+ */
+static mem_header_t *get_header(void *ptr)
+{
+    mem_header_t *header = (mem_header_t *)ptr - 1;
+
+    if (header->info.magic != MEM_MAGIC) {
+        fprintf(stderr, "%s: %p wasn't allocated with base_malloc(), aborting.\n",
+                __func__, ptr);
+        abort();
+    }
+    return header;
+}
+
+
+/** \brief  Start tracking the allocation \a header
+ *
+ * \param[in,out]   header  header of allocation
+ * \param[in]       size    size requested
+ * \param[in]       file    source file of the call site
+ * \param[in]       line    line number of the call site
+ *
+ * \return  memory following \a header
+ */
+static void *track(mem_header_t *header, size_t size, const char *file, int line)
+{
+    pthread_mutex_lock(&mem_lock);
+    if (!mem_report_registered) {
+        atexit(base_mem_report);
+        mem_report_registered = true;
+    }
+    header->info.size = size;
+    header->info.site = site_index(file, line);
+    header->info.magic = MEM_MAGIC;
+    mem_stats.allocs++;
+    site_add(header->info.site, size);
+    pthread_mutex_unlock(&mem_lock);
+    return header + 1;
+}
+
+
+/** \brief  Report allocation failure and exit
+ *
+ * \param[in]   func    function name
+ * \param[in]   size    number of bytes requested
+ * \param[in]   file    source file of the call site
+ * \param[in]   line    line number of the call site
+ */
+static void alloc_failed(const char *func, size_t size, const char *file, int line)
+{
+    fprintf(stderr, "%s: failed to allocate %zu bytes at %s:%d, exiting.\n",
+            func, size, file != NULL ? file : "?", line);
+    exit(EXIT_FAILURE);
+}
+
+
+/** \brief  Allocate \a size bytes of memory, recording the call site
+ *
+ * \param[in]   size    number of bytes to allocate
+ * \param[in]   file    source file of the call site
+ * \param[in]   line    line number of the call site
+ *
+ * \return  pointer to allocated memory
+ */
+void *base_malloc_at(size_t size, const char *file, int line)
+{
+    mem_header_t *header = NULL;
+
+    if (size <= SIZE_MAX - sizeof *header) {
+        header = malloc(sizeof *header + size);
+    }
+    if (header == NULL) {
+        alloc_failed(__func__, size, file, line);
+    }
+    return track(header, size, file, line);
+}
+
+
+/** \brief  Allocate and initialize \a nelem elements of \a elsize, recording
+ *          the call site
+ *
+ * \param[in]   nelem   number of elements
+ * \param[in]   elsize  element size
+ * \param[in]   file    source file of the call site
+ * \param[in]   line    line number of the call site
+ *
+ * \return  pointer to allocated memory
+ */
+void *base_calloc_at(size_t nelem, size_t elsize, const char *file, int line)
+{
+    mem_header_t *header = NULL;
+    size_t size = nelem * elsize;
+
+    if (elsize == 0 || nelem <= (SIZE_MAX - sizeof *header) / elsize) {
+        header = calloc(1, sizeof *header + size);
+    }
+    if (header == NULL) {
+        alloc_failed(__func__, size, file, line);
+    }
+    return track(header, size, file, line);
+}
+
+
+/** \brief  Reallocate memory allocated at \a ptr to \a size bytes, recording
+ *          the call site
+ *
+ * The bytes are attributed to the call site of the reallocation from then on.
+ *
+ * \param[in]   ptr     memory to reallocate
+ * \param[in]   size    new size in bytes
+ * \param[in]   file    source file of the call site
+ * \param[in]   line    line number of the call site
+ *
+ * \return  pointer to resized memory, NULL when \a size is 0 and \a ptr != NULL
+ */
+void *base_realloc_at(void *ptr, size_t size, const char *file, int line)
+{
+    mem_header_t *header;
+    mem_header_t *tmp = NULL;
+    size_t old_size;
+    uint32_t old_site;
+
+    if (ptr == NULL) {
+        return base_malloc_at(size, file, line);
+    }
+    if (size == 0) {
+        base_free(ptr);
+        return NULL;
+    }
+
+    header = get_header(ptr);
+    old_size = header->info.size;
+    old_site = header->info.site;
+    if (size <= SIZE_MAX - sizeof *header) {
+        tmp = realloc(header, sizeof *header + size);
+    }
+    if (tmp == NULL) {
+        alloc_failed(__func__, size, file, line);
+    }
+
+    pthread_mutex_lock(&mem_lock);
+    mem_sites[old_site].bytes_live -= old_size;
+    mem_stats.bytes_live -= old_size;
+    mem_stats.reallocs++;
+    tmp->info.size = size;
+    tmp->info.site = site_index(file, line);
+    site_add(tmp->info.site, size);
+    /* only growth counts as newly allocated */
+    mem_sites[tmp->info.site].bytes_total -= size > old_size ? old_size : size;
+    mem_stats.bytes_total -= size > old_size ? old_size : size;
+    pthread_mutex_unlock(&mem_lock);
+    return tmp + 1;
+}
+
+
+/** \brief  Create heap-allocated copy of string \a s, recording the call site
+ *
+ * \param[in]   s       string to copy
+ * \param[in]   file    source file of the call site
+ * \param[in]   line    line number of the call site
+ *
+ * \return  heap-allocated copy of \a s
+ *
+ * \note    returns "'\0'" when \a s is `NULL`
+ */
+char *base_strdup_at(const char *s, const char *file, int line)
+{
+    size_t len = s != NULL ? strlen(s) : 0;
+    char *t = base_malloc_at(len + 1, file, line);
+
+    if (len > 0) {
+        memcpy(t, s, len + 1);
+    } else {
+        *t = '\0';
+    }
+    return t;
+}
+
+
+/** \brief  Compare call sites on peak number of bytes, descending
+ *
+ * \param[in]   p1  first site
+ * \param[in]   p2  second site
+ *
+ * \return  <0, 0 or >0
+ */
+static int site_compare(const void *p1, const void *p2)
+{
+    const mem_site_t *s1 = *(const mem_site_t * const *)p1;
+    const mem_site_t *s2 = *(const mem_site_t * const *)p2;
+
+    if (s1->bytes_peak != s2->bytes_peak) {
+        return s1->bytes_peak < s2->bytes_peak ? 1 : -1;
+    }
+    return s1->line - s2->line;
+}
+
+#endif  /* HAVE_MEM_TRACKING */
+
+
+/*
+ * The names of the functions below are parenthesized, so they don't get
+ * expanded by the call site recording macros in mem.h.
+ */
+
 /** \brief  Allocate \a size bytes of memory
  *
  * Basic xmalloc implementation -> simply exit on alloc failure.
@@ -40,8 +381,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  *
  * \return  pointer to allocated memory
  */
-void *base_malloc(size_t size)
+void *(base_malloc)(size_t size)
 {
+#ifdef HAVE_MEM_TRACKING
+    return base_malloc_at(size, NULL, 0);
+#else
     void *ptr = malloc(size);
     if (ptr == NULL) {
         fprintf(stderr, "%s: failed to allocate %zu bytes, exiting.\n",
@@ -49,6 +393,7 @@ void *base_malloc(size_t size)
         exit(EXIT_FAILURE);
     }
     return ptr;
+#endif
 }
 
 
@@ -59,8 +404,11 @@ void *base_malloc(size_t size)
  *
  * \return  pointer to allocated memory
  */
-void *base_calloc(size_t nelem, size_t elsize)
+void *(base_calloc)(size_t nelem, size_t elsize)
 {
+#ifdef HAVE_MEM_TRACKING
+    return base_calloc_at(nelem, elsize, NULL, 0);
+#else
     void *ptr = calloc(nelem, elsize);
     if (ptr == NULL) {
         fprintf(stderr, "%s: failed to allocate %zu bytes, exiting.\n",
@@ -68,6 +416,7 @@ void *base_calloc(size_t nelem, size_t elsize)
         exit(EXIT_FAILURE);
     }
     return ptr;
+#endif
 }
 
 
@@ -81,8 +430,11 @@ void *base_calloc(size_t nelem, size_t elsize)
  * \note    calls lib_malloc() when \a ptr == NULL
  * \note    calls lib_free() when \a ptr != NULL && \a size == 0
  */
-void *base_realloc(void *ptr, size_t size)
+void *(base_realloc)(void *ptr, size_t size)
 {
+#ifdef HAVE_MEM_TRACKING
+    return base_realloc_at(ptr, size, NULL, 0);
+#else
     void *tmp;
 
     /* ptr == NULL means call malloc(3) */
@@ -107,6 +459,7 @@ void *base_realloc(void *ptr, size_t size)
         exit(EXIT_FAILURE);
     }
     return tmp;
+#endif
 }
 
 
@@ -116,7 +469,23 @@ void *base_realloc(void *ptr, size_t size)
  */
 void base_free(void *ptr)
 {
+#ifdef HAVE_MEM_TRACKING
+    mem_header_t *header;
+
+    if (ptr == NULL) {
+        return;
+    }
+    header = get_header(ptr);
+    pthread_mutex_lock(&mem_lock);
+    mem_stats.frees++;
+    mem_stats.bytes_live -= header->info.size;
+    mem_sites[header->info.site].bytes_live -= header->info.size;
+    pthread_mutex_unlock(&mem_lock);
+    header->info.magic = 0;
+    free(header);
+#else
     free(ptr);
+#endif
 }
 
 
@@ -128,8 +497,11 @@ void base_free(void *ptr)
  *
  * \note    returns "'\0'" when \a s is `NULL`
  */
-char *base_strdup(const char *s)
+char *(base_strdup)(const char *s)
 {
+#ifdef HAVE_MEM_TRACKING
+    return base_strdup_at(s, NULL, 0);
+#else
     char *t;
     size_t len;
 
@@ -146,6 +518,75 @@ char *base_strdup(const char *s)
         *t = '\0';
     }
     return t;
+#endif
+}
+
+
+/** \brief  Get allocation statistics
+ *
+ * Only gathered when compiled with HAVE_MEM_TRACKING, otherwise \a stats is
+ * zeroed.
+ *
+ * \param[out]  stats   statistics
+ */
+void base_mem_get_stats(base_mem_stats_t *stats)
+{
+#ifdef HAVE_MEM_TRACKING
+    pthread_mutex_lock(&mem_lock);
+    *stats = mem_stats;
+    pthread_mutex_unlock(&mem_lock);
+    stats->tracking = true;
+#else
+    memset(stats, 0, sizeof *stats);
+    stats->tracking = false;
+#endif
+}
+
+
+/** \brief  Print allocation statistics on stderr
+ *
+ * Lists the totals and the call sites with the highest peak memory use.
+ * Registered with atexit() on the first allocation when compiled with
+ * HAVE_MEM_TRACKING, does nothing otherwise.
+ */
+void base_mem_report(void)
+{
+#ifdef HAVE_MEM_TRACKING
+    mem_site_t *sites[MEM_SITES_SIZE];
+    size_t count = 0;
+
+    pthread_mutex_lock(&mem_lock);
+    for (size_t i = 0; i < MEM_SITES_SIZE; i++) {
+        if (mem_sites[i].allocs > 0) {
+            sites[count++] = &mem_sites[i];
+        }
+    }
+    qsort(sites, count, sizeof sites[0], site_compare);
+
+    fprintf(stderr, "memory usage:\n");
+    fprintf(stderr, "  allocations   : %zu\n", mem_stats.allocs);
+    fprintf(stderr, "  frees         : %zu\n", mem_stats.frees);
+    fprintf(stderr, "  reallocations : %zu\n", mem_stats.reallocs);
+    fprintf(stderr, "  bytes total   : %zu\n", mem_stats.bytes_total);
+    fprintf(stderr, "  peak bytes    : %zu\n", mem_stats.bytes_peak);
+    fprintf(stderr, "  live bytes    : %zu\n", mem_stats.bytes_live);
+    fprintf(stderr, "  call sites by peak bytes:\n");
+    fprintf(stderr, "  %-36s %10s %12s %12s %12s\n",
+            "site", "allocs", "total", "peak", "live");
+    for (size_t i = 0; i < count && i < MEM_REPORT_SITES; i++) {
+        char name[64];
+
+        if (sites[i]->file != NULL) {
+            snprintf(name, sizeof name, "%s:%d", sites[i]->file, sites[i]->line);
+        } else {
+            snprintf(name, sizeof name, "(unknown)");
+        }
+        fprintf(stderr, "  %-36s %10zu %12zu %12zu %12zu\n",
+                name, sites[i]->allocs, sites[i]->bytes_total,
+                sites[i]->bytes_peak, sites[i]->bytes_live);
+    }
+    pthread_mutex_unlock(&mem_lock);
+#endif
 }
 
 
@@ -228,3 +669,262 @@ int base_strcasecmp(const char *s1, const char *s2)
         return 1;
     }
 }
+
+
+/** \brief  Offset of the data in an arena chunk
+ */
+#define ARENA_CHUNK_DATA \
+    ((sizeof(base_arena_chunk_t) + BASE_ARENA_ALIGN - 1u) & \
+     ~(BASE_ARENA_ALIGN - 1u))
+
+
+/** \brief  Get pointer to the data of arena \a chunk
+ *
+ * \param[in]   chunk   arena chunk
+ *
+ * \return  pointer to first usable byte
+ */
+static unsigned char *arena_chunk_data(base_arena_chunk_t *chunk)
+{
+    return (unsigned char *)chunk + ARENA_CHUNK_DATA;
+}
+
+
+/** \brief  Exit with an error message about an impossible arena request
+ *
+ * \param[in]   func    function name
+ * \param[in]   size    requested size
+ */
+static void arena_fail(const char *func, size_t size)
+{
+    fprintf(stderr, "%s: failed to allocate %zu bytes, exiting.\n", func, size);
+    exit(EXIT_FAILURE);
+}
+
+
+/** \brief  Initialize \a arena
+ *
+ * No memory is allocated until the first allocation request.
+ *
+ * \param[out]  arena       arena
+ * \param[in]   chunk_size  size of chunks to allocate from the heap, 0 means
+ *                          #BASE_ARENA_CHUNK_SIZE
+ */
+void base_arena_init(base_arena_t *arena, size_t chunk_size)
+{
+    arena->current = NULL;
+    arena->spare = NULL;
+    arena->chunk_size = chunk_size > 0 ? chunk_size : BASE_ARENA_CHUNK_SIZE;
+}
+
+
+/** \brief  Free all memory used by \a arena
+ *
+ * The arena can be used again after this, as if freshly initialized.
+ *
+ * \param[in,out]   arena   arena
+ */
+void base_arena_free(base_arena_t *arena)
+{
+    base_arena_chunk_t *chunk = arena->current;
+
+    while (chunk != NULL) {
+        base_arena_chunk_t *prev = chunk->prev;
+        base_free(chunk);
+        chunk = prev;
+    }
+    base_free(arena->spare);
+    arena->current = NULL;
+    arena->spare = NULL;
+}
+
+
+/** \brief  Allocate \a size bytes with alignment \a align from \a arena
+ *
+ * Requests larger than the chunk size get a chunk of their own.
+ *
+ * \param[in,out]   arena   arena
+ * \param[in]       size    number of bytes to allocate
+ * \param[in]       align   alignment, must be a power of two
+ *
+ * \return  pointer to allocated memory, valid until released
+ */
+void *base_arena_alloc_aligned(base_arena_t *arena, size_t size, size_t align)
+{
+    base_arena_chunk_t *chunk = arena->current;
+    uintptr_t base;
+    uintptr_t addr;
+    size_t need;
+
+    if (align == 0 || !base_ispow2(align)) {
+        align = BASE_ARENA_ALIGN;
+    }
+
+    /* fast path: fits in the current chunk */
+    if (chunk != NULL) {
+        base = (uintptr_t)arena_chunk_data(chunk);
+        addr = (base + chunk->used + align - 1u) & ~(uintptr_t)(align - 1u);
+        if (addr + size <= base + chunk->size && addr + size >= addr) {
+            chunk->used = (size_t)(addr - base) + size;
+            return (void *)addr;
+        }
+    }
+
+    /* need a new chunk, with enough room for worst case alignment padding */
+    if (size > SIZE_MAX - align - ARENA_CHUNK_DATA) {
+        arena_fail(__func__, size);
+    }
+    need = size + align;
+    if (arena->spare != NULL && arena->spare->size >= need) {
+        chunk = arena->spare;
+        arena->spare = NULL;
+    } else {
+        size_t csize = need > arena->chunk_size ? need : arena->chunk_size;
+
+        chunk = base_malloc(ARENA_CHUNK_DATA + csize);
+        chunk->size = csize;
+    }
+    chunk->prev = arena->current;
+    chunk->used = 0;
+    arena->current = chunk;
+
+    base = (uintptr_t)arena_chunk_data(chunk);
+    addr = (base + align - 1u) & ~(uintptr_t)(align - 1u);
+    chunk->used = (size_t)(addr - base) + size;
+    return (void *)addr;
+}
+
+
+/** \brief  Allocate \a size bytes from \a arena
+ *
+ * The memory is aligned on #BASE_ARENA_ALIGN bytes.
+ *
+ * \param[in,out]   arena   arena
+ * \param[in]       size    number of bytes to allocate
+ *
+ * \return  pointer to allocated memory, valid until released
+ */
+void *base_arena_alloc(base_arena_t *arena, size_t size)
+{
+    return base_arena_alloc_aligned(arena, size, BASE_ARENA_ALIGN);
+}
+
+
+/** \brief  Allocate and clear \a nelem elements of \a elsize from \a arena
+ *
+ * \param[in,out]   arena   arena
+ * \param[in]       nelem   number of elements
+ * \param[in]       elsize  element size
+ *
+ * \return  pointer to allocated memory, valid until released
+ */
+void *base_arena_calloc(base_arena_t *arena, size_t nelem, size_t elsize)
+{
+    void *ptr;
+
+    if (elsize > 0 && nelem > SIZE_MAX / elsize) {
+        arena_fail(__func__, SIZE_MAX);
+    }
+    ptr = base_arena_alloc(arena, nelem * elsize);
+    memset(ptr, 0, nelem * elsize);
+    return ptr;
+}
+
+
+/** \brief  Copy at most \a len characters of \a s into \a arena
+ *
+ * \param[in,out]   arena   arena
+ * \param[in]       s       string to copy (doesn't need to be 0-terminated)
+ * \param[in]       len     maximum number of characters to copy
+ *
+ * \return  0-terminated copy of \a s, valid until released
+ */
+char *base_arena_strndup(base_arena_t *arena, const char *s, size_t len)
+{
+    char *t;
+    size_t n = 0;
+
+    if (s != NULL) {
+        while (n < len && s[n] != '\0') {
+            n++;
+        }
+    }
+    t = base_arena_alloc_aligned(arena, n + 1u, 1u);
+    if (n > 0) {
+        memcpy(t, s, n);
+    }
+    t[n] = '\0';
+    return t;
+}
+
+
+/** \brief  Copy string \a s into \a arena
+ *
+ * \param[in,out]   arena   arena
+ * \param[in]       s       string to copy
+ *
+ * \return  copy of \a s, valid until released
+ *
+ * \note    returns "'\0'" when \a s is `NULL`
+ */
+char *base_arena_strdup(base_arena_t *arena, const char *s)
+{
+    return base_arena_strndup(arena, s, s == NULL ? 0 : strlen(s));
+}
+
+
+/** \brief  Get current position of \a arena
+ *
+ * \param[in]   arena   arena
+ *
+ * \return  mark to pass to base_arena_release()
+ */
+base_arena_mark_t base_arena_mark(const base_arena_t *arena)
+{
+    base_arena_mark_t mark;
+
+    mark.chunk = arena->current;
+    mark.used = arena->current != NULL ? arena->current->used : 0;
+    return mark;
+}
+
+
+/** \brief  Release all memory allocated from \a arena after \a mark
+ *
+ * Marks must be released in reverse order of creation, releasing a mark
+ * invalidates all marks taken after it. One released chunk is kept around
+ * so alternating allocating and releasing doesn't thrash the heap.
+ *
+ * \param[in,out]   arena   arena
+ * \param[in]       mark    mark obtained with base_arena_mark()
+ */
+void base_arena_release(base_arena_t *arena, base_arena_mark_t mark)
+{
+    while (arena->current != mark.chunk && arena->current != NULL) {
+        base_arena_chunk_t *chunk = arena->current;
+
+        arena->current = chunk->prev;
+        if (arena->spare == NULL && chunk->size == arena->chunk_size) {
+            arena->spare = chunk;
+        } else {
+            base_free(chunk);
+        }
+    }
+    if (arena->current != NULL) {
+        arena->current->used = mark.used;
+    }
+}
+
+
+/** \brief  Release all memory allocated from \a arena
+ *
+ * Unlike base_arena_free() a chunk is kept for reuse.
+ *
+ * \param[in,out]   arena   arena
+ */
+void base_arena_reset(base_arena_t *arena)
+{
+    base_arena_mark_t mark = { NULL, 0 };
+
+    base_arena_release(arena, mark);
+}
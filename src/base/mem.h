@@ -26,11 +26,74 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define BASE_MEM_H
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 
 #define base_array_len(A)   (sizeof(A) / sizeof(A[0]))
 
+/** \brief  Default alignment of arena allocations
+ *
+ * Suitable for any of the scalar types used in the code base.
+ */
+#define BASE_ARENA_ALIGN        (2 * sizeof(void *))
+
+/** \brief  Default size of arena chunks
+ */
+#define BASE_ARENA_CHUNK_SIZE   65536
+
+
+/** \brief  Arena chunk
+ *
+ * Header of a block of memory allocated from the heap, the memory handed out
+ * by the arena follows the header.
+ */
+typedef struct base_arena_chunk_s {
+    struct base_arena_chunk_s * prev;   /**< previously allocated chunk */
+    size_t                      size;   /**< number of usable bytes */
+    size_t                      used;   /**< number of bytes handed out */
+} base_arena_chunk_t;
+
+
+/** \brief  Arena (region) allocator
+ *
+ * Hands out memory by bumping a pointer in the current chunk, individual
+ * allocations cannot be freed. Memory is released in bulk with
+ * base_arena_release(), base_arena_reset() or base_arena_free().
+ */
+typedef struct base_arena_s {
+    base_arena_chunk_t *    current;    /**< chunk allocations are taken from */
+    base_arena_chunk_t *    spare;      /**< released chunk kept for reuse */
+    size_t                  chunk_size; /**< size of normal chunks */
+} base_arena_t;
+
+
+/** \brief  Arena position, used to release everything allocated after it
+ */
+typedef struct base_arena_mark_s {
+    base_arena_chunk_t *    chunk;  /**< current chunk at time of marking */
+    size_t                  used;   /**< bytes used in \c chunk */
+} base_arena_mark_t;
+
+
+/** \brief  Allocation statistics
+ *
+ * \see base_mem_get_stats(), base_mem_report()
+ */
+typedef struct base_mem_stats_s {
+    bool    tracking;       /**< compiled with HAVE_MEM_TRACKING, otherwise
+                                 all other members are 0 */
+    size_t  allocs;         /**< number of allocations */
+    size_t  frees;          /**< number of frees */
+    size_t  reallocs;       /**< number of reallocations */
+    size_t  bytes_total;    /**< total number of bytes allocated, including
+                                 growth by reallocation */
+    size_t  bytes_live;     /**< number of bytes currently allocated */
+    size_t  bytes_peak;     /**< maximum of \c bytes_live */
+    size_t  sites;          /**< number of call sites seen */
+} base_mem_stats_t;
+
+
 void *  base_malloc(size_t size);
 void *  base_calloc(size_t nelem, size_t elsize);
 void *  base_realloc(void *ptr, size_t size);
@@ -38,9 +101,42 @@ void    base_free(void *ptr);
 
 char *  base_strdup(const char *s);
 
+void    base_mem_get_stats(base_mem_stats_t *stats);
+void    base_mem_report(void);
+
+#ifdef HAVE_MEM_TRACKING
+void *  base_malloc_at(size_t size, const char *file, int line);
+void *  base_calloc_at(size_t nelem, size_t elsize, const char *file, int line);
+void *  base_realloc_at(void *ptr, size_t size, const char *file, int line);
+char *  base_strdup_at(const char *s, const char *file, int line);
+
+/*
+ * Record the call site of each allocation. Taking the address of one of these
+ * functions still works, those allocations are attributed to an unknown site.
+ */
+# define base_malloc(size)          base_malloc_at((size), __FILE__, __LINE__)
+# define base_calloc(nelem, elsize) base_calloc_at((nelem), (elsize), \
+                                                   __FILE__, __LINE__)
+# define base_realloc(ptr, size)    base_realloc_at((ptr), (size), \
+                                                    __FILE__, __LINE__)
+# define base_strdup(s)             base_strdup_at((s), __FILE__, __LINE__)
+#endif
+
 bool    base_ispow2(size_t n);
 size_t  base_nextpow2(size_t n);
 
 int     base_strcasecmp(const char *s1, const char *s2);
 
+void    base_arena_init(base_arena_t *arena, size_t chunk_size);
+void    base_arena_free(base_arena_t *arena);
+void *  base_arena_alloc(base_arena_t *arena, size_t size);
+void *  base_arena_alloc_aligned(base_arena_t *arena, size_t size, size_t align);
+void *  base_arena_calloc(base_arena_t *arena, size_t nelem, size_t elsize);
+char *  base_arena_strdup(base_arena_t *arena, const char *s);
+char *  base_arena_strndup(base_arena_t *arena, const char *s, size_t len);
+
+base_arena_mark_t base_arena_mark(const base_arena_t *arena);
+void    base_arena_release(base_arena_t *arena, base_arena_mark_t mark);
+void    base_arena_reset(base_arena_t *arena);
+
 #endif
@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
 #include <assert.h>
+#include <limits.h>
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -51,10 +52,92 @@ static void objpool_object_set_base(objpool_obj_t *obj,
 
 
 
+/** \brief  Get index of lowest set bit in \a mask
+ *
+ * \param[in]   mask    bit mask, must not be 0
+ *
+ * \return  bit index
+ */
+static unsigned int lowest_bit(uint32_t mask)
+{
+#ifdef __GNUC__
+    return (unsigned int)__builtin_ctz(mask);
+#else
+    unsigned int bit = 0;
+
+    while ((mask & 1u) == 0) {
+        mask >>= 1u;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+
+/** \brief  Get index of highest set bit in \a n
+ *
+ * \param[in]   n   value, must not be 0
+ *
+ * \return  floor(log2(n))
+ */
+static unsigned int highest_bit(size_t n)
+{
+#ifdef __GNUC__
+    return (unsigned int)(sizeof(unsigned long long) * CHAR_BIT - 1u) -
+           (unsigned int)__builtin_clzll((unsigned long long)n);
+#else
+    unsigned int bit = 0;
+
+    while (n > 1u) {
+        n >>= 1u;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+
+/** \brief  Get size class of an object of \a size bytes
+ *
+ * \param[in]   size    object size
+ *
+ * \return  floor(log2(size)), clamped to the last class
+ */
+static unsigned int size_class(size_t size)
+{
+    unsigned int class;
+
+    if (size == 0) {
+        return 0;
+    }
+    class = highest_bit(size);
+    return class < OBJPOOL_CLASSES ? class : OBJPOOL_CLASSES - 1u;
+}
+
+
+/** \brief  Get smallest size class of which every object fits \a size bytes
+ *
+ * \param[in]   size    requested size, larger than 0
+ *
+ * \return  ceil(log2(size)), clamped to the last class
+ */
+static unsigned int request_class(size_t size)
+{
+    unsigned int class = size_class(size);
+
+    /* round up unless \a size is a power of two */
+    if (!base_ispow2(size) && class < OBJPOOL_CLASSES - 1u) {
+        class++;
+    }
+    return class;
+}
+
+
 /** \brief  Initialize \a pool for use
  *
- * Initializes \a pool by allocating the active and inactive objects list and
- * setting members to their proper values.
+ * Initializes \a pool by allocating the active objects list and setting
+ * members to their proper values. The free lists of the size classes are
+ * allocated on demand.
  *
  * \param[in,out]   pool    memory bool
  */
@@ -70,28 +153,36 @@ void objpool_init(objpool_t *pool)
 
     /* initialize fields */
     pool->active_used = 0;
+    pool->active_min = pool->active_size;
+    pool->active_peak = 0;
     pool->inactive_used = 0;
+    pool->inactive_peak = 0;
+    pool->classes_used = 0;
     pool->requests_total = 0;
     pool->requests_from_pool = 0;
     pool->requests_resizes = 0;
     pool->requests_frees = 0;
+    pool->trims_frees = 0;
+    for (size_t c = 0; c < OBJPOOL_CLASSES; c++) {
+        pool->classes[c].list = NULL;
+        pool->classes[c].size = 0;
+        pool->classes[c].used = 0;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
 
-    /* allocate and initialize arrays */
+    /* allocate and initialize array */
     pool->active_list = base_malloc(pool->active_size * sizeof *(pool->active_list));
     for (size_t i = 0; i < pool->active_size; i++) {
         pool->active_list[i] = NULL;
     }
-    pool->inactive_list = base_malloc(pool->inactive_size * sizeof *(pool->inactive_list));
-    for (size_t i = 0; i < pool->inactive_size; i++) {
-        pool->inactive_list[i] = NULL;
-    }
 }
 
 
 /** \brief  Clean up \a pool
  *
- * Frees memory used by members of \a pool and the objects in both the active
- * in inactive objects list.
+ * Frees memory used by members of \a pool and both the active and inactive
+ * objects.
  *
  * \param[in,out]   pool    object pool
  */
@@ -107,16 +198,17 @@ void objpool_free(objpool_t *pool)
     }
     base_free(pool->active_list);
 
-    /* free inactive object list and its objects */
-    base_debug("Freeing inactive object list:");
-    for (size_t i = 0; i < pool->inactive_used; i++) {
-        if (pool->inactive_list[i] != NULL) {
-            base_debug("Calling obj_free(%zu).", i);
-            pool->free_cb(pool->inactive_list[i]);
+    /* free inactive objects */
+    base_debug("Freeing inactive objects:");
+    for (size_t c = 0; c < OBJPOOL_CLASSES; c++) {
+        objpool_class_t *class = &pool->classes[c];
+
+        for (size_t i = 0; i < class->used; i++) {
+            pool->free_cb(class->list[i]);
         }
+        base_free(class->list);
     }
-    base_free(pool->inactive_list);
-
+    pthread_mutex_destroy(&pool->lock);
 }
 
 
@@ -147,113 +239,437 @@ static void *objpool_add_active(objpool_t *pool, void *obj)
 
     /* add object to list */
     pool->active_list[pool->active_used++] = obj;
+    if (pool->active_used > pool->active_peak) {
+        pool->active_peak = pool->active_used;
+    }
     return obj;
 }
 
 
+/** \brief  Remove \a obj from active objects in \a pool
+ *
+ * The last active object is moved into the hole left by \a obj, so the list
+ * stays dense and removal is O(1).
+ *
+ * \param[in,out]   pool    object pool
+ * \param[in]       obj     active object
+ */
+static void objpool_remove_active(objpool_t *pool, void *obj)
+{
+    size_t index = ((objpool_obj_t *)obj)->index;
+    void *last;
+
+    assert(((objpool_obj_t *)obj)->pool == pool);
+    assert(index < pool->active_used && pool->active_list[index] == obj);
+
+    last = pool->active_list[--(pool->active_used)];
+    pool->active_list[index] = last;
+    objpool_object_set_base(last, pool, index);
+    pool->active_list[pool->active_used] = NULL;
+}
+
+
+/** \brief  Take an inactive object from size class \a class
+ *
+ * \param[in,out]   pool    object pool
+ * \param[in]       class   size class, must not be empty
+ *
+ * \return  object
+ */
+static void *objpool_take_inactive(objpool_t *pool, unsigned int class)
+{
+    objpool_class_t *list = &pool->classes[class];
+    void *obj = list->list[--(list->used)];
+
+    if (list->used == 0) {
+        pool->classes_used &= ~(UINT32_C(1) << class);
+    }
+    pool->inactive_used--;
+    return obj;
+}
+
 
 /** \brief  Request a suitable object from the \a pool
  *
- * Scans the inactive object list for a suitable object.
+ * Reuses an inactive object if possible, or else allocates a new object.
  *
- * If \a size is 0, it'll return the last object in the inactive objects list,
- * if size > 0 it will use the registered 'obj_size_cb' to find the first object
- * that satisfies the \a size requirement.
+ * If \a size is 0 or the pool doesn't have a 'size_cb', any inactive object
+ * can be reused, and the smallest one is. If \a size > 0 the object is taken
+ * from the smallest size class in which all objects are at least \a size
+ * bytes, which makes finding the best fit O(1).
  *
  * \param[in,out]   pool    object pool
- * \param[in,out]   size    object size request (optional)
+ * \param[in]       size    object size request (optional)
  * \param[in]       param   parameter for the \a object constructor (optional)
+ *
+ * \return  object
  */
 void *objpool_request(objpool_t *pool, size_t size, void *param)
 {
     void *obj = NULL;
+    uint32_t candidates = pool->classes_used;
 
     pool->requests_total++;
 
     base_debug("New object requested with size %zu:", size);
-    if (pool->inactive_used == 0) {
-        base_debug("No inactive object, allocate new object:");
-        obj = pool->alloc_cb(param);
-        objpool_add_active(pool, obj);
-    } else {
-        base_debug("Checking inactive objects list for suitable object:");
-
-        if (pool->size_cb != NULL) {
-
-            /* try to find the first item with enough size */
-            base_debug("Size comparison requested:\n");
-            for (size_t i = 0; pool->inactive_used; i++) {
-                size_t curr_size = pool->size_cb(pool->inactive_list[i]);
-                base_debug("new obj size() = %zu, list obj size - %zu\n",
-                        size, curr_size);
-                if (size <= curr_size) {
-                    base_debug("found entry at %zu\n", i);
-                }
+    if (size > 0 && pool->size_cb != NULL) {
+        unsigned int class = request_class(size);
+
+        /* only classes holding objects of at least 2^class bytes */
+        candidates &= ~((UINT32_C(1) << class) - 1u);
+        if (candidates != 0 && class == OBJPOOL_CLASSES - 1u) {
+            /* the last class isn't bounded: check the actual size */
+            objpool_class_t *last = &pool->classes[class];
+
+            if (pool->size_cb(last->list[last->used - 1u]) < size) {
+                candidates = 0;
             }
-            base_debug("Couldn't find a suitable item, allocating new one\n");
-        } else {
-            obj = pool->inactive_list[--(pool->inactive_used)];
         }
+    }
+
+    if (candidates == 0) {
+        base_debug("No suitable inactive object, allocate new object:");
+        obj = pool->alloc_cb(param);
+    } else {
+        obj = objpool_take_inactive(pool, lowest_bit(candidates));
         pool->reuse_cb(obj, param);
+        pool->requests_from_pool++;
     }
-    return obj;
+    return objpool_add_active(pool, obj);
 }
 
 
 /** \brief  Release \a obj
  *
  * Release \a obj either back into the pool as a reusable object, or frees
- * it entirely when the free list is full.
+ * it entirely when the pool already holds its maximum of inactive objects.
  *
  * \param[in,out]   pool    object pool
  * \param[in,out]   obj     object
  */
 void objpool_release(objpool_t *pool, void *obj)
 {
+    unsigned int index = 0;
+    objpool_class_t *class;
+
     base_debug("Called.");
 
+    objpool_remove_active(pool, obj);
 
     if (pool->inactive_size == pool->inactive_used) {
         base_debug("Free list full\n");
-        /* TODO: check size and free the smallest item? */
         pool->free_cb(obj);
         pool->requests_frees++;
-    } else {
-        base_debug("Adding to free list:\n");
-        /* FIXME: remove from active list */
+        return;
+    }
 
+    base_debug("Adding to free list:\n");
+    if (pool->size_cb != NULL) {
+        index = size_class(pool->size_cb(obj));
+    }
+    class = &pool->classes[index];
+    if (class->used == class->size) {
+        class->size = class->size == 0 ? 8u : class->size * 2u;
+        class->list = base_realloc(class->list,
+                                   class->size * sizeof *(class->list));
+    }
+    objpool_object_set_base(obj, pool, class->used);
+    class->list[class->used++] = obj;
+    pool->classes_used |= UINT32_C(1) << index;
+    if (++(pool->inactive_used) > pool->inactive_peak) {
+        pool->inactive_peak = pool->inactive_used;
+    }
+}
 
-        objpool_object_set_base(obj, pool, pool->inactive_used);
-        pool->inactive_list[pool->inactive_used++] = obj;
+
+/** \brief  Return memory of \a pool not needed since the previous trim
+ *
+ * Keeps as many inactive objects as needed to get back to the high-water
+ * mark of active objects since the previous call and frees the others,
+ * largest first. The active objects list is shrunk to the smallest size
+ * that held that high-water mark, but not below its initial size. The
+ * high-water mark is then reset to the current number of active objects.
+ *
+ * Calling this at regular points, for example after each pass of a watch mode
+ * assembler, lets the pool follow its actual use: memory needed by the
+ * previous run is kept, memory not needed for a whole period is released.
+ *
+ * Takes the pool lock, so it can be called while other threads use the pool
+ * through their caches. Objects held in the caches count as active objects
+ * and aren't touched.
+ *
+ * \param[in,out]   pool    object pool
+ */
+void objpool_trim(objpool_t *pool)
+{
+    size_t keep;
+    size_t size;
+
+    base_debug("Called.");
+
+    pthread_mutex_lock(&pool->lock);
+    keep = pool->active_peak - pool->active_used;
+
+    /* free the largest inactive objects first */
+    for (unsigned int c = OBJPOOL_CLASSES;
+            c > 0 && pool->inactive_used > keep; c--) {
+        objpool_class_t *class = &pool->classes[c - 1u];
+
+        while (class->used > 0 && pool->inactive_used > keep) {
+            pool->free_cb(objpool_take_inactive(pool, c - 1u));
+            pool->trims_frees++;
+        }
     }
+    for (size_t c = 0; c < OBJPOOL_CLASSES; c++) {
+        objpool_class_t *class = &pool->classes[c];
+
+        if (class->used == 0 && class->list != NULL) {
+            base_free(class->list);
+            class->list = NULL;
+            class->size = 0;
+        }
+    }
+
+    /* shrink the active list */
+    size = pool->active_min;
+    while (size < pool->active_peak) {
+        size *= 2;
+    }
+    if (size < pool->active_size) {
+        base_debug("Shrinking list to %zu items.", size);
+        pool->active_list = base_realloc(pool->active_list,
+                                         size * sizeof *(pool->active_list));
+        pool->active_size = size;
+    }
+
+    pool->active_peak = pool->active_used;
+    pthread_mutex_unlock(&pool->lock);
 }
 
 
 /** \brief  Dump statistics on \a pool on stdout
  *
- * \param[in]   pool    object pool
+ * Takes the pool lock, so the numbers are consistent while other threads use
+ * the pool through their caches.
+ *
+ * \param[in,out]   pool    object pool
  */
-void objpool_dump_stats(const objpool_t *pool)
+void objpool_dump_stats(objpool_t *pool)
 {
+    pthread_mutex_lock(&pool->lock);
     printf("active objects: %zu/%zu (%.2f%%)\n",
             pool->active_used,
             pool->active_size,
             (double)(pool->active_used) / (double)(pool->active_size) * 100.0);
-    printf("active ojects array resize count: %lu\n", pool->requests_resizes);
-
-    printf("list = [");
-    for (size_t i = 0; i < pool->active_size; i++) {
-        putchar(pool->active_list[i] != NULL ? '*' : '-');
-    }
-    printf("]\n");
+    printf("active ojects array resize count: %zu\n", pool->requests_resizes);
+    printf("active objects peak since last trim: %zu\n", pool->active_peak);
 
     printf("inactive objects: %zu/%zu (%.2f%%)\n",
             pool->inactive_used,
             pool->inactive_size,
             (double)(pool->inactive_used) / (double)(pool->inactive_size) * 100.0);
-    printf("list = [");
-    for (size_t i = 0; i < pool->inactive_size; i++) {
-        putchar(pool->inactive_list[i] != NULL ? 'X' : '-');
+    for (unsigned int c = 0; c < OBJPOOL_CLASSES; c++) {
+        if (pool->classes[c].used > 0) {
+            printf("  class %2u (%zu+ bytes): %zu\n",
+                   c, (size_t)1 << c, pool->classes[c].used);
+        }
+    }
+    printf("inactive objects peak: %zu\n", pool->inactive_peak);
+    printf("requests: %zu, from pool: %zu, frees: %zu, freed by trim: %zu\n",
+           pool->requests_total, pool->requests_from_pool, pool->requests_frees,
+           pool->trims_frees);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+/** \brief  Initialize per-thread cache \a cache for \a pool
+ *
+ * \param[out]  cache   cache
+ * \param[in]   pool    initialized object pool
+ */
+void objpool_cache_init(objpool_cache_t *cache, objpool_t *pool)
+{
+    cache->pool = pool;
+    for (size_t c = 0; c < OBJPOOL_CLASSES; c++) {
+        cache->magazines[c] = NULL;
+        cache->used[c] = 0;
+    }
+    cache->magazines_used = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->transfers = 0;
+}
+
+
+/** \brief  Move \a count objects from magazine \a class of \a cache to the pool
+ *
+ * Must be called with the pool lock held.
+ *
+ * \param[in,out]   cache   per-thread cache
+ * \param[in]       class   size class
+ * \param[in]       count   number of objects
+ */
+static void cache_flush(objpool_cache_t *cache, unsigned int class, size_t count)
+{
+    void **magazine = cache->magazines[class];
+
+    while (count-- > 0) {
+        objpool_release(cache->pool, magazine[--(cache->used[class])]);
+    }
+    if (cache->used[class] == 0) {
+        cache->magazines_used &= ~(UINT32_C(1) << class);
+    }
+    cache->transfers++;
+}
+
+
+/** \brief  Move a batch of inactive objects of \a class or larger to \a cache
+ *
+ * Takes up to half a magazine of objects from the smallest non-empty size
+ * class of the pool that is at least \a class, and marks them active.
+ *
+ * \param[in,out]   cache   per-thread cache
+ * \param[in]       class   smallest size class
+ *
+ * \return  `true` if any object was moved
+ */
+static bool cache_refill(objpool_cache_t *cache, unsigned int class)
+{
+    objpool_t *pool = cache->pool;
+    uint32_t candidates;
+    size_t count = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    candidates = pool->classes_used & ~((UINT32_C(1) << class) - 1u);
+    if (candidates != 0) {
+        unsigned int from = lowest_bit(candidates);
+
+        if (cache->magazines[from] == NULL) {
+            cache->magazines[from] = base_malloc(
+                    OBJPOOL_MAGAZINE_SIZE * sizeof *(cache->magazines[from]));
+        }
+        while (count < OBJPOOL_MAGAZINE_SIZE / 2 &&
+                cache->used[from] < OBJPOOL_MAGAZINE_SIZE &&
+                pool->classes[from].used > 0) {
+            void *obj = objpool_take_inactive(pool, from);
+
+            objpool_add_active(pool, obj);
+            cache->magazines[from][cache->used[from]++] = obj;
+            count++;
+        }
+        cache->magazines_used |= UINT32_C(1) << from;
+        cache->transfers++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return count > 0;
+}
+
+
+/** \brief  Free per-thread cache \a cache
+ *
+ * Returns all cached objects to the pool.
+ *
+ * \param[in,out]   cache   per-thread cache
+ */
+void objpool_cache_free(objpool_cache_t *cache)
+{
+    pthread_mutex_lock(&cache->pool->lock);
+    for (unsigned int c = 0; c < OBJPOOL_CLASSES; c++) {
+        if (cache->used[c] > 0) {
+            cache_flush(cache, c, cache->used[c]);
+        }
+        base_free(cache->magazines[c]);
+        cache->magazines[c] = NULL;
+    }
+    pthread_mutex_unlock(&cache->pool->lock);
+}
+
+
+/** \brief  Request a suitable object through per-thread cache \a cache
+ *
+ * Like objpool_request(), but served from the cache when possible. Objects
+ * are only allocated outside the lock.
+ *
+ * \param[in,out]   cache   per-thread cache
+ * \param[in]       size    object size request (optional)
+ * \param[in]       param   parameter for the \a object constructor (optional)
+ *
+ * \return  object
+ */
+void *objpool_cache_request(objpool_cache_t *cache, size_t size, void *param)
+{
+    objpool_t *pool = cache->pool;
+    unsigned int class = 0;
+    uint32_t candidates;
+    void *obj;
+
+    if (size > 0 && pool->size_cb != NULL) {
+        class = request_class(size);
+        if (class == OBJPOOL_CLASSES - 1u) {
+            /* the last class isn't bounded, leave it to the pool */
+            pthread_mutex_lock(&pool->lock);
+            obj = objpool_request(pool, size, param);
+            pthread_mutex_unlock(&pool->lock);
+            cache->misses++;
+            return obj;
+        }
+    }
+
+    candidates = cache->magazines_used & ~((UINT32_C(1) << class) - 1u);
+    if (candidates != 0) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+        if (cache_refill(cache, class)) {
+            candidates = cache->magazines_used & ~((UINT32_C(1) << class) - 1u);
+        }
+    }
+
+    if (candidates != 0) {
+        unsigned int from = lowest_bit(candidates);
+
+        obj = cache->magazines[from][--(cache->used[from])];
+        if (cache->used[from] == 0) {
+            cache->magazines_used &= ~(UINT32_C(1) << from);
+        }
+        return pool->reuse_cb(obj, param);
+    }
+
+    /* nothing to reuse: allocate without holding the lock */
+    obj = pool->alloc_cb(param);
+    pthread_mutex_lock(&pool->lock);
+    pool->requests_total++;
+    objpool_add_active(pool, obj);
+    pthread_mutex_unlock(&pool->lock);
+    return obj;
+}
+
+
+/** \brief  Release \a obj into per-thread cache \a cache
+ *
+ * When the magazine for the size class of \a obj is full, half of it is
+ * released to the pool first, which frees objects once the pool holds its
+ * maximum of inactive objects.
+ *
+ * \param[in,out]   cache   per-thread cache
+ * \param[in]       obj     object requested from a cache of the same pool
+ */
+void objpool_cache_release(objpool_cache_t *cache, void *obj)
+{
+    objpool_t *pool = cache->pool;
+    unsigned int class = 0;
+
+    if (pool->size_cb != NULL) {
+        class = size_class(pool->size_cb(obj));
+    }
+    if (cache->magazines[class] == NULL) {
+        cache->magazines[class] = base_malloc(
+                OBJPOOL_MAGAZINE_SIZE * sizeof *(cache->magazines[class]));
+    } else if (cache->used[class] == OBJPOOL_MAGAZINE_SIZE) {
+        pthread_mutex_lock(&pool->lock);
+        cache_flush(cache, class, OBJPOOL_MAGAZINE_SIZE / 2);
+        pthread_mutex_unlock(&pool->lock);
     }
-    printf("]\n");
+    cache->magazines[class][cache->used[class]++] = obj;
+    cache->magazines_used |= UINT32_C(1) << class;
 }
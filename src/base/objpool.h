@@ -25,7 +25,23 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define BASE_OBJPOOL_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
+
+
+/** \brief  Number of size classes of inactive objects
+ *
+ * Class \c n holds objects with a size of at least 2^n and less than 2^(n+1),
+ * the last class holds all larger objects.
+ */
+#define OBJPOOL_CLASSES 32
+
+/** \brief  Number of objects a per-thread cache holds per size class
+ *
+ * Half of this is transferred between cache and pool at once.
+ */
+#define OBJPOOL_MAGAZINE_SIZE   32
 
 
 /** \brief  Housekeeping data for each objpool object
@@ -34,7 +50,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  * use some housekeeping data.
  *
  * * pool:  The pool containing the object
- * * index: Index in the pool of the object
+ * * index: Index in the active objects list or the free list of the object,
+ *          used to remove an active object in O(1)
  */
 #define OBJ_POOL_OBJ_BASE \
     struct objpool_s *pool; \
@@ -48,17 +65,40 @@ typedef struct objpool_obj_s {
 } objpool_obj_t;
 
 
+/** \brief  List of inactive objects of a size class
+ */
+typedef struct objpool_class_s {
+    void ** list;   /**< inactive objects */
+    size_t  size;   /**< number of elements allocated for \c list */
+    size_t  used;   /**< number of objects in \c list */
+} objpool_class_t;
+
+
 /** \brief  Object pool
  *
+ * Inactive objects are kept in free lists per power-of-two size class, so a
+ * sized request takes an object from the smallest non-empty class that is
+ * guaranteed to fit, without scanning. Pools without a \c size_cb use a
+ * single class.
  */
 typedef struct objpool_s {
     void ** active_list;    /**< list of active objects */
     size_t  active_size;    /**< size of active objects list */
     size_t  active_used;    /**< number items in active objects list */
+    size_t  active_min;     /**< initial size of active objects list */
+    size_t  active_peak;    /**< high-water mark of active objects since the
+                                 last trim */
+
+    size_t  inactive_size;  /**< maximum number of inactive objects */
+    size_t  inactive_used;  /**< number of inactive objects */
+    size_t  inactive_peak;  /**< high-water mark of inactive objects */
+
+    objpool_class_t classes[OBJPOOL_CLASSES];   /**< inactive objects per
+                                                     size class */
+    uint32_t        classes_used;   /**< bitmask of non-empty classes */
 
-    void ** inactive_list;  /**< list of active objects */
-    size_t  inactive_size;  /**< size of active objects list */
-    size_t  inactive_used;  /**< number items in active objects list */
+    pthread_mutex_t lock;   /**< lock used by the per-thread caches,
+                                 objpool_trim() and objpool_dump_stats() */
 
     /*
      * Callbacks to object handling functions
@@ -66,28 +106,32 @@ typedef struct objpool_s {
 
     /** \brief  Function called to create the requested object
      *
-     * Called when the inactive objects list is empty or no suitably sized
-     * object could be found.
+     * Called when there are no inactive objects or no suitably sized object
+     * could be found.
      */
     void *  (*alloc_cb)(void *param);
 
     /** \brief  Function called to reuse an object
      *
-     * Called when reusing an object from the inactive objects list.
+     * Called when reusing an inactive object.
      *
      * The \a param argument is an optional initializer, for example a string
-     * when creating a string pool.
+     * when creating a string pool. For requests with a size of 0 the object
+     * isn't guaranteed to be large enough, so the function has to check.
      */
     void *  (*reuse_cb)(void *obj, void *param);
 
-    /** \brief  Function called when removing \a obj from the inactive list
+    /** \brief  Function called to free \a obj
      */
     void    (*free_cb)(void *obj);
 
     /** \brief  Function called to get the size of \a obj
      *
      * This is an optional function, useful when an object has a variable size,
-     * such as a string object, or an array of other objects.
+     * such as a string object, or an array of other objects. It returns the
+     * allocated size, not the size in use. Allocating objects in power-of-two
+     * sizes makes every inactive object of a size class reusable for all
+     * requests for that class.
      */
     size_t  (*size_cb)(void *obj);
 
@@ -101,14 +145,48 @@ typedef struct objpool_s {
                                      got resized */
     size_t  requests_frees;     /**< number of times an object actually had to
                                      be freed due to the free list being full */
+    size_t  trims_frees;        /**< number of inactive objects freed by
+                                     objpool_trim() */
 } objpool_t;
 
 
+/** \brief  Per-thread cache in front of an object pool
+ *
+ * Keeps a 'magazine' of released objects per size class, from which requests
+ * are served without locking. An empty magazine is refilled from the pool and
+ * a full one is half emptied into the pool, one batch per lock. Objects in a
+ * cache count as active objects of the pool.
+ *
+ * Each thread uses its own cache. All threads sharing the pool must use a
+ * cache: the objpool_request() and objpool_release() functions don't lock.
+ * objpool_trim() and objpool_dump_stats() do, and can be called from any
+ * thread.
+ */
+typedef struct objpool_cache_s {
+    objpool_t * pool;                           /**< shared pool */
+    void **     magazines[OBJPOOL_CLASSES];     /**< cached objects per size
+                                                     class */
+    size_t      used[OBJPOOL_CLASSES];          /**< number of objects per
+                                                     magazine */
+    uint32_t    magazines_used;                 /**< bitmask of non-empty
+                                                     magazines */
+    size_t      hits;       /**< requests served from the cache */
+    size_t      misses;     /**< requests that had to go to the pool */
+    size_t      transfers;  /**< number of batches moved to or from the pool */
+} objpool_cache_t;
+
+
 void    objpool_init(objpool_t *pool);
 void    objpool_free(objpool_t *pool);
 
 void *  objpool_request(objpool_t *pool, size_t size, void *data);
 void    objpool_release(objpool_t *pool, void *obj);
-void    objpool_dump_stats(const objpool_t *pool);
+void    objpool_trim(objpool_t *pool);
+void    objpool_dump_stats(objpool_t *pool);
+
+void    objpool_cache_init(objpool_cache_t *cache, objpool_t *pool);
+void    objpool_cache_free(objpool_cache_t *cache);
+void *  objpool_cache_request(objpool_cache_t *cache, size_t size, void *param);
+void    objpool_cache_release(objpool_cache_t *cache, void *obj);
 
 #endif
@@ -24,8 +24,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
 
+#include <assert.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "mem.h"
 #include "error.h"
@@ -111,27 +114,117 @@ static const operator_info_t operator_table[OPERATOR_COUNT] = {
 };
 
 
-/** \brief  List of valid characters for operators
+/** \brief  Maximum number of states in the operator DFA
+ *
+ * One state per distinct prefix of the operator string literals, plus the
+ * start state.
+ */
+#define DFA_MAX_STATES      64
+
+/** \brief  Maximum number of character classes in the operator DFA
+ *
+ * Class 0 is reserved for characters that cannot occur in an operator.
+ */
+#define DFA_MAX_CLASSES     32
+
+/** \brief  Number of parser contexts
  */
-static const char valid_operator_chars[] = "!%&()*+,-./<=>?~";
+#define DFA_CTX_COUNT       2
 
 
-/** \brief  Test if a character is a valid operator character
+/** \brief  Operator recognizer DFA
  *
- * \param[in]   ch  character to test
+ * Generated from #operator_table on first use by dfa_build(). State 0 is the
+ * start state, a transition to state 0 means 'no transition'.
+ */
+static struct {
+    uint8_t         nstates;                /**< number of states used */
+    uint8_t         nclasses;               /**< number of classes used */
+    uint8_t         charclass[128];         /**< character class per ASCII
+                                                 character */
+    /** transition table, indexed by state and character class */
+    uint8_t         next[DFA_MAX_STATES][DFA_MAX_CLASSES];
+    /** accepted operator per state and context, or #OPR_ID_INVALID */
+    operator_id_t   accept[DFA_MAX_STATES][DFA_CTX_COUNT];
+} dfa;
+
+
+/** \brief  Makes sure dfa_build() runs once, even with concurrent first calls
+ */
+static pthread_once_t dfa_once = PTHREAD_ONCE_INIT;
+
+
+/** \brief  Determine if an operator fits a parser context
+ *
+ * Prefix operators (unary and right-to-left associative) fit the
+ * #OPR_CTX_OPERAND context, all others fit the #OPR_CTX_OPERATOR context.
+ *
+ * \param[in]   info    operator table element
+ * \param[in]   ctx     parser context
  *
  * \return  bool
  */
-inline static bool valid_char(int ch)
+static bool fits_context(const operator_info_t *info, operator_ctx_t ctx)
+{
+    bool prefix = info->arity == OPR_UNARY && info->assoc == OPR_RTL;
+
+    return ctx == OPR_CTX_OPERAND ? prefix : !prefix;
+}
+
+
+/** \brief  Generate the operator recognizer DFA from #operator_table
+ *
+ * Adds a path of states for each operator string literal. The state at the
+ * end of a path accepts, per context, the first operator in the table that
+ * fits the context, falling back to the first operator with that literal
+ * when none fits (for example the parentheses, which are valid in both
+ * contexts).
+ */
+static void dfa_build(void)
 {
-    const char *v;
+    dfa.nstates = 1;
+    dfa.nclasses = 1;
+    for (size_t c = 0; c < base_array_len(dfa.charclass); c++) {
+        dfa.charclass[c] = 0;
+    }
+    for (size_t st = 0; st < DFA_MAX_STATES; st++) {
+        for (size_t c = 0; c < DFA_MAX_CLASSES; c++) {
+            dfa.next[st][c] = 0;
+        }
+        dfa.accept[st][OPR_CTX_OPERAND] = OPR_ID_INVALID;
+        dfa.accept[st][OPR_CTX_OPERATOR] = OPR_ID_INVALID;
+    }
+
+    for (size_t i = 0; i < base_array_len(operator_table); i++) {
+        const operator_info_t *info = &operator_table[i];
+        const char *t;
+        uint8_t state = 0;
+
+        for (t = info->text; *t != '\0'; t++) {
+            unsigned char ch = (unsigned char)*t;
 
-    for (v = valid_operator_chars; *v != '\0' && ch >= *v; v++) {
-        if (*v == ch) {
-            return true;
+            assert(ch < base_array_len(dfa.charclass));
+            if (dfa.charclass[ch] == 0) {
+                assert(dfa.nclasses < DFA_MAX_CLASSES);
+                dfa.charclass[ch] = dfa.nclasses++;
+            }
+            if (dfa.next[state][dfa.charclass[ch]] == 0) {
+                assert(dfa.nstates < DFA_MAX_STATES);
+                dfa.next[state][dfa.charclass[ch]] = dfa.nstates++;
+            }
+            state = dfa.next[state][dfa.charclass[ch]];
+        }
+
+        for (int ctx = 0; ctx < DFA_CTX_COUNT; ctx++) {
+            operator_id_t current = dfa.accept[state][ctx];
+
+            if (current == OPR_ID_INVALID ||
+                    (!fits_context(&operator_table[current], (operator_ctx_t)ctx)
+                     && fits_context(info, (operator_ctx_t)ctx))) {
+                dfa.accept[state][ctx] = info->id;
+            }
         }
     }
-    return false;
 }
 
 
@@ -254,36 +347,48 @@ const operator_info_t *operator_get_full_table(void)
 
 /** \brief  Parse string for an operator string literal
  *
- * Parse \a s doing greedy matching of operator strings.
+ * Recognize the longest operator string literal at the start of \a s in a
+ * single pass over at most #OPERATOR_MAX_LEN characters.
+ *
+ * Operators sharing a string literal ('<', '>', '+', '-', '++' and '--') are
+ * disambiguated by \a ctx: when the lexer expects an operand the prefix
+ * operator is returned, otherwise the binary or postfix operator.
  *
  * \param[in]   s   string to parse
+ * \param[in]   ctx parser context
+ * \param[out]  len number of characters consumed (optional, set to 0 when
+ *                  no operator was found)
  *
  * \return  operator ID or #OPR_ID_INVALID if not found
  */
-operator_id_t operator_parse(const char *s)
+operator_id_t operator_parse(const char *s, operator_ctx_t ctx, size_t *len)
 {
-    const char *p = s;
-    size_t len;
+    operator_id_t id = OPR_ID_INVALID;
+    size_t matched = 0;
+    uint8_t state = 0;
 
-    if (s == NULL || *s == '\0') {
-        return OPR_ID_INVALID;
-    }
+    pthread_once(&dfa_once, dfa_build);
 
-    /* greedy matching: find largest string with valid chars */
-    while (*p != '\0' && (p - s) < OPERATOR_MAX_LEN && valid_char(*s)) {
-        p++;
-    }
-    len = (size_t)(p - s);
-    /* try matching a string of reducing length */
-    while (len-- > 0) {
-        for (size_t i = 0; i < base_array_len(operator_table); i++) {
-            /* skip strncmp() for len 1 */
-            if (len == 1 && operator_table[i].text[0] == *s) {
-                return (operator_id_t)i;
-            } else if (strncmp(operator_table[i].text, s, len) == 0) {
-                return (operator_id_t)i;
+    if (s != NULL && (ctx == OPR_CTX_OPERAND || ctx == OPR_CTX_OPERATOR)) {
+        for (size_t i = 0; i < OPERATOR_MAX_LEN && s[i] != '\0'; i++) {
+            unsigned char ch = (unsigned char)s[i];
+
+            if (ch >= base_array_len(dfa.charclass)) {
+                break;
+            }
+            state = dfa.next[state][dfa.charclass[ch]];
+            if (state == 0) {
+                break;
+            }
+            if (dfa.accept[state][ctx] != OPR_ID_INVALID) {
+                id = dfa.accept[state][ctx];
+                matched = i + 1;
             }
         }
     }
-    return OPR_ID_INVALID;
+
+    if (len != NULL) {
+        *len = matched;
+    }
+    return id;
 }
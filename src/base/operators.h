@@ -25,6 +25,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef BASE_OPERATORS_H
 #define BASE_OPERATORS_H
 
+#include <stddef.h>
+
 /** \brief  Operator ID enum
  */
 typedef enum operator_id_e {
@@ -115,6 +117,16 @@ typedef enum operator_arity_e {
     OPR_TERNARY         /**< ternary operator (three operands: only '?:') */
 } operator_arity_t;
 
+/** \brief  Operator parser context
+ *
+ * Used to disambiguate operators sharing a string literal, such as '<' (LSB
+ * or less than) and '-' (unary minus or subtraction).
+ */
+typedef enum operator_ctx_e {
+    OPR_CTX_OPERAND,    /**< expecting an operand: prefix operators */
+    OPR_CTX_OPERATOR    /**< after an operand: binary and postfix operators */
+} operator_ctx_t;
+
 /** \brief  Operator table element
  */
 typedef struct operator_info_s {
@@ -133,5 +145,5 @@ int                     operator_prec(operator_id_t id);
 const operator_info_t * operator_info(operator_id_t id);
 const operator_info_t * operator_get_full_table(void);
 
-operator_id_t operator_parse(const char *s);
+operator_id_t operator_parse(const char *s, operator_ctx_t ctx, size_t *len);
 #endif
@@ -0,0 +1,562 @@
+/** \file   resolver.c
+ * \brief   Incremental symbol/expression resolver
+ * \ingroup base
+ *
+ * Tracks which compiled expressions refer to which symbols, so that after a
+ * symbol changes value only the expressions depending on it are evaluated
+ * again. Changes propagate through symbols defined by expressions using a
+ * worklist until nothing changes anymore, making the amount of work per
+ * assembler pass proportional to the amount of change rather than to the
+ * size of the source.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "debug.h"
+#include "dict.h"
+#include "error.h"
+#include "expr.h"
+#include "mem.h"
+
+#include "resolver.h"
+
+
+/** \brief  Initial number of symbol slots and expressions
+ */
+#define RESOLVER_INITIAL_SIZE   64
+
+/** \brief  Maximum number of evaluations per expression in a single update
+ *
+ * Used to detect circular definitions that keep changing value.
+ */
+#define RESOLVER_EVAL_FACTOR    16
+
+
+/** \brief  Resize the symbol slot arrays of \a resolver to \a size elements
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       size        new number of slots
+ */
+static void slots_resize(resolver_t *resolver, size_t size)
+{
+    resolver->values = base_realloc(resolver->values,
+                                    size * sizeof *(resolver->values));
+    resolver->defined = base_realloc(resolver->defined,
+                                     size * sizeof *(resolver->defined));
+    resolver->deps = base_realloc(resolver->deps,
+                                  size * sizeof *(resolver->deps));
+    resolver->slots_size = size;
+}
+
+
+/** \brief  Add expression index to the dependency list of a slot
+ *
+ * \param[in,out]   deps    dependency list
+ * \param[in]       index   expression index
+ */
+static void deps_add(resolver_deps_t *deps, uint32_t index)
+{
+    if (deps->used == deps->size) {
+        deps->size = deps->size == 0 ? 4u : deps->size * 2u;
+        deps->list = base_realloc(deps->list, deps->size * sizeof *(deps->list));
+    }
+    deps->list[deps->used++] = index;
+}
+
+
+/** \brief  Put expression on the worklist if not already queued
+ *
+ * The worklist is processed in FIFO order, so expressions get evaluated in
+ * the order they were added, which usually is the order of definition.
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       index       expression index
+ */
+static void enqueue(resolver_t *resolver, uint32_t index)
+{
+    resolver_expr_t *e = &resolver->exprs[index];
+
+    if (!e->queued) {
+        size_t tail = (resolver->work_head + resolver->work_used) %
+                      resolver->exprs_size;
+
+        e->queued = true;
+        resolver->worklist[tail] = index;
+        resolver->work_used++;
+    }
+}
+
+
+/** \brief  Set slot value and queue its dependents if the value changed
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       slot        slot index
+ * \param[in]       value       new value
+ */
+static void slot_update(resolver_t *resolver, uint32_t slot, int32_t value)
+{
+    const resolver_deps_t *deps;
+
+    if (resolver->defined[slot] && resolver->values[slot] == value) {
+        return;
+    }
+    resolver->values[slot] = value;
+    resolver->defined[slot] = true;
+
+    deps = &resolver->deps[slot];
+    for (size_t i = 0; i < deps->used; i++) {
+        enqueue(resolver, deps->list[i]);
+    }
+}
+
+
+/** \brief  Mark slot undefined and queue its dependents if it was defined
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       slot        slot index
+ */
+static void slot_undefine(resolver_t *resolver, uint32_t slot)
+{
+    const resolver_deps_t *deps;
+
+    if (!resolver->defined[slot]) {
+        return;
+    }
+    resolver->defined[slot] = false;
+
+    deps = &resolver->deps[slot];
+    for (size_t i = 0; i < deps->used; i++) {
+        enqueue(resolver, deps->list[i]);
+    }
+}
+
+
+/** \brief  Symbol callback for the expression compiler
+ *
+ * Maps \a name to a slot, creating the slot if required, and records the slot
+ * as a dependency of the expression being compiled.
+ *
+ * \param[in]   name    symbol name (not 0-terminated)
+ * \param[in]   len     length of \a name
+ * \param[out]  slot    slot index
+ * \param[in]   data    resolver
+ *
+ * \return  `true` on success
+ */
+static bool symbol_cb(const char *name, size_t len, uint32_t *slot, void *data)
+{
+    resolver_t *resolver = data;
+    char buffer[64];
+    char *key = buffer;
+    uint32_t s;
+
+    if (len >= sizeof buffer) {
+        key = base_malloc(len + 1u);
+    }
+    memcpy(key, name, len);
+    key[len] = '\0';
+    s = resolver_symbol(resolver, key);
+    if (key != buffer) {
+        base_free(key);
+    }
+    if (s == RESOLVER_NO_SLOT) {
+        return false;
+    }
+
+    /* record dependency once */
+    for (size_t i = 0; i < resolver->refs_used; i++) {
+        if (resolver->refs[i] == s) {
+            *slot = s;
+            return true;
+        }
+    }
+    if (resolver->refs_used == resolver->refs_size) {
+        resolver->refs_size *= 2u;
+        resolver->refs = base_realloc(resolver->refs,
+                                      resolver->refs_size * sizeof *(resolver->refs));
+    }
+    resolver->refs[resolver->refs_used++] = s;
+    *slot = s;
+    return true;
+}
+
+
+/** \brief  Compile and track expression
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       text        expression text
+ * \param[in]       target      slot defined by the expression or
+ *                              #RESOLVER_NO_SLOT
+ * \param[out]      index       expression index (optional)
+ *
+ * \return  `true` on success
+ */
+static bool track(resolver_t *resolver,
+                  const char *text,
+                  uint32_t target,
+                  uint32_t *index)
+{
+    resolver_expr_t *e;
+    expr_t expr;
+    const char *end;
+    size_t code_used = resolver->code.used;
+    uint32_t idx;
+
+    resolver->refs_used = 0;
+    if (!expr_compile(&resolver->code, text, &end, symbol_cb, resolver, &expr)) {
+        resolver->code.used = code_used;
+        return false;
+    }
+    if (*end != '\0') {
+        /* drop the bytecode of the rejected expression */
+        resolver->code.used = code_used;
+        base_errno = BASE_ERR_SYNTAX;
+        return false;
+    }
+
+    if (resolver->exprs_used == resolver->exprs_size) {
+        size_t old_size = resolver->exprs_size;
+
+        resolver->exprs_size *= 2u;
+        resolver->exprs = base_realloc(resolver->exprs,
+                                       resolver->exprs_size * sizeof *(resolver->exprs));
+        resolver->worklist = base_realloc(resolver->worklist,
+                                          resolver->exprs_size * sizeof *(resolver->worklist));
+        /* unwrap the ring buffer: move the wrapped part after the old end */
+        if (resolver->work_head + resolver->work_used > old_size) {
+            memcpy(resolver->worklist + old_size,
+                   resolver->worklist,
+                   (resolver->work_head + resolver->work_used - old_size) *
+                   sizeof *(resolver->worklist));
+        }
+    }
+    idx = (uint32_t)resolver->exprs_used++;
+    e = &resolver->exprs[idx];
+    e->expr = expr;
+    e->target = target;
+    e->value = 0;
+    e->resolved = false;
+    e->queued = false;
+
+    for (size_t i = 0; i < resolver->refs_used; i++) {
+        deps_add(&resolver->deps[resolver->refs[i]], idx);
+    }
+    enqueue(resolver, idx);
+
+    if (index != NULL) {
+        *index = idx;
+    }
+    return true;
+}
+
+
+/** \brief  Initialize \a resolver
+ *
+ * \param[out]  resolver    resolver
+ */
+void resolver_init(resolver_t *resolver)
+{
+    expr_code_init(&resolver->code);
+    resolver->names = dict_new_backend(DICT_BACKEND_OPEN, 0);
+
+    resolver->values = NULL;
+    resolver->defined = NULL;
+    resolver->deps = NULL;
+    resolver->slots_used = 0;
+    slots_resize(resolver, RESOLVER_INITIAL_SIZE);
+
+    resolver->exprs_size = RESOLVER_INITIAL_SIZE;
+    resolver->exprs_used = 0;
+    resolver->exprs = base_malloc(resolver->exprs_size * sizeof *(resolver->exprs));
+    resolver->worklist = base_malloc(resolver->exprs_size * sizeof *(resolver->worklist));
+    resolver->work_head = 0;
+    resolver->work_used = 0;
+
+    resolver->refs_size = 16;
+    resolver->refs_used = 0;
+    resolver->refs = base_malloc(resolver->refs_size * sizeof *(resolver->refs));
+
+    resolver->evals = 0;
+}
+
+
+/** \brief  Free memory used by \a resolver
+ *
+ * \param[in,out]   resolver    resolver
+ */
+void resolver_free(resolver_t *resolver)
+{
+    for (size_t i = 0; i < resolver->slots_used; i++) {
+        base_free(resolver->deps[i].list);
+    }
+    base_free(resolver->values);
+    base_free(resolver->defined);
+    base_free(resolver->deps);
+    base_free(resolver->exprs);
+    base_free(resolver->worklist);
+    base_free(resolver->refs);
+    dict_free(resolver->names);
+    expr_code_free(&resolver->code);
+}
+
+
+/** \brief  Get slot of symbol \a name, creating it if required
+ *
+ * New symbols start out undefined.
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       name        symbol name
+ *
+ * \return  slot index or #RESOLVER_NO_SLOT on error
+ * \throw   BASE_ERR_KEY    \a name is `NULL` or empty
+ */
+uint32_t resolver_symbol(resolver_t *resolver, const char *name)
+{
+    dict_value_t value;
+    uint32_t hash;
+    uint32_t slot;
+
+    if (name == NULL || *name == '\0') {
+        base_errno = BASE_ERR_KEY;
+        return RESOLVER_NO_SLOT;
+    }
+    /* hash once for both the lookup and the insertion */
+    hash = dict_hash_key(name);
+    if (dict_get_hashed(resolver->names, name, hash, &value, NULL)) {
+        return (uint32_t)DICT_VALUE_TO_INT(value);
+    }
+
+    if (resolver->slots_used == resolver->slots_size) {
+        slots_resize(resolver, resolver->slots_size * 2u);
+    }
+    slot = (uint32_t)resolver->slots_used++;
+    resolver->values[slot] = 0;
+    resolver->defined[slot] = false;
+    resolver->deps[slot].list = NULL;
+    resolver->deps[slot].size = 0;
+    resolver->deps[slot].used = 0;
+    dict_set_hashed(resolver->names, name, hash,
+                    DICT_INT_TO_VALUE(slot), DICT_ITEM_INT);
+    return slot;
+}
+
+
+/** \brief  Set symbol value
+ *
+ * Expressions depending on the symbol are queued for evaluation by the next
+ * resolver_update() if the value changed.
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       slot        symbol slot
+ * \param[in]       value       symbol value
+ *
+ * \return  `false` on error
+ * \throw   BASE_ERR_INDEX  \a slot is invalid
+ */
+bool resolver_set(resolver_t *resolver, uint32_t slot, int32_t value)
+{
+    if (slot >= resolver->slots_used) {
+        base_errno = BASE_ERR_INDEX;
+        return false;
+    }
+    slot_update(resolver, slot, value);
+    return true;
+}
+
+
+/** \brief  Get symbol value
+ *
+ * \param[in]   resolver    resolver
+ * \param[in]   slot        symbol slot
+ * \param[out]  value       symbol value
+ *
+ * \return  `false` if the symbol is undefined
+ * \throw   BASE_ERR_INDEX  \a slot is invalid
+ * \throw   BASE_ERR_UNDEF  symbol is undefined
+ */
+bool resolver_get(const resolver_t *resolver, uint32_t slot, int32_t *value)
+{
+    if (slot >= resolver->slots_used) {
+        base_errno = BASE_ERR_INDEX;
+        return false;
+    }
+    if (!resolver->defined[slot]) {
+        base_errno = BASE_ERR_UNDEF;
+        return false;
+    }
+    *value = resolver->values[slot];
+    return true;
+}
+
+
+/** \brief  Define symbol \a name as the value of expression \a text
+ *
+ * The expression is evaluated by the next resolver_update().
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       name        symbol name
+ * \param[in]       text        expression text
+ * \param[out]      index       expression index (optional)
+ *
+ * \return  `true` on success
+ * \throw   BASE_ERR_KEY    \a name is `NULL` or empty
+ * \throw   BASE_ERR_SYNTAX trailing garbage after the expression
+ *
+ * \see expr_compile() for other errors
+ */
+bool resolver_define(resolver_t *resolver,
+                     const char *name,
+                     const char *text,
+                     uint32_t *index)
+{
+    uint32_t slot = resolver_symbol(resolver, name);
+
+    if (slot == RESOLVER_NO_SLOT) {
+        return false;
+    }
+    return track(resolver, text, slot, index);
+}
+
+
+/** \brief  Add fixup expression \a text
+ *
+ * The expression is evaluated by the next resolver_update(), its value can
+ * be retrieved with resolver_value().
+ *
+ * \param[in,out]   resolver    resolver
+ * \param[in]       text        expression text
+ * \param[out]      index       expression index (optional)
+ *
+ * \return  `true` on success
+ * \throw   BASE_ERR_SYNTAX trailing garbage after the expression
+ *
+ * \see expr_compile() for other errors
+ */
+bool resolver_add(resolver_t *resolver, const char *text, uint32_t *index)
+{
+    return track(resolver, text, RESOLVER_NO_SLOT, index);
+}
+
+
+/** \brief  Get value of expression
+ *
+ * \param[in]   resolver    resolver
+ * \param[in]   index       expression index
+ * \param[out]  value       value of the expression
+ *
+ * \return  `false` if the expression is unresolved
+ * \throw   BASE_ERR_INDEX  \a index is invalid
+ * \throw   BASE_ERR_UNDEF  expression is unresolved
+ */
+bool resolver_value(const resolver_t *resolver, uint32_t index, int32_t *value)
+{
+    const resolver_expr_t *e;
+
+    if (index >= resolver->exprs_used) {
+        base_errno = BASE_ERR_INDEX;
+        return false;
+    }
+    e = &resolver->exprs[index];
+    if (!e->resolved) {
+        base_errno = BASE_ERR_UNDEF;
+        return false;
+    }
+    *value = e->value;
+    return true;
+}
+
+
+/** \brief  Evaluate queued expressions until nothing changes
+ *
+ * Only expressions that are new or whose symbols changed value since the
+ * previous update are evaluated. Expressions defining a symbol queue the
+ * dependents of that symbol when their value changes. When such an
+ * expression fails to evaluate, its symbol becomes undefined and the
+ * dependents are queued as well.
+ *
+ * \param[in,out]   resolver    resolver
+ *
+ * \return  `false` when circular definitions keep changing value
+ * \throw   BASE_ERR_RANGE  evaluation limit reached
+ */
+bool resolver_update(resolver_t *resolver)
+{
+    expr_env_t env;
+    size_t limit = RESOLVER_EVAL_FACTOR * (resolver->exprs_used + 1u);
+    size_t count = 0;
+
+    while (resolver->work_used > 0) {
+        uint32_t idx = resolver->worklist[resolver->work_head];
+        resolver_expr_t *e = &resolver->exprs[idx];
+        int32_t value;
+
+        resolver->work_head = (resolver->work_head + 1u) % resolver->exprs_size;
+        resolver->work_used--;
+        e->queued = false;
+        if (++count > limit) {
+            base_errno = BASE_ERR_RANGE;
+            return false;
+        }
+
+        /* slots can be added between updates, so set up env each time */
+        env.values = resolver->values;
+        env.defined = resolver->defined;
+        env.count = resolver->slots_used;
+
+        resolver->evals++;
+        if (!expr_eval(&resolver->code, &e->expr, &env, &value)) {
+            e->resolved = false;
+            if (e->target != RESOLVER_NO_SLOT) {
+                slot_undefine(resolver, e->target);
+            }
+            continue;
+        }
+        e->resolved = true;
+        e->value = value;
+        if (e->target != RESOLVER_NO_SLOT) {
+            slot_update(resolver, e->target, value);
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Get number of unresolved expressions
+ *
+ * \param[in]   resolver    resolver
+ *
+ * \return  number of expressions whose last evaluation failed
+ */
+size_t resolver_unresolved(const resolver_t *resolver)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < resolver->exprs_used; i++) {
+        if (!resolver->exprs[i].resolved) {
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,113 @@
+/** \file   resolver.h
+ * \brief   Incremental symbol/expression resolver - header
+ * \ingroup base
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BASE_RESOLVER_H
+#define BASE_RESOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dict.h"
+#include "expr.h"
+
+
+/** \brief  Slot index used for expressions that don't define a symbol
+ */
+#define RESOLVER_NO_SLOT    UINT32_MAX
+
+
+/** \brief  Expression tracked by the resolver
+ */
+typedef struct resolver_expr_s {
+    expr_t      expr;       /**< compiled expression */
+    uint32_t    target;     /**< slot of the symbol defined by the expression,
+                                 or #RESOLVER_NO_SLOT for a fixup */
+    int32_t     value;      /**< last value */
+    bool        resolved;   /**< last evaluation succeeded */
+    bool        queued;     /**< expression is on the worklist */
+} resolver_expr_t;
+
+
+/** \brief  Dependency list of a symbol slot
+ *
+ * Indices of the expressions referring to the symbol.
+ */
+typedef struct resolver_deps_s {
+    uint32_t *  list;   /**< expression indices */
+    size_t      size;   /**< number of elements allocated */
+    size_t      used;   /**< number of elements used */
+} resolver_deps_t;
+
+
+/** \brief  Resolver object
+ */
+typedef struct resolver_s {
+    expr_code_t         code;       /**< bytecode of all expressions */
+    dict_t *            names;      /**< symbol name to slot index map */
+
+    int32_t *           values;     /**< symbol values, indexed by slot */
+    bool *              defined;    /**< symbol defined flags */
+    resolver_deps_t *   deps;       /**< dependents of each slot */
+    size_t              slots_size; /**< number of slots allocated */
+    size_t              slots_used; /**< number of slots used */
+
+    resolver_expr_t *   exprs;      /**< tracked expressions */
+    size_t              exprs_size; /**< number of expressions allocated */
+    size_t              exprs_used; /**< number of expressions used */
+
+    uint32_t *          worklist;   /**< expressions to (re)evaluate, ring
+                                         buffer of \c exprs_size elements */
+    size_t              work_head;  /**< index of first queued expression */
+    size_t              work_used;  /**< number of expressions queued */
+
+    uint32_t *          refs;       /**< slots referenced by the expression
+                                         being compiled */
+    size_t              refs_size;  /**< number of elements allocated */
+    size_t              refs_used;  /**< number of elements used */
+
+    size_t              evals;      /**< total number of evaluations */
+} resolver_t;
+
+
+void    resolver_init(resolver_t *resolver);
+void    resolver_free(resolver_t *resolver);
+
+uint32_t resolver_symbol(resolver_t *resolver, const char *name);
+bool    resolver_set(resolver_t *resolver, uint32_t slot, int32_t value);
+bool    resolver_get(const resolver_t *resolver, uint32_t slot, int32_t *value);
+
+bool    resolver_define(resolver_t *resolver,
+                        const char *name,
+                        const char *text,
+                        uint32_t *index);
+bool    resolver_add(resolver_t *resolver, const char *text, uint32_t *index);
+bool    resolver_value(const resolver_t *resolver,
+                       uint32_t index,
+                       int32_t *value);
+
+bool    resolver_update(resolver_t *resolver);
+size_t  resolver_unresolved(const resolver_t *resolver);
+
+#endif
@@ -0,0 +1,388 @@
+/** \file   scope.c
+ * \brief   Scoped symbol tables
+ * \ingroup base
+ *
+ * A stack of nested scopes (file, procedure, macro expansion, anonymous
+ * block) on top of the global scope. Each scope has a small open addressing
+ * hash table of its symbols. A name is resolved by hashing it once and
+ * probing the tables from the innermost scope outwards.
+ *
+ * Everything belonging to a scope, including the scope itself, is allocated
+ * from one arena. Entering a scope takes a mark of the arena, leaving it
+ * releases the arena up to that mark, so both are constant time no matter
+ * how many symbols the scope holds.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "dict.h"
+#include "error.h"
+#include "mem.h"
+
+#include "scope.h"
+
+
+/** \brief  Initial number of slots of a scope's hash table
+ */
+#define SCOPE_INIT_CAPACITY 8u
+
+/** \brief  Size of the arena chunks
+ */
+#define SCOPE_CHUNK_SIZE    16384u
+
+
+/** \brief  Allocate and initialize scope
+ *
+ * \param[in,out]   table   scope table
+ * \param[in]       kind    kind of scope
+ * \param[in]       name    name of the scope (optional)
+ *
+ * \return  new scope
+ */
+static scope_t *scope_new(scope_table_t *table, scope_kind_t kind, const char *name)
+{
+    base_arena_mark_t mark = base_arena_mark(&table->arena);
+    scope_t *scope = base_arena_alloc(&table->arena, sizeof *scope);
+
+    scope->parent = table->current;
+    scope->kind = kind;
+    scope->name = name != NULL ? base_arena_strdup(&table->arena, name) : NULL;
+    scope->id = table->next_id++;
+    scope->depth = table->current != NULL ? table->current->depth + 1u : 0;
+    scope->capacity = SCOPE_INIT_CAPACITY;
+    scope->slots = base_arena_calloc(&table->arena, scope->capacity,
+                                     sizeof *(scope->slots));
+    scope->count = 0;
+    scope->mark = mark;
+    return scope;
+}
+
+
+/** \brief  Find slot for \a name in \a scope
+ *
+ * \param[in]   scope   scope
+ * \param[in]   name    name
+ * \param[in]   hash    hash of \a name
+ *
+ * \return  slot holding the symbol, or the empty slot where it would go
+ */
+static scope_symbol_t **find_slot(const scope_t *scope, const char *name, uint32_t hash)
+{
+    size_t mask = scope->capacity - 1u;
+    size_t index = hash & mask;
+
+    while (scope->slots[index] != NULL) {
+        const scope_symbol_t *symbol = scope->slots[index];
+
+        if (symbol->hash == hash && strcmp(symbol->name, name) == 0) {
+            break;
+        }
+        index = (index + 1u) & mask;
+    }
+    return &scope->slots[index];
+}
+
+
+/** \brief  Double the size of the hash table of \a scope
+ *
+ * The old table stays in the arena until the scope is left.
+ *
+ * \param[in,out]   table   scope table
+ * \param[in,out]   scope   scope
+ */
+static void grow(scope_table_t *table, scope_t *scope)
+{
+    scope_symbol_t **old = scope->slots;
+    size_t old_capacity = scope->capacity;
+
+    scope->capacity *= 2u;
+    scope->slots = base_arena_calloc(&table->arena, scope->capacity,
+                                     sizeof *(scope->slots));
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i] != NULL) {
+            size_t index = old[i]->hash & (scope->capacity - 1u);
+
+            while (scope->slots[index] != NULL) {
+                index = (index + 1u) & (scope->capacity - 1u);
+            }
+            scope->slots[index] = old[i];
+        }
+    }
+}
+
+
+/** \brief  Initialize scope table
+ *
+ * The table starts out with only the global scope.
+ *
+ * \param[out]  table   scope table
+ */
+void scope_table_init(scope_table_t *table)
+{
+    base_arena_init(&table->arena, SCOPE_CHUNK_SIZE);
+    table->current = NULL;
+    table->next_id = 1;
+    table->cache_hits = 0;
+    table->cache_misses = 0;
+    table->global = scope_new(table, SCOPE_GLOBAL, NULL);
+    table->current = table->global;
+}
+
+
+/** \brief  Free scope table, including all scopes and symbols
+ *
+ * \param[in,out]   table   scope table
+ */
+void scope_table_free(scope_table_t *table)
+{
+    base_arena_free(&table->arena);
+    table->global = NULL;
+    table->current = NULL;
+}
+
+
+/** \brief  Enter new scope
+ *
+ * \param[in,out]   table   scope table
+ * \param[in]       kind    kind of scope
+ * \param[in]       name    name of the scope (optional)
+ *
+ * \return  new scope, which is now the current scope
+ * \throw   BASE_ERR_ENUM   \a kind is invalid
+ */
+scope_t *scope_enter(scope_table_t *table, scope_kind_t kind, const char *name)
+{
+    switch (kind) {
+        case SCOPE_FILE:    /* fall through */
+        case SCOPE_PROC:    /* fall through */
+        case SCOPE_MACRO:   /* fall through */
+        case SCOPE_ANON:
+            break;
+        case SCOPE_GLOBAL:  /* fall through */
+        default:
+            base_errno = BASE_ERR_ENUM;
+            return NULL;
+    }
+    table->current = scope_new(table, kind, name);
+    return table->current;
+}
+
+
+/** \brief  Leave current scope
+ *
+ * Releases the scope and all its symbols, pointers to them become invalid.
+ *
+ * \param[in,out]   table   scope table
+ *
+ * \return  `false` if the current scope is the global scope
+ * \throw   BASE_ERR_EMPTY  no scope to leave
+ */
+bool scope_leave(scope_table_t *table)
+{
+    scope_t *scope = table->current;
+
+    if (scope->parent == NULL) {
+        base_errno = BASE_ERR_EMPTY;
+        return false;
+    }
+    table->current = scope->parent;
+    base_arena_release(&table->arena, scope->mark);
+    return true;
+}
+
+
+/** \brief  Define symbol in the current scope, or find it if it already exists
+ *
+ * Only the current scope is searched, a symbol with the same name in an
+ * enclosing scope is shadowed by the new symbol.
+ *
+ * \param[in,out]   table   scope table
+ * \param[in]       name    name
+ * \param[out]      added   set to `true` if the symbol was added (optional)
+ *
+ * \return  symbol or `NULL` on error
+ * \throw   BASE_ERR_KEY    \a name is `NULL` or empty
+ */
+scope_symbol_t *scope_define(scope_table_t *table, const char *name, bool *added)
+{
+    scope_t *scope = table->current;
+    scope_symbol_t **slot;
+    scope_symbol_t *symbol;
+    uint32_t hash;
+
+    if (added != NULL) {
+        *added = false;
+    }
+    if (name == NULL || *name == '\0') {
+        base_errno = BASE_ERR_KEY;
+        return NULL;
+    }
+
+    hash = dict_hash_key(name);
+    slot = find_slot(scope, name, hash);
+    if (*slot != NULL) {
+        return *slot;
+    }
+
+    /* keep the load factor at or below 3/4 */
+    if ((scope->count + 1u) * 4u > scope->capacity * 3u) {
+        grow(table, scope);
+        slot = find_slot(scope, name, hash);
+    }
+
+    symbol = base_arena_alloc(&table->arena, sizeof *symbol);
+    symbol->name = base_arena_strdup(&table->arena, name);
+    symbol->hash = hash;
+    symbol->type = 0;
+    symbol->value = 0;
+    symbol->object = NULL;
+    symbol->scope = scope;
+    *slot = symbol;
+    scope->count++;
+
+    if (added != NULL) {
+        *added = true;
+    }
+    return symbol;
+}
+
+
+/** \brief  Find symbol in \a scope only
+ *
+ * \param[in]   scope   scope
+ * \param[in]   name    name
+ * \param[in]   hash    hash of \a name as returned by dict_hash_key()
+ *
+ * \return  symbol or `NULL` when not found
+ */
+scope_symbol_t *scope_find_local(const scope_t *scope, const char *name, uint32_t hash)
+{
+    return *find_slot(scope, name, hash);
+}
+
+
+/** \brief  Resolve \a name and \a hash from \a scope outwards
+ *
+ * \param[in]   scope   innermost scope to search
+ * \param[in]   name    name
+ * \param[in]   hash    hash of \a name
+ *
+ * \return  symbol or `NULL` when not found
+ */
+static scope_symbol_t *resolve(const scope_t *scope, const char *name, uint32_t hash)
+{
+    for (; scope != NULL; scope = scope->parent) {
+        scope_symbol_t *symbol = *find_slot(scope, name, hash);
+
+        if (symbol != NULL) {
+            return symbol;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Look up symbol, searching from the current scope outwards
+ *
+ * \param[in]   table   scope table
+ * \param[in]   name    name
+ *
+ * \return  symbol or `NULL` when not found
+ * \throw   BASE_ERR_KEY    \a name is `NULL`, empty or not found
+ */
+scope_symbol_t *scope_lookup(const scope_table_t *table, const char *name)
+{
+    scope_symbol_t *symbol;
+
+    if (name == NULL || *name == '\0') {
+        base_errno = BASE_ERR_KEY;
+        return NULL;
+    }
+    symbol = resolve(table->current, name, dict_hash_key(name));
+    if (symbol == NULL) {
+        base_errno = BASE_ERR_KEY;
+    }
+    return symbol;
+}
+
+
+/** \brief  Initialize symbol reference
+ *
+ * \param[out]  ref     reference
+ * \param[in]   name    name of the referenced symbol, must not be `NULL`
+ *                      and must outlive \a ref
+ */
+void scope_ref_init(scope_ref_t *ref, const char *name)
+{
+    ref->name = name;
+    ref->hash = dict_hash_key(name);
+    ref->scope_id = 0;
+    ref->count = 0;
+    ref->symbol = NULL;
+}
+
+
+/** \brief  Resolve symbol reference from the current scope
+ *
+ * The result is cached in \a ref and reused while the current scope is the
+ * same scope. Symbols are only ever defined in the current scope and never
+ * removed, so the cached symbol can only be shadowed by a symbol with the
+ * same name defined in the current scope since: if the scope gained symbols,
+ * only the current scope is probed instead of walking all scopes. Scope IDs
+ * are never reused, so a cached symbol of a scope that has been left is never
+ * returned.
+ *
+ * \param[in,out]   table   scope table
+ * \param[in,out]   ref     reference
+ *
+ * \return  symbol or `NULL` when not found
+ * \throw   BASE_ERR_KEY    symbol not found
+ */
+scope_symbol_t *scope_resolve(scope_table_t *table, scope_ref_t *ref)
+{
+    scope_t *scope = table->current;
+
+    if (ref->symbol != NULL && ref->scope_id == scope->id) {
+        if (ref->count != scope->count &&
+                ref->symbol->scope != scope &&
+                *find_slot(scope, ref->name, ref->hash) != NULL) {
+            /* shadowed */
+            ref->symbol = NULL;
+        } else {
+            ref->count = scope->count;
+            table->cache_hits++;
+            return ref->symbol;
+        }
+    }
+
+    table->cache_misses++;
+    ref->symbol = resolve(scope, ref->name, ref->hash);
+    ref->scope_id = scope->id;
+    ref->count = scope->count;
+    if (ref->symbol == NULL) {
+        base_errno = BASE_ERR_KEY;
+    }
+    return ref->symbol;
+}
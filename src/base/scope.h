@@ -0,0 +1,128 @@
+/** \file   scope.h
+ * \brief   Scoped symbol tables - header
+ * \ingroup base
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BASE_SCOPE_H
+#define BASE_SCOPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mem.h"
+
+
+/** \brief  Scope kinds
+ */
+typedef enum scope_kind_e {
+    SCOPE_GLOBAL,   /**< outermost scope, always present */
+    SCOPE_FILE,     /**< source file */
+    SCOPE_PROC,     /**< procedure */
+    SCOPE_MACRO,    /**< macro expansion */
+    SCOPE_ANON      /**< anonymous block */
+} scope_kind_t;
+
+
+/** \brief  Symbol in a scope
+ */
+typedef struct scope_symbol_s {
+    const char *        name;   /**< name */
+    uint32_t            hash;   /**< hash of \c name, see dict_hash_key() */
+    int                 type;   /**< symbol type, free for the caller to use */
+    int32_t             value;  /**< symbol value */
+    void *              object; /**< additional data */
+    struct scope_s *    scope;  /**< scope the symbol is defined in */
+} scope_symbol_t;
+
+
+/** \brief  Scope
+ *
+ * Scopes and their symbols are allocated from the arena of the scope table,
+ * leaving a scope releases all of it at once.
+ */
+typedef struct scope_s {
+    struct scope_s *    parent;     /**< enclosing scope, `NULL` for the
+                                         global scope */
+    scope_kind_t        kind;       /**< kind of scope */
+    const char *        name;       /**< name (optional) */
+    uint32_t            id;         /**< unique ID, never reused */
+    unsigned int        depth;      /**< nesting depth, 0 for global */
+    scope_symbol_t **   slots;      /**< open addressing hash table */
+    size_t              capacity;   /**< number of slots (power of two) */
+    size_t              count;      /**< number of symbols */
+    base_arena_mark_t   mark;       /**< arena position before the scope
+                                         was entered */
+} scope_t;
+
+
+/** \brief  Scope table: a stack of scopes
+ */
+typedef struct scope_table_s {
+    base_arena_t    arena;          /**< storage for scopes and symbols */
+    scope_t *       global;         /**< global scope */
+    scope_t *       current;        /**< innermost scope */
+    uint32_t        next_id;        /**< ID for the next scope entered */
+    size_t          cache_hits;     /**< resolutions served from cache */
+    size_t          cache_misses;   /**< resolutions walking the scopes */
+} scope_table_t;
+
+
+/** \brief  Reference to a symbol from a particular place in the source
+ *
+ * Holds the hash of the name so it's only calculated once, and the result of
+ * the last resolution, which is reused as long as it's resolved from the same
+ * scope and no symbol with the same name was defined in that scope since.
+ *
+ * \see scope_ref_init(), scope_resolve()
+ */
+typedef struct scope_ref_s {
+    const char *        name;       /**< name, must outlive the reference */
+    uint32_t            hash;       /**< hash of \c name */
+    uint32_t            scope_id;   /**< ID of the scope \c symbol was
+                                         resolved from */
+    size_t              count;      /**< number of symbols of the scope
+                                         at resolution */
+    scope_symbol_t *    symbol;     /**< cached symbol or `NULL` */
+} scope_ref_t;
+
+
+void                scope_table_init(scope_table_t *table);
+void                scope_table_free(scope_table_t *table);
+
+scope_t *           scope_enter(scope_table_t *table,
+                                scope_kind_t kind,
+                                const char *name);
+bool                scope_leave(scope_table_t *table);
+
+scope_symbol_t *    scope_define(scope_table_t *table,
+                                 const char *name,
+                                 bool *added);
+scope_symbol_t *    scope_find_local(const scope_t *scope,
+                                     const char *name,
+                                     uint32_t hash);
+scope_symbol_t *    scope_lookup(const scope_table_t *table, const char *name);
+
+void                scope_ref_init(scope_ref_t *ref, const char *name);
+scope_symbol_t *    scope_resolve(scope_table_t *table, scope_ref_t *ref);
+
+#endif
@@ -29,17 +29,36 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdint.h>
 #include <ctype.h>
 #include <errno.h>
+#include <stdlib.h>
 
 #include "error.h"
 
 #include "strings.h"
 
 
+/** \brief  Character literal delimiter
+ */
+#define STR_CHAR_QUOTE  '\''
+
+
+/** \brief  Digit lookup table
+ *
+ * Value of each valid digit character plus one, 0 means not a digit. Valid
+ * for all bases up to 16, the caller checks the value against the base.
+ */
+static const uint8_t digit_table[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+    ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
+
+
 /** \brief  Determine if string could contain a numeric literal
  *
  * Check string \a s for a valid numeric literal character.
  *
- * Currently valid are 0-9, % and $.
+ * Currently valid are 0-9, %, $ and the character literal quote.
  *
  * \param[in]   s   string to check
  */
@@ -47,12 +66,165 @@ bool str_maybe_int_literal(const char *s)
 {
     return (*s == STR_PREFIX_BIN ||
             *s == STR_PREFIX_HEX ||
+            *s == STR_CHAR_QUOTE ||
             isdigit((int)(*s)))
         ? true : false;
 }
 
 
+/** \brief  Scan digits in \a base
+ *
+ * Keeps consuming digits after an overflow so the length covers the entire
+ * literal.
+ *
+ * \param[in]   s       string to scan
+ * \param[in]   base    number base (2, 10 or 16)
+ * \param[out]  len     number of digits consumed
+ * \param[out]  value   resulting value
+ *
+ * \return  `false` on overflow
+ */
+static bool scan_digits(const unsigned char *s,
+                        uint32_t base,
+                        size_t *len,
+                        int32_t *value)
+{
+    const uint32_t limit = (uint32_t)INT32_MAX / base;
+    const unsigned char *p = s;
+    uint32_t result = 0;
+    bool ok = true;
+
+    while (true) {
+        uint32_t digit = digit_table[*p];
+
+        if (digit == 0 || digit > base) {
+            break;
+        }
+        digit--;
+        if (result > limit || result * base > (uint32_t)INT32_MAX - digit) {
+            ok = false;
+        }
+        result = result * base + digit;
+        p++;
+    }
+    *len = (size_t)(p - s);
+    *value = (int32_t)(result & (uint32_t)INT32_MAX);
+    return ok;
+}
+
+
+/** \brief  Scan character literal
+ *
+ * Supports the escape sequences \\0, \\n, \\r, \\t, \\\\ and \\'.
+ *
+ * \param[in]   s       string to scan, starting at the opening quote
+ * \param[out]  len     number of characters consumed, including both quotes
+ * \param[out]  value   character code
+ *
+ * \return  `true` on success
+ */
+static bool scan_char(const unsigned char *s, size_t *len, int32_t *value)
+{
+    const unsigned char *p = s + 1;
+    unsigned char ch = *p++;
+
+    if (ch == STR_CHAR_QUOTE) {
+        base_errno = BASE_ERR_EMPTY;
+        return false;
+    }
+    if (ch == '\0') {
+        base_errno = BASE_ERR_SYNTAX;
+        return false;
+    }
+    if (ch == '\\') {
+        switch (*p++) {
+            case '0':   ch = '\0'; break;
+            case 'n':   ch = '\n'; break;
+            case 'r':   ch = '\r'; break;
+            case 't':   ch = '\t'; break;
+            case '\\':  ch = '\\'; break;
+            case '\'':  ch = '\''; break;
+            default:
+                base_errno = BASE_ERR_SYNTAX;
+                return false;
+        }
+    }
+    if (*p != STR_CHAR_QUOTE) {
+        base_errno = BASE_ERR_SYNTAX;
+        return false;
+    }
+    *len = (size_t)(p + 1 - s);
+    *value = ch;
+    return true;
+}
+
+
+/** \brief  Scan string for an integer literal
+ *
+ * Recognizes decimal literals, hexadecimal literals prefixed with
+ * #STR_PREFIX_HEX, binary literals prefixed with #STR_PREFIX_BIN and
+ * character literals in single quotes. Leading whitespace and signs are not
+ * accepted, those are handled by the expression parser.
+ *
+ * Unlike strtol() and friends this doesn't touch `errno`. On overflow \a len
+ * is still set to the length of the entire literal, so the caller can report
+ * the error and continue scanning after it.
+ *
+ * \param[in]   s       string to scan
+ * \param[out]  len     number of characters consumed, including the prefix
+ * \param[out]  value   resulting integer value
+ *
+ * \return  `true` on success
+ * \throw   BASE_ERR_EMPTY  no digits after the prefix, or empty character
+ *                          literal
+ * \throw   BASE_ERR_RANGE  value doesn't fit in an int32_t
+ * \throw   BASE_ERR_SYNTAX invalid character literal
+ */
+bool str_scan_int(const char *s, size_t *len, int32_t *value)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    uint32_t base = 10;
+    size_t prefix = 0;
+    size_t digits;
+
+    *len = 0;
+    switch (*p) {
+        case STR_PREFIX_HEX:
+            base = 16;
+            prefix = 1;
+            break;
+        case STR_PREFIX_BIN:
+            base = 2;
+            prefix = 1;
+            break;
+        case STR_CHAR_QUOTE:
+            return scan_char(p, len, value);
+        default:
+            break;
+    }
+
+    if (!scan_digits(p + prefix, base, &digits, value)) {
+        *len = prefix + digits;
+        base_errno = BASE_ERR_RANGE;
+        return false;
+    }
+    if (digits == 0) {
+        base_errno = BASE_ERR_EMPTY;
+        return false;
+    }
+    *len = prefix + digits;
+    return true;
+}
+
+
 /** \brief  Parse a string for an integer literal
+ *
+ * Wrapper around str_scan_int() for callers that want an end pointer.
+ *
+ * \note   Unlike the strtoll(3)-based implementation this replaced, leading
+ *          whitespace and a sign are not accepted: the literal must start at
+ *          \a nptr. Negative values are handled by the unary minus operator
+ *          of the expression parser.
  *
  * \param[in]   nptr    string to parse
  * \param[out]  endptr  pointer to first non-literal character (optional, use
@@ -63,36 +235,18 @@ bool str_maybe_int_literal(const char *s)
  * \throw   BASE_ERR_EMPTY  not a single valid character was encountered
  *                          (besides a possible prefix)
  * \throw   BASE_ERR_RANGE  result is out of range
+ * \throw   BASE_ERR_SYNTAX invalid character literal
  */
 bool str_parse_int(const char *nptr, char **endptr, int32_t *result)
 {
-    int base = 10;
-    long long res;
-
-    if (*nptr == STR_PREFIX_BIN) {
-        base = 2;
-        nptr++;
-    } else if (*nptr == STR_PREFIX_HEX) {
-        base = 16;
-        nptr++;
-    }
+    size_t len;
+    bool ok;
 
-    errno = 0;
-    res = strtoll(nptr, endptr, base);
-    if ((const char *)(*endptr) == nptr) {
-        base_errno = BASE_ERR_EMPTY;
-        return false;
-    }
-    if (errno == ERANGE) {
-        base_errno = BASE_ERR_RANGE;
-        return false;
+    ok = str_scan_int(nptr, &len, result);
+    if (endptr != NULL) {
+        *endptr = (char *)(uintptr_t)(nptr + len);
     }
-    if (res < INT32_MIN || res > INT32_MAX) {
-        base_errno = BASE_ERR_RANGE;
-        return false;
-    }
-    *result = (int32_t)res;
-    return true;
+    return ok;
 }
 
 
@@ -25,6 +25,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef BASE_STRINGS_H
 #define BASE_STRINGS_H
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -38,6 +39,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 
 bool str_maybe_int_literal(const char *s);
+bool str_scan_int(const char *s, size_t *len, int32_t *value);
 bool str_parse_int(const char *nptr, char **endptr, int32_t *value);
 bool str_parse_double(const char *nptr, char **endptr, double *result);
 char *str_find_closing_quote(char *s);
@@ -36,6 +36,57 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #define STRLIST_INITIAL_SIZE    4
 
+/** \brief  Initial size of the character blob of a string list
+ */
+#define STRLIST_INITIAL_BLOB    64
+
+
+/** \brief  Create string list storage
+ *
+ * \param[in]   items   number of items to allocate
+ * \param[in]   bytes   number of bytes to allocate for the strings
+ *
+ * \return  new storage with a reference count of 1
+ */
+static strlist_data_t *data_new(size_t items, size_t bytes)
+{
+    strlist_data_t *data = base_malloc(sizeof *data);
+
+    data->blob = base_malloc(bytes);
+    data->blob_size = bytes;
+    data->blob_used = 0;
+    data->offsets = base_malloc(items * sizeof *(data->offsets));
+    data->offsets_size = items;
+    data->items_used = 0;
+    data->sorted = true;
+    data->refcount = 1;
+    return data;
+}
+
+
+/** \brief  Give \a slist storage of its own before modifying it
+ *
+ * \param[in,out]   slist   string list
+ */
+static void unshare(strlist_t *slist)
+{
+    strlist_data_t *old = slist->data;
+    strlist_data_t *data;
+
+    if (old->refcount == 1) {
+        return;
+    }
+    base_debug("copying shared storage of %zu items.", old->items_used);
+    data = data_new(old->offsets_size, old->blob_size);
+    memcpy(data->blob, old->blob, old->blob_used);
+    memcpy(data->offsets, old->offsets, old->items_used * sizeof *(old->offsets));
+    data->blob_used = old->blob_used;
+    data->items_used = old->items_used;
+    data->sorted = old->sorted;
+    old->refcount--;
+    slist->data = data;
+}
+
 
 /** \brief  Create a string list
  *
@@ -44,13 +95,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 strlist_t *strlist_init(void)
 {
     strlist_t *slist = base_malloc(sizeof *slist);
-    slist->items = base_malloc(STRLIST_INITIAL_SIZE * sizeof *(slist->items));
-    slist->items_max = STRLIST_INITIAL_SIZE;
-    slist->items_used = 0;
 
-    for (size_t i = 0; i < STRLIST_INITIAL_SIZE; i++) {
-        slist->items[i] = NULL;
-    }
+    slist->data = data_new(STRLIST_INITIAL_SIZE, STRLIST_INITIAL_BLOB);
     return slist;
 }
 
@@ -61,10 +107,13 @@ strlist_t *strlist_init(void)
  */
 void strlist_free(strlist_t *slist)
 {
-    for (size_t i = 0; i < slist->items_used; i++) {
-        base_free(slist->items[i]);
+    strlist_data_t *data = slist->data;
+
+    if (--(data->refcount) == 0) {
+        base_free(data->blob);
+        base_free(data->offsets);
+        base_free(data);
     }
-    base_free(slist->items);
     base_free(slist);
 }
 
@@ -77,17 +126,22 @@ void strlist_free(strlist_t *slist)
  */
 size_t strlist_len(const strlist_t *slist)
 {
-    return slist->items_used;
+    return slist->data->items_used;
 }
 
 
 /** \brief  Add string \a s to string list \a slist
+ *
+ * Pointers returned by strlist_item() become invalid.
  *
  * \param[in,out]   slist   string list
  * \param[in]       s       string to add
  */
 void strlist_add(strlist_t *slist, const char *s)
 {
+    strlist_data_t *data;
+    size_t size;
+
     if (s == NULL) {
         base_debug("got NULL, ignoring.");
         return;
@@ -97,16 +151,33 @@ void strlist_add(strlist_t *slist, const char *s)
         return;
     }
 
-    if (slist->items_max == slist->items_used) {
-        slist->items_max *= 2;
+    unshare(slist);
+    data = slist->data;
+    if (data->offsets_size == data->items_used) {
+        data->offsets_size *= 2;
         base_debug("Resizing string list to %zu items",
-                slist->items_max);
-        slist->items = base_realloc(slist->items,
-                                    slist->items_max * sizeof *(slist->items));
+                data->offsets_size);
+        data->offsets = base_realloc(data->offsets,
+                                     data->offsets_size * sizeof *(data->offsets));
+    }
+    size = strlen(s) + 1u;
+    if (data->blob_size - data->blob_used < size) {
+        while (data->blob_size - data->blob_used < size) {
+            data->blob_size *= 2;
+        }
+        data->blob = base_realloc(data->blob, data->blob_size);
     }
     base_debug("adding item '%s' at index %zu.\n",
-            s, slist->items_used);
-    slist->items[slist->items_used++] = base_strdup(s);
+            s, data->items_used);
+
+    /* appending in order keeps the list sorted */
+    if (data->sorted && data->items_used > 0 &&
+            strcmp(data->blob + data->offsets[data->items_used - 1u], s) > 0) {
+        data->sorted = false;
+    }
+    memcpy(data->blob + data->blob_used, s, size);
+    data->offsets[data->items_used++] = data->blob_used;
+    data->blob_used += size;
 }
 
 
@@ -116,33 +187,34 @@ void strlist_add(strlist_t *slist, const char *s)
  */
 void strlist_dump(const strlist_t *slist)
 {
-    for (size_t i = 0; i < slist->items_used; i++) {
-        printf("[%zu] = '%s'\n", i, slist->items[i]);
+    for (size_t i = 0; i < slist->data->items_used; i++) {
+        printf("[%zu] = '%s'\n", i, strlist_item(slist, i));
     }
 }
 
 
-/** \brief  Create a deep copy of \a slist
+/** \brief  Create a copy of \a slist
+ *
+ * The copy shares the storage of \a slist until either list is modified, so
+ * this is O(1).
  *
  * \param[in]   slist   string list
  *
- * \return  heap-allocated deep copy of \a slist
+ * \return  heap-allocated copy of \a slist
  */
 strlist_t *strlist_dup(const strlist_t *slist)
 {
     strlist_t *newlist = base_malloc(sizeof *newlist);
-    newlist->items = base_malloc(slist->items_max * sizeof *(newlist->items));
-    newlist->items_max = slist->items_max;
-    newlist->items_used = slist->items_used;
 
-    for (size_t i = 0; i < newlist->items_used; i++) {
-        newlist->items[i] = base_strdup(slist->items[i]);
-    }
+    newlist->data = slist->data;
+    newlist->data->refcount++;
     return newlist;
 }
 
 
 /** \brief  Get item in strlist by index
+ *
+ * The item is valid until \a slist is modified or freed.
  *
  * \param[in]   slist   string list
  * \param[in]   index   index in \a slist
@@ -151,9 +223,124 @@ strlist_t *strlist_dup(const strlist_t *slist)
  */
 const char *strlist_item(const strlist_t *slist, size_t index)
 {
-    if (index >= slist->items_used) {
+    const strlist_data_t *data = slist->data;
+
+    if (index >= data->items_used) {
         return NULL;
     }
-    return slist->items[index];
+    return data->blob + data->offsets[index];
 }
 
+
+/** \brief  Move offset at \a root down the heap until it's in place
+ *
+ * \param[in]       blob    strings
+ * \param[in,out]   offsets heap of offsets
+ * \param[in]       root    index of offset to move
+ * \param[in]       count   number of offsets in the heap
+ */
+static void sift_down(const char *blob, size_t *offsets, size_t root, size_t count)
+{
+    size_t value = offsets[root];
+
+    while (root * 2u + 1u < count) {
+        size_t child = root * 2u + 1u;
+
+        if (child + 1u < count &&
+                strcmp(blob + offsets[child], blob + offsets[child + 1u]) < 0) {
+            child++;
+        }
+        if (strcmp(blob + value, blob + offsets[child]) >= 0) {
+            break;
+        }
+        offsets[root] = offsets[child];
+        root = child;
+    }
+    offsets[root] = value;
+}
+
+
+/** \brief  Sort items of \a slist in strcmp() order
+ *
+ * Sorts the offsets in place with heapsort, the strings aren't moved. Sorting
+ * enables binary search in strlist_find().
+ *
+ * \param[in,out]   slist   string list
+ */
+void strlist_sort(strlist_t *slist)
+{
+    strlist_data_t *data;
+    size_t count;
+
+    if (slist->data->sorted) {
+        return;
+    }
+    unshare(slist);
+    data = slist->data;
+    count = data->items_used;
+
+    for (size_t i = count / 2u; i > 0; i--) {
+        sift_down(data->blob, data->offsets, i - 1u, count);
+    }
+    while (count > 1u) {
+        size_t tmp = data->offsets[0];
+
+        count--;
+        data->offsets[0] = data->offsets[count];
+        data->offsets[count] = tmp;
+        sift_down(data->blob, data->offsets, 0, count);
+    }
+    data->sorted = true;
+}
+
+
+/** \brief  Find string \a s in \a slist
+ *
+ * Uses binary search when the list is sorted, either by strlist_sort() or by
+ * adding items in order, or a linear search otherwise.
+ *
+ * \param[in]   slist   string list
+ * \param[in]   s       string to find
+ * \param[out]  index   index of \a s in \a slist (optional)
+ *
+ * \return  `true` if found
+ */
+bool strlist_find(const strlist_t *slist, const char *s, size_t *index)
+{
+    const strlist_data_t *data = slist->data;
+
+    if (s == NULL) {
+        return false;
+    }
+    if (data->sorted) {
+        size_t low = 0;
+        size_t high = data->items_used;
+
+        while (low < high) {
+            size_t mid = low + (high - low) / 2u;
+            int cmp = strcmp(data->blob + data->offsets[mid], s);
+
+            if (cmp == 0) {
+                if (index != NULL) {
+                    *index = mid;
+                }
+                return true;
+            } else if (cmp < 0) {
+                low = mid + 1u;
+            } else {
+                high = mid;
+            }
+        }
+        return false;
+    }
+
+    for (size_t i = 0; i < data->items_used; i++) {
+        if (strcmp(data->blob + data->offsets[i], s) == 0) {
+            if (index != NULL) {
+                *index = i;
+            }
+            return true;
+        }
+    }
+    return false;
+}
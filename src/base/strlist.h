@@ -26,14 +26,31 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define BASE_STRLIST_H
 
 #include <stdlib.h>
+#include <stdbool.h>
+
+
+/** \brief  String list storage, shared between copies of a list
+ */
+typedef struct strlist_data_s {
+    char *      blob;           /**< strings, NUL-terminated, back to back */
+    size_t      blob_size;      /**< number of bytes allocated for \c blob */
+    size_t      blob_used;      /**< number of bytes used in \c blob */
+    size_t *    offsets;        /**< offset in \c blob of each item */
+    size_t      offsets_size;   /**< number of elements allocated for
+                                     \c offsets */
+    size_t      items_used;     /**< number of items */
+    bool        sorted;         /**< items are in strcmp() order */
+    size_t      refcount;       /**< number of lists sharing the data */
+} strlist_data_t;
 
 
 /** \brief  String list handle
+ *
+ * Copies made with strlist_dup() share their storage until one of them is
+ * modified (copy-on-write). Sharing isn't thread-safe.
  */
 typedef struct strlist_s {
-    char **items;       /**< list of strings */
-    size_t items_max;   /**< size of the list */
-    size_t items_used;  /**< number of items used in the list */
+    strlist_data_t *data;   /**< storage */
 } strlist_t;
 
 
@@ -44,5 +61,7 @@ size_t      strlist_len(const strlist_t *slist);
 void        strlist_add(strlist_t *slist, const char *s);
 void        strlist_dump(const strlist_t *slist);
 const char *strlist_item(const strlist_t *slist, size_t index);
+void        strlist_sort(strlist_t *slist);
+bool        strlist_find(const strlist_t *slist, const char *s, size_t *index);
 
 #endif
@@ -1,5 +1,22 @@
 /** \file   strpool.c
- * \brief   Module to reuse heap-allocated strings
+ * \brief   String interning
+ *
+ * Stores a single copy of every distinct string and hands out a 32-bit ID for
+ * it, so strings can be compared by comparing their IDs. IDs and the text
+ * pointers returned by strpool_text() stay valid until strpool_free().
+ *
+ * The text of the strings is stored back to back in the chunks of an arena,
+ * the IDs index blocks of entries with the location, length and hash of each
+ * string and a hash set of IDs finds the ID of a string. The hashes are the
+ * same as returned by dict_hash_key(), so they can be passed to the
+ * dict_*_hashed() functions.
+ *
+ * The pool is a single global object, shared by all threads. The hash set is
+ * protected by a read/write lock, and each thread has a small cache of recently
+ * interned strings in front of it, so repeated lookups of the same names don't
+ * touch the lock. Entries never move once added, so strpool_text(),
+ * strpool_len() and strpool_hash() don't lock at all. strpool_init() and
+ * strpool_free() must not be called while other threads use the pool.
  */
 
 /*
@@ -21,148 +38,503 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
-#include <assert.h>
+/* for pthread_rwlock_t */
+#define _POSIX_C_SOURCE 200809L
 
-#include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "debug.h"
+#include "dict.h"
 #include "error.h"
+#include "helpers.h"
 #include "mem.h"
-#include "objpool.h"
 
 #include "strpool.h"
 
-/* Forward declarations of methods
+
+/** \brief  Initial number of slots in the hash set
+ */
+#define STRPOOL_INIT_SLOTS      1024u
+
+/** \brief  Number of bits of an ID selecting the entry in a block
+ */
+#define STRPOOL_BLOCK_BITS      12u
+
+/** \brief  Number of entries in a block
  */
-static void *   strpool_obj_alloc(void *param);
-static void *   strpool_obj_reuse(void *obj, void *param);
-static void     strpool_obj_free(void *obj);
-static size_t   strpool_obj_size(void *obj);
+#define STRPOOL_BLOCK_SIZE      (1u << STRPOOL_BLOCK_BITS)
+
+/** \brief  Maximum number of blocks
+ *
+ * Limits the pool to 16M strings, minus #STRPOOL_NONE.
+ */
+#define STRPOOL_BLOCKS_MAX      4096u
+
+/** \brief  Size of the arena chunks holding the text
+ */
+#define STRPOOL_CHUNK_SIZE      65536u
+
+/** \brief  Number of entries in the per-thread cache (power of two)
+ */
+#define STRPOOL_CACHE_SIZE      256u
+
+
+/** \brief  Interned string
+ */
+typedef struct strpool_entry_s {
+    const char *    text;   /**< NUL-terminated text */
+    uint32_t        len;    /**< length of \c text */
+    uint32_t        hash;   /**< hash of \c text */
+} strpool_entry_t;
+
 
+/** \brief  Per-thread cache of interned strings
+ *
+ * Direct-mapped on the hash of the string.
+ */
+typedef struct strpool_cache_s {
+    unsigned int    generation;                 /**< pool generation the
+                                                     cache is valid for */
+    uint32_t        ids[STRPOOL_CACHE_SIZE];    /**< cached IDs */
+} strpool_cache_t;
+
+
+/** \brief  Lock protecting the hash set, the arena and adding entries
+ */
+static pthread_rwlock_t pool_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/** \brief  Text of all strings
+ */
+static base_arena_t pool_text;
+
+/** \brief  Blocks of strings, indexed by ID (entry 0 is unused)
+ */
+static strpool_entry_t *pool_blocks[STRPOOL_BLOCKS_MAX];
+
+/** \brief  Number of entries used, including entry 0
+ */
+static size_t pool_entries_used = 0;
+
+/** \brief  Hash set: string IDs, #STRPOOL_NONE for an empty slot
+ */
+static uint32_t *pool_slots = NULL;
+
+/** \brief  Number of slots in \c pool_slots (power of two)
+ */
+static size_t pool_slots_size = 0;
+
+/** \brief  Generation of the pool, incremented by strpool_init()
+ *
+ * Invalidates the per-thread caches filled with IDs of a previous pool.
+ */
+static unsigned int pool_generation = 0;
 
-/** \brief  Data of the string pool
+/** \brief  Cache of the current thread
  */
-static objpool_t strpool_data = {
-    NULL, 8, 0,
-    NULL, 4, 0,
-    strpool_obj_alloc,
-    strpool_obj_reuse,
-    strpool_obj_free,
-    strpool_obj_size,
-    0, 0, 0, 0
-};
+static BASE_THREAD_LOCAL strpool_cache_t thread_cache;
 
 
-/** \brief  Allocate string object
+/** \brief  Get entry of \a id
  *
- * \param[in]   param   initial string (const char *)
+ * \param[in]   id  string ID
  *
- * \return  object
+ * \return  entry
  */
-static void *strpool_obj_alloc(void *param)
+static inline strpool_entry_t *get_entry(uint32_t id)
 {
-    strpool_obj_t *obj;
-    size_t len;
-    size_t size;
+    return &pool_blocks[id >> STRPOOL_BLOCK_BITS][id & (STRPOOL_BLOCK_SIZE - 1u)];
+}
+
+
+/** \brief  Check if string \a id is \a text
+ *
+ * \param[in]   id      string ID
+ * \param[in]   text    text
+ * \param[in]   len     length of \a text
+ * \param[in]   hash    hash of \a text
+ *
+ * \return  `true` if equal
+ */
+static bool entry_equals(uint32_t id,
+                         const char *text,
+                         size_t len,
+                         uint32_t hash)
+{
+    const strpool_entry_t *entry = get_entry(id);
+
+    return entry->hash == hash && entry->len == len &&
+           memcmp(entry->text, text, len) == 0;
+}
 
-    len = strlen((const char *)param);
-    size = base_nextpow2(len + 1);
 
-    base_debug("strlen = %zu, allocated = %zu\n", len, size);
+/** \brief  Find slot for \a text
+ *
+ * Must be called with the lock held.
+ *
+ * \param[in]   text    text
+ * \param[in]   len     length of \a text
+ * \param[in]   hash    hash of \a text
+ *
+ * \return  index of the slot holding the ID of \a text, or of the empty slot
+ *          where it would go
+ */
+static size_t find_slot(const char *text, size_t len, uint32_t hash)
+{
+    size_t mask = pool_slots_size - 1u;
+    size_t index = hash & mask;
 
-    obj = base_malloc(sizeof *obj);
-    obj->text = base_malloc(size);
-    memcpy(obj->text, param, len + 1);
-    obj->len = len;
-    obj->size = size;
-    return obj;
+    while (pool_slots[index] != STRPOOL_NONE &&
+            !entry_equals(pool_slots[index], text, len, hash)) {
+        index = (index + 1u) & mask;
+    }
+    return index;
 }
 
 
-/** \brief  Free \a obj and its members
+/** \brief  Double the size of the hash set
  *
- * \param[in,out]   obj strpool object
+ * Must be called with the write lock held.
  */
-static void strpool_obj_free(void *obj)
+static void grow_slots(void)
 {
-    strpool_obj_t *s = obj;
+    size_t size = pool_slots_size * 2u;
+    size_t mask = size - 1u;
+
+    base_free(pool_slots);
+    pool_slots = base_calloc(size, sizeof *pool_slots);
+    pool_slots_size = size;
+
+    for (size_t id = 1; id < pool_entries_used; id++) {
+        size_t index = get_entry((uint32_t)id)->hash & mask;
 
-    if (obj == NULL) {
-        fprintf(stderr, "%s:%d:%s*(): got NULL ?\n",
-                __FILE__, __LINE__, __func__);
-    } else {
-        if (s->text != NULL) {
-            base_free(s->text);
+        while (pool_slots[index] != STRPOOL_NONE) {
+            index = (index + 1u) & mask;
         }
-        base_free(s);
+        pool_slots[index] = (uint32_t)id;
     }
 }
 
 
-/** \brief  Reuse \a obj
+/** \brief  Look up \a text in the cache of the current thread
+ *
+ * \param[in]   text    text
+ * \param[in]   len     length of \a text
+ * \param[in]   hash    hash of \a text
+ *
+ * \return  ID or #STRPOOL_NONE if not cached
+ */
+static uint32_t cache_find(const char *text, size_t len, uint32_t hash)
+{
+    strpool_cache_t *cache = &thread_cache;
+    uint32_t id;
+
+    if (cache->generation != pool_generation) {
+        memset(cache->ids, 0, sizeof cache->ids);
+        cache->generation = pool_generation;
+        return STRPOOL_NONE;
+    }
+    id = cache->ids[hash & (STRPOOL_CACHE_SIZE - 1u)];
+    if (id != STRPOOL_NONE && entry_equals(id, text, len, hash)) {
+        return id;
+    }
+    return STRPOOL_NONE;
+}
+
+
+/** \brief  Store \a id in the cache of the current thread
+ *
+ * \param[in]   id      string ID
+ * \param[in]   hash    hash of the string
+ */
+static void cache_store(uint32_t id, uint32_t hash)
+{
+    thread_cache.ids[hash & (STRPOOL_CACHE_SIZE - 1u)] = id;
+}
+
+
+/** \brief  Initialize the string pool
+ */
+void strpool_init(void)
+{
+    base_arena_init(&pool_text, STRPOOL_CHUNK_SIZE);
+    pool_blocks[0] = base_malloc(STRPOOL_BLOCK_SIZE * sizeof *pool_blocks[0]);
+    pool_entries_used = 1;  /* ID 0 is STRPOOL_NONE */
+    pool_slots_size = STRPOOL_INIT_SLOTS;
+    pool_slots = base_calloc(pool_slots_size, sizeof *pool_slots);
+    pool_generation++;
+}
+
+
+/** \brief  Free the string pool
  *
- * Copy string \a param into \a obj, updating len.
+ * All IDs and text pointers handed out become invalid.
+ */
+void strpool_free(void)
+{
+    base_arena_free(&pool_text);
+    for (size_t b = 0; b < STRPOOL_BLOCKS_MAX && pool_blocks[b] != NULL; b++) {
+        base_free(pool_blocks[b]);
+        pool_blocks[b] = NULL;
+    }
+    base_free(pool_slots);
+    pool_slots = NULL;
+    pool_entries_used = 0;
+    pool_slots_size = 0;
+    pool_generation++;
+}
+
+
+/** \brief  Add \a text to the pool
  *
- * This only works if \a param fits in the already allocated data in \a obj,
- * which it should as long as \c obj_size() function works properly when
- * requesting a new string.
+ * Must be called with the write lock held.
  *
- * \param[in,out]   obj     strpool object
- * \param[in]       param   new string for the object
+ * \param[in]   text    text
+ * \param[in]   len     length of \a text
+ * \param[in]   hash    hash of \a text
  *
- * \return  pointer to object
+ * \return  ID of the string, or #STRPOOL_NONE when the pool is full
+ * \throw   BASE_ERR_INVALID_SIZE   pool is full
  */
-static void *strpool_obj_reuse(void *obj, void *param)
+static uint32_t add_string(const char *text, size_t len, uint32_t hash)
 {
-    strpool_obj_t *s = obj;
-    size_t len = strlen(param);
+    strpool_entry_t *entry;
+    uint32_t id;
+    size_t slot = find_slot(text, len, hash);
+
+    /* added by another thread between dropping the read lock and taking the
+     * write lock? */
+    if (pool_slots[slot] != STRPOOL_NONE) {
+        return pool_slots[slot];
+    }
+
+    if (pool_entries_used == (size_t)STRPOOL_BLOCKS_MAX * STRPOOL_BLOCK_SIZE) {
+        base_errno = BASE_ERR_INVALID_SIZE;
+        return STRPOOL_NONE;
+    }
+    /* keep the load factor at or below 1/2 */
+    if (pool_entries_used * 2u > pool_slots_size) {
+        grow_slots();
+        slot = find_slot(text, len, hash);
+    }
 
-    s->len = len;
-    memcpy(s->text, param, len + 1);
-    return s;
+    id = (uint32_t)pool_entries_used;
+    if ((id & (STRPOOL_BLOCK_SIZE - 1u)) == 0) {
+        pool_blocks[id >> STRPOOL_BLOCK_BITS] =
+            base_malloc(STRPOOL_BLOCK_SIZE * sizeof *pool_blocks[0]);
+    }
+    entry = get_entry(id);
+    entry->text = base_arena_strndup(&pool_text, text, len);
+    entry->len = (uint32_t)len;
+    entry->hash = hash;
+    pool_slots[slot] = id;
+    pool_entries_used++;
+    return id;
 }
 
 
-static size_t strpool_obj_size(void *obj)
+/** \brief  Intern \a len characters of \a text
+ *
+ * \a text doesn't need to be NUL-terminated, which allows interning
+ * identifiers straight from a source line.
+ *
+ * \param[in]   text    text
+ * \param[in]   len     number of characters of \a text
+ *
+ * \return  ID of the string, or #STRPOOL_NONE on error
+ * \throw   BASE_ERR_NULL           \a text is `NULL`
+ * \throw   BASE_ERR_INVALID_SIZE   \a len doesn't fit in 32 bits or the pool
+ *                                  is full
+ */
+uint32_t strpool_intern_len(const char *text, size_t len)
 {
-    return ((strpool_obj_t *)obj)->size;
+    uint32_t hash;
+    uint32_t id;
+
+    if (text == NULL) {
+        base_errno = BASE_ERR_NULL;
+        return STRPOOL_NONE;
+    }
+    if (len > UINT32_MAX - 1u) {
+        base_errno = BASE_ERR_INVALID_SIZE;
+        return STRPOOL_NONE;
+    }
+
+    hash = dict_hash_bytes(text, len);
+    id = cache_find(text, len, hash);
+    if (id != STRPOOL_NONE) {
+        return id;
+    }
+
+    pthread_rwlock_rdlock(&pool_lock);
+    id = pool_slots[find_slot(text, len, hash)];
+    pthread_rwlock_unlock(&pool_lock);
+
+    if (id == STRPOOL_NONE) {
+        pthread_rwlock_wrlock(&pool_lock);
+        id = add_string(text, len, hash);
+        pthread_rwlock_unlock(&pool_lock);
+        if (id == STRPOOL_NONE) {
+            return STRPOOL_NONE;
+        }
+    }
+    cache_store(id, hash);
+    return id;
 }
 
 
-void strpool_init(void)
+/** \brief  Intern \a text
+ *
+ * \param[in]   text    text
+ *
+ * \return  ID of the string, or #STRPOOL_NONE on error
+ * \throw   BASE_ERR_NULL   \a text is `NULL`
+ */
+uint32_t strpool_intern(const char *text)
 {
-    objpool_init(&strpool_data);
+    if (text == NULL) {
+        base_errno = BASE_ERR_NULL;
+        return STRPOOL_NONE;
+    }
+    return strpool_intern_len(text, strlen(text));
 }
 
 
+/** \brief  Get ID of \a text without interning it
+ *
+ * \param[in]   text    text
+ *
+ * \return  ID of the string, or #STRPOOL_NONE if it isn't interned
+ */
+uint32_t strpool_find(const char *text)
+{
+    size_t len;
+    uint32_t hash;
+    uint32_t id;
 
-void strpool_free(void)
+    if (text == NULL) {
+        return STRPOOL_NONE;
+    }
+    len = strlen(text);
+    hash = dict_hash_bytes(text, len);
+    id = cache_find(text, len, hash);
+    if (id == STRPOOL_NONE) {
+        pthread_rwlock_rdlock(&pool_lock);
+        id = pool_slots[find_slot(text, len, hash)];
+        pthread_rwlock_unlock(&pool_lock);
+        if (id != STRPOOL_NONE) {
+            cache_store(id, hash);
+        }
+    }
+    return id;
+}
+
+
+/** \brief  Get number of strings in the pool
+ *
+ * \return  number of strings
+ */
+size_t strpool_count(void)
 {
-    objpool_free(&strpool_data);
+    size_t count;
+
+    pthread_rwlock_rdlock(&pool_lock);
+    count = pool_entries_used > 0 ? pool_entries_used - 1u : 0;
+    pthread_rwlock_unlock(&pool_lock);
+    return count;
 }
 
 
-void *strpool_add(char *text)
+/** \brief  Check ID for validity
+ *
+ * Only rejects #STRPOOL_NONE: checking against the number of strings would
+ * require the lock. Any other ID must have been returned by the pool.
+ *
+ * \param[in]   id  string ID
+ *
+ * \return  `true` if valid
+ * \throw   BASE_ERR_INDEX  \a id is invalid
+ */
+static bool valid_id(uint32_t id)
 {
-    void *obj;
-    size_t len = strlen(text);
+    if (id == STRPOOL_NONE) {
+        base_errno = BASE_ERR_INDEX;
+        return false;
+    }
+    return true;
+}
 
-    obj = objpool_request(&strpool_data, len + 1, text);
-    return obj;
+
+/** \brief  Get text of string
+ *
+ * \param[in]   id  string ID
+ *
+ * \return  text or `NULL` on error
+ * \throw   BASE_ERR_INDEX  \a id is #STRPOOL_NONE
+ */
+const char *strpool_text(uint32_t id)
+{
+    return valid_id(id) ? get_entry(id)->text : NULL;
 }
 
 
-void strpool_del(void *obj)
+/** \brief  Get length of string
+ *
+ * \param[in]   id  string ID
+ *
+ * \return  length, 0 on error
+ * \throw   BASE_ERR_INDEX  \a id is #STRPOOL_NONE
+ */
+size_t strpool_len(uint32_t id)
 {
-    objpool_release(&strpool_data, obj);
+    return valid_id(id) ? get_entry(id)->len : 0;
 }
 
 
+/** \brief  Get hash of string
+ *
+ * \param[in]   id  string ID
+ *
+ * \return  hash as returned by dict_hash_key(), 0 on error
+ * \throw   BASE_ERR_INDEX  \a id is #STRPOOL_NONE
+ */
+uint32_t strpool_hash(uint32_t id)
+{
+    return valid_id(id) ? get_entry(id)->hash : 0;
+}
+
 
+/** \brief  Debug hook: dump statistics of the pool on stdout
+ *
+ * The probe lengths are computed by walking the hash set.
+ */
 void strpool_dump_stats(void)
 {
-    objpool_dump_stats(&strpool_data);
+    size_t bytes = 0;
+    size_t probes = 0;
+    size_t count;
+    size_t mask;
+
+    pthread_rwlock_rdlock(&pool_lock);
+    count = pool_entries_used > 0 ? pool_entries_used - 1u : 0;
+    mask = pool_slots_size - 1u;
+    for (size_t slot = 0; slot < pool_slots_size; slot++) {
+        if (pool_slots[slot] != STRPOOL_NONE) {
+            const strpool_entry_t *entry = get_entry(pool_slots[slot]);
+
+            bytes += entry->len + 1u;
+            probes += ((slot - (entry->hash & mask)) & mask) + 1u;
+        }
+    }
+    printf("strings     : %zu\n", count);
+    printf("text bytes  : %zu\n", bytes);
+    printf("slots       : %zu (load factor %.3f)\n",
+           pool_slots_size,
+           pool_slots_size > 0 ? (double)count / (double)pool_slots_size : 0.0);
+    printf("avg probes  : %.3f\n",
+           count > 0 ? (double)probes / (double)count : 0.0);
+    pthread_rwlock_unlock(&pool_lock);
 }
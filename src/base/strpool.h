@@ -1,5 +1,5 @@
 /** \file   strpool.h
- * \brief   Module to reuse heap-allocated strings - header
+ * \brief   String interning - header
  */
 
 /*
@@ -24,27 +24,26 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef BASE_STRPOOL_H
 #define BASE_STRPOOL_H
 
-#include "objpool.h"
+#include <stddef.h>
+#include <stdint.h>
 
 
-/** \brief  String pool object
- *
- * The memory allocated for \c text will be increased to the next power of two
- * when len+1 isn't a power of two.
+/** \brief  ID that is never handed out, used to indicate errors
  */
-typedef struct strpool_obj_s {
-    OBJ_POOL_OBJ_BASE
-    char *  text;   /**< text */
-    size_t  size;   /**< number of bytes allocated text */
-    size_t  len;    /**< actual string length of text */
-} strpool_obj_t;
+#define STRPOOL_NONE    0u
 
-void strpool_init(void);
-void strpool_free(void);
-void strpool_dump_stats(void);
 
-void *strpool_add(char *text);
-void strpool_del(void *obj);
+void        strpool_init(void);
+void        strpool_free(void);
+void        strpool_dump_stats(void);
 
+uint32_t    strpool_intern(const char *text);
+uint32_t    strpool_intern_len(const char *text, size_t len);
+uint32_t    strpool_find(const char *text);
+size_t      strpool_count(void);
+
+const char *strpool_text(uint32_t id);
+size_t      strpool_len(uint32_t id);
+uint32_t    strpool_hash(uint32_t id);
 
 #endif
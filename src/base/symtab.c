@@ -1,7 +1,16 @@
 /** \file   symtab.c
  * \brief   Symbol table implementation
  *
- * Simple recursive binary tree implementation.
+ * Symbols are found through a hash index on their names, so lookups take
+ * constant time on average regardless of the order in which symbols were
+ * added. There's no recursion anywhere, not even when freeing nested tables,
+ * so tables with hundreds of thousands of symbols or deeply nested tables are
+ * fine.
+ *
+ * Names are interned in the string pool, so a name is stored once no matter
+ * how many tables use it, and the index compares string pool IDs instead of
+ * text. The pool must be initialized with strpool_init() before a table is
+ * used and may only be freed after all tables have been freed.
  */
 
 /*
@@ -25,146 +34,333 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
-#include <assert.h>
-#include "debug.h"
 
+#include "debug.h"
+#include "error.h"
 #include "mem.h"
+#include "strpool.h"
 
 #include "symtab.h"
 
 
+/** \brief  Initial number of elements of the symbols array
+ */
+#define SYMBOLS_INIT_SIZE   64u
 
-/** \brief  Allocate and initialize a symbol table node
- *
- * Allocates a symtab_node_t instance on the heap initializes all fields to
- * `NULL`, copies \a name.
+/** \brief  Initial number of elements of the stack used by symtab_free()
+ */
+#define STACK_INIT_SIZE     16u
+
+/** \brief  Initial number of slots of the hash index (power of two)
+ */
+#define SLOTS_INIT_SIZE     128u
+
+/** \brief  Size of the arena chunks holding symbols
+ */
+#define SYMTAB_CHUNK_SIZE   16384u
+
+
+/** \brief  Compare symbols by name for qsort()
  *
- * \param[in]   name    symbol name
+ * \param[in]   p1  pointer to symbol pointer
+ * \param[in]   p2  pointer to symbol pointer
  *
- * \return  symbol table node
+ * \return  \<0, 0 or \>0
  */
-static symtab_node_t *symtab_node_alloc(const char *name)
+static int compare_symbols(const void *p1, const void *p2)
 {
-    symtab_node_t *node;
-
-    assert(name != NULL && *name != '\0');
-
-    node = base_malloc(sizeof *node);
-    node->parent = NULL;
-    node->left = NULL;
-    node->right = NULL;
-    node->object = NULL;
-    node->name = base_strdup(name);
-    node->type = SYM_ILL;
-    return node;
+    const symtab_symbol_t *s1 = *(symtab_symbol_t * const *)p1;
+    const symtab_symbol_t *s2 = *(symtab_symbol_t * const *)p2;
+
+    return strcmp(s1->name, s2->name);
 }
 
 
-/** \brief  Free node and all of its children, including child symbol tables
+/** \brief  Find slot of the symbol with string pool ID \a id
  *
- * \param[in]   node    symbol table node
+ * \param[in]   table   symbol table
+ * \param[in]   id      string pool ID of the name
+ * \param[in]   hash    hash of the name
+ *
+ * \return  index of the slot holding the symbol, or of the empty slot
+ *          where it would be inserted
  */
-void symtab_node_free(symtab_node_t *node)
+static size_t find_slot(const symtab_t *table, uint32_t id, uint32_t hash)
 {
-    if (node == NULL) {
-        return;
-    }
-    if (node->left != NULL) {
-        symtab_node_free(node->left);
-    }
-    if (node->right != NULL) {
-        symtab_node_free(node->right);
+    size_t mask = table->slots_size - 1u;
+    size_t slot = hash & mask;
+
+    while (table->slots[slot] != NULL && table->slots[slot]->id != id) {
+        slot = (slot + 1u) & mask;
     }
-    if (node->type == SYM_SYMTAB) {
-        symtab_node_free(node->object);
+    return slot;
+}
+
+
+/** \brief  Double the number of slots of the hash index
+ *
+ * \param[in,out]   table   symbol table
+ */
+static void grow_slots(symtab_t *table)
+{
+    base_free(table->slots);
+    table->slots_size *= 2u;
+    table->slots = base_calloc(table->slots_size, sizeof *(table->slots));
+    for (size_t i = 0; i < table->count; i++) {
+        symtab_symbol_t *symbol = table->symbols[i];
+
+        table->slots[find_slot(table, symbol->id, symbol->hash)] = symbol;
     }
-    base_free(node->name);
-    base_free(node);
 }
 
 
-/** \brief  Add node with \a name to tree \a node
+/** \brief  Initialize symbol table
  *
- * \param[in,out]   node    node to add add node with \a name to
- * \param[in]       name    node name
+ * \param[out]  table   symbol table
+ */
+void symtab_init(symtab_t *table)
+{
+    table->slots_size = SLOTS_INIT_SIZE;
+    table->slots = base_calloc(table->slots_size, sizeof *(table->slots));
+    base_arena_init(&table->arena, SYMTAB_CHUNK_SIZE);
+    table->symbols_size = SYMBOLS_INIT_SIZE;
+    table->symbols = base_malloc(table->symbols_size * sizeof *(table->symbols));
+    table->count = 0;
+    table->sorted = NULL;
+    table->sorted_count = 0;
+}
+
+
+/** \brief  Free the members of \a table, but not its child tables
  *
- * \return  pointer to new node or `NULL` on error
+ * \param[in,out]   table   symbol table
  */
-symtab_node_t *symtab_node_add(symtab_node_t *node, const char *name)
+static void table_release(symtab_t *table)
 {
-    int d;
-
-    if (node == NULL) {
-        node = symtab_node_alloc(name);
-    } else {
-        d = strcmp(name, node->name);
-        if (d == 0) {
-            abort();
+    base_free(table->slots);
+    base_arena_free(&table->arena);
+    base_free(table->symbols);
+    base_free(table->sorted);
+    table->slots = NULL;
+    table->slots_size = 0;
+    table->symbols = NULL;
+    table->sorted = NULL;
+    table->count = 0;
+    table->sorted_count = 0;
+}
+
+
+/** \brief  Free all symbols in symbol table
+ *
+ * Child symbol tables (symbols of type \c SYM_SYMTAB) are freed as well,
+ * using a stack of tables still to free instead of recursion. The table can
+ * be reused after calling symtab_init() again.
+ *
+ * \param[in,out]   table   symbol table
+ */
+void symtab_free(symtab_t *table)
+{
+    size_t stack_size = STACK_INIT_SIZE;
+    size_t stack_used = 0;
+    symtab_t **stack = base_malloc(stack_size * sizeof *stack);
+
+    stack[stack_used++] = table;
+    while (stack_used > 0) {
+        symtab_t *current = stack[--stack_used];
+
+        for (size_t i = 0; i < current->count; i++) {
+            symtab_symbol_t *symbol = current->symbols[i];
+
+            if (symbol->type == SYM_SYMTAB && symbol->object != NULL) {
+                if (stack_used == stack_size) {
+                    stack_size *= 2u;
+                    stack = base_realloc(stack, stack_size * sizeof *stack);
+                }
+                stack[stack_used++] = symbol->object;
+            }
         }
-        if (d < 0) {
-            /* base_debug("new('%s') < root('%s')\n", name, node->name); */
-            node->left = symtab_node_add(node->left, name);
-            node->parent = node->left;
-        } else {
-            /* base_debug("new('%s') > root('%s')\n", name, node->name); */
-            node->right = symtab_node_add(node->right, name);
-            node->parent = node->right;
+        table_release(current);
+        /* child tables are heap-allocated, \a table is owned by the caller */
+        if (current != table) {
+            base_free(current);
         }
     }
-    return node;
+    base_free(stack);
 }
 
 
-/** \brief  Dump node names in order
+/** \brief  Add symbol to symbol table, or find it if it already exists
  *
- * \param[in]   node    starting node
+ * A new symbol has type \c SYM_ILL and a `NULL` object, to be filled in by
+ * the caller.
+ *
+ * \param[in,out]   table   symbol table
+ * \param[in]       name    symbol name
+ * \param[out]      added   set to `true` if the symbol was added, `false`
+ *                          if it already existed (optional)
+ *
+ * \return  symbol or `NULL` on error
+ * \throw   BASE_ERR_KEY            \a name is `NULL` or empty
+ * \throw   BASE_ERR_INVALID_SIZE   the string pool is full
  */
-void symtab_node_dump(symtab_node_t *node)
+symtab_symbol_t *symtab_add(symtab_t *table, const char *name, bool *added)
 {
-    if (node != NULL) {
-        symtab_node_dump(node->left);
-        printf("%s\n", node->name);
-        symtab_node_dump(node->right);
+    symtab_symbol_t *symbol;
+    uint32_t id;
+    uint32_t hash;
+    size_t slot;
+
+    if (added != NULL) {
+        *added = false;
+    }
+    if (name == NULL || *name == '\0') {
+        base_errno = BASE_ERR_KEY;
+        return NULL;
     }
-}
 
+    id = strpool_intern(name);
+    if (id == STRPOOL_NONE) {
+        return NULL;
+    }
+    hash = strpool_hash(id);
+    slot = find_slot(table, id, hash);
+    if (table->slots[slot] != NULL) {
+        return table->slots[slot];
+    }
 
+    symbol = base_arena_alloc(&table->arena, sizeof *symbol);
+    symbol->name = strpool_text(id);
+    symbol->id = id;
+    symbol->hash = hash;
+    symbol->type = SYM_ILL;
+    symbol->object = NULL;
+    table->slots[slot] = symbol;
 
+    if (table->count == table->symbols_size) {
+        table->symbols_size *= 2u;
+        table->symbols = base_realloc(table->symbols,
+                                      table->symbols_size * sizeof *(table->symbols));
+    }
+    table->symbols[table->count++] = symbol;
 
-void symtab_init(symtab_t *table)
-{
-    table->root = NULL;
+    /* keep the load factor at or below 1/2 */
+    if (table->count * 2u > table->slots_size) {
+        grow_slots(table);
+    }
+
+    if (added != NULL) {
+        *added = true;
+    }
+    return symbol;
 }
 
 
-void symtab_free(symtab_t *table)
+/** \brief  Find symbol in symbol table
+ *
+ * A name that was never interned can't be in any table, so it's rejected
+ * without probing the index.
+ *
+ * \param[in]   table   symbol table
+ * \param[in]   name    symbol name
+ *
+ * \return  symbol or `NULL` when not found
+ * \throw   BASE_ERR_KEY    \a name is `NULL`, empty or not found
+ */
+symtab_symbol_t *symtab_find(const symtab_t *table, const char *name)
 {
-    if (table->root != NULL) {
-        symtab_node_free(table->root);
+    symtab_symbol_t *symbol;
+    uint32_t id = strpool_find(name);
+
+    if (id == STRPOOL_NONE) {
+        base_errno = BASE_ERR_KEY;
+        return NULL;
+    }
+    symbol = table->slots[find_slot(table, id, strpool_hash(id))];
+    if (symbol == NULL) {
+        base_errno = BASE_ERR_KEY;
     }
-    table->root = NULL;
+    return symbol;
 }
 
 
-symtab_node_t *symtab_add(symtab_t *table, const char *name)
+/** \brief  Get number of symbols in symbol table
+ *
+ * \param[in]   table   symbol table
+ *
+ * \return  number of symbols
+ */
+size_t symtab_count(const symtab_t *table)
 {
-    symtab_node_t *node;
+    return table->count;
+}
 
 
-    if (table->root == NULL) {
-        node = symtab_node_alloc(name);
-    } else {
-        node = symtab_node_add(table->root, name);
+/** \brief  Get symbols sorted by name
+ *
+ * The symbols added since the previous call are sorted and merged into the
+ * sorted list, so repeatedly adding a few symbols and requesting the list
+ * doesn't sort the whole table each time.
+ *
+ * \param[in,out]   table   symbol table
+ *
+ * \return  array of symtab_count() symbols sorted by name, owned by \a table
+ *          and valid until the next call of symtab_add()
+ */
+symtab_symbol_t **symtab_sorted(symtab_t *table)
+{
+    symtab_symbol_t **merged;
+    symtab_symbol_t **added;
+    size_t old = table->sorted_count;
+    size_t new = table->count - old;
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    if (table->sorted != NULL && new == 0) {
+        return table->sorted;
     }
-    if (node != NULL) {
-        table->root = node;
+
+    /* sort the new symbols on their own */
+    added = base_malloc((new + 1u) * sizeof *added);
+    memcpy(added, table->symbols + old, new * sizeof *added);
+    qsort(added, new, sizeof *added, compare_symbols);
+
+    /* and merge them with the previously sorted symbols */
+    merged = base_malloc((table->count + 1u) * sizeof *merged);
+    while (i < old && j < new) {
+        if (compare_symbols(&table->sorted[i], &added[j]) <= 0) {
+            merged[k++] = table->sorted[i++];
+        } else {
+            merged[k++] = added[j++];
+        }
+    }
+    while (i < old) {
+        merged[k++] = table->sorted[i++];
+    }
+    while (j < new) {
+        merged[k++] = added[j++];
     }
-    return node;
+
+    base_free(added);
+    base_free(table->sorted);
+    table->sorted = merged;
+    table->sorted_count = table->count;
+    return table->sorted;
 }
 
 
+/** \brief  Dump symbol names in order
+ *
+ * \param[in,out]   table   symbol table
+ */
 void symtab_dump(symtab_t *table)
 {
-    symtab_node_dump(table->root);
+    symtab_symbol_t **sorted = symtab_sorted(table);
+
+    for (size_t i = 0; i < table->count; i++) {
+        printf("%s\n", sorted[i]->name);
+    }
 }
@@ -24,6 +24,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef BASE_SYMTAB_H
 #define BASE_SYMTAB_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mem.h"
+
 
 /** \brief  Symbol types
  */
@@ -36,35 +42,52 @@ enum {
 };
 
 
-/** \brief  Symbol table binary tree node
+/** \brief  Symbol
+ *
+ * Symbols are owned by their symbol table and stay at the same address until
+ * the table is freed.
  */
-typedef struct symtab_node_s {
-    struct symtab_node_s *parent;   /**< parent node */
-    struct symtab_node_s *left;     /**< left node */
-    struct symtab_node_s *right;    /**< right node */
-    void *object;                   /**< symbol value */
-    char *name;                     /**< symbol name */
-    int type;                       /**< symbol type */
-} symtab_node_t;
+typedef struct symtab_symbol_s {
+    const char *    name;   /**< symbol name, owned by the string pool */
+    uint32_t        id;     /**< string pool ID of \c name */
+    uint32_t        hash;   /**< hash of \c name, see dict_hash_key() */
+    int             type;   /**< symbol type, \c SYM_ILL for a new symbol */
+    void *          object; /**< symbol value, for \c SYM_SYMTAB a symbol
+                                 table freed with its parent */
+} symtab_symbol_t;
 
 
 /** \brief  Symbol table object
+ *
+ * Symbols are looked up through a hash index on the string pool IDs of their
+ * names. A list of the symbols sorted by name is built on demand for dumps
+ * and listings, and only the symbols added since it was last built need to
+ * be sorted to bring it up to date.
  */
 typedef struct symtab_s {
-    symtab_node_t *root;    /**< binary tree root node */
+    symtab_symbol_t **  slots;          /**< hash index, `NULL` for an empty
+                                             slot */
+    size_t              slots_size;     /**< number of slots (power of two) */
+    base_arena_t        arena;          /**< storage for symbols */
+
+    symtab_symbol_t **  symbols;        /**< symbols in order of addition */
+    size_t              symbols_size;   /**< number of elements allocated
+                                             for \c symbols */
+    size_t              count;          /**< number of symbols */
+
+    symtab_symbol_t **  sorted;         /**< symbols sorted by name */
+    size_t              sorted_count;   /**< number of symbols in \c sorted */
 } symtab_t;
 
 
+void                symtab_init(symtab_t *table);
+void                symtab_free(symtab_t *table);
 
-symtab_node_t *symtab_node_add(symtab_node_t *node, const char *name);
-void symtab_node_free(symtab_node_t *node);
-void symtab_node_dump(symtab_node_t *node);
-
-
-void symtab_init(symtab_t *table);
-void symtab_free(symtab_t *table);
+symtab_symbol_t *   symtab_add(symtab_t *table, const char *name, bool *added);
+symtab_symbol_t *   symtab_find(const symtab_t *table, const char *name);
+size_t              symtab_count(const symtab_t *table);
 
-symtab_node_t *symtab_add(symtab_t *symtab, const char *name);
-void symtab_dump(symtab_t *table);
+symtab_symbol_t **  symtab_sorted(symtab_t *table);
+void                symtab_dump(symtab_t *table);
 
 #endif
@@ -0,0 +1,98 @@
+/** \file   bench.c
+ * \brief   Benchmark helpers
+ *
+ * Timing, reporting and a few utilities shared by the benchmarks.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* for clock_gettime() */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "bench.h"
+
+
+/** \brief  State of the pseudo random number generator
+ */
+static uint32_t random_state = 0x2545f491u;
+
+/** \brief  Sink for results, keeps the compiler from optimizing work away
+ */
+static volatile uintptr_t sink;
+
+
+/** \brief  Get monotonic time in nanoseconds
+ *
+ * \return  time in nanoseconds
+ */
+uint64_t bench_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+
+/** \brief  Print result of a timed run
+ *
+ * \param[in]   label   description of the run
+ * \param[in]   ops     number of operations performed
+ * \param[in]   ns      time taken in nanoseconds
+ */
+void bench_report(const char *label, size_t ops, uint64_t ns)
+{
+    printf("  %-40s %10zu ops %10.3f ms %8.2f ns/op\n",
+           label, ops, (double)ns / 1e6,
+           ops > 0 ? (double)ns / (double)ops : 0.0);
+}
+
+
+/** \brief  Get pseudo random number
+ *
+ * Xorshift32, deterministic so runs are comparable.
+ *
+ * \return  pseudo random number
+ */
+uint32_t bench_random(void)
+{
+    uint32_t x = random_state;
+
+    x ^= x << 13u;
+    x ^= x >> 17u;
+    x ^= x << 5u;
+    random_state = x;
+    return x;
+}
+
+
+/** \brief  Consume a result so the work producing it isn't optimized away
+ *
+ * \param[in]   value   result
+ */
+void bench_sink(uintptr_t value)
+{
+    sink += value;
+}
@@ -0,0 +1,47 @@
+/** \file   bench.h
+ * \brief   Benchmark helpers - header
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/** \brief  Benchmark object
+ */
+typedef struct bench_s {
+    const char *    name;           /**< name, used to select the benchmark */
+    const char *    description;    /**< short description */
+    bool            (*run)(void);   /**< function running the benchmark,
+                                         returns `false` on fatal error */
+} bench_t;
+
+
+uint64_t    bench_time_ns(void);
+void        bench_report(const char *label, size_t ops, uint64_t ns);
+uint32_t    bench_random(void);
+void        bench_sink(uintptr_t value);
+
+#endif
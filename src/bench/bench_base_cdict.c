@@ -0,0 +1,176 @@
+/** \file   bench_base_cdict.c
+ * \brief   Benchmarks for base/cdict.c
+ *
+ * Measures how a read-mostly workload on a shared concurrent dict scales with
+ * the number of threads, with a single shard (one global lock) and with the
+ * default number of shards.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "../base/cdict.h"
+#include "../base/mem.h"
+#include "bench.h"
+
+#include "bench_base_cdict.h"
+
+
+/** \brief  Number of symbols in the dict
+ */
+#define SCALING_SYMBOLS     100000
+
+/** \brief  Number of operations per thread
+ */
+#define SCALING_OPS         200000
+
+/** \brief  Maximum number of threads
+ */
+#define SCALING_MAX_THREADS 32
+
+/** \brief  One in this many operations is an update, the rest are lookups
+ */
+#define SCALING_WRITE_RATIO 10u
+
+
+/** \brief  Per thread state
+ */
+typedef struct worker_s {
+    pthread_t   thread; /**< thread ID */
+    cdict_t *   cdict;  /**< shared dict */
+    char      (*names)[16]; /**< symbol names */
+    uint32_t    seed;   /**< random seed of the thread */
+    uintptr_t   sum;    /**< sum of values found */
+} worker_t;
+
+
+/** \brief  Worker thread: mix of lookups and updates
+ *
+ * \param[in,out]   arg worker state
+ *
+ * \return  `NULL`
+ */
+static void *worker(void *arg)
+{
+    worker_t *w = arg;
+    uint32_t x = w->seed;
+
+    for (int i = 0; i < SCALING_OPS; i++) {
+        const char *key;
+        dict_value_t value;
+
+        /* xorshift32, bench_random() isn't thread-safe */
+        x ^= x << 13u;
+        x ^= x >> 17u;
+        x ^= x << 5u;
+        key = w->names[x % SCALING_SYMBOLS];
+        if (x % SCALING_WRITE_RATIO == 0) {
+            cdict_set(w->cdict, key, DICT_INT_TO_VALUE(i), DICT_ITEM_INT);
+        } else if (cdict_get(w->cdict, key, &value, NULL)) {
+            w->sum += (uintptr_t)value;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Time workload on \a cdict with \a count threads
+ *
+ * \param[in]   cdict   shared dict
+ * \param[in]   names   symbol names
+ * \param[in]   count   number of threads
+ * \param[in]   shards  number of shards, for the report
+ *
+ * \return  `false` if a thread couldn't be created
+ */
+static bool run_threads(cdict_t *cdict, char (*names)[16], int count, size_t shards)
+{
+    worker_t workers[SCALING_MAX_THREADS];
+    char label[64];
+    uint64_t start;
+    uintptr_t sum = 0;
+    int started;
+
+    start = bench_time_ns();
+    for (started = 0; started < count; started++) {
+        worker_t *w = &workers[started];
+
+        w->cdict = cdict;
+        w->names = names;
+        w->seed = 0x9e3779b9u * (uint32_t)(started + 1);
+        w->sum = 0;
+        if (pthread_create(&w->thread, NULL, worker, w) != 0) {
+            break;
+        }
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t].thread, NULL);
+        sum += workers[t].sum;
+    }
+    if (started < count) {
+        fprintf(stderr, "failed to create thread %d\n", started);
+        return false;
+    }
+
+    snprintf(label, sizeof label, "%zu shard(s), %d thread(s)", shards, count);
+    bench_report(label, (size_t)count * SCALING_OPS, bench_time_ns() - start);
+    bench_sink(sum);
+    return true;
+}
+
+
+/** \brief  Benchmark scaling of the concurrent dict over 1 to 32 threads
+ *
+ * The reported time per operation is wall clock time divided by the total
+ * number of operations of all threads, so it drops as long as adding threads
+ * helps.
+ *
+ * \return  `false` on error
+ */
+bool bench_base_cdict_scaling(void)
+{
+    static const size_t shard_counts[] = { 1, CDICT_DEFAULT_SHARDS };
+    char (*names)[16];
+    bool result = true;
+
+    names = base_malloc(SCALING_SYMBOLS * sizeof *names);
+    for (int i = 0; i < SCALING_SYMBOLS; i++) {
+        snprintf(names[i], sizeof names[i], "sym_%d", i);
+    }
+
+    for (size_t s = 0; s < base_array_len(shard_counts) && result; s++) {
+        cdict_t *cdict = cdict_new(shard_counts[s]);
+
+        for (int i = 0; i < SCALING_SYMBOLS; i++) {
+            cdict_set(cdict, names[i], DICT_INT_TO_VALUE(i), DICT_ITEM_INT);
+        }
+        for (int count = 1; count <= SCALING_MAX_THREADS && result; count *= 2) {
+            result = run_threads(cdict, names, count, shard_counts[s]);
+        }
+        cdict_free(cdict);
+    }
+
+    base_free(names);
+    return result;
+}
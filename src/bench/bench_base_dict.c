@@ -0,0 +1,135 @@
+/** \file   bench_base_dict.c
+ * \brief   Benchmarks for base/dict.c
+ *
+ * Compares single key lookups with batched lookups on tables too large to
+ * fit in the cache, for both dict backends.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../base/dict.h"
+#include "../base/mem.h"
+#include "bench.h"
+
+#include "bench_base_dict.h"
+
+
+/** \brief  Number of symbols in the dict
+ */
+#define LOOKUP_SYMBOLS  200000
+
+/** \brief  Number of lookups per timed run
+ */
+#define LOOKUP_COUNT    1000000
+
+/** \brief  Number of keys passed to dict_get_many() per call
+ */
+#define LOOKUP_BATCH    64
+
+
+/** \brief  Time single and batched lookups in \a dict
+ *
+ * \param[in]   dict    dict containing all \a keys
+ * \param[in]   keys    keys to look up, in random order
+ * \param[in]   backend name of the backend for the report
+ *
+ * \return  `false` if a key wasn't found
+ */
+static bool time_lookups(const dict_t *dict, const char **keys, const char *backend)
+{
+    dict_value_t values[LOOKUP_BATCH];
+    char label[64];
+    uintptr_t sum = 0;
+    size_t found = 0;
+    uint64_t start;
+
+    start = bench_time_ns();
+    for (size_t i = 0; i < LOOKUP_COUNT; i++) {
+        dict_value_t value;
+
+        if (dict_get(dict, keys[i], &value, NULL)) {
+            found++;
+            sum += (uintptr_t)value;
+        }
+    }
+    snprintf(label, sizeof label, "%s: dict_get()", backend);
+    bench_report(label, LOOKUP_COUNT, bench_time_ns() - start);
+
+    start = bench_time_ns();
+    for (size_t i = 0; i < LOOKUP_COUNT; i += LOOKUP_BATCH) {
+        found += dict_get_many(dict, keys + i, LOOKUP_BATCH, values, NULL);
+        for (size_t v = 0; v < LOOKUP_BATCH; v++) {
+            sum += (uintptr_t)values[v];
+        }
+    }
+    snprintf(label, sizeof label, "%s: dict_get_many(%d)", backend, LOOKUP_BATCH);
+    bench_report(label, LOOKUP_COUNT, bench_time_ns() - start);
+
+    bench_sink(sum);
+    if (found != LOOKUP_COUNT * 2u) {
+        fprintf(stderr, "%s: %zu of %d keys found\n",
+                backend, found, LOOKUP_COUNT * 2);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Benchmark single versus batched lookups
+ *
+ * \return  `false` on error
+ */
+bool bench_base_dict_lookup(void)
+{
+    static const dict_backend_t backends[] = {
+        DICT_BACKEND_CHAINED, DICT_BACKEND_OPEN
+    };
+    static const char *backend_names[] = { "chained", "open" };
+    char (*names)[16];
+    const char **keys;
+    bool result = true;
+
+    names = base_malloc(LOOKUP_SYMBOLS * sizeof *names);
+    keys = base_malloc(LOOKUP_COUNT * sizeof *keys);
+    for (int i = 0; i < LOOKUP_SYMBOLS; i++) {
+        snprintf(names[i], sizeof names[i], "sym_%d", i);
+    }
+    for (size_t i = 0; i < LOOKUP_COUNT; i++) {
+        keys[i] = names[bench_random() % LOOKUP_SYMBOLS];
+    }
+
+    for (size_t b = 0; b < base_array_len(backends) && result; b++) {
+        dict_t *dict = dict_new_backend(backends[b], LOOKUP_SYMBOLS);
+
+        for (int i = 0; i < LOOKUP_SYMBOLS; i++) {
+            dict_set_int(dict, names[i], i);
+        }
+        result = time_lookups(dict, keys, backend_names[b]);
+        dict_free(dict);
+    }
+
+    base_free(keys);
+    base_free(names);
+    return result;
+}
@@ -0,0 +1,168 @@
+/** \file   bench_base_hash.c
+ * \brief   Benchmarks for base/hash.c
+ *
+ * Compares FNV-1a with XXH64 on identifier-sized keys and on megabytes of
+ * data.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../base/hash.h"
+#include "../base/mem.h"
+#include "bench.h"
+
+#include "bench_base_hash.h"
+
+
+/** \brief  Number of identifiers
+ */
+#define SHORT_KEYS      4096
+
+/** \brief  Number of times all identifiers are hashed
+ */
+#define SHORT_ROUNDS    256
+
+/** \brief  Size of the buffer for the long input benchmark
+ */
+#define LONG_SIZE       (4u * 1024u * 1024u)
+
+/** \brief  Number of times the buffer is hashed
+ */
+#define LONG_ROUNDS     16
+
+/** \brief  Size of the pieces fed to the streaming hash
+ */
+#define LONG_PIECE      4096u
+
+
+/** \brief  Benchmark hashing identifier-sized keys
+ *
+ * Identifiers are 4 to 19 characters, like typical labels.
+ *
+ * \return  `true`
+ */
+bool bench_base_hash_short(void)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+    char (*keys)[20];
+    size_t lengths[SHORT_KEYS];
+    uint64_t sum = 0;
+    uint64_t start;
+    size_t bytes = 0;
+
+    keys = base_malloc(SHORT_KEYS * sizeof *keys);
+    for (size_t k = 0; k < SHORT_KEYS; k++) {
+        size_t len = 4u + bench_random() % 16u;
+
+        for (size_t i = 0; i < len; i++) {
+            keys[k][i] = alphabet[bench_random() % (sizeof alphabet - 1u)];
+        }
+        keys[k][len] = '\0';
+        lengths[k] = len;
+        bytes += len;
+    }
+    printf("  average key length: %.1f bytes\n", (double)bytes / SHORT_KEYS);
+
+    start = bench_time_ns();
+    for (int r = 0; r < SHORT_ROUNDS; r++) {
+        for (size_t k = 0; k < SHORT_KEYS; k++) {
+            sum += hash_fnv1_32((const uint8_t *)keys[k], lengths[k]);
+        }
+    }
+    bench_report("FNV-1a 32", SHORT_KEYS * SHORT_ROUNDS, bench_time_ns() - start);
+
+    start = bench_time_ns();
+    for (int r = 0; r < SHORT_ROUNDS; r++) {
+        for (size_t k = 0; k < SHORT_KEYS; k++) {
+            sum += hash_xx64(keys[k], lengths[k], 0);
+        }
+    }
+    bench_report("XXH64", SHORT_KEYS * SHORT_ROUNDS, bench_time_ns() - start);
+
+    /* including strlen(), as done for dict keys */
+    start = bench_time_ns();
+    for (int r = 0; r < SHORT_ROUNDS; r++) {
+        for (size_t k = 0; k < SHORT_KEYS; k++) {
+            sum += hash_xx64(keys[k], strlen(keys[k]), 0);
+        }
+    }
+    bench_report("XXH64 + strlen()", SHORT_KEYS * SHORT_ROUNDS,
+                 bench_time_ns() - start);
+
+    bench_sink((uintptr_t)sum);
+    base_free(keys);
+    return true;
+}
+
+
+/** \brief  Benchmark hashing megabytes of data
+ *
+ * Reported per byte.
+ *
+ * \return  `true`
+ */
+bool bench_base_hash_long(void)
+{
+    uint8_t *buffer;
+    uint64_t sum = 0;
+    uint64_t start;
+    uint64_t ns;
+
+    buffer = base_malloc(LONG_SIZE);
+    for (size_t i = 0; i < LONG_SIZE; i++) {
+        buffer[i] = (uint8_t)bench_random();
+    }
+
+    start = bench_time_ns();
+    for (int r = 0; r < LONG_ROUNDS; r++) {
+        sum += hash_fnv1_32(buffer, LONG_SIZE);
+    }
+    ns = bench_time_ns() - start;
+    bench_report("FNV-1a 32 (per byte)", LONG_SIZE * LONG_ROUNDS, ns);
+
+    start = bench_time_ns();
+    for (int r = 0; r < LONG_ROUNDS; r++) {
+        sum += hash_xx64(buffer, LONG_SIZE, 0);
+    }
+    ns = bench_time_ns() - start;
+    bench_report("XXH64 (per byte)", LONG_SIZE * LONG_ROUNDS, ns);
+
+    start = bench_time_ns();
+    for (int r = 0; r < LONG_ROUNDS; r++) {
+        hash_xx64_t state;
+
+        hash_xx64_init(&state, 0);
+        for (size_t pos = 0; pos < LONG_SIZE; pos += LONG_PIECE) {
+            hash_xx64_update(&state, buffer + pos, LONG_PIECE);
+        }
+        sum += hash_xx64_final(&state);
+    }
+    ns = bench_time_ns() - start;
+    bench_report("XXH64 streaming (per byte)", LONG_SIZE * LONG_ROUNDS, ns);
+
+    bench_sink((uintptr_t)sum);
+    base_free(buffer);
+    return true;
+}
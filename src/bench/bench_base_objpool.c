@@ -0,0 +1,314 @@
+/** \file   bench_base_objpool.c
+ * \brief   Benchmarks for base/objpool.c
+ *
+ * Compares requesting and releasing variable-sized strings from an object
+ * pool with plain malloc() and free(), and sharing a pool between threads by
+ * locking it or through per-thread caches.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../base/mem.h"
+#include "../base/objpool.h"
+#include "bench.h"
+
+#include "bench_base_objpool.h"
+
+
+/** \brief  Number of live strings
+ */
+#define WORKING_SET     256
+
+/** \brief  Number of strings replaced
+ */
+#define ROUNDS          (4 * 1024 * 1024)
+
+/** \brief  Maximum string size
+ */
+#define MAX_SIZE        1024u
+
+/** \brief  Maximum number of threads
+ */
+#define MAX_THREADS     8
+
+/** \brief  Number of live strings per thread
+ */
+#define THREAD_SET      64
+
+
+/** \brief  Pooled string
+ */
+typedef struct bench_string_s {
+    OBJ_POOL_OBJ_BASE
+    char *  text;   /**< text */
+    size_t  size;   /**< size of \c text */
+} bench_string_t;
+
+
+/** \brief  Create pooled string
+ *
+ * \param[in]   param   requested size
+ *
+ * \return  new string, its size rounded up to a power of two
+ */
+static void *string_alloc(void *param)
+{
+    bench_string_t *s = base_malloc(sizeof *s);
+
+    s->size = *(const size_t *)param;
+    /* round up to the size class, so any request for the class fits */
+    if (!base_ispow2(s->size)) {
+        s->size = base_nextpow2(s->size);
+    }
+    s->text = base_malloc(s->size);
+    s->text[0] = '\0';
+    return s;
+}
+
+
+/** \brief  Reuse pooled string
+ *
+ * \param[in]   obj     string
+ * \param[in]   param   requested size
+ *
+ * \return  \a obj
+ */
+static void *string_reuse(void *obj, void *param)
+{
+    bench_string_t *s = obj;
+
+    /* sized requests always fit */
+    (void)param;
+    s->text[0] = '\0';
+    return obj;
+}
+
+
+/** \brief  Free pooled string
+ *
+ * \param[in]   obj     string
+ */
+static void string_free(void *obj)
+{
+    bench_string_t *s = obj;
+
+    base_free(s->text);
+    base_free(s);
+}
+
+
+/** \brief  Get size of pooled string
+ *
+ * \param[in]   obj     string
+ *
+ * \return  allocated size
+ */
+static size_t string_size(void *obj)
+{
+    return ((const bench_string_t *)obj)->size;
+}
+
+
+/** \brief  Benchmark replacing random strings in a working set
+ *
+ * \return  `true`
+ */
+bool bench_base_objpool_strings(void)
+{
+    objpool_t pool = {
+        .active_size = WORKING_SET,
+        .inactive_size = WORKING_SET,
+        .alloc_cb = string_alloc,
+        .reuse_cb = string_reuse,
+        .free_cb = string_free,
+        .size_cb = string_size
+    };
+    char *plain[WORKING_SET];
+    bench_string_t *pooled[WORKING_SET];
+    size_t *sizes;
+    uint64_t start;
+
+    sizes = base_malloc(ROUNDS * sizeof *sizes);
+    for (size_t i = 0; i < ROUNDS; i++) {
+        sizes[i] = 8u + bench_random() % (MAX_SIZE - 8u);
+    }
+
+    /* malloc() and free() */
+    for (size_t i = 0; i < WORKING_SET; i++) {
+        plain[i] = base_malloc(sizes[i]);
+    }
+    start = bench_time_ns();
+    for (size_t i = 0; i < ROUNDS; i++) {
+        size_t slot = sizes[i] % WORKING_SET;
+
+        base_free(plain[slot]);
+        plain[slot] = base_malloc(sizes[i]);
+        plain[slot][0] = '\0';
+    }
+    bench_report("malloc()/free()", ROUNDS, bench_time_ns() - start);
+    for (size_t i = 0; i < WORKING_SET; i++) {
+        base_free(plain[i]);
+    }
+
+    /* objpool_request() and objpool_release() */
+    objpool_init(&pool);
+    for (size_t i = 0; i < WORKING_SET; i++) {
+        pooled[i] = objpool_request(&pool, sizes[i], &sizes[i]);
+    }
+    start = bench_time_ns();
+    for (size_t i = 0; i < ROUNDS; i++) {
+        size_t slot = sizes[i] % WORKING_SET;
+
+        objpool_release(&pool, pooled[slot]);
+        pooled[slot] = objpool_request(&pool, sizes[i], &sizes[i]);
+    }
+    bench_report("objpool_request()/objpool_release()", ROUNDS,
+                 bench_time_ns() - start);
+    printf("  %.1f%% of requests served from the pool\n",
+           (double)pool.requests_from_pool * 100.0 / (double)pool.requests_total);
+    objpool_free(&pool);
+
+    base_free(sizes);
+    return true;
+}
+
+
+/** \brief  State of a thread of the threads benchmark
+ */
+typedef struct thread_state_s {
+    objpool_t *         pool;       /**< shared pool */
+    const size_t *      sizes;      /**< random string sizes */
+    size_t              rounds;     /**< number of strings replaced */
+    bool                cached;     /**< use a per-thread cache */
+} thread_state_t;
+
+
+/** \brief  Replace random strings in a per-thread working set
+ *
+ * \param[in]   arg thread state
+ *
+ * \return  `NULL`
+ */
+static void *replace_thread(void *arg)
+{
+    const thread_state_t *state = arg;
+    objpool_t *pool = state->pool;
+    objpool_cache_t cache;
+    void *live[THREAD_SET];
+
+    objpool_cache_init(&cache, pool);
+    for (size_t i = 0; i < state->rounds + THREAD_SET; i++) {
+        size_t slot = i % THREAD_SET;
+        /* cast away const: objpool passes the parameter as void * */
+        size_t *size = (size_t *)(uintptr_t)&state->sizes[i];
+
+        if (i >= THREAD_SET) {
+            if (state->cached) {
+                objpool_cache_release(&cache, live[slot]);
+            } else {
+                pthread_mutex_lock(&pool->lock);
+                objpool_release(pool, live[slot]);
+                pthread_mutex_unlock(&pool->lock);
+            }
+        }
+        if (state->cached) {
+            live[slot] = objpool_cache_request(&cache, *size, size);
+        } else {
+            pthread_mutex_lock(&pool->lock);
+            live[slot] = objpool_request(pool, *size, size);
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+    for (size_t i = 0; i < THREAD_SET; i++) {
+        objpool_cache_release(&cache, live[i]);
+    }
+    objpool_cache_free(&cache);
+    return NULL;
+}
+
+
+/** \brief  Benchmark sharing a pool between threads
+ *
+ * The same total number of strings is replaced by 1 to #MAX_THREADS threads,
+ * locking the pool for every call or using per-thread caches.
+ *
+ * \return  `false` when a thread couldn't be created
+ */
+bool bench_base_objpool_threads(void)
+{
+    size_t *sizes;
+    size_t count = ROUNDS + THREAD_SET + MAX_THREADS;
+    bool result = true;
+
+    sizes = base_malloc(count * sizeof *sizes);
+    for (size_t i = 0; i < count; i++) {
+        sizes[i] = 8u + bench_random() % (MAX_SIZE - 8u);
+    }
+
+    for (int cached = 0; cached < 2 && result; cached++) {
+        for (int threads = 1; threads <= MAX_THREADS && result; threads *= 2) {
+            objpool_t pool = {
+                .active_size = THREAD_SET * MAX_THREADS,
+                .inactive_size = THREAD_SET * MAX_THREADS,
+                .alloc_cb = string_alloc,
+                .reuse_cb = string_reuse,
+                .free_cb = string_free,
+                .size_cb = string_size
+            };
+            pthread_t ids[MAX_THREADS];
+            thread_state_t states[MAX_THREADS];
+            char label[64];
+            uint64_t start;
+            int t;
+
+            objpool_init(&pool);
+            start = bench_time_ns();
+            for (t = 0; t < threads; t++) {
+                states[t].pool = &pool;
+                /* all threads read the same sizes, from a different start */
+                states[t].sizes = sizes + t;
+                states[t].rounds = ROUNDS / (size_t)threads;
+                states[t].cached = cached != 0;
+                if (pthread_create(&ids[t], NULL, replace_thread, &states[t]) != 0) {
+                    fprintf(stderr, "%s(): failed to create thread\n", __func__);
+                    result = false;
+                    break;
+                }
+            }
+            while (t-- > 0) {
+                pthread_join(ids[t], NULL);
+            }
+            snprintf(label, sizeof label, "%s, %d thread%s",
+                     cached ? "per-thread caches" : "locked pool",
+                     threads, threads > 1 ? "s" : "");
+            bench_report(label, ROUNDS, bench_time_ns() - start);
+            objpool_free(&pool);
+        }
+    }
+
+    base_free(sizes);
+    return result;
+}
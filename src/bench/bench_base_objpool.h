@@ -0,0 +1,32 @@
+/** \file   bench_base_objpool.h
+ * \brief   Benchmarks for base/objpool.c - header
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BENCH_BENCH_BASE_OBJPOOL_H
+#define BENCH_BENCH_BASE_OBJPOOL_H
+
+#include <stdbool.h>
+
+bool bench_base_objpool_strings(void);
+bool bench_base_objpool_threads(void);
+
+#endif
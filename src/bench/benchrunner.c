@@ -0,0 +1,155 @@
+/** \file   benchrunner.c
+ * \brief   Benchmark runner
+ *
+ * Runs the benchmarks named on the command line, or all benchmarks when no
+ * names are given.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../base/cmdline.h"
+#include "../base/mem.h"
+#include "../base/strlist.h"
+#include "bench.h"
+
+#include "bench_base_cdict.h"
+#include "bench_base_dict.h"
+#include "bench_base_hash.h"
+#include "bench_base_objpool.h"
+
+
+/** \brief  Command line option: list benchmarks (--list)
+ */
+static int opt_list = 0;
+
+
+/** \brief  Command line options
+ */
+static const cmdline_option_t options[] = {
+    { 'l', "list", NULL, CMDLINE_TYPE_BOOL,
+        &opt_list, (void *)0,
+        "list available benchmarks" },
+    CMDLINE_OPTION_TERMINATOR
+};
+
+
+/** \brief  List of benchmarks
+ */
+static const bench_t benchmarks[] = {
+    { "cdict_scaling",  "concurrent dict with 1 to 32 threads",
+      bench_base_cdict_scaling },
+    { "dict_lookup",    "dict_get() versus dict_get_many()",
+      bench_base_dict_lookup },
+    { "hash_short",     "FNV-1a versus XXH64 on identifiers",
+      bench_base_hash_short },
+    { "hash_long",      "FNV-1a versus XXH64 on megabytes of data",
+      bench_base_hash_long },
+    { "objpool_strings", "objpool versus malloc() on variable-sized strings",
+      bench_base_objpool_strings },
+    { "objpool_threads", "locked objpool versus per-thread caches",
+      bench_base_objpool_threads }
+};
+
+
+/** \brief  Run benchmark
+ *
+ * \param[in]   bench   benchmark
+ *
+ * \return  `true` on success
+ */
+static bool run_bench(const bench_t *bench)
+{
+    printf("%s: %s\n", bench->name, bench->description);
+    return bench->run();
+}
+
+
+/** \brief  Find benchmark by name
+ *
+ * \param[in]   name    benchmark name
+ *
+ * \return  benchmark or `NULL` when not found
+ */
+static const bench_t *find_bench(const char *name)
+{
+    for (size_t i = 0; i < base_array_len(benchmarks); i++) {
+        if (strcmp(benchmarks[i].name, name) == 0) {
+            return &benchmarks[i];
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Main entry point
+ *
+ * \param[in]   argc    argument count
+ * \param[in]   argv    argument vector
+ *
+ * \return  EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char *argv[])
+{
+    int optres;
+    strlist_t *args = NULL; /* freed by cmdline_exit() */
+    bool result = true;
+
+    cmdline_init("benchrunner", "0.1");
+    cmdline_add_options(options);
+
+    optres = cmdline_parse(argc, argv, &args);
+    if (optres == CMDLINE_EXIT_ERROR) {
+        cmdline_exit();
+        return EXIT_FAILURE;
+    } else if (optres == CMDLINE_EXIT_HELP || optres == CMDLINE_EXIT_VERSION) {
+        cmdline_exit();
+        return EXIT_SUCCESS;
+    }
+
+    if (opt_list) {
+        for (size_t i = 0; i < base_array_len(benchmarks); i++) {
+            printf("%-20s %s\n", benchmarks[i].name, benchmarks[i].description);
+        }
+    } else if (args == NULL || strlist_len(args) == 0) {
+        for (size_t i = 0; i < base_array_len(benchmarks) && result; i++) {
+            result = run_bench(&benchmarks[i]);
+        }
+    } else {
+        for (size_t i = 0; i < strlist_len(args) && result; i++) {
+            const char *name = strlist_item(args, i);
+            const bench_t *bench = find_bench(name);
+
+            if (bench == NULL) {
+                fprintf(stderr, "error: unknown benchmark '%s'.\n", name);
+                result = false;
+            } else {
+                result = run_bench(bench);
+            }
+        }
+    }
+
+    cmdline_exit();
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,342 @@
+/** \file   test_base_cdict.c
+ * \brief   Unit tests for base/cdict.c
+ *
+ * Unit tests for the concurrent dictionary.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "../base/cdict.h"
+#include "../base/error.h"
+#include "../base/mem.h"
+#include "testcase.h"
+
+#include "test_base_cdict.h"
+
+
+/** \brief  Number of threads in the stress test
+ */
+#define STRESS_THREADS  8
+
+/** \brief  Number of keys inserted by each thread in the stress test
+ */
+#define STRESS_KEYS     20000
+
+/** \brief  Number of keys all threads try to add in the stress test
+ */
+#define STRESS_SHARED   5000
+
+
+/** \brief  Concurrent dict for tests
+ */
+static cdict_t *cdict = NULL;
+
+
+static bool setup(void)
+{
+    cdict = cdict_new(0);
+    return true;
+}
+
+static bool teardown(void)
+{
+    if (cdict != NULL) {
+        cdict_free(cdict);
+        cdict = NULL;
+    }
+    return true;
+}
+
+
+/** \brief  Test setting, getting and removing items
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_basic(testcase_t *self)
+{
+    dict_value_t value = NULL;
+    dict_type_t type = DICT_ITEM_ERR;
+    bool result;
+
+    printf("... setting 'border' to $d020 ..\n");
+    result = cdict_set(cdict, "border", DICT_INT_TO_VALUE(0xd020), DICT_ITEM_INT);
+    testcase_assert_true(self, result && cdict_size(cdict) == 1);
+
+    printf("... getting 'border' ..\n");
+    result = cdict_get(cdict, "border", &value, &type);
+    testcase_assert_true(self,
+                         result && type == DICT_ITEM_INT &&
+                         DICT_VALUE_TO_INT(value) == 0xd020);
+
+    printf("... getting 'screen' (should fail without setting base_errno) ..\n");
+    base_errno = 0;
+    result = cdict_get(cdict, "screen", NULL, NULL);
+    testcase_assert_true(self, !result && base_errno == 0);
+
+    printf("... removing 'border' ..\n");
+    result = cdict_remove(cdict, "border");
+    testcase_assert_true(self,
+                         result && !cdict_has_key(cdict, "border") &&
+                         cdict_size(cdict) == 0);
+
+    printf("... removing 'border' again (should fail) ..\n");
+    base_errno = 0;
+    result = cdict_remove(cdict, "border");
+    testcase_assert_true(self, !result && base_errno == BASE_ERR_KEY);
+    return true;
+}
+
+
+/** \brief  Test string values
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_str(testcase_t *self)
+{
+    dict_value_t value = NULL;
+    dict_type_t type = DICT_ITEM_ERR;
+    bool result;
+
+    printf("... setting 'name' to \"cpx65\" ..\n");
+    cdict_set(cdict, "name", "cpx65", DICT_ITEM_STR);
+    result = cdict_get(cdict, "name", &value, &type);
+    printf("... replacing and removing 'name' while holding the value ..\n");
+    cdict_set(cdict, "name", "cpx65as", DICT_ITEM_STR);
+    cdict_remove(cdict, "name");
+    testcase_assert_true(self,
+                         result && type == DICT_ITEM_STR &&
+                         strcmp(value, "cpx65") == 0);
+    if (result) {
+        base_free(value);
+    }
+
+    printf("... adding existing string item ..\n");
+    cdict_set(cdict, "name", "cpx65", DICT_ITEM_STR);
+    value = NULL;
+    result = cdict_add(cdict, "name", "cpx65da", DICT_ITEM_STR,
+                       &value);
+    cdict_remove(cdict, "name");
+    testcase_assert_true(self,
+                         !result && value != NULL &&
+                         strcmp(value, "cpx65") == 0);
+    base_free(value);
+    return true;
+}
+
+
+/** \brief  Test cdict_add()
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_add(testcase_t *self)
+{
+    dict_value_t existing = NULL;
+    bool result;
+
+    printf("... adding 'start' ..\n");
+    result = cdict_add(cdict, "start", DICT_INT_TO_VALUE(0x0801), DICT_ITEM_INT,
+                       &existing);
+    testcase_assert_true(self, result);
+
+    printf("... adding 'start' again (should fail) ..\n");
+    result = cdict_add(cdict, "start", DICT_INT_TO_VALUE(0xc000), DICT_ITEM_INT,
+                       &existing);
+    printf("... existing value = $%04x\n", (unsigned int)DICT_VALUE_TO_INT(existing));
+    testcase_assert_true(self,
+                         !result && DICT_VALUE_TO_INT(existing) == 0x0801 &&
+                         cdict_size(cdict) == 1);
+    return true;
+}
+
+
+/** \brief  Per thread state for the stress test
+ */
+typedef struct stress_state_s {
+    int     id;         /**< thread number */
+    int     wins;       /**< number of shared keys added by this thread */
+    int     errors;     /**< number of wrong values seen */
+} stress_state_t;
+
+
+/** \brief  Stress test thread
+ *
+ * Inserts keys of its own, removes half of them again, races the other
+ * threads adding shared keys and looks up keys of the other threads while
+ * they're being inserted.
+ *
+ * \param[in,out]   arg stress test state
+ *
+ * \return  `NULL`
+ */
+static void *stress_thread(void *arg)
+{
+    stress_state_t *state = arg;
+    char key[32];
+
+    for (int i = 0; i < STRESS_KEYS; i++) {
+        dict_value_t value;
+        dict_type_t type;
+        int other = (state->id + 1 + i) % STRESS_THREADS;
+
+        snprintf(key, sizeof key, "t%d_%d", state->id, i);
+        cdict_set(cdict, key, DICT_INT_TO_VALUE(state->id * STRESS_KEYS + i),
+                  DICT_ITEM_INT);
+
+        if (i < STRESS_SHARED) {
+            snprintf(key, sizeof key, "shared_%d", i);
+            if (cdict_add(cdict, key, DICT_INT_TO_VALUE(state->id),
+                          DICT_ITEM_INT, NULL)) {
+                state->wins++;
+            }
+        }
+
+        /* all threads replace the same string item */
+        snprintf(key, sizeof key, "text_%d_%d", state->id, i);
+        cdict_set(cdict, "text", key, DICT_ITEM_STR);
+        if (cdict_get(cdict, "text", &value, &type)) {
+            if (type != DICT_ITEM_STR || strncmp(value, "text_", 5) != 0) {
+                state->errors++;
+            }
+            base_free(value);
+        }
+
+        /* odd keys of other threads may be gone already */
+        snprintf(key, sizeof key, "t%d_%d", other, i);
+        if (cdict_get(cdict, key, &value, NULL) &&
+                DICT_VALUE_TO_INT(value) != other * STRESS_KEYS + i) {
+            state->errors++;
+        }
+    }
+    for (int i = 1; i < STRESS_KEYS; i += 2) {
+        snprintf(key, sizeof key, "t%d_%d", state->id, i);
+        if (!cdict_remove(cdict, key)) {
+            state->errors++;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Test concurrent access from multiple threads
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_stress(testcase_t *self)
+{
+    pthread_t threads[STRESS_THREADS];
+    stress_state_t states[STRESS_THREADS];
+    int wins = 0;
+    int errors = 0;
+    size_t expected;
+    char key[32];
+
+    printf("... running %d threads ..\n", STRESS_THREADS);
+    for (int t = 0; t < STRESS_THREADS; t++) {
+        states[t].id = t;
+        states[t].wins = 0;
+        states[t].errors = 0;
+        if (pthread_create(&threads[t], NULL, stress_thread, &states[t]) != 0) {
+            fprintf(stderr, "%s(): failed to create thread\n", __func__);
+            return false;
+        }
+    }
+    for (int t = 0; t < STRESS_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        wins += states[t].wins;
+        errors += states[t].errors;
+    }
+
+    /* the keys left by each thread, the shared keys and "text" */
+    expected = STRESS_THREADS * (STRESS_KEYS / 2) + STRESS_SHARED + 1;
+    printf("... %d shared keys won, %d errors, size = %zu (expected %zu)\n",
+           wins, errors, cdict_size(cdict), expected);
+    testcase_assert_true(self,
+                         wins == STRESS_SHARED && errors == 0 &&
+                         cdict_size(cdict) == expected);
+
+    printf("... checking remaining keys ..\n");
+    for (int t = 0; t < STRESS_THREADS; t++) {
+        for (int i = 0; i < STRESS_KEYS; i++) {
+            dict_value_t value = NULL;
+            bool found;
+
+            snprintf(key, sizeof key, "t%d_%d", t, i);
+            found = cdict_get(cdict, key, &value, NULL);
+            if (found != (i % 2 == 0) ||
+                    (found && DICT_VALUE_TO_INT(value) != t * STRESS_KEYS + i)) {
+                errors++;
+            }
+        }
+    }
+    testcase_assert_equal(self, errors, 0);
+    return true;
+}
+
+
+/** \brief  Create test group 'base/cdict'
+ *
+ * \return  test group
+ */
+testgroup_t *get_base_cdict_tests(void)
+{
+    testgroup_t *group;
+    testcase_t *test;
+
+    group = testgroup_new("base/cdict",
+                          "Test the base/cdict module",
+                          NULL, NULL);
+
+    test = testcase_new("basic",
+                        "Test setting, getting and removing items",
+                        5, test_basic, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("add",
+                        "Test cdict_add()",
+                        2, test_add, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("str",
+                        "Test string values",
+                        2, test_str, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("stress",
+                        "Test concurrent access from multiple threads",
+                        2, test_stress, setup, teardown);
+    testgroup_add_case(group, test);
+
+    return group;
+}
@@ -28,16 +28,52 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 
+#include "../base/error.h"
 #include "../base/mem.h"
 #include "../base/cpu/addrmode.h"
 #include "../base/cpu/cputype.h"
 #include "../base/cpu/mnemonic.h"
 #include "../base/cpu/opcode.h"
+#include "../base/strings.h"
 #include "testcase.h"
 
 #include "test_base_cpu.h"
 
+
+/** \brief  Number of passes over the opcode table in the 'threads' test
+ */
+#define THREADS_PASSES  2000
+
+
+/** \brief  State of a thread in the 'threads' test
+ */
+typedef struct thread_state_s {
+    cpu_type_t  cpu_type;   /**< CPU type used by the thread */
+    int         err;        /**< error code the thread triggers */
+    const char *text;       /**< integer literal triggering \c err */
+    int         errors;     /**< number of errors */
+} thread_state_t;
+
+
+/** \brief  Thread states for the 'threads' test
+ *
+ * Each thread uses a different CPU type and triggers a different error.
+ */
+static thread_state_t thread_states[] = {
+    { CPU_65XX,     BASE_ERR_EMPTY,     "$",            0 },
+    { CPU_65C02,    BASE_ERR_RANGE,     "2147483648",   0 },
+    { CPU_R65C02,   BASE_ERR_SYNTAX,    "'ab'",         0 },
+    { CPU_W65C02S,  BASE_ERR_EMPTY,     "%",            0 },
+    { CPU_HUC6280,  BASE_ERR_RANGE,     "$100000000",   0 }
+};
+
+
+/** \brief  Mnemonic IDs per opcode for the CPU types in \c thread_states
+ */
+static int thread_expected[base_array_len(thread_states)][0x100];
+
 /** \brief  Data object for the mnemonic_get_text() tests
  */
 typedef struct mne_text_test_s {
@@ -159,6 +195,82 @@ static bool test_opcodes(int *total, int *passed)
 #endif
 
 
+/** \brief  Look up opcodes and trigger errors
+ *
+ * \param[in,out]   arg thread state
+ *
+ * \return  `NULL`
+ */
+static void *opcode_thread(void *arg)
+{
+    thread_state_t *state = arg;
+    const int *expected = thread_expected[state - thread_states];
+
+    opcode_set_cpu_type(state->cpu_type);
+    for (int pass = 0; pass < THREADS_PASSES; pass++) {
+        size_t len;
+        int32_t value;
+
+        base_errno = 0;
+        str_scan_int(state->text, &len, &value);
+        for (int opc = 0; opc < 0x100; opc++) {
+            if (opcode_get_mnemonic_id(opc) != expected[opc]) {
+                state->errors++;
+            }
+        }
+        /* other threads have set their own error code in the meantime */
+        if (base_errno != state->err ||
+                opcode_get_cpu_type() != state->cpu_type) {
+            state->errors++;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Test using the opcode tables and base_errno from multiple threads
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_threads(testcase_t *self)
+{
+    pthread_t threads[base_array_len(thread_states)];
+    int errors = 0;
+
+    for (size_t t = 0; t < base_array_len(thread_states); t++) {
+        opcode_set_cpu_type(thread_states[t].cpu_type);
+        for (int opc = 0; opc < 0x100; opc++) {
+            thread_expected[t][opc] = opcode_get_mnemonic_id(opc);
+        }
+        thread_states[t].errors = 0;
+    }
+    opcode_set_cpu_type(CPU_65XX);
+    base_errno = BASE_ERR_OK;
+
+    printf("... running %zu threads ..\n", base_array_len(thread_states));
+    for (size_t t = 0; t < base_array_len(thread_states); t++) {
+        if (pthread_create(&threads[t], NULL, opcode_thread, &thread_states[t]) != 0) {
+            fprintf(stderr, "%s(): failed to create thread\n", __func__);
+            return false;
+        }
+    }
+    for (size_t t = 0; t < base_array_len(thread_states); t++) {
+        pthread_join(threads[t], NULL);
+        errors += thread_states[t].errors;
+    }
+    printf("... %d errors\n", errors);
+    testcase_assert_true(self, errors == 0);
+
+    printf("... checking the main thread's state is untouched ..\n");
+    testcase_assert_true(self,
+                         opcode_get_cpu_type() == CPU_65XX &&
+                         base_errno == BASE_ERR_OK);
+    return true;
+}
+
+
 /** \brief  Create test group 'base/cpu'
  *
  * \return  test group
@@ -184,6 +296,11 @@ testgroup_t *get_base_cpu_tests(void)
                         test_mnemonic_id, NULL, NULL);
     testgroup_add_case(group, test);
 
+    test = testcase_new("threads",
+                        "Test using the opcode tables from multiple threads",
+                        2, test_threads, NULL, NULL);
+    testgroup_add_case(group, test);
+
 
     return group;
 }
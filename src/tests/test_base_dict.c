@@ -30,6 +30,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "testcase.h"
 #include "../base/dict.h"
+#include "../base/dict_open.h"
 #include "../base/error.h"
 #include "../base/mem.h"
 
@@ -49,6 +50,12 @@ static bool setup(void)
     return true;
 }
 
+static bool setup_open(void)
+{
+    dict = dict_new_backend(DICT_BACKEND_OPEN, 0);
+    return true;
+}
+
 static bool teardown(void)
 {
     if (dict != NULL) {
@@ -305,6 +312,9 @@ static bool test_keys(testcase_t *self)
 
     /* test #8: test dict_keys() */
     printf("... testing dict_keys(): requesting list of keys\n");
+    for (i = 0; i < (int)(base_array_len(keys_tests)); i++) {
+        keys_tests[i].found = 0;
+    }
     keys = dict_keys(dict);
     printf("..... ");
     print_keys(keys);
@@ -385,6 +395,413 @@ static bool test_remove(testcase_t *self)
 }
 
 
+/** \brief  Number of items used for the grow test
+ *
+ * Chosen so the dict is still moving items to the new hashmap after adding
+ * the items, to test lookups and removals during rehashing.
+ */
+#define GROW_COUNT  35000
+
+
+/** \brief  Test growing the hashmap
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_grow(testcase_t *self)
+{
+    char key[32];
+    size_t initial = dict->size;
+    bool found = true;
+    int value;
+
+    printf("... adding %d items ..\n", GROW_COUNT);
+    for (int i = 0; i < GROW_COUNT; i++) {
+        snprintf(key, sizeof key, "sym%d", i);
+        if (!dict_set_int(dict, key, i)) {
+            return false;
+        }
+    }
+    if (dict->open != NULL) {
+        printf("... dict_size() = %zu, table capacity %zu\n",
+               dict_size(dict), dict->open->capacity);
+        testcase_assert_true(self,
+                             dict_size(dict) == GROW_COUNT &&
+                             dict->open->capacity > GROW_COUNT);
+    } else {
+        printf("... dict_size() = %zu, hashmap size %zu -> %zu (%s)\n",
+               dict_size(dict), initial, dict->size,
+               dict->old_items != NULL ? "rehashing" : "not rehashing");
+        testcase_assert_true(self,
+                             dict_size(dict) == GROW_COUNT &&
+                             dict->size >= GROW_COUNT / 2);
+    }
+
+    printf("... checking all items are found ..\n");
+    for (int i = 0; i < GROW_COUNT; i++) {
+        snprintf(key, sizeof key, "sym%d", i);
+        if (!dict_get_int(dict, key, &value) || value != i) {
+            printf("... '%s' not found or wrong value\n", key);
+            found = false;
+            break;
+        }
+    }
+    testcase_assert_true(self, found);
+
+    printf("... removing every other item ..\n");
+    for (int i = 0; i < GROW_COUNT; i += 2) {
+        snprintf(key, sizeof key, "sym%d", i);
+        dict_remove(dict, key);
+    }
+    found = dict_size(dict) == GROW_COUNT / 2;
+    for (int i = 0; i < GROW_COUNT && found; i++) {
+        snprintf(key, sizeof key, "sym%d", i);
+        found = dict_has_key(dict, key) == ((i & 1) != 0);
+    }
+    testcase_assert_true(self, found);
+    return true;
+}
+
+
+/** \brief  Test dict_new_size()
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_new_size(testcase_t *self)
+{
+    dict_t *tmpdict;
+    char key[32];
+    bool grown = false;
+
+    printf("... creating dict with dict_new_size(5000)\n");
+    tmpdict = dict_new_size(5000);
+    printf("... dict hashmap size = %zu\n", tmpdict->size);
+    testcase_assert_true(self, tmpdict->size >= 5000);
+
+    printf("... adding 5000 items, checking hashmap doesn't grow ..\n");
+    for (int i = 0; i < 5000; i++) {
+        snprintf(key, sizeof key, "sym%d", i);
+        dict_set_int(tmpdict, key, i);
+        if (tmpdict->old_items != NULL) {
+            grown = true;
+        }
+    }
+    testcase_assert_false(self, grown);
+    dict_free(tmpdict);
+    return true;
+}
+
+
+/** \brief  Test replacing the value of an existing item
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_replace(testcase_t *self)
+{
+    int value = 0;
+    char *str = NULL;
+
+    dict_set_int(dict, "foo", 1);
+    dict_set_int(dict, "foo", 2);
+    dict_get_int(dict, "foo", &value);
+    printf("... 'foo' = %d, expected 2\n", value);
+    testcase_assert_true(self, value == 2 && dict_size(dict) == 1);
+
+    dict_set_str(dict, "foo", "bar");
+    dict_get_str(dict, "foo", &str);
+    printf("... 'foo' = '%s', expected 'bar'\n", str);
+    testcase_assert_true(self, strcmp(str, "bar") == 0 && dict_size(dict) == 1);
+    return true;
+}
+
+
+/** \brief  Test the dict_*_hashed() functions
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_hashed(testcase_t *self)
+{
+    dict_value_t value = NULL;
+    uint32_t hash;
+    bool result;
+
+    hash = dict_hash_key("label");
+    printf("... dict_hash_key(\"label\") = $%08"PRIx32"\n", hash);
+
+    printf("... setting 'label' with dict_set_hashed() ..\n");
+    dict_set_hashed(dict, "label", hash, DICT_INT_TO_VALUE(42), DICT_ITEM_INT);
+    result = dict_get(dict, "label", &value, NULL);
+    testcase_assert_true(self, result && DICT_VALUE_TO_INT(value) == 42);
+
+    printf("... getting 'label' with dict_get_hashed() ..\n");
+    value = NULL;
+    result = dict_get_hashed(dict, "label", hash, &value, NULL);
+    testcase_assert_true(self, result && DICT_VALUE_TO_INT(value) == 42);
+
+    /* the stored hash is compared before the key, so a wrong hash must not
+     * match even though the key does */
+    printf("... getting 'label' with a wrong hash (should fail) ..\n");
+    result = dict_has_key_hashed(dict, "label", hash ^ 1u);
+    testcase_assert_false(self, result);
+    return true;
+}
+
+
+/** \brief  Test iterating a dict
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_iter(testcase_t *self)
+{
+    dict_iter_t iter;
+    const char *key;
+    dict_value_t value;
+    int count = 0;
+    int sum = 0;
+
+    printf("... adding items to the dict:\n");
+    if (!add_keys_tests()) {
+        return false;
+    }
+
+    printf("... iterating:");
+    dict_iter_init(&iter, dict);
+    while (dict_iter_next(&iter, &key, &value, NULL)) {
+        printf(" '%s'", key);
+        count++;
+        sum += DICT_VALUE_TO_INT(value);
+    }
+    printf("\n... %d items, sum of values = %d\n", count, sum);
+    testcase_assert_true(self,
+                         count == (int)(base_array_len(keys_tests)) &&
+                         sum == 1 + 2 + 3 + 4 + 5);
+    return true;
+}
+
+
+/** \brief  Check keys of the test dict against \a expected
+ *
+ * \param[in]   expected    `NULL`-terminated list of keys in expected order
+ *
+ * \return  `true` if the keys match in order
+ */
+static bool keys_in_order(const char **expected)
+{
+    const char **keys = dict_keys(dict);
+    bool result = true;
+    int i;
+
+    printf("..... ");
+    print_keys(keys);
+    for (i = 0; keys[i] != NULL && expected[i] != NULL; i++) {
+        if (strcmp(keys[i], expected[i]) != 0) {
+            result = false;
+        }
+    }
+    if (keys[i] != NULL || expected[i] != NULL) {
+        result = false;
+    }
+    base_free(keys);
+    return result;
+}
+
+
+/** \brief  Test insertion order of the open addressing backend
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_order(testcase_t *self)
+{
+    const char *initial[] = { "one", "two", "three", "four", "five", NULL };
+    const char *reordered[] = { "one", "three", "four", "five", "two", NULL };
+
+    printf("... adding items to the dict:\n");
+    if (!add_keys_tests()) {
+        return false;
+    }
+    printf("... checking keys are in insertion order:\n");
+    testcase_assert_true(self, keys_in_order(initial));
+
+    printf("... removing and adding 'two' again:\n");
+    dict_remove(dict, "two");
+    dict_set_int(dict, "two", 2);
+    testcase_assert_true(self, keys_in_order(reordered));
+
+    printf("... compacting:\n");
+    dict_compact(dict);
+    testcase_assert_true(self,
+                         keys_in_order(reordered) &&
+                         dict->open->entries_used == dict->open->count &&
+                         dict->open->keys_dead == 0);
+    return true;
+}
+
+
+/** \brief  Number of insert/remove cycles of the churn test
+ */
+#define CHURN_COUNT 20000
+
+
+/** \brief  Test memory use of keys with a remove/insert workload
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_churn(testcase_t *self)
+{
+    char key[32];
+    int value = -1;
+
+    printf("... adding and removing %d keys ..\n", CHURN_COUNT);
+    dict_set_int(dict, "permanent", 42);
+    for (int i = 0; i < CHURN_COUNT; i++) {
+        snprintf(key, sizeof key, "churn%d", i);
+        dict_set_int(dict, key, i);
+        dict_remove(dict, key);
+    }
+    printf("... %zu bytes of keys, %zu of removed keys\n",
+           dict->open->keys_size, dict->open->keys_dead);
+    testcase_assert_true(self,
+                         dict->open->keys_size < 1024u &&
+                         dict_get_int(dict, "permanent", &value) && value == 42);
+
+    printf("... compacting ..\n");
+    dict_compact(dict);
+    testcase_assert_true(self,
+                         dict->open->keys_dead == 0 &&
+                         dict->open->keys_size == sizeof "permanent" &&
+                         dict_get_int(dict, "permanent", &value) && value == 42);
+    return true;
+}
+
+
+/** \brief  Number of items used by the batch tests
+ *
+ * Not a multiple of the batch size, so the last batch is a partial one.
+ */
+#define MANY_COUNT  100
+
+
+/** \brief  Test dict_set_many() and dict_get_many()
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_many(testcase_t *self)
+{
+    char names[MANY_COUNT + 2][24];
+    const char *keys[MANY_COUNT + 3];
+    dict_value_t values[MANY_COUNT + 3];
+    dict_type_t types[MANY_COUNT + 3];
+    size_t found;
+    bool result;
+
+    for (int i = 0; i < MANY_COUNT + 2; i++) {
+        snprintf(names[i], sizeof names[i], "label%d", i);
+        keys[i] = names[i];
+        values[i] = DICT_INT_TO_VALUE(i * 3);
+    }
+
+    printf("... setting %d items with dict_set_many() ..\n", MANY_COUNT);
+    result = dict_set_many(dict, keys, values, MANY_COUNT, DICT_ITEM_INT);
+    testcase_assert_true(self, result && dict_size(dict) == MANY_COUNT);
+
+    /* two keys that aren't in the dict and an empty one */
+    keys[MANY_COUNT + 2] = "";
+    memset(values, 0, sizeof values);
+    printf("... getting %d items with dict_get_many() ..\n", MANY_COUNT + 3);
+    found = dict_get_many(dict, keys, MANY_COUNT + 3, values, types);
+    printf("... found %zu items\n", found);
+    result = found == MANY_COUNT;
+    for (int i = 0; i < MANY_COUNT; i++) {
+        if (types[i] != DICT_ITEM_INT || DICT_VALUE_TO_INT(values[i]) != i * 3) {
+            printf("... '%s': wrong value or type\n", keys[i]);
+            result = false;
+        }
+    }
+    testcase_assert_true(self, result);
+
+    printf("... checking missing keys ..\n");
+    result = true;
+    for (int i = MANY_COUNT; i < MANY_COUNT + 3; i++) {
+        if (types[i] != DICT_ITEM_ERR || values[i] != NULL) {
+            result = false;
+        }
+    }
+    testcase_assert_true(self, result);
+    return true;
+}
+
+
+/** \brief  Number of items used by the stats test
+ */
+#define STATS_COUNT 1000
+
+
+/** \brief  Test dict_get_stats()
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_stats(testcase_t *self)
+{
+    dict_stats_t stats;
+    char key[32];
+    size_t total = 0;
+
+    for (int i = 0; i < STATS_COUNT; i++) {
+        snprintf(key, sizeof key, "label%d", i);
+        dict_set_int(dict, key, i);
+    }
+    /* all keys, then half as many missing keys */
+    for (int i = 0; i < STATS_COUNT + STATS_COUNT / 2; i++) {
+        snprintf(key, sizeof key, "label%d", i);
+        dict_has_key(dict, key);
+    }
+
+    dict_dump_stats(dict);
+    dict_get_stats(dict, &stats);
+    for (size_t i = 0; i < DICT_STATS_PROBES; i++) {
+        total += stats.probes[i];
+    }
+    printf("... checking structure ..\n");
+    testcase_assert_true(self,
+                         stats.count == STATS_COUNT && total == STATS_COUNT &&
+                         stats.max_probe >= 1 && stats.avg_probe >= 1.0 &&
+                         stats.load_factor > 0.0 && stats.load_factor <= 1.0 &&
+                         stats.collisions == STATS_COUNT - stats.probes[0]);
+
+    printf("... checking the table grew ..\n");
+    testcase_assert_true(self, stats.rehashes > 0);
+
+    printf("... checking lookup counters ..\n");
+#ifdef HAVE_DICT_STATS
+    testcase_assert_true(self,
+                         stats.counters &&
+                         stats.lookups == STATS_COUNT + STATS_COUNT / 2 &&
+                         stats.hits == STATS_COUNT &&
+                         stats.misses == STATS_COUNT / 2);
+#else
+    testcase_assert_true(self, !stats.counters && stats.lookups == 0);
+#endif
+    return true;
+}
+
+
 /** \brief  Create test group 'base/dict'
  *
  * \return  test group
@@ -418,5 +835,99 @@ testgroup_t *get_base_dict_tests(void)
                         3, test_remove, setup, teardown);
     testgroup_add_case(group, test);
 
+    test = testcase_new("replace",
+                        "Test replacing values",
+                        2, test_replace, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("grow",
+                        "Test growing the hashmap",
+                        3, test_grow, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("hashed",
+                        "Test the dict_*_hashed() functions",
+                        3, test_hashed, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("hashed_open",
+                        "Test the dict_*_hashed() functions with the open"
+                        " addressing backend",
+                        3, test_hashed, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("iter",
+                        "Test iterating a dict",
+                        1, test_iter, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("iter_open",
+                        "Test iterating a dict with the open addressing"
+                        " backend",
+                        1, test_iter, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("order_open",
+                        "Test insertion order of the open addressing backend",
+                        3, test_order, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("churn_open",
+                        "Test reclaiming removed keys of the open addressing"
+                        " backend",
+                        2, test_churn, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("set_open",
+                        "Test dict_set() with the open addressing backend",
+                        8, test_set, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("keys_open",
+                        "Test dict_keys() and dict_has_key() with the open"
+                        " addressing backend",
+                        8, test_keys, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("remove_open",
+                        "Test dict_remove() with the open addressing backend",
+                        3, test_remove, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("replace_open",
+                        "Test replacing values with the open addressing backend",
+                        2, test_replace, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("grow_open",
+                        "Test growing the open addressing backend",
+                        3, test_grow, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("many",
+                        "Test batched lookups",
+                        3, test_many, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("many_open",
+                        "Test batched lookups with the open addressing backend",
+                        3, test_many, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("stats",
+                        "Test dict statistics",
+                        3, test_stats, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("stats_open",
+                        "Test dict statistics with the open addressing backend",
+                        3, test_stats, setup_open, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("new_size",
+                        "Test dict_new_size()",
+                        2, test_new_size, NULL, NULL);
+    testgroup_add_case(group, test);
+
     return group;
 }
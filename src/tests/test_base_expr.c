@@ -0,0 +1,268 @@
+/** \file   test_base_expr.c
+ * \brief   Unit tests for base/expr.c
+ *
+ * Unit tests for the expression compiler and evaluator.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../base/error.h"
+#include "../base/expr.h"
+#include "../base/mem.h"
+#include "testcase.h"
+
+#include "test_base_expr.h"
+
+
+/** \brief  Symbol names for the tests, the index is the slot
+ */
+static const char *symbol_names[] = { "label", "zp", "undef" };
+
+/** \brief  Symbol values for the tests
+ */
+static const int32_t symbol_values[] = { 0x1234, 0xfb, 0 };
+
+/** \brief  Symbol defined flags for the tests
+ */
+static const bool symbol_defined[] = { true, true, false };
+
+/** \brief  Symbol environment for the evaluator
+ */
+static const expr_env_t env = {
+    symbol_values, symbol_defined, sizeof symbol_values / sizeof symbol_values[0]
+};
+
+
+/** \brief  Object for compile/evaluate tests
+ */
+typedef struct eval_test_s {
+    const char *    text;       /**< expression text */
+    int32_t         value;      /**< expected value */
+    bool            constant;   /**< expected to be folded into a constant */
+    size_t          len;        /**< expected number of characters compiled */
+} eval_test_t;
+
+
+/** \brief  Compile/evaluate tests
+ */
+static const eval_test_t eval_tests[] = {
+    { "42",                     42,         true,   2 },
+    { "$ff+1",                  0x100,      true,   5 },
+    { "1+2*3",                  7,          true,   5 },
+    { "(1+2)*3",                9,          true,   7 },
+    { "10-4-3",                 3,          true,   6 },
+    { "-%101",                  -5,         true,   5 },
+    { "<label",                 0x34,       false,  6 },
+    { ">label",                 0x12,       false,  6 },
+    { "label+2*8",              0x1244,     false,  9 },
+    { "(zp),y",                 0xfb,       false,  4 },
+    { "zp),y",                  0xfb,       false,  2 },
+    { "zp , x",                 0xfb,       false,  3 },
+    { "label % 256",            0x34,       false,  11 },
+    { "1 << 4 | 1",             17,         true,   10 },
+    { "!0 && label >= $1000",   1,          false,  20 },
+    { "~0",                     -1,         true,   2 },
+    { "- - 3",                  3,          true,   5 },
+    { "'a'+1",                  0x62,       true,   5 }
+};
+
+
+/** \brief  Object for compile error tests
+ */
+typedef struct error_test_s {
+    const char *    text;   /**< expression text */
+    int             err;    /**< expected error code */
+} error_test_t;
+
+
+/** \brief  Compile error tests
+ */
+static const error_test_t error_tests[] = {
+    { "",           BASE_ERR_EMPTY },
+    { "1+",         BASE_ERR_SYNTAX },
+    { "(1+2",       BASE_ERR_SYNTAX },
+    { "foo",        BASE_ERR_UNDEF },
+    { "1/0",        BASE_ERR_RANGE },
+    { "$",          BASE_ERR_EMPTY }
+};
+
+
+/** \brief  Symbol resolver for the tests
+ *
+ * \param[in]   name    symbol name
+ * \param[in]   len     length of \a name
+ * \param[out]  slot    slot index
+ * \param[in]   data    unused
+ *
+ * \return  `true` if found
+ */
+static bool resolve_symbol(const char *name, size_t len, uint32_t *slot, void *data)
+{
+    (void)data;
+    for (size_t i = 0; i < base_array_len(symbol_names); i++) {
+        if (strlen(symbol_names[i]) == len &&
+                strncmp(symbol_names[i], name, len) == 0) {
+            *slot = (uint32_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** \brief  Test compiling and evaluating expressions
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_eval(testcase_t *self)
+{
+    expr_code_t code;
+
+    expr_code_init(&code);
+    for (size_t i = 0; i < base_array_len(eval_tests); i++) {
+        const eval_test_t *test = &eval_tests[i];
+        const char *end;
+        expr_t expr;
+        int32_t value = 0;
+        bool constant;
+        bool ok;
+
+        ok = expr_compile(&code, test->text, &end, resolve_symbol, NULL, &expr);
+        if (ok) {
+            constant = expr_is_const(&code, &expr, NULL);
+            ok = expr_eval(&code, &expr, &env, &value);
+        } else {
+            constant = false;
+        }
+        printf("... \"%s\" = %"PRId32" (%s, %zu chars), expected %"PRId32
+               " (%s, %zu chars)\n",
+               test->text, value, constant ? "const" : "non-const",
+               (size_t)(end - test->text), test->value,
+               test->constant ? "const" : "non-const", test->len);
+        testcase_assert_true(self,
+                             ok && value == test->value &&
+                             constant == test->constant &&
+                             (size_t)(end - test->text) == test->len);
+    }
+    expr_code_free(&code);
+    return true;
+}
+
+
+/** \brief  Test compiler errors
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_errors(testcase_t *self)
+{
+    expr_code_t code;
+
+    expr_code_init(&code);
+    for (size_t i = 0; i < base_array_len(error_tests); i++) {
+        const error_test_t *test = &error_tests[i];
+        expr_t expr;
+        bool ok;
+
+        base_errno = 0;
+        ok = expr_compile(&code, test->text, NULL, resolve_symbol, NULL, &expr);
+        printf("... \"%s\": result = %s, error %d ('%s'), expected %d ('%s')\n",
+               test->text, ok ? "true" : "false",
+               base_errno, base_strerror(base_errno),
+               test->err, base_strerror(test->err));
+        testcase_assert_true(self, !ok && base_errno == test->err);
+    }
+    printf("... checking arena is empty after failed compiles: %zu bytes used\n",
+           code.used);
+    testcase_assert_equal(self, (int)code.used, 0);
+    expr_code_free(&code);
+    return true;
+}
+
+
+/** \brief  Test evaluating an expression with an undefined symbol
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_undefined(testcase_t *self)
+{
+    expr_code_t code;
+    expr_t expr;
+    int32_t value;
+    bool ok;
+
+    expr_code_init(&code);
+    printf("... compiling \"label+undef\" ..\n");
+    ok = expr_compile(&code, "label+undef", NULL, resolve_symbol, NULL, &expr);
+    testcase_assert_true(self, ok);
+
+    base_errno = 0;
+    ok = expr_eval(&code, &expr, &env, &value);
+    printf("... evaluating: result = %s, error %d ('%s')\n",
+           ok ? "true" : "false", base_errno, base_strerror(base_errno));
+    testcase_assert_true(self, !ok && base_errno == BASE_ERR_UNDEF);
+    expr_code_free(&code);
+    return true;
+}
+
+
+/** \brief  Create test group 'base/expr'
+ *
+ * \return  test group
+ */
+testgroup_t *get_base_expr_tests(void)
+{
+    testgroup_t *group;
+    testcase_t *test;
+
+    group = testgroup_new("base/expr",
+                          "Test the base/expr module",
+                          NULL, NULL);
+
+    test = testcase_new("eval",
+                        "Test compiling and evaluating expressions",
+                        (int)(base_array_len(eval_tests)),
+                        test_eval, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("errors",
+                        "Test expression compiler errors",
+                        (int)(base_array_len(error_tests)) + 1,
+                        test_errors, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("undefined",
+                        "Test evaluating undefined symbols",
+                        2, test_undefined, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    return group;
+}
@@ -0,0 +1,215 @@
+/** \file   test_base_hash.c
+ * \brief   Unit tests for base/hash.c
+ *
+ * Unit tests for the hash functions.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../base/hash.h"
+#include "../base/mem.h"
+#include "testcase.h"
+
+#include "test_base_hash.h"
+
+
+/** \brief  Object for hash tests
+ */
+typedef struct hash_test_s {
+    const char *    text;   /**< text to hash */
+    uint64_t        seed;   /**< seed (XXH64 only) */
+    uint64_t        hash;   /**< expected hash */
+} hash_test_t;
+
+
+/** \brief  FNV-1a 32-bit test vectors
+ */
+static const hash_test_t fnv1_tests[] = {
+    { "",               0,  0x811c9dc5u },
+    { "a",              0,  0xe40c292cu },
+    { "foobar",         0,  0xbf9cf968u }
+};
+
+/** \brief  XXH64 test vectors
+ */
+static const hash_test_t xx64_tests[] = {
+    { "",               0,              0xef46db3751d8e999u },
+    { "a",              0,              0xd24ec4f1a98c6e5bu },
+    { "abc",            0,              0x44bc2cf5ad770999u },
+    { "start_label",    0,              0x28d8938848f72fa5u },
+    { "",               0x9e3779b1u,    0xac75fda2929b17efu },
+    { "abc",            0x9e3779b1u,    0x1318df30094a85fdu }
+};
+
+
+/** \brief  Size of the buffer used for the long input tests
+ */
+#define LONG_SIZE   1024
+
+/** \brief  XXH64 of the long test input with seed 0
+ */
+#define LONG_HASH   0x6f3914f18fe4df57u
+
+
+/** \brief  Fill \a buffer with the long test input
+ *
+ * \param[out]  buffer  buffer of #LONG_SIZE bytes
+ */
+static void fill_long(uint8_t *buffer)
+{
+    for (size_t i = 0; i < LONG_SIZE; i++) {
+        buffer[i] = (uint8_t)i;
+    }
+}
+
+
+/** \brief  Test FNV-1a hash
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_fnv1(testcase_t *self)
+{
+    for (size_t i = 0; i < base_array_len(fnv1_tests); i++) {
+        const hash_test_t *test = &fnv1_tests[i];
+        uint32_t hash;
+
+        hash = hash_fnv1_32((const uint8_t *)test->text, strlen(test->text));
+        printf("... \"%s\": $%08"PRIx32" (expected $%08"PRIx64")\n",
+               test->text, hash, test->hash);
+        testcase_assert_true(self, hash == test->hash);
+    }
+    return true;
+}
+
+
+/** \brief  Test XXH64 hash
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_xx64(testcase_t *self)
+{
+    uint8_t buffer[LONG_SIZE];
+    uint64_t hash;
+
+    for (size_t i = 0; i < base_array_len(xx64_tests); i++) {
+        const hash_test_t *test = &xx64_tests[i];
+
+        hash = hash_xx64(test->text, strlen(test->text), test->seed);
+        printf("... \"%s\", seed $%"PRIx64": $%016"PRIx64" (expected $%016"PRIx64")\n",
+               test->text, test->seed, hash, test->hash);
+        testcase_assert_true(self, hash == test->hash);
+    }
+
+    fill_long(buffer);
+    hash = hash_xx64(buffer, sizeof buffer, 0);
+    printf("... %d bytes: $%016"PRIx64" (expected $%016"PRIx64")\n",
+           LONG_SIZE, hash, LONG_HASH);
+    testcase_assert_true(self, hash == LONG_HASH);
+    return true;
+}
+
+
+/** \brief  Test streaming XXH64 against the one-shot function
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_xx64_stream(testcase_t *self)
+{
+    uint8_t buffer[LONG_SIZE];
+    hash_xx64_t state;
+    bool result = true;
+
+    fill_long(buffer);
+
+    /* every prefix length, fed in pieces of every size from 1 to 40 bytes,
+     * so the buffering is exercised at all offsets */
+    printf("... hashing prefixes in pieces of 1-40 bytes ..\n");
+    for (size_t piece = 1; piece <= 40 && result; piece++) {
+        for (size_t len = 0; len <= 100; len++) {
+            hash_xx64_init(&state, 42);
+            for (size_t pos = 0; pos < len; pos += piece) {
+                size_t n = len - pos < piece ? len - pos : piece;
+
+                hash_xx64_update(&state, buffer + pos, n);
+            }
+            if (hash_xx64_final(&state) != hash_xx64(buffer, len, 42)) {
+                printf("... mismatch: length %zu, pieces of %zu\n", len, piece);
+                result = false;
+                break;
+            }
+        }
+    }
+    testcase_assert_true(self, result);
+
+    printf("... hashing %d bytes in uneven pieces ..\n", LONG_SIZE);
+    hash_xx64_init(&state, 0);
+    hash_xx64_update(&state, buffer, 7);
+    hash_xx64_update(&state, buffer + 7, 500);
+    hash_xx64_update(&state, buffer + 507, 0);
+    hash_xx64_update(&state, buffer + 507, LONG_SIZE - 507);
+    testcase_assert_true(self, hash_xx64_final(&state) == LONG_HASH);
+    return true;
+}
+
+
+/** \brief  Create test group 'base/hash'
+ *
+ * \return  test group
+ */
+testgroup_t *get_base_hash_tests(void)
+{
+    testgroup_t *group;
+    testcase_t *test;
+
+    group = testgroup_new("base/hash",
+                          "Test the base/hash module",
+                          NULL, NULL);
+
+    test = testcase_new("fnv1",
+                        "Test the FNV-1a hash",
+                        (int)(base_array_len(fnv1_tests)),
+                        test_fnv1, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("xx64",
+                        "Test the XXH64 hash",
+                        (int)(base_array_len(xx64_tests)) + 1,
+                        test_xx64, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("xx64_stream",
+                        "Test the streaming XXH64 hash",
+                        2, test_xx64_stream, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    return group;
+}
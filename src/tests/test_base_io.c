@@ -21,11 +21,18 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+/* for mkdir(), chmod() and opendir() */
+#define _XOPEN_SOURCE 700
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "testcase.h"
 #include "../base/error.h"
@@ -39,6 +46,30 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #define TEXT_TEST_FILE  "src/base/io/txtfile.c"
 
+/** \brief  Test file for output image handling
+ */
+#define IMAGE_TEST_FILE "test_image.prg"
+
+/** \brief  Test file for binary file writing
+ */
+#define BIN_TEST_FILE   "test_binfile.bin"
+
+/** \brief  Directory the binary file writing test tries to replace
+ */
+#define BIN_TEST_DIR    "test_binfile.dir"
+
+/** \brief  Test file for the text file cache
+ */
+#define CACHE_TEST_FILE "test_txtcache.s"
+
+/** \brief  Test file with CR+LF line endings for the text file cache
+ */
+#define CRLF_TEST_FILE  "test_txtcache_crlf.s"
+
+/** \brief  Prefix of the test files for output image segments
+ */
+#define IMAGE_TEST_PREFIX   "test_image_"
+
 
 /** \brief  Test the binary file I/O
  *
@@ -76,6 +107,95 @@ static bool test_binfile(testcase_t *self)
 }
 
 
+/** \brief  Check the current directory for temporary files of \a path
+ *
+ * \param[in]   path    path of a file in the current directory
+ *
+ * \return  `true` if a file named \a path followed by a dot and ending in a
+ *          tilde exists
+ */
+static bool temp_file_left(const char *path)
+{
+    DIR *dir = opendir(".");
+    struct dirent *entry;
+    size_t len = strlen(path);
+    bool found = false;
+
+    if (dir == NULL) {
+        return false;
+    }
+    while (!found && (entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        size_t name_len = strlen(name);
+
+        found = name_len > len + 1u &&
+                strncmp(name, path, len) == 0 &&
+                name[len] == '.' &&
+                name[name_len - 1u] == '~';
+    }
+    closedir(dir);
+    return found;
+}
+
+
+/** \brief  Test writing binary files
+ *
+ * \param[in]   self    test case
+ *
+ * \return  bool
+ */
+static bool test_binfile_write(testcase_t *self)
+{
+    static const uint8_t header[] = { 0x01, 0x08 };
+    static const uint8_t code[] = { 0xa9, 0x00, 0x8d, 0x20, 0xd0, 0x60 };
+    const base_binfile_part_t parts[] = {
+        { header, sizeof header },
+        { NULL, 0 },
+        { code, sizeof code }
+    };
+    struct stat st;
+    uint8_t *data = NULL;
+    long size;
+    bool ok;
+
+    printf("... writing two parts to '%s' ..\n", BIN_TEST_FILE);
+    /* write something else first, to check it gets replaced and keeps its
+     * permissions */
+    base_binfile_write(BIN_TEST_FILE, code, 2, false);
+    chmod(BIN_TEST_FILE, 0640);
+    ok = base_binfile_write_parts(BIN_TEST_FILE, parts, base_array_len(parts), true);
+    size = base_binfile_read(BIN_TEST_FILE, &data);
+    printf("... read back %ld bytes\n", size);
+    testcase_assert_true(self,
+                         ok && size == 8 &&
+                         memcmp(data, header, 2) == 0 &&
+                         memcmp(data + 2, code, 6) == 0 &&
+                         stat(BIN_TEST_FILE, &st) == 0 &&
+                         (st.st_mode & 0777) == 0640);
+    if (size >= 0) {
+        base_free(data);
+    }
+    remove(BIN_TEST_FILE);
+
+    printf("... writing to a non-existent directory ..\n");
+    base_errno = 0;
+    ok = base_binfile_write("foo-bar-huppel/" BIN_TEST_FILE, code, 6, false);
+    testcase_assert_true(self, !ok && base_errno == BASE_ERR_IO);
+
+    /* the temporary file is written, but can't be renamed over a directory */
+    printf("... replacing directory '%s' (should fail) ..\n", BIN_TEST_DIR);
+    mkdir(BIN_TEST_DIR, 0755);
+    base_errno = 0;
+    ok = base_binfile_write(BIN_TEST_DIR, code, 6, false);
+    testcase_assert_true(self,
+                         !ok && base_errno == BASE_ERR_IO &&
+                         !temp_file_left(BIN_TEST_DIR));
+    rmdir(BIN_TEST_DIR);
+
+    return true;
+}
+
+
 /** \brief  Test the text file I/O
  *
  * \param[in]   self    test case
@@ -140,6 +260,267 @@ static bool test_txtfile(testcase_t *self)
 }
 
 
+/** \brief  Read \a path both directly and through \a cache and compare lines
+ *
+ * \param[in,out]   cache   text file cache
+ * \param[in]       path    path to file
+ * \param[out]      lines   number of lines read
+ *
+ * \return  `true` if both return the same lines and reach EOF together
+ */
+static bool compare_cached(txtcache_t *cache, const char *path, long *lines)
+{
+    txtfile_t plain;
+    txtfile_t cached;
+    const char *line1;
+    const char *line2;
+    bool ok = true;
+
+    *lines = 0;
+    if (!txtfile_open(&plain, path)) {
+        return false;
+    }
+    if (!txtfile_open_cached(&cached, cache, path)) {
+        txtfile_close(&plain);
+        return false;
+    }
+
+    do {
+        line1 = txtfile_readline(&plain);
+        line2 = txtfile_readline(&cached);
+        if ((line1 == NULL) != (line2 == NULL) ||
+                (line1 != NULL &&
+                 (strcmp(line1, line2) != 0 ||
+                  txtfile_get_linelen(&plain) != txtfile_get_linelen(&cached) ||
+                  strcmp(txtfile_get_text(&cached), line2) != 0))) {
+            ok = false;
+        }
+    } while (ok && line1 != NULL);
+
+    ok = ok && txtfile_get_eof(&plain) && txtfile_get_eof(&cached) &&
+         txtfile_get_linenum(&plain) == txtfile_get_linenum(&cached);
+    *lines = txtfile_get_linenum(&cached);
+    txtfile_close(&plain);
+    txtfile_close(&cached);
+    return ok;
+}
+
+
+/** \brief  Test the text file cache
+ *
+ * \param[in]   self    test case
+ *
+ * \return  bool
+ */
+static bool test_txtcache(testcase_t *self)
+{
+    static const char text1[] = "lda #0\nrts\n";
+    static const char text2[] = "lda #0\r\nsta $d020\r\nrts";
+    /* CR+LF, an empty line, a CR inside a line and no final newline */
+    static const char text3[] = "lda #$00\r\n\r\n.text \"a\rb\"\r\nrts";
+    txtcache_t cache;
+    const txtcache_file_t *file1;
+    const txtcache_file_t *file2;
+    long lines;
+    bool ok;
+
+    txtcache_init(&cache);
+
+    printf("... getting '%s' twice, through different paths ..\n",
+           TEXT_TEST_FILE);
+    file1 = txtcache_get(&cache, TEXT_TEST_FILE);
+    file2 = txtcache_get(&cache, "./src/../" TEXT_TEST_FILE);
+    printf("... %zu lines, %zu hits, %zu misses\n",
+           file1 != NULL ? file1->line_count : 0, cache.hits, cache.misses);
+    testcase_assert_true(self,
+                         file1 != NULL && file1 == file2 &&
+                         cache.hits == 1 && cache.misses == 1);
+
+    printf("... comparing cached and uncached lines ..\n");
+    ok = compare_cached(&cache, TEXT_TEST_FILE, &lines);
+    testcase_assert_true(self, ok && lines > 0);
+    printf("... %zu hits, %zu misses\n", cache.hits, cache.misses);
+    testcase_assert_true(self, cache.hits == 2 && cache.misses == 1);
+
+    printf("... comparing lines of '%s' (CR+LF, no final newline) ..\n",
+           CRLF_TEST_FILE);
+    base_binfile_write(CRLF_TEST_FILE, (const uint8_t *)text3,
+                       sizeof text3 - 1u, false);
+    ok = compare_cached(&cache, CRLF_TEST_FILE, &lines);
+    printf("... %ld lines\n", lines);
+    testcase_assert_true(self, ok && lines == 4);
+    remove(CRLF_TEST_FILE);
+
+    printf("... changing '%s' ..\n", CACHE_TEST_FILE);
+    base_binfile_write(CACHE_TEST_FILE, (const uint8_t *)text1,
+                       sizeof text1 - 1u, false);
+    file1 = txtcache_get(&cache, CACHE_TEST_FILE);
+    base_binfile_write(CACHE_TEST_FILE, (const uint8_t *)text2,
+                       sizeof text2 - 1u, false);
+    file2 = txtcache_get(&cache, CACHE_TEST_FILE);
+    printf("... %zu reloads\n", cache.reloads);
+    testcase_assert_true(self,
+                         file1 != NULL && file2 != NULL && file1 != file2 &&
+                         cache.reloads == 1 &&
+                         file1->line_count == 2 &&
+                         strcmp(txtcache_line(file1, 1), "rts") == 0 &&
+                         file2->line_count == 3 &&
+                         strcmp(txtcache_line(file2, 1), "sta $d020") == 0 &&
+                         strcmp(txtcache_line(file2, 2), "rts") == 0);
+
+    printf("... emptying '%s' ..\n", CACHE_TEST_FILE);
+    base_binfile_write(CACHE_TEST_FILE, (const uint8_t *)text1, 0, false);
+    file1 = txtcache_get(&cache, CACHE_TEST_FILE);
+    testcase_assert_true(self,
+                         file1 != NULL && file1->size == 0 &&
+                         file1->line_count == 0 &&
+                         txtcache_line(file1, 0) == NULL);
+    remove(CACHE_TEST_FILE);
+
+    printf("... getting non-existent file ..\n");
+    base_errno = 0;
+    file1 = txtcache_get(&cache, "foo-bar-huppel-appel-meloen");
+    testcase_assert_true(self, file1 == NULL && base_errno == BASE_ERR_IO);
+
+    txtcache_free(&cache);
+    return true;
+}
+
+
+/** \brief  Write the segments used by the output image tests
+ *
+ * Writes 16 bytes at $0801, 300 bytes at $c0f0 and 4 bytes at $123456.
+ *
+ * \param[out]  image   image
+ * \param[out]  data    data written, at least 300 bytes
+ */
+static void image_setup(image_t *image, uint8_t *data)
+{
+    for (size_t i = 0; i < 300u; i++) {
+        data[i] = (uint8_t)(i * 7u + 1u);
+    }
+    image_init(image, 0xea);
+    image_write(image, 0x0801, data, 16);
+    image_write(image, 0xc0f0, data, 300);
+    image_write(image, 0x123456, data, 4);
+}
+
+
+/** \brief  Test the output image
+ *
+ * \param[in]   self    test case
+ *
+ * \return  bool
+ */
+static bool test_image(testcase_t *self)
+{
+    image_t image;
+    uint8_t data[300];
+    uint8_t buffer[32];
+    uint32_t start;
+    uint32_t end = 0;
+    size_t bytes;
+    int count = 0;
+    bool ok;
+
+    printf("... writing three segments ..\n");
+    image_setup(&image, data);
+    printf("... %zu pages, %zu bytes, $%06lx-$%06lx\n",
+           image.pages_used, image.bytes_used,
+           (unsigned long)image.start, (unsigned long)image.end);
+    testcase_assert_true(self,
+                         image.pages_used == 5 && image.bytes_used == 320 &&
+                         image.start == 0x0801 && image.end == 0x12345a);
+
+    printf("... writing overlapping data ..\n");
+    bytes = image.bytes_used;
+    base_errno = 0;
+    ok = image_write(&image, 0x07f8, data, 16);
+    printf("... error %d ('%s') at $%04lx\n",
+           base_errno, base_strerror(base_errno), (unsigned long)image.overlap);
+    testcase_assert_true(self,
+                         !ok && base_errno == BASE_ERR_OVERLAP &&
+                         image.overlap == 0x0801 && image.bytes_used == bytes);
+
+    printf("... reading across a gap ..\n");
+    image_read(&image, 0x0800, buffer, sizeof buffer);
+    testcase_assert_true(self,
+                         buffer[0] == 0xea && memcmp(buffer + 1, data, 16) == 0 &&
+                         buffer[17] == 0xea && buffer[31] == 0xea);
+
+    printf("... iterating segments ..\n");
+    while (image_next_segment(&image, end, &start, &end)) {
+        printf("..... $%06lx-$%06lx\n", (unsigned long)start, (unsigned long)end);
+        if ((count == 0 && (start != 0x0801 || end != 0x0811)) ||
+                (count == 1 && (start != 0xc0f0 || end != 0xc21c)) ||
+                (count == 2 && (start != 0x123456 || end != 0x12345a))) {
+            count = -10;
+        }
+        count++;
+    }
+    testcase_assert_equal(self, count, 3);
+
+    image_free(&image);
+    return true;
+}
+
+
+/** \brief  Test writing the output image to file
+ *
+ * \param[in]   self    test case
+ *
+ * \return  bool
+ */
+static bool test_image_save(testcase_t *self)
+{
+    image_t image;
+    uint8_t data[300];
+    uint8_t *file = NULL;
+    long size;
+    bool ok;
+
+    image_setup(&image, data);
+
+    printf("... saving image as PRG (should fail: it doesn't fit) ..\n");
+    base_errno = 0;
+    ok = image_save(&image, IMAGE_TEST_FILE, IMAGE_FORMAT_PRG, false);
+    testcase_assert_true(self, !ok && base_errno == BASE_ERR_RANGE);
+
+    printf("... saving $0801-$c21c as PRG ..\n");
+    ok = image_save_range(&image, IMAGE_TEST_FILE, IMAGE_FORMAT_PRG,
+                          0x0801, 0xc21c, true);
+    size = base_binfile_read(IMAGE_TEST_FILE, &file);
+    printf("... %ld bytes\n", size);
+    testcase_assert_true(self,
+                         ok && size == 0xc21c - 0x0801 + 2 &&
+                         file[0] == 0x01 && file[1] == 0x08 &&
+                         memcmp(file + 2, data, 16) == 0 &&
+                         file[2 + 16] == 0xea &&
+                         file[2 + 0xc0ef - 0x0801] == 0xea &&
+                         memcmp(file + 2 + 0xc0f0 - 0x0801, data, 300) == 0);
+    if (size >= 0) {
+        base_free(file);
+    }
+    remove(IMAGE_TEST_FILE);
+
+    printf("... saving segments as raw files ..\n");
+    ok = image_save_segments(&image, IMAGE_TEST_PREFIX, ".bin",
+                             IMAGE_FORMAT_RAW, false);
+    size = base_binfile_read(IMAGE_TEST_PREFIX "123456.bin", &file);
+    testcase_assert_true(self,
+                         ok && size == 4 && memcmp(file, data, 4) == 0);
+    if (size >= 0) {
+        base_free(file);
+    }
+    remove(IMAGE_TEST_PREFIX "0801.bin");
+    remove(IMAGE_TEST_PREFIX "c0f0.bin");
+    remove(IMAGE_TEST_PREFIX "123456.bin");
+
+    image_free(&image);
+    return true;
+}
+
+
 /** \brief  Create test group 'base/io'
  *
  * \return  test group
@@ -158,10 +539,30 @@ testgroup_t *get_base_io_tests(void)
                         2, test_binfile, NULL, NULL);
     testgroup_add_case(group, test);
 
+    test = testcase_new("binfile_write",
+                        "Test writing binary files",
+                        3, test_binfile_write, NULL, NULL);
+    testgroup_add_case(group, test);
+
     test = testcase_new("txtfile",
                         "Test text file handling",
                         4, test_txtfile, NULL, NULL);
     testgroup_add_case(group, test);
 
+    test = testcase_new("txtcache",
+                        "Test the text file cache",
+                        7, test_txtcache, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("image",
+                        "Test the output image",
+                        4, test_image, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("image_save",
+                        "Test writing the output image to file",
+                        3, test_image_save, NULL, NULL);
+    testgroup_add_case(group, test);
+
     return group;
 }
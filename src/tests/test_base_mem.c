@@ -120,6 +120,117 @@ static bool test_nextpow2(testcase_t *self)
 }
 
 
+/** \brief  Test the arena allocator
+ *
+ * \param[in]   self    test case
+ *
+ * \return  bool
+ */
+static bool test_arena(testcase_t *self)
+{
+    base_arena_t arena;
+    base_arena_mark_t mark;
+    base_arena_chunk_t *chunk;
+    unsigned char *p;
+    unsigned char *q;
+    char *s;
+    bool aligned = true;
+
+    base_arena_init(&arena, 256);
+
+    printf("... checking alignment of allocations ..\n");
+    for (size_t align = 1; align <= 64; align <<= 1) {
+        base_arena_alloc(&arena, 1);
+        p = base_arena_alloc_aligned(&arena, 3, align);
+        if (((uintptr_t)p & (align - 1u)) != 0) {
+            printf("... alloc of 3 bytes aligned on %zu: %p\n", align, (void *)p);
+            aligned = false;
+        }
+    }
+    testcase_assert_true(self, aligned);
+
+    s = base_arena_strdup(&arena, "hello world");
+    printf("... strdup: \"%s\"\n", s);
+    testcase_assert_true(self, strcmp(s, "hello world") == 0);
+    s = base_arena_strndup(&arena, "label: lda #0", 5);
+    printf("... strndup: \"%s\"\n", s);
+    testcase_assert_true(self, strcmp(s, "label") == 0);
+
+    printf("... checking release to mark reuses memory ..\n");
+    mark = base_arena_mark(&arena);
+    p = base_arena_alloc(&arena, 16);
+    base_arena_alloc(&arena, 1000);     /* larger than a chunk */
+    for (int i = 0; i < 100; i++) {
+        base_arena_alloc(&arena, 24);
+    }
+    base_arena_release(&arena, mark);
+    q = base_arena_alloc(&arena, 16);
+    testcase_assert_true(self, p == q);
+
+    printf("... checking reset keeps a chunk for reuse ..\n");
+    base_arena_reset(&arena);
+    chunk = arena.spare;
+    base_arena_alloc(&arena, 8);
+    testcase_assert_true(self, chunk != NULL && arena.current == chunk);
+
+    base_arena_free(&arena);
+    return true;
+}
+
+
+/** \brief  Test allocation tracking
+ *
+ * Only checks the statistics are disabled when not compiled with
+ * HAVE_MEM_TRACKING.
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_tracking(testcase_t *self)
+{
+    base_mem_stats_t before;
+    base_mem_stats_t after;
+    char *p;
+    char *s;
+
+    base_mem_get_stats(&before);
+    p = base_malloc(100);
+    p = base_realloc(p, 300);
+    s = base_strdup("abc");
+    base_mem_get_stats(&after);
+    printf("... tracking = %s, %zu allocations, %zu reallocations, "
+           "%zu bytes, %zu live, %zu peak\n",
+           after.tracking ? "true" : "false",
+           after.allocs - before.allocs, after.reallocs - before.reallocs,
+           after.bytes_total - before.bytes_total,
+           after.bytes_live - before.bytes_live, after.bytes_peak);
+#ifdef HAVE_MEM_TRACKING
+    testcase_assert_true(self,
+                         after.tracking &&
+                         after.allocs - before.allocs == 2 &&
+                         after.reallocs - before.reallocs == 1 &&
+                         after.bytes_total - before.bytes_total == 304 &&
+                         after.bytes_live - before.bytes_live == 304 &&
+                         after.bytes_peak >= after.bytes_live);
+#else
+    testcase_assert_true(self, !after.tracking && after.allocs == 0);
+#endif
+
+    base_free(p);
+    base_free(s);
+    base_mem_get_stats(&after);
+#ifdef HAVE_MEM_TRACKING
+    testcase_assert_true(self,
+                         after.frees - before.frees == 2 &&
+                         after.bytes_live == before.bytes_live);
+#else
+    testcase_assert_true(self, after.frees == 0 && after.bytes_live == 0);
+#endif
+    return true;
+}
+
+
 /** \brief  Create test group 'base/mem'
  *
  * \return  test group
@@ -145,5 +256,15 @@ testgroup_t *get_base_mem_tests(void)
                         test_nextpow2, NULL, NULL);
     testgroup_add_case(group, test);
 
+    test = testcase_new("arena",
+                        "Test the arena allocator",
+                        5, test_arena, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("tracking",
+                        "Test allocation tracking",
+                        2, test_tracking, NULL, NULL);
+    testgroup_add_case(group, test);
+
     return group;
 }
@@ -26,6 +26,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "testcase.h"
 #include "../base/debug.h"
@@ -41,6 +42,19 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define MIN_ALLOC   16
 
 
+/** \brief  Number of threads in the 'cache_threads' test
+ */
+#define CACHE_THREADS   8
+
+/** \brief  Number of live objects per thread in the 'cache_threads' test
+ */
+#define CACHE_LIVE      64
+
+/** \brief  Number of objects replaced per thread in the 'cache_threads' test
+ */
+#define CACHE_ROUNDS    20000
+
+
 /** \brief  Object pool test object
  *
  * A simple 'string' object
@@ -78,13 +92,12 @@ static size_t   pool_obj_size(void *obj);
 
 
 static objpool_t pool_test = {
-    NULL, 8, 0,
-    NULL, 4, 0,
-    pool_obj_alloc,
-    pool_obj_reuse,
-    pool_obj_free,
-    pool_obj_size,
-    0, 0, 0, 0
+    .active_size = 8,
+    .inactive_size = 4,
+    .alloc_cb = pool_obj_alloc,
+    .reuse_cb = pool_obj_reuse,
+    .free_cb = pool_obj_free,
+    .size_cb = pool_obj_size
 };
 
 
@@ -93,30 +106,34 @@ static objpool_t pool_test = {
  */
 
 
+/** \brief  Get size to allocate for a string of \a len characters
+ *
+ * \param[in]   len     string length
+ *
+ * \return  size
+ */
+static size_t string_obj_size(size_t len)
+{
+    if (len + 1 < MIN_ALLOC) {
+        return MIN_ALLOC;
+    }
+    return base_nextpow2(len + 1);
+}
+
+
 static void *pool_obj_alloc(void *param)
 {
     string_obj_test_t *obj;
     size_t len;
-    size_t size;
 
     base_debug("Called.");
 
     len = strlen((const char *)param);
 
     obj = base_malloc(sizeof *obj);
-
-    if (len + 1 < MIN_ALLOC) {
-        size = MIN_ALLOC;
-    } else {
-        size = base_nextpow2(len + 1);
-    }
-
-
-    obj->text = base_malloc(size);
-
+    obj->size = string_obj_size(len);
+    obj->text = base_malloc(obj->size);
     memcpy(obj->text, param, len + 1);
-
-    obj->size = size;
     obj->len = len;
     return obj;
 }
@@ -124,10 +141,18 @@ static void *pool_obj_alloc(void *param)
 
 static void *pool_obj_reuse(void *obj, void *param)
 {
+    string_obj_test_t *s = obj;
+    size_t len = strlen((const char *)param);
+
     base_debug("Called.");
-    (void)obj;
-    (void)param;
-    return NULL;
+
+    if (len + 1 > s->size) {
+        s->size = string_obj_size(len);
+        s->text = base_realloc(s->text, s->size);
+    }
+    memcpy(s->text, param, len + 1);
+    s->len = len;
+    return obj;
 }
 
 
@@ -147,8 +172,7 @@ static void pool_obj_free(void *obj)
 static size_t pool_obj_size(void *obj)
 {
     base_debug("Called.");
-    (void)obj;
-    return 0;
+    return ((string_obj_test_t *)obj)->size;
 }
 
 
@@ -165,6 +189,25 @@ static void *string_obj_test_alloc(char *text)
 
 
 
+/** \brief  Check the active objects list is dense and indexed correctly
+ *
+ * \param[in]   pool    object pool
+ *
+ * \return  true if consistent
+ */
+static bool active_list_ok(const objpool_t *pool)
+{
+    for (size_t i = 0; i < pool->active_used; i++) {
+        const string_obj_test_t *s = pool->active_list[i];
+
+        if (s == NULL || s->pool != pool || s->index != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
 static bool setup(void)
 {
     objpool_init(&pool_test);
@@ -210,7 +253,11 @@ static bool test_add_item(testcase_t *self)
 }
 
 
-/* FIXME: Incomplete test
+/** \brief  Test reusing released objects
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
  */
 static bool test_item_reuse(testcase_t *self)
 {
@@ -218,9 +265,10 @@ static bool test_item_reuse(testcase_t *self)
     int i;
     int k;
     char *strings[]= {
-        "compyx", "fucking", "rules", "and", "don't you forget it",
-        "you bastardo!", "pummkle", "piemel", NULL
+        "compyx", "rules", "and", "don't you forget it",
+        "lda #$00", "sta $d020", "rts", "jmp *", NULL
     };
+    string_obj_test_t *s;
 
 
     /* wipe ptrs to avoid weird stuff */
@@ -239,14 +287,277 @@ static bool test_item_reuse(testcase_t *self)
      * format: [index:size:len] "string content"
      */
     for (k = 0; k < i; k++) {
-        string_obj_test_t *s = ptrs[k];
+        s = ptrs[k];
         printf(".. [%04d:%04zu:%04zu \"%s\"\n",
                 k, s->size, s->len, s->text);
     }
+
+    printf("... releasing '%s' and '%s' ..\n", strings[0], strings[3]);
+    objpool_release(&pool_test, ptrs[0]);
+    objpool_release(&pool_test, ptrs[3]);
+    testcase_assert_true(self,
+                         pool_test.active_used == (size_t)i - 2u &&
+                         pool_test.inactive_used == 2 &&
+                         active_list_ok(&pool_test));
+
+    printf("... requesting 'lda #$ff' ..\n");
+    s = string_obj_test_alloc("lda #$ff");
+    testcase_assert_true(self,
+                         s == ptrs[0] && strcmp(s->text, "lda #$ff") == 0 &&
+                         pool_test.requests_from_pool == 1);
     objpool_dump_stats(&pool_test);
+    return true;
+}
 
-    /* TODO: free one or more objects and add new ones */
-    testcase_pass(self);
+
+/** \brief  Test size classes
+ *
+ * A sized request must get the smallest inactive object large enough for it,
+ * or a new object when none is.
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_classes(testcase_t *self)
+{
+    char text[2048];
+    string_obj_test_t *objs[3];
+    string_obj_test_t *s;
+    size_t lengths[3] = { 10, 100, 1000 };
+
+    for (size_t i = 0; i < 3; i++) {
+        memset(text, 'x', lengths[i]);
+        text[lengths[i]] = '\0';
+        objs[i] = string_obj_test_alloc(text);
+    }
+    for (size_t i = 0; i < 3; i++) {
+        printf("... releasing object of size %zu ..\n", objs[i]->size);
+        objpool_release(&pool_test, objs[i]);
+    }
+
+    printf("... requesting 90 bytes ..\n");
+    memset(text, 'y', 89);
+    text[89] = '\0';
+    s = string_obj_test_alloc(text);
+    printf("... got object of size %zu\n", s->size);
+    testcase_assert_true(self, s == objs[1] && strcmp(s->text, text) == 0);
+
+    printf("... requesting 200 bytes ..\n");
+    memset(text, 'y', 199);
+    text[199] = '\0';
+    s = string_obj_test_alloc(text);
+    printf("... got object of size %zu\n", s->size);
+    /* the 16 byte object is too small, so the 1024 byte one is used */
+    testcase_assert_true(self, s == objs[2]);
+
+    printf("... requesting 2000 bytes ..\n");
+    memset(text, 'z', 1999);
+    text[1999] = '\0';
+    s = string_obj_test_alloc(text);
+    printf("... got object of size %zu\n", s->size);
+    testcase_assert_true(self,
+                         s != objs[0] && s->size == 2048 &&
+                         pool_test.requests_from_pool == 2 &&
+                         pool_test.inactive_used == 1);
+    return true;
+}
+
+
+/** \brief  Test trimming the pool
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_trim(testcase_t *self)
+{
+    void *ptrs[16];
+    char text[32];
+    void *obj;
+
+    printf("... requesting 16 objects ..\n");
+    for (size_t i = 0; i < base_array_len(ptrs); i++) {
+        snprintf(text, sizeof text, "object %zu", i);
+        ptrs[i] = string_obj_test_alloc(text);
+    }
+    printf("... releasing 12 objects, every other one first ..\n");
+    for (size_t i = 0; i < base_array_len(ptrs); i += 2) {
+        objpool_release(&pool_test, ptrs[i]);
+    }
+    for (size_t i = 1; i < 8; i += 2) {
+        objpool_release(&pool_test, ptrs[i]);
+    }
+    objpool_dump_stats(&pool_test);
+
+    printf("... trimming, the peak should keep everything ..\n");
+    objpool_trim(&pool_test);
+    testcase_assert_true(self,
+                         pool_test.active_used == 4 &&
+                         pool_test.inactive_used == 4 &&
+                         pool_test.active_size == 16 &&
+                         active_list_ok(&pool_test));
+
+    printf("... trimming again, should free inactive objects ..\n");
+    objpool_trim(&pool_test);
+    objpool_dump_stats(&pool_test);
+    testcase_assert_true(self,
+                         pool_test.inactive_used == 0 &&
+                         pool_test.active_size == 8 &&
+                         pool_test.trims_frees == 4 &&
+                         active_list_ok(&pool_test));
+
+    printf("... requesting object after trim ..\n");
+    obj = string_obj_test_alloc("after trim");
+    testcase_assert_true(self,
+                         obj != NULL && pool_test.active_used == 5 &&
+                         active_list_ok(&pool_test));
+    return true;
+}
+
+
+/** \brief  Test requesting and releasing objects through a cache
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_cache(testcase_t *self)
+{
+    objpool_cache_t cache;
+    void *ptrs[OBJPOOL_MAGAZINE_SIZE + 1];
+    void *obj;
+
+    objpool_cache_init(&cache, &pool_test);
+
+    printf("... requesting and releasing an object ..\n");
+    obj = objpool_cache_request(&cache, 8, "cached");
+    objpool_cache_release(&cache, obj);
+    testcase_assert_true(self,
+                         objpool_cache_request(&cache, 8, "again") == obj &&
+                         strcmp(((string_obj_test_t *)obj)->text, "again") == 0 &&
+                         cache.hits == 1 && pool_test.inactive_used == 0);
+    objpool_cache_release(&cache, obj);
+
+    printf("... overflowing the magazine ..\n");
+    for (size_t i = 0; i < base_array_len(ptrs); i++) {
+        ptrs[i] = objpool_cache_request(&cache, 8, "object");
+    }
+    for (size_t i = 0; i < base_array_len(ptrs); i++) {
+        objpool_cache_release(&cache, ptrs[i]);
+    }
+    printf("... cache: %zu hits, %zu misses, %zu transfers\n",
+           cache.hits, cache.misses, cache.transfers);
+    objpool_dump_stats(&pool_test);
+    /* half a magazine went to the pool, which keeps four of them */
+    testcase_assert_true(self,
+                         pool_test.inactive_used == 4 &&
+                         pool_test.requests_frees == OBJPOOL_MAGAZINE_SIZE / 2 - 4 &&
+                         cache.transfers == 1);
+
+    printf("... freeing the cache ..\n");
+    objpool_cache_free(&cache);
+    testcase_assert_true(self, pool_test.active_used == 0);
+    return true;
+}
+
+
+/** \brief  State of a thread in the 'cache_threads' test
+ */
+typedef struct cache_state_s {
+    objpool_t * pool;   /**< shared pool */
+    int         id;     /**< thread number */
+    int         errors; /**< number of corrupted objects */
+} cache_state_t;
+
+
+/** \brief  Replace random objects through a per-thread cache
+ *
+ * \param[in,out]   arg thread state
+ *
+ * \return  `NULL`
+ */
+static void *cache_thread(void *arg)
+{
+    cache_state_t *state = arg;
+    objpool_cache_t cache;
+    string_obj_test_t *live[CACHE_LIVE];
+    char text[CACHE_LIVE][64];
+    uint32_t seed = (uint32_t)state->id + 1u;
+
+    objpool_cache_init(&cache, state->pool);
+    for (int i = 0; i < CACHE_LIVE; i++) {
+        snprintf(text[i], sizeof text[i], "%d:%d", state->id, i);
+        live[i] = objpool_cache_request(&cache, strlen(text[i]) + 1u, text[i]);
+    }
+    for (int r = 0; r < CACHE_ROUNDS; r++) {
+        int i;
+        int len;
+
+        seed = seed * 1103515245u + 12345u;
+        i = (int)((seed >> 16) % CACHE_LIVE);
+        len = (int)((seed >> 8) % 40u);
+        if (strcmp(live[i]->text, text[i]) != 0) {
+            state->errors++;
+        }
+        objpool_cache_release(&cache, live[i]);
+        snprintf(text[i], sizeof text[i], "%d:%d:%*s", state->id, r, len, "");
+        live[i] = objpool_cache_request(&cache, strlen(text[i]) + 1u, text[i]);
+    }
+    for (int i = 0; i < CACHE_LIVE; i++) {
+        objpool_cache_release(&cache, live[i]);
+    }
+    objpool_cache_free(&cache);
+    return NULL;
+}
+
+
+/** \brief  Test using a pool from multiple threads through caches
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_cache_threads(testcase_t *self)
+{
+    objpool_t pool = {
+        .active_size = 64,
+        .inactive_size = 256,
+        .alloc_cb = pool_obj_alloc,
+        .reuse_cb = pool_obj_reuse,
+        .free_cb = pool_obj_free,
+        .size_cb = pool_obj_size
+    };
+    pthread_t threads[CACHE_THREADS];
+    cache_state_t states[CACHE_THREADS];
+    int errors = 0;
+
+    objpool_init(&pool);
+    printf("... running %d threads ..\n", CACHE_THREADS);
+    for (int t = 0; t < CACHE_THREADS; t++) {
+        states[t].pool = &pool;
+        states[t].id = t;
+        states[t].errors = 0;
+        if (pthread_create(&threads[t], NULL, cache_thread, &states[t]) != 0) {
+            fprintf(stderr, "%s(): failed to create thread\n", __func__);
+            objpool_free(&pool);
+            return false;
+        }
+    }
+    /* trimming locks the pool, so it's safe while the threads run */
+    for (int i = 0; i < 100; i++) {
+        objpool_trim(&pool);
+    }
+    for (int t = 0; t < CACHE_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        errors += states[t].errors;
+    }
+    objpool_dump_stats(&pool);
+    printf("... %d errors\n", errors);
+    testcase_assert_true(self,
+                         errors == 0 && pool.active_used == 0 &&
+                         pool.inactive_used <= pool.inactive_size);
+    objpool_free(&pool);
     return true;
 }
 
@@ -276,7 +587,27 @@ testgroup_t *get_base_objpool_tests(void)
 
     test = testcase_new("reuse",
                         "Test reusing object in an object pool",
-                        1, test_item_reuse, setup, teardown);
+                        2, test_item_reuse, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("classes",
+                        "Test reusing objects by size class",
+                        3, test_classes, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("trim",
+                        "Test trimming an object pool",
+                        3, test_trim, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("cache",
+                        "Test using an object pool through a cache",
+                        3, test_cache, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("cache_threads",
+                        "Test using an object pool from multiple threads",
+                        1, test_cache_threads, NULL, NULL);
     testgroup_add_case(group, test);
 
     return group;
@@ -61,6 +61,50 @@ static const info_test_t info_tests[] = {
 };
 
 
+/** \brief  Object for parser tests
+ */
+typedef struct parse_test_s {
+    const char *        text;   /**< input */
+    operator_ctx_t      ctx;    /**< parser context */
+    operator_id_t       id;     /**< expected operator ID */
+    size_t              len;    /**< expected number of characters consumed */
+} parse_test_t;
+
+
+/** \brief  Table of tests for operator_parse()
+ */
+static const parse_test_t parse_tests[] = {
+    { "+",      OPR_CTX_OPERAND,    OPR_ID_PLUS,            1 },
+    { "+",      OPR_CTX_OPERATOR,   OPR_ID_ADD,             1 },
+    { "+=1",    OPR_CTX_OPERATOR,   OPR_ID_ASSIGN_ADD,      2 },
+    { "-$10",   OPR_CTX_OPERAND,    OPR_ID_MINUS,           1 },
+    { "-$10",   OPR_CTX_OPERATOR,   OPR_ID_SUB,             1 },
+    { "<label", OPR_CTX_OPERAND,    OPR_ID_LSB,             1 },
+    { "<label", OPR_CTX_OPERATOR,   OPR_ID_LT,              1 },
+    { ">label", OPR_CTX_OPERAND,    OPR_ID_MSB,             1 },
+    { "<=",     OPR_CTX_OPERATOR,   OPR_ID_LTE,             2 },
+    { "<<",     OPR_CTX_OPERATOR,   OPR_ID_LSHIFT,          2 },
+    { "<<=",    OPR_CTX_OPERATOR,   OPR_ID_ASSIGN_LSHIFT,   3 },
+    { ">>=2",   OPR_CTX_OPERATOR,   OPR_ID_ASSIGN_RSHIFT,   3 },
+    { "++",     OPR_CTX_OPERAND,    OPR_ID_INCR_PRE,        2 },
+    { "---",    OPR_CTX_OPERATOR,   OPR_ID_DECR_POST,       2 },
+    { "!",      OPR_CTX_OPERAND,    OPR_ID_NOT_LOG,         1 },
+    { "!=",     OPR_CTX_OPERATOR,   OPR_ID_NOTEQUAL,        2 },
+    { "&&",     OPR_CTX_OPERATOR,   OPR_ID_AND_LOG,         2 },
+    { "||",     OPR_CTX_OPERATOR,   OPR_ID_OR_LOG,          2 },
+    { "|x",     OPR_CTX_OPERATOR,   OPR_ID_OR_BIT,          1 },
+    { "^",      OPR_CTX_OPERATOR,   OPR_ID_XOR,             1 },
+    { "==",     OPR_CTX_OPERATOR,   OPR_ID_EQUAL,           2 },
+    { "(",      OPR_CTX_OPERAND,    OPR_ID_LPAREN,          1 },
+    { ")",      OPR_CTX_OPERATOR,   OPR_ID_RPAREN,          1 },
+    { "[",      OPR_CTX_OPERAND,    OPR_ID_LBRACKET,        1 },
+    { "~",      OPR_CTX_OPERAND,    OPR_ID_NOT_BIT,         1 },
+    { ",",      OPR_CTX_OPERATOR,   OPR_ID_COMMA,           1 },
+    { "label",  OPR_CTX_OPERATOR,   OPR_ID_INVALID,         0 },
+    { "",       OPR_CTX_OPERAND,    OPR_ID_INVALID,         0 }
+};
+
+
 /** \brief  Test #operator_text()
  *
  * \param[in]   self    test case
@@ -109,6 +153,31 @@ static bool test_operator_text(testcase_t *self)
 }
 
 
+/** \brief  Test #operator_parse()
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_operator_parse(testcase_t *self)
+{
+    for (size_t i = 0; i < base_array_len(parse_tests); i++) {
+        const parse_test_t *test = &parse_tests[i];
+        operator_id_t id;
+        size_t len;
+
+        id = operator_parse(test->text, test->ctx, &len);
+        printf("... operator_parse(\"%s\", %s) = %d (len %zu), expected %d"
+               " (len %zu)\n",
+               test->text,
+               test->ctx == OPR_CTX_OPERAND ? "operand" : "operator",
+               id, len, test->id, test->len);
+        testcase_assert_true(self, id == test->id && len == test->len);
+    }
+    return true;
+}
+
+
 /** \brief  Create test group 'base/operators'
  *
  * \return  test group
@@ -127,5 +196,11 @@ testgroup_t *get_base_operators_tests(void)
                         1, test_operator_text, NULL, NULL);
     testgroup_add_case(group, test);
 
+    test = testcase_new("parse",
+                        "Test parsing operator string literals",
+                        (int)(base_array_len(parse_tests)),
+                        test_operator_parse, NULL, NULL);
+    testgroup_add_case(group, test);
+
     return group;
 }
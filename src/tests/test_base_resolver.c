@@ -0,0 +1,280 @@
+/** \file   test_base_resolver.c
+ * \brief   Unit tests for base/resolver.c
+ *
+ * Unit tests for the incremental expression resolver.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "../base/error.h"
+#include "../base/resolver.h"
+#include "testcase.h"
+
+#include "test_base_resolver.h"
+
+
+/** \brief  Test propagating changes through a chain of definitions
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_chain(testcase_t *self)
+{
+    resolver_t resolver;
+    uint32_t start;
+    uint32_t fixup;
+    uint32_t other;
+    int32_t value = 0;
+    size_t evals;
+
+    resolver_init(&resolver);
+    start = resolver_symbol(&resolver, "start");
+    resolver_set(&resolver, start, 0x0801);
+    resolver_define(&resolver, "main", "start+$0d", NULL);
+    resolver_define(&resolver, "loop", "main+3", NULL);
+    resolver_add(&resolver, "loop-main", &fixup);
+    resolver_add(&resolver, "$d020", &other);
+
+    printf("... initial update ..\n");
+    testcase_assert_true(self, resolver_update(&resolver));
+    resolver_value(&resolver, fixup, &value);
+    printf("... loop-main = %"PRId32", %zu evaluations\n", value, resolver.evals);
+    testcase_assert_true(self, value == 3 && resolver.evals == 4);
+
+    printf("... setting start to the same value ..\n");
+    evals = resolver.evals;
+    resolver_set(&resolver, start, 0x0801);
+    resolver_update(&resolver);
+    printf("... %zu evaluations\n", resolver.evals - evals);
+    testcase_assert_equal(self, (int)(resolver.evals - evals), 0);
+
+    printf("... setting start to $c000 ..\n");
+    evals = resolver.evals;
+    resolver_set(&resolver, start, 0xc000);
+    resolver_update(&resolver);
+    resolver_get(&resolver, resolver_symbol(&resolver, "loop"), &value);
+    printf("... loop = $%04"PRIx32", %zu evaluations\n",
+           (uint32_t)value, resolver.evals - evals);
+    /* main and loop change, the fixup is evaluated but unchanged; the
+     * constant expression is left alone */
+    testcase_assert_true(self, value == 0xc010 && resolver.evals - evals == 3);
+
+    resolver_free(&resolver);
+    return true;
+}
+
+
+/** \brief  Test resolving forward references
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_forward(testcase_t *self)
+{
+    resolver_t resolver;
+    uint32_t fixup;
+    int32_t value;
+    bool ok;
+
+    resolver_init(&resolver);
+    resolver_add(&resolver, "<(later+1)", &fixup);
+    resolver_update(&resolver);
+
+    base_errno = 0;
+    ok = resolver_value(&resolver, fixup, &value);
+    printf("... before definition: %zu unresolved, error %d ('%s')\n",
+           resolver_unresolved(&resolver), base_errno, base_strerror(base_errno));
+    testcase_assert_true(self,
+                         !ok && base_errno == BASE_ERR_UNDEF &&
+                         resolver_unresolved(&resolver) == 1);
+
+    resolver_define(&resolver, "later", "$10ff", NULL);
+    resolver_update(&resolver);
+    ok = resolver_value(&resolver, fixup, &value);
+    printf("... after definition: %zu unresolved, value = $%02"PRIx32"\n",
+           resolver_unresolved(&resolver), (uint32_t)value);
+    testcase_assert_true(self,
+                         ok && value == 0 && resolver_unresolved(&resolver) == 0);
+
+    resolver_free(&resolver);
+    return true;
+}
+
+
+/** \brief  Test resolving a long chain of forward references
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_many(testcase_t *self)
+{
+    resolver_t resolver;
+    char name[32];
+    char text[32];
+    int32_t value = 0;
+
+    resolver_init(&resolver);
+    /* define sym999 = sym998 + 1 ... sym1 = sym0 + 1, then sym0 = 1 */
+    for (int i = 999; i > 0; i--) {
+        snprintf(name, sizeof name, "sym%d", i);
+        snprintf(text, sizeof text, "sym%d+1", i - 1);
+        resolver_define(&resolver, name, text, NULL);
+    }
+    resolver_define(&resolver, "sym0", "1", NULL);
+    resolver_update(&resolver);
+
+    resolver_get(&resolver, resolver_symbol(&resolver, "sym999"), &value);
+    printf("... sym999 = %"PRId32", %zu unresolved\n",
+           value, resolver_unresolved(&resolver));
+    testcase_assert_true(self,
+                         value == 1000 && resolver_unresolved(&resolver) == 0);
+
+    resolver_free(&resolver);
+    return true;
+}
+
+
+/** \brief  Test detecting circular definitions
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_cycle(testcase_t *self)
+{
+    resolver_t resolver;
+    bool ok;
+
+    resolver_init(&resolver);
+    resolver_set(&resolver, resolver_symbol(&resolver, "a"), 0);
+    resolver_define(&resolver, "b", "a+1", NULL);
+    resolver_define(&resolver, "a", "b+1", NULL);
+
+    base_errno = 0;
+    ok = resolver_update(&resolver);
+    printf("... update: result = %s, error %d ('%s')\n",
+           ok ? "true" : "false", base_errno, base_strerror(base_errno));
+    testcase_assert_true(self, !ok && base_errno == BASE_ERR_RANGE);
+
+    resolver_free(&resolver);
+    return true;
+}
+
+
+/** \brief  Test error handling
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_errors(testcase_t *self)
+{
+    resolver_t resolver;
+    uint32_t divisor;
+    uint32_t fixup;
+    size_t code_used;
+    int32_t value = 0;
+    bool ok;
+
+    resolver_init(&resolver);
+    divisor = resolver_symbol(&resolver, "divisor");
+    resolver_set(&resolver, divisor, 2);
+    resolver_define(&resolver, "half", "10/divisor", NULL);
+    resolver_add(&resolver, "half+1", &fixup);
+    resolver_update(&resolver);
+    resolver_value(&resolver, fixup, &value);
+    printf("... half+1 = %"PRId32"\n", value);
+    testcase_assert_equal(self, (int)value, 6);
+
+    printf("... setting divisor to 0 ..\n");
+    resolver_set(&resolver, divisor, 0);
+    resolver_update(&resolver);
+    base_errno = 0;
+    ok = resolver_get(&resolver, resolver_symbol(&resolver, "half"), &value);
+    printf("... half: %s, %zu unresolved\n",
+           ok ? "defined" : "undefined", resolver_unresolved(&resolver));
+    testcase_assert_true(self,
+                         !ok && base_errno == BASE_ERR_UNDEF &&
+                         !resolver_value(&resolver, fixup, &value) &&
+                         resolver_unresolved(&resolver) == 2);
+
+    printf("... adding expression with trailing garbage ..\n");
+    code_used = resolver.code.used;
+    base_errno = 0;
+    ok = resolver_add(&resolver, "half+2 foo", NULL);
+    printf("... error %d ('%s'), %zu bytes of code added\n",
+           base_errno, base_strerror(base_errno), resolver.code.used - code_used);
+    testcase_assert_true(self,
+                         !ok && base_errno == BASE_ERR_SYNTAX &&
+                         resolver.code.used == code_used);
+
+    resolver_free(&resolver);
+    return true;
+}
+
+
+/** \brief  Create test group 'base/resolver'
+ *
+ * \return  test group
+ */
+testgroup_t *get_base_resolver_tests(void)
+{
+    testgroup_t *group;
+    testcase_t *test;
+
+    group = testgroup_new("base/resolver",
+                          "Test the base/resolver module",
+                          NULL, NULL);
+
+    test = testcase_new("chain",
+                        "Test propagating changes through definitions",
+                        4, test_chain, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("forward",
+                        "Test resolving forward references",
+                        2, test_forward, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("many",
+                        "Test resolving a long chain of forward references",
+                        1, test_many, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("cycle",
+                        "Test detecting circular definitions",
+                        1, test_cycle, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("errors",
+                        "Test handling evaluation and syntax errors",
+                        3, test_errors, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    return group;
+}
@@ -0,0 +1,274 @@
+/** \file   test_base_scope.c
+ * \brief   Unit tests for base/scope.c
+ *
+ * Unit tests for the scoped symbol tables.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../base/error.h"
+#include "../base/scope.h"
+#include "testcase.h"
+
+#include "test_base_scope.h"
+
+
+/** \brief  Nesting depth used by the 'deep' test
+ */
+#define DEEP_COUNT  1000
+
+
+/** \brief  Scope table for tests
+ */
+static scope_table_t table;
+
+
+static bool setup(void)
+{
+    scope_table_init(&table);
+    return true;
+}
+
+static bool teardown(void)
+{
+    scope_table_free(&table);
+    return true;
+}
+
+
+/** \brief  Define symbol with a value in the current scope
+ *
+ * \param[in]   name    name
+ * \param[in]   value   value
+ */
+static void define(const char *name, int32_t value)
+{
+    scope_symbol_t *symbol = scope_define(&table, name, NULL);
+
+    symbol->value = value;
+}
+
+
+/** \brief  Get value of symbol visible from the current scope
+ *
+ * \param[in]   name    name
+ *
+ * \return  value or -1 when not found
+ */
+static int32_t lookup(const char *name)
+{
+    scope_symbol_t *symbol = scope_lookup(&table, name);
+
+    return symbol != NULL ? symbol->value : -1;
+}
+
+
+/** \brief  Test defining, shadowing and looking up symbols
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_define(testcase_t *self)
+{
+    bool added = false;
+
+    define("screen", 0x0400);
+    define("loop", 1);
+    scope_enter(&table, SCOPE_PROC, "clear");
+    define("loop", 2);
+
+    printf("... inner 'loop' shadows outer 'loop', 'screen' is visible ..\n");
+    testcase_assert_true(self, lookup("loop") == 2 && lookup("screen") == 0x0400);
+
+    printf("... defining 'loop' again returns the existing symbol ..\n");
+    testcase_assert_true(self,
+                         scope_define(&table, "loop", &added)->value == 2 &&
+                         !added && table.current->count == 1);
+
+    printf("... after leaving, outer 'loop' is visible again ..\n");
+    scope_leave(&table);
+    testcase_assert_true(self, lookup("loop") == 1);
+    return true;
+}
+
+
+/** \brief  Test entering and leaving scopes
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_leave(testcase_t *self)
+{
+    base_arena_mark_t before;
+    base_arena_mark_t after;
+    char name[32];
+
+    define("start", 0x0801);
+    before = base_arena_mark(&table.arena);
+
+    printf("... defining 1000 symbols in a macro scope ..\n");
+    scope_enter(&table, SCOPE_MACRO, "fill");
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof name, "tmp%d", i);
+        define(name, i);
+    }
+    testcase_assert_true(self, lookup("tmp999") == 999 && lookup("start") == 0x0801);
+
+    printf("... leaving releases the scope's memory ..\n");
+    scope_leave(&table);
+    after = base_arena_mark(&table.arena);
+    testcase_assert_true(self,
+                         after.chunk == before.chunk && after.used == before.used &&
+                         lookup("tmp999") == -1 && table.current == table.global);
+
+    printf("... leaving the global scope (should fail) ..\n");
+    base_errno = 0;
+    testcase_assert_true(self, !scope_leave(&table) && base_errno == BASE_ERR_EMPTY);
+    return true;
+}
+
+
+/** \brief  Test caching of resolved references
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_cache(testcase_t *self)
+{
+    scope_ref_t ref;
+    scope_symbol_t *symbol;
+
+    define("border", 0xd020);
+    scope_enter(&table, SCOPE_FILE, "main.s");
+    scope_enter(&table, SCOPE_ANON, NULL);
+    scope_ref_init(&ref, "border");
+
+    printf("... resolving twice ..\n");
+    scope_resolve(&table, &ref);
+    symbol = scope_resolve(&table, &ref);
+    printf("... %zu hits, %zu misses\n", table.cache_hits, table.cache_misses);
+    testcase_assert_true(self,
+                         symbol != NULL && symbol->value == 0xd020 &&
+                         table.cache_hits == 1 && table.cache_misses == 1);
+
+    printf("... defining 'sprite' keeps the cached symbol ..\n");
+    define("sprite", 0x2000);
+    symbol = scope_resolve(&table, &ref);
+    testcase_assert_true(self,
+                         symbol != NULL && symbol->value == 0xd020 &&
+                         table.cache_hits == 2 && table.cache_misses == 1);
+
+    printf("... shadowing 'border' invalidates the cached symbol ..\n");
+    define("border", 0xd021);
+    symbol = scope_resolve(&table, &ref);
+    testcase_assert_true(self,
+                         symbol != NULL && symbol->value == 0xd021 &&
+                         table.cache_misses == 2);
+
+    printf("... leaving the scope invalidates the cached symbol ..\n");
+    scope_leave(&table);
+    symbol = scope_resolve(&table, &ref);
+    testcase_assert_true(self,
+                         symbol != NULL && symbol->value == 0xd020 &&
+                         table.cache_misses == 3);
+    return true;
+}
+
+
+/** \brief  Test resolving through deeply nested scopes
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_deep(testcase_t *self)
+{
+    char name[32];
+    bool result = true;
+
+    printf("... entering %d nested scopes ..\n", DEEP_COUNT);
+    for (int i = 0; i < DEEP_COUNT; i++) {
+        scope_enter(&table, SCOPE_ANON, NULL);
+        snprintf(name, sizeof name, "level%d", i);
+        define(name, i);
+        define("x", i);
+    }
+    for (int i = 0; i < DEEP_COUNT; i += 100) {
+        snprintf(name, sizeof name, "level%d", i);
+        if (lookup(name) != i) {
+            result = false;
+        }
+    }
+    testcase_assert_true(self,
+                         result && lookup("x") == DEEP_COUNT - 1 &&
+                         table.current->depth == DEEP_COUNT);
+
+    for (int i = 0; i < DEEP_COUNT; i++) {
+        scope_leave(&table);
+    }
+    testcase_assert_true(self, table.current == table.global && lookup("x") == -1);
+    return true;
+}
+
+
+/** \brief  Create test group 'base/scope'
+ *
+ * \return  test group
+ */
+testgroup_t *get_base_scope_tests(void)
+{
+    testgroup_t *group;
+    testcase_t *test;
+
+    group = testgroup_new("base/scope",
+                          "Test the base/scope module",
+                          NULL, NULL);
+
+    test = testcase_new("define",
+                        "Test defining and shadowing symbols",
+                        3, test_define, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("leave",
+                        "Test entering and leaving scopes",
+                        3, test_leave, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("cache",
+                        "Test caching resolved references",
+                        4, test_cache, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("deep",
+                        "Test deeply nested scopes",
+                        2, test_deep, setup, teardown);
+    testgroup_add_case(group, test);
+
+    return group;
+}
@@ -0,0 +1,158 @@
+/** \file   test_base_strings.c
+ * \brief   Unit tests for base/strings.c
+ *
+ * Unit tests for low-level string handling.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "../base/error.h"
+#include "../base/mem.h"
+#include "../base/strings.h"
+#include "testcase.h"
+
+#include "test_base_strings.h"
+
+
+/** \brief  Object for integer literal scanner tests
+ */
+typedef struct scan_test_s {
+    const char *    text;   /**< text to scan */
+    int             err;    /**< expected error code, 0 for success */
+    int32_t         value;  /**< expected value */
+    size_t          len;    /**< expected number of characters consumed */
+} scan_test_t;
+
+
+/** \brief  Integer literal scanner tests
+ */
+static const scan_test_t scan_tests[] = {
+    { "0",              0,                  0,          1 },
+    { "1234,x",         0,                  1234,       4 },
+    { "$d020",          0,                  0xd020,     5 },
+    { "$FFFF",          0,                  0xffff,     5 },
+    { "$7fffffff",      0,                  INT32_MAX,  9 },
+    { "%10100101",      0,                  0xa5,       9 },
+    { "%102",           0,                  2,          3 },
+    { "2147483647",     0,                  INT32_MAX,  10 },
+    { "'A'",            0,                  'A',        3 },
+    { "'\\n'",          0,                  '\n',       4 },
+    { "'\\''",          0,                  '\'',       4 },
+    { "$",              BASE_ERR_EMPTY,     0,          0 },
+    { "%",              BASE_ERR_EMPTY,     0,          0 },
+    { "$g",             BASE_ERR_EMPTY,     0,          0 },
+    { "2147483648",     BASE_ERR_RANGE,     0,          10 },
+    { "$100000000+1",   BASE_ERR_RANGE,     0,          10 },
+    { "''",             BASE_ERR_EMPTY,     0,          0 },
+    { "'ab'",           BASE_ERR_SYNTAX,    0,          0 },
+    { "'a",             BASE_ERR_SYNTAX,    0,          0 },
+    { "'",              BASE_ERR_SYNTAX,    0,          0 },
+    { "'\\q'",          BASE_ERR_SYNTAX,    0,          0 }
+};
+
+
+/** \brief  Test the integer literal scanner
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_scan_int(testcase_t *self)
+{
+    for (size_t i = 0; i < base_array_len(scan_tests); i++) {
+        const scan_test_t *test = &scan_tests[i];
+        int32_t value = 0;
+        size_t len = 0;
+        bool ok;
+
+        base_errno = 0;
+        errno = 0;
+        ok = str_scan_int(test->text, &len, &value);
+        printf("... \"%s\": result = %s, value = %"PRId32", len = %zu, "
+               "error %d ('%s')\n",
+               test->text, ok ? "true" : "false", value, len,
+               base_errno, base_strerror(base_errno));
+        if (test->err == 0) {
+            testcase_assert_true(self,
+                                 ok && value == test->value &&
+                                 len == test->len && errno == 0);
+        } else {
+            testcase_assert_true(self,
+                                 !ok && base_errno == test->err &&
+                                 len == test->len && errno == 0);
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Test str_parse_int()
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_parse_int(testcase_t *self)
+{
+    const char *text = "$c000 ; start";
+    char *end = NULL;
+    int32_t value = 0;
+    bool ok;
+
+    ok = str_parse_int(text, &end, &value);
+    printf("... \"%s\": value = $%04"PRIx32", rest = \"%s\"\n",
+           text, (uint32_t)value, end);
+    testcase_assert_true(self, ok && value == 0xc000 && end == text + 5);
+    return true;
+}
+
+
+/** \brief  Create test group 'base/strings'
+ *
+ * \return  test group
+ */
+testgroup_t *get_base_strings_tests(void)
+{
+    testgroup_t *group;
+    testcase_t *test;
+
+    group = testgroup_new("base/strings",
+                          "Test the base/strings module",
+                          NULL, NULL);
+
+    test = testcase_new("scan_int",
+                        "Test the integer literal scanner",
+                        (int)(base_array_len(scan_tests)),
+                        test_scan_int, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("parse_int",
+                        "Test parsing integer literals",
+                        1, test_parse_int, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    return group;
+}
@@ -0,0 +1,244 @@
+/** \file   test_base_strlist.c
+ * \brief   Unit tests for base/strlist.c
+ *
+ * Unit tests for the string list module.
+ */
+
+/*
+cpx65 - Assembler for MOS 6502 and variants.
+Copyright (C) 2019-2022  Bas Wassink.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../base/mem.h"
+#include "../base/strlist.h"
+#include "testcase.h"
+
+#include "test_base_strlist.h"
+
+
+/** \brief  Number of strings in the 'many' test
+ */
+#define MANY_COUNT  5000
+
+
+/** \brief  Test strings, not sorted
+ */
+static const char *words[] = {
+    "lda", "sta", "jmp", "bne", "rts", "inx", "dey", "cmp", "adc", "sbc"
+};
+
+
+/** \brief  Create list with the test strings
+ *
+ * \return  new list
+ */
+static strlist_t *words_list(void)
+{
+    strlist_t *slist = strlist_init();
+
+    for (size_t i = 0; i < base_array_len(words); i++) {
+        strlist_add(slist, words[i]);
+    }
+    return slist;
+}
+
+
+/** \brief  Test adding strings
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_add(testcase_t *self)
+{
+    strlist_t *slist = words_list();
+    bool ok = true;
+
+    printf("... checking items ..\n");
+    for (size_t i = 0; i < base_array_len(words); i++) {
+        if (strcmp(strlist_item(slist, i), words[i]) != 0) {
+            ok = false;
+        }
+    }
+    testcase_assert_true(self, ok && strlist_len(slist) == base_array_len(words));
+
+    printf("... adding NULL and empty string (should be ignored) ..\n");
+    strlist_add(slist, NULL);
+    strlist_add(slist, "");
+    testcase_assert_true(self, strlist_len(slist) == base_array_len(words));
+
+    printf("... getting item out of bounds ..\n");
+    testcase_assert_true(self, strlist_item(slist, strlist_len(slist)) == NULL);
+
+    strlist_free(slist);
+    return true;
+}
+
+
+/** \brief  Test copying lists
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_dup(testcase_t *self)
+{
+    strlist_t *slist = words_list();
+    strlist_t *copy;
+
+    printf("... copying list (should share storage) ..\n");
+    copy = strlist_dup(slist);
+    testcase_assert_true(self,
+                         copy->data == slist->data && slist->data->refcount == 2 &&
+                         strcmp(strlist_item(copy, 3), "bne") == 0);
+
+    printf("... adding to the copy (should copy storage) ..\n");
+    strlist_add(copy, "nop");
+    testcase_assert_true(self,
+                         copy->data != slist->data &&
+                         strlist_len(copy) == strlist_len(slist) + 1u &&
+                         slist->data->refcount == 1 && copy->data->refcount == 1);
+
+    printf("... freeing original, copy should be intact ..\n");
+    strlist_free(slist);
+    testcase_assert_true(self,
+                         strcmp(strlist_item(copy, 0), "lda") == 0 &&
+                         strcmp(strlist_item(copy, base_array_len(words)), "nop") == 0);
+
+    strlist_free(copy);
+    return true;
+}
+
+
+/** \brief  Test sorting and finding strings
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_sort(testcase_t *self)
+{
+    strlist_t *slist = words_list();
+    strlist_t *copy = strlist_dup(slist);
+    size_t index = 0;
+    bool ok = true;
+
+    printf("... sorting list ..\n");
+    strlist_sort(slist);
+    strlist_dump(slist);
+    for (size_t i = 1; i < strlist_len(slist); i++) {
+        if (strcmp(strlist_item(slist, i - 1u), strlist_item(slist, i)) >= 0) {
+            ok = false;
+        }
+    }
+    testcase_assert_true(self,
+                         ok && strcmp(strlist_item(copy, 0), "lda") == 0);
+
+    printf("... finding 'rts' and 'nop' ..\n");
+    testcase_assert_true(self,
+                         strlist_find(slist, "rts", &index) &&
+                         strcmp(strlist_item(slist, index), "rts") == 0 &&
+                         !strlist_find(slist, "nop", NULL) &&
+                         strlist_find(copy, "rts", &index) && index == 4);
+
+    printf("... checking adding in order keeps the list sorted ..\n");
+    strlist_add(slist, "txa");
+    ok = slist->data->sorted;
+    strlist_add(slist, "asl");
+    testcase_assert_true(self, ok && !slist->data->sorted);
+
+    strlist_free(slist);
+    strlist_free(copy);
+    return true;
+}
+
+
+/** \brief  Test sorting and finding many strings
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_many(testcase_t *self)
+{
+    strlist_t *slist = strlist_init();
+    char text[32];
+    bool ok = true;
+
+    printf("... adding %d strings ..\n", MANY_COUNT);
+    for (int i = 0; i < MANY_COUNT; i++) {
+        /* scramble the order */
+        snprintf(text, sizeof text, "define_%d", (i * 7919) % MANY_COUNT);
+        strlist_add(slist, text);
+    }
+    strlist_sort(slist);
+    for (int i = 0; i < MANY_COUNT; i++) {
+        size_t index;
+
+        snprintf(text, sizeof text, "define_%d", i);
+        if (!strlist_find(slist, text, &index) ||
+                strcmp(strlist_item(slist, index), text) != 0) {
+            ok = false;
+        }
+    }
+    testcase_assert_true(self, ok && strlist_len(slist) == MANY_COUNT);
+
+    strlist_free(slist);
+    return true;
+}
+
+
+/** \brief  Create test group 'base/strlist'
+ *
+ * \return  test group
+ */
+testgroup_t *get_base_strlist_tests(void)
+{
+    testgroup_t *group;
+    testcase_t *test;
+
+    group = testgroup_new("base/strlist",
+                          "Test the base/strlist module",
+                          NULL, NULL);
+
+    test = testcase_new("add",
+                        "Test adding strings",
+                        3, test_add, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("dup",
+                        "Test copy-on-write copies",
+                        3, test_dup, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("sort",
+                        "Test sorting and finding strings",
+                        3, test_sort, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("many",
+                        "Test sorting and finding many strings",
+                        1, test_many, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    return group;
+}
@@ -21,65 +21,70 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
-#include <stdlib.h>
 #include <stdio.h>
-#include <stdint.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 
-#include "../base/debug.h"
-#include "unit.h"
+#include "../base/dict.h"
+#include "../base/error.h"
 #include "../base/mem.h"
-#include "../base/strlist.h"
 #include "../base/strpool.h"
+#include "testcase.h"
 
 #include "test_base_strpool.h"
 
 
+/** \brief  Number of strings interned by the 'many' test
+ */
+#define MANY_COUNT  50000
 
-/*
- * Forward declarations
+
+/** \brief  Number of threads in the 'threads' test
+ */
+#define THREADS_COUNT   8
+
+/** \brief  Number of strings interned by all threads in the 'threads' test
  */
+#define THREADS_SHARED  2000
 
-static bool setup(void);
-static bool teardown(void);
+/** \brief  Number of strings interned by a single thread in the 'threads' test
+ */
+#define THREADS_OWN     500
+
+
+/** \brief  State of a thread in the 'threads' test
+ */
+typedef struct thread_state_s {
+    int         id;                     /**< thread number */
+    int         errors;                 /**< number of errors */
+    uint32_t    shared[THREADS_SHARED]; /**< IDs of the shared strings */
+} thread_state_t;
 
 
-static char *list1[] = {
+/** \brief  Test strings, with duplicates
+ */
+static const char *list1[] = {
     "compyx",
-    "fucking",
     "rules",
     "and",
     "that's",
     "true",
     "also large string",
+    "compyx",
     "more",
     "bla",
     "iweurowieuroiuweorewr",
+    "and",
     "erwerwer"
 };
 
 
-#define USED_OBJLIST_SIZE   64
-
-static void *used_objects_list[USED_OBJLIST_SIZE];
-static size_t used_objects_num = 0;
-
-
-static void used_objects_add(void *obj)
-{
-    if (used_objects_num == USED_OBJLIST_SIZE) {
-        fprintf(stderr, "%s:%d:%s(): Error: object list full, aborting!\n",
-                __FILE__, __LINE__, __func__);
-        abort();
-    }
-
-    used_objects_list[used_objects_num++] = obj;
-}
-
-
-
-
+/*
+ * The pool is set up once for the whole group, so the cases use distinct
+ * strings and only check the number of strings they add themselves.
+ */
 
 static bool setup(void)
 {
@@ -89,44 +94,194 @@ static bool setup(void)
 
 static bool teardown(void)
 {
+    strpool_dump_stats();
     strpool_free();
     return true;
 }
 
 
-/*
- * Unit tests
+/** \brief  Test interning strings
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
  */
-
-/* FIXME: Write proper test */
-static bool test_add(testcase_t *self)
+static bool test_intern(testcase_t *self)
 {
-    size_t i;
-    void *obj;
+    uint32_t ids[sizeof list1 / sizeof list1[0]];
+    size_t count = strpool_count();
+    bool result = true;
 
-    for (i = 0; i < sizeof list1 / sizeof list1[0]; i++) {
-        printf("... adding '%s':\n", list1[i]);
-        obj = strpool_add(list1[i]);
-        used_objects_add(obj);
+    for (size_t i = 0; i < base_array_len(list1); i++) {
+        ids[i] = strpool_intern(list1[i]);
+        printf("... '%s' -> %"PRIu32"\n", list1[i], ids[i]);
     }
 
-    strpool_dump_stats();
+    printf("... checking duplicates got the same ID ..\n");
+    testcase_assert_true(self,
+                         ids[0] == ids[6] && ids[2] == ids[10] &&
+                         ids[0] != ids[1] && ids[0] != STRPOOL_NONE);
+
+    printf("... checking text and count ..\n");
+    for (size_t i = 0; i < base_array_len(list1); i++) {
+        if (strcmp(strpool_text(ids[i]), list1[i]) != 0 ||
+                strpool_len(ids[i]) != strlen(list1[i])) {
+            result = false;
+        }
+    }
+    testcase_assert_true(self, result && strpool_count() == count + 10u);
 
-    testcase_pass(self);
+    printf("... checking hash matches dict_hash_key() ..\n");
+    testcase_assert_true(self, strpool_hash(ids[0]) == dict_hash_key("compyx"));
     return true;
 }
 
 
+/** \brief  Test strpool_intern_len() and strpool_find()
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_intern_len(testcase_t *self)
+{
+    const char *line = "loop: dex";
+    uint32_t id;
+
+    printf("... interning 'loop' from '%s' ..\n", line);
+    id = strpool_intern_len(line, 4);
+    testcase_assert_true(self,
+                         id != STRPOOL_NONE && strcmp(strpool_text(id), "loop") == 0 &&
+                         strpool_find("loop") == id);
+
+    printf("... finding 'dex' (not interned) ..\n");
+    testcase_assert_true(self, strpool_find("dex") == STRPOOL_NONE);
+
+    printf("... getting text of invalid ID (should fail) ..\n");
+    base_errno = 0;
+    testcase_assert_true(self,
+                         strpool_text(STRPOOL_NONE) == NULL &&
+                         base_errno == BASE_ERR_INDEX);
+    return true;
+}
+
+
+/** \brief  Test interning many strings
+ *
+ * IDs and text pointers must survive the pool growing.
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_many(testcase_t *self)
+{
+    uint32_t first_id = strpool_intern("many0");
+    const char *first_text = strpool_text(first_id);
+    char text[32];
+    bool result = true;
+
+    printf("... interning %d strings twice ..\n", MANY_COUNT);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < MANY_COUNT; i++) {
+            uint32_t id;
+
+            snprintf(text, sizeof text, "many%d", i);
+            id = strpool_intern(text);
+            if (id == STRPOOL_NONE || strcmp(strpool_text(id), text) != 0) {
+                result = false;
+            }
+        }
+    }
+    testcase_assert_true(self,
+                         result && strpool_intern("many0") == first_id &&
+                         strpool_text(first_id) == first_text);
+    return true;
+}
+
 
-static bool test_del(testcase_t *self)
+/** \brief  Intern shared and thread-specific strings
+ *
+ * \param[in,out]   arg thread state
+ *
+ * \return  `NULL`
+ */
+static void *intern_thread(void *arg)
 {
-    void *obj;
+    thread_state_t *state = arg;
+    char text[32];
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < THREADS_SHARED; i++) {
+            uint32_t id;
+
+            /* start at a different offset in each thread */
+            int n = (i + state->id * (THREADS_SHARED / THREADS_COUNT)) % THREADS_SHARED;
+
+            snprintf(text, sizeof text, "shared%d", n);
+            id = strpool_intern(text);
+            if (pass == 0) {
+                state->shared[n] = id;
+            } else if (state->shared[n] != id) {
+                state->errors++;
+            }
+            if (i < THREADS_OWN) {
+                snprintf(text, sizeof text, "thread%d_%d", state->id, i);
+                id = strpool_intern(text);
+                if (id == STRPOOL_NONE || strcmp(strpool_text(id), text) != 0) {
+                    state->errors++;
+                }
+            }
+        }
+    }
+    return NULL;
+}
 
-    obj = used_objects_list[0];
-    strpool_del(obj);
-    used_objects_list[0] = NULL;
 
-    testcase_pass(self);
+/** \brief  Test interning from multiple threads
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_threads(testcase_t *self)
+{
+    static thread_state_t states[THREADS_COUNT];
+    pthread_t threads[THREADS_COUNT];
+    size_t count = strpool_count();
+    int errors = 0;
+    char text[32];
+
+    printf("... running %d threads ..\n", THREADS_COUNT);
+    for (int t = 0; t < THREADS_COUNT; t++) {
+        states[t].id = t;
+        states[t].errors = 0;
+        if (pthread_create(&threads[t], NULL, intern_thread, &states[t]) != 0) {
+            fprintf(stderr, "%s(): failed to create thread\n", __func__);
+            return false;
+        }
+    }
+    for (int t = 0; t < THREADS_COUNT; t++) {
+        pthread_join(threads[t], NULL);
+        errors += states[t].errors;
+    }
+    printf("... %d errors, %zu strings added\n", errors, strpool_count() - count);
+    testcase_assert_true(self,
+                         errors == 0 &&
+                         strpool_count() - count ==
+                         THREADS_SHARED + THREADS_COUNT * THREADS_OWN);
+
+    printf("... checking all threads got the same IDs ..\n");
+    for (int i = 0; i < THREADS_SHARED; i++) {
+        snprintf(text, sizeof text, "shared%d", i);
+        for (int t = 0; t < THREADS_COUNT; t++) {
+            if (states[t].shared[i] != states[0].shared[i] ||
+                    strcmp(strpool_text(states[t].shared[i]), text) != 0) {
+                errors++;
+            }
+        }
+    }
+    testcase_assert_true(self, errors == 0);
     return true;
 }
 
@@ -144,14 +299,24 @@ testgroup_t *get_base_strpool_tests(void)
                           "Test the string pool module",
                           setup, teardown);
 
-    test = testcase_new("add",
-                        "Test adding items to a string pool",
-                        1, test_add, NULL, NULL);
+    test = testcase_new("intern",
+                        "Test interning strings",
+                        3, test_intern, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("intern_len",
+                        "Test interning part of a string",
+                        3, test_intern_len, NULL, NULL);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("many",
+                        "Test interning many strings",
+                        1, test_many, NULL, NULL);
     testgroup_add_case(group, test);
 
-    test = testcase_new("del",
-                        "Test deleting items from a string pool",
-                        1, test_del, NULL, NULL);
+    test = testcase_new("threads",
+                        "Test interning strings from multiple threads",
+                        2, test_threads, NULL, NULL);
     testgroup_add_case(group, test);
 
     return group;
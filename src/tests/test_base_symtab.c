@@ -27,77 +27,292 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdbool.h>
 #include <string.h>
 
-#include "unit.h"
-#include "../base/debug.h"
+#include "../base/error.h"
 #include "../base/mem.h"
+#include "../base/strpool.h"
 #include "../base/symtab.h"
-#include "../base/helpers.h"
+#include "testcase.h"
 
-#include "test_mem.h"
+#include "test_base_symtab.h"
 
 
-static bool test_add_symbols(int *total, int *passed);
+/** \brief  Number of symbols added by the 'many' test
+ */
+#define MANY_COUNT  100000
 
 
-/** \brief  List of subtests
+/** \brief  Nesting depth of the tables added by the 'nested' test
  */
-static unit_test_t tests[] = {
-    { "add", "Test adding symbols", test_add_symbols, false },
-    { NULL, NULL, NULL, false }
-};
+#define NESTED_DEPTH    100000
+
+/** \brief  Symbol table for tests
+ */
+static symtab_t table;
 
 
-/** \brief  Public unit test module
+/** \brief  Test labels
  */
-unit_module_t symtab_module = {
-    "symtab",
-    "Test base/symtab",
-    NULL, NULL,
-    0, 0,
-    tests
+static const char *labels[] = {
+    "foo", "bar", "huppel", "compyx", "is", "very", "great", "and", "awesome"
 };
 
 
-static bool test_add_symbols(int *total, int *passed)
+static bool setup(void)
 {
-    symtab_t table;
-    symtab_node_t *result;
-    size_t i;
+    strpool_init();
+    symtab_init(&table);
+    return true;
+}
+
+static bool teardown(void)
+{
+    symtab_free(&table);
+    strpool_free();
+    return true;
+}
 
-    const char *labels[] = {
-        "foo", "bar", "huppel", "compyx", "is", "very", "great", "and", "awesome"
-    };
 
-    symtab_init(&table);
+/** \brief  Add the test labels
+ *
+ * \return  `false` if a label wasn't added
+ */
+static bool add_labels(void)
+{
+    for (size_t i = 0; i < base_array_len(labels); i++) {
+        bool added = false;
 
-    (*total)++;
-    for (i = 0; i < BASE_ARRAY_SIZE(labels); i++) {
-        printf("...... adding '%s' .. ", labels[i]);
-        result = symtab_add(&table, labels[i]);
-        if (result == NULL) {
-            /* unexpected failure */
-            printf("failed!\n");
-            symtab_free(&table);
+        if (symtab_add(&table, labels[i], &added) == NULL || !added) {
+            printf("... adding '%s' failed\n", labels[i]);
             return false;
         }
-        printf("OK.\n");
     }
-    printf("...... dumping symbols in order:\n");
+    return true;
+}
+
+
+/** \brief  Check if the sorted view of the test table is sorted
+ *
+ * \return  `true` if sorted
+ */
+static bool is_sorted(void)
+{
+    symtab_symbol_t **sorted = symtab_sorted(&table);
+
+    for (size_t i = 1; i < symtab_count(&table); i++) {
+        if (strcmp(sorted[i - 1u]->name, sorted[i]->name) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Test adding symbols
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_add(testcase_t *self)
+{
+    symtab_symbol_t *first;
+    symtab_symbol_t *again;
+    bool added = true;
+
+    printf("... adding %zu symbols ..\n", base_array_len(labels));
+    testcase_assert_true(self, add_labels());
+
+    /* adding an existing symbol returns the existing symbol */
+    printf("... adding existing symbol 'compyx' ..\n");
+    first = symtab_find(&table, "compyx");
+    again = symtab_add(&table, "compyx", &added);
+    testcase_assert_true(self,
+                         again != NULL && again == first && !added &&
+                         symtab_count(&table) == base_array_len(labels));
+
+    printf("... adding empty name (should fail) ..\n");
+    base_errno = 0;
+    testcase_assert_true(self,
+                         symtab_add(&table, "", NULL) == NULL &&
+                         base_errno == BASE_ERR_KEY);
+    return true;
+}
+
+
+/** \brief  Test finding symbols
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_find(testcase_t *self)
+{
+    symtab_symbol_t *symbol;
+
+    if (!add_labels()) {
+        return false;
+    }
+
+    printf("... finding 'huppel' ..\n");
+    symbol = symtab_find(&table, "huppel");
+    testcase_assert_true(self,
+                         symbol != NULL && strcmp(symbol->name, "huppel") == 0 &&
+                         symbol->type == SYM_ILL);
+
+    printf("... finding 'nope' (should fail) ..\n");
+    testcase_assert_true(self, symtab_find(&table, "nope") == NULL);
+    return true;
+}
+
+
+/** \brief  Test the sorted view
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_sorted(testcase_t *self)
+{
+    if (!add_labels()) {
+        return false;
+    }
+
+    printf("... dumping symbols in order:\n");
     symtab_dump(&table);
-    (*passed)++;
-
-    /* add existing symbol: expected result: fail */
-    (*total)++;
-    printf("...... adding existing symbol 'compyx' .. ");
-    result = symtab_add(&table, "compyx");
-    if (result != NULL) {
-        printf("OK (unexpected, failure)\n");
-    } else {
-        printf("failed (expected, OK)\n");
-        (*passed)++;
+    testcase_assert_true(self, is_sorted());
+
+    /* merged into the existing sorted list */
+    printf("... adding 'zzz', 'aaa' and 'mmm' ..\n");
+    symtab_add(&table, "zzz", NULL);
+    symtab_add(&table, "aaa", NULL);
+    symtab_add(&table, "mmm", NULL);
+    testcase_assert_true(self,
+                         is_sorted() &&
+                         strcmp(symtab_sorted(&table)[0]->name, "aaa") == 0 &&
+                         symtab_count(&table) == base_array_len(labels) + 3u);
+    return true;
+}
+
+
+/** \brief  Test adding many symbols in sorted order
+ *
+ * Sorted input used to turn the old binary tree into a linked list.
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_many(testcase_t *self)
+{
+    char name[32];
+    bool result = true;
+
+    printf("... adding %d symbols in sorted order ..\n", MANY_COUNT);
+    for (int i = 0; i < MANY_COUNT; i++) {
+        snprintf(name, sizeof name, "label%06d", i);
+        symtab_add(&table, name, NULL);
     }
+    printf("... finding all of them ..\n");
+    for (int i = 0; i < MANY_COUNT; i++) {
+        symtab_symbol_t *symbol;
 
-    symtab_free(&table);
+        snprintf(name, sizeof name, "label%06d", i);
+        symbol = symtab_find(&table, name);
+        if (symbol == NULL || strcmp(symbol->name, name) != 0) {
+            result = false;
+        }
+    }
+    testcase_assert_true(self,
+                         result && symtab_count(&table) == MANY_COUNT &&
+                         is_sorted());
+    return true;
+}
+
+
+/** \brief  Test freeing nested symbol tables
+ *
+ * \param[in]   self    test case
+ *
+ * \return  false on fatal error
+ */
+static bool test_nested(testcase_t *self)
+{
+    symtab_symbol_t *scope;
+    symtab_t *child;
+    symtab_t *parent;
+    int depth = 0;
+
+    printf("... adding child table 'sprites' with symbol 'player' ..\n");
+    child = base_malloc(sizeof *child);
+    symtab_init(child);
+    symtab_add(child, "player", NULL);
+    scope = symtab_add(&table, "sprites", NULL);
+    scope->type = SYM_SYMTAB;
+    scope->object = child;
 
+    /* freed by teardown(), use ASan/valgrind to check for leaks */
+    testcase_assert_true(self,
+                         symtab_find(symtab_find(&table, "sprites")->object,
+                                     "player") != NULL);
+
+    printf("... nesting %d tables named 'inner' ..\n", NESTED_DEPTH);
+    parent = &table;
+    for (int i = 0; i < NESTED_DEPTH; i++) {
+        child = base_malloc(sizeof *child);
+        symtab_init(child);
+        scope = symtab_add(parent, "inner", NULL);
+        scope->type = SYM_SYMTAB;
+        scope->object = child;
+        parent = child;
+    }
+    for (parent = &table;
+            (scope = symtab_find(parent, "inner")) != NULL;
+            parent = scope->object) {
+        depth++;
+    }
+    /* freeing them mustn't recurse */
+    testcase_assert_true(self, depth == NESTED_DEPTH);
     return true;
 }
+
+
+/** \brief  Create test group 'base/symtab'
+ *
+ * \return  test group
+ */
+testgroup_t *get_base_symtab_tests(void)
+{
+    testgroup_t *group;
+    testcase_t *test;
+
+    group = testgroup_new("base/symtab",
+                          "Test the base/symtab module",
+                          NULL, NULL);
+
+    test = testcase_new("add",
+                        "Test adding symbols",
+                        3, test_add, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("find",
+                        "Test finding symbols",
+                        2, test_find, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("sorted",
+                        "Test the sorted view",
+                        2, test_sorted, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("many",
+                        "Test adding many symbols in sorted order",
+                        1, test_many, setup, teardown);
+    testgroup_add_case(group, test);
+
+    test = testcase_new("nested",
+                        "Test nested symbol tables",
+                        2, test_nested, setup, teardown);
+    testgroup_add_case(group, test);
+
+    return group;
+}
@@ -24,8 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef TESTS_TEST_BASE_SYMTAB_H
 #define TESTS_TEST_BASE_SYMTAB_H
 
-#include "unit.h"
 
-extern unit_module_t symtab_module;
+testgroup_t *get_base_symtab_tests(void);
 
 #endif
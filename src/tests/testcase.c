@@ -464,7 +464,48 @@ void testgroup_list_cases(const testgroup_t *group)
 }
 
 
+/** \brief  Call setup function of \a group, if any
+ *
+ * \param[in]   group   test group
+ *
+ * \return  false on fatal error
+ */
+static bool testgroup_setup(testgroup_t *group)
+{
+    if (group->setup != NULL) {
+        printf(". calling group setup().\n");
+        if (!group->setup()) {
+            printf(". fatal error during group setup, aborting.\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Call teardown function of \a group, if any
+ *
+ * \param[in]   group   test group
+ *
+ * \return  false on fatal error
+ */
+static bool testgroup_teardown(testgroup_t *group)
+{
+    if (group->teardown != NULL) {
+        printf(". calling group teardown().\n");
+        if (!group->teardown()) {
+            printf(". fatal error during group teardown, aborting.\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+
 /** \brief  Execute all test cases in a test group
+ *
+ * The group's setup() is called before the first case and its teardown()
+ * after the last case.
  *
  * \param[in]   group   test group
  *
@@ -475,19 +516,26 @@ bool testgroup_exec_cases(testgroup_t *group)
     printf("running all cases of group '%s%s%s':\n",
            LMAGENTA, group->name, RESET);
 
+    if (!testgroup_setup(group)) {
+        return false;
+    }
     for (int c = 0; c < group->case_count; c++) {
         testcase_t *test = group->cases[c];
 
         printf(". case %d of %d:\n", group->case_current, group->case_count);
         if (!testcase_exec(test)) {
+            testgroup_teardown(group);
             return false;
         }
         group->case_current++;
         group->tests_count += test->count;
         group->tests_passed += test->passed;
     }
+    if (!testgroup_teardown(group)) {
+        return false;
+    }
     printf(". %d of %d tests of '%s%s%s' passed.\n",
-           group->tests_count, group->tests_passed,
+           group->tests_passed, group->tests_count,
            LMAGENTA, group->name, RESET);
 
     return true;
@@ -511,5 +559,12 @@ bool testgroup_exec_case(testgroup_t *group, const char *name)
         fprintf(stderr, "error: unknown case '%s'.\n", name);
         return false;
     }
-    return testcase_exec(test);
+    if (!testgroup_setup(group)) {
+        return false;
+    }
+    if (!testcase_exec(test)) {
+        testgroup_teardown(group);
+        return false;
+    }
+    return testgroup_teardown(group);
 }
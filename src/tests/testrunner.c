@@ -34,27 +34,35 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "testcase.h"
 
 #include "test_testcase.h"
+#include "test_base_cdict.h"
 #include "test_base_cpu.h"
 #include "test_base_dict.h"
+#include "test_base_expr.h"
+#include "test_base_hash.h"
 #include "test_base_io.h"
 #include "test_base_mem.h"
 #include "test_base_objpool.h"
 #include "test_base_operators.h"
+#include "test_base_resolver.h"
+#include "test_base_scope.h"
+#include "test_base_strings.h"
+#include "test_base_strlist.h"
 #include "test_base_strpool.h"
+#include "test_base_symtab.h"
 //#include "test_keywords.h"
 
 
 /** \brief  Command line option: disable colored output (--no-color)
  */
-static bool opt_no_color = false;
+static int opt_no_color = 0;
 
 /** \brief  Command line option: List groups and their cases (--list-all)
  */
-static bool opt_list_all = false;
+static int opt_list_all = 0;
 
 /** \brief  Command line option: List groups (--list-groups)
  */
-static bool opt_list_groups = false;
+static int opt_list_groups = 0;
 
 /** \brief  Command line option: List cases of a group (--list-cases \<group\>)
  */
@@ -62,7 +70,7 @@ static char *opt_list_cases = NULL;
 
 /** \brief  Command line option: Execute all cases in all groups (-a)
  */
-static bool opt_exec_all = false;
+static int opt_exec_all = 0;
 
 /** \brief  Command line option: Execute all cases in a group (-g)
  */
@@ -156,13 +164,21 @@ static void register_groups(void)
     register_group(get_testcase_tests());
  //   register_group(get_keywords_tests());
  //
+    register_group(get_base_cdict_tests());
     register_group(get_base_cpu_tests());
     register_group(get_base_dict_tests());
+    register_group(get_base_expr_tests());
+    register_group(get_base_hash_tests());
     register_group(get_base_io_tests());
     register_group(get_base_mem_tests());
     register_group(get_base_objpool_tests());
     register_group(get_base_operators_tests());
+    register_group(get_base_resolver_tests());
+    register_group(get_base_scope_tests());
+    register_group(get_base_strings_tests());
+    register_group(get_base_strlist_tests());
     register_group(get_base_strpool_tests());
+    register_group(get_base_symtab_tests());
 }
 
 